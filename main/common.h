@@ -18,6 +18,9 @@
  * @file common.h
  * @brief this file contain common macros and definitions used across the project.
  *
+ * With CONFIG_LOG_RING_ENABLE the LOG macro writes a binary record to the
+ * asynchronous log ring (log_ring.h) and returns; the text is formatted and
+ * printed later by the drain task.
  * 
  * @author Marconatale Parise
  * @date 19 Feb 2026
@@ -30,6 +33,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "esp_log.h"
+#include "log_ring.h"
 
 
 #ifndef __COMMON_H__
@@ -43,7 +47,11 @@
 #define DEBUG_DAC 0
 
 #if DEBUG
+#if CONFIG_LOG_RING_ENABLE
+#define LOG(x,...) if(DEBUG){ LOG_RING(ESP_LOG_INFO, "APP", x, ##__VA_ARGS__);}
+#else
 #define LOG(x,...) if(DEBUG){ ESP_LOGI("APP", x, ##__VA_ARGS__);}
+#endif
 #define LOG_ADC(x,...) if(DEBUG_ADC){ ESP_LOGI("ADC_HAL", x, ##__VA_ARGS__);}
 #define LOG_GPIO(x,...) if(DEBUG_GPIO){ ESP_LOGI("GPIO_HAL", x, ##__VA_ARGS__);}
 #define LOG_BT(x,...) if(DEBUG_BT){ ESP_LOGI("BT_HAL", x, ##__VA_ARGS__);}
@@ -0,0 +1,228 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_evt.c
+ * @brief Lock-free ISR -> task ring of timestamped, debounced GPIO edges
+ *
+ * @author Marconatale Parise
+ * @date 18 Mar 2026
+ */
+#include "gpio_evt.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/task.h"
+
+static const char *TAG = "gpio_evt";
+
+#define RING_LEN    CONFIG_GPIO_EVT_RING_LEN
+#define RING_MASK   (RING_LEN - 1)
+
+_Static_assert((RING_LEN & RING_MASK) == 0, "CONFIG_GPIO_EVT_RING_LEN must be a power of two");
+_Static_assert(GPIO_NUM_MAX <= 64, "settle mask holds one bit per GPIO");
+
+typedef struct {
+    uint32_t debounce_cycles;
+    uint32_t last_cycles;       /* last accepted edge */
+    uint8_t  level;             /* level after the last accepted edge */
+    bool     used;
+} pin_state_t;
+
+/* head is written by the ISR, or by the consumer with the ISR masked on its core;
+ * tail by the consumer only */
+static gpio_evt_t s_ring[RING_LEN];
+static atomic_uint s_head;
+static atomic_uint s_tail;
+static pin_state_t s_pin[GPIO_NUM_MAX];
+static volatile uint64_t s_settle;  /* pins whose last edge fell in the debounce window */
+static portMUX_TYPE s_settle_lock = portMUX_INITIALIZER_UNLOCKED;
+static gpio_evt_stats_t s_stats;
+static TaskHandle_t s_consumer;
+static bool s_ready;
+
+static inline bool IRAM_ATTR ring_push(uint32_t now, gpio_num_t gpio, uint8_t level)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+    if (head - tail >= RING_LEN) {
+        s_stats.overflows++;
+        return false;
+    }
+    s_ring[head & RING_MASK] = (gpio_evt_t){ .cycles = now, .gpio = (uint8_t)gpio, .level = level };
+    atomic_store_explicit(&s_head, head + 1, memory_order_release);
+    s_stats.events++;
+    return true;
+}
+
+static void IRAM_ATTR gpio_evt_isr(void *arg)
+{
+    uint32_t now = esp_cpu_get_cycle_count();
+    gpio_num_t gpio = (gpio_num_t)(uintptr_t)arg;
+    pin_state_t *p = &s_pin[gpio];
+    uint8_t level = (uint8_t)gpio_get_level(gpio);
+    BaseType_t woken = pdFALSE;
+
+    if (level == p->level) return;                      /* bounce already filtered, line back */
+    if (now - p->last_cycles < p->debounce_cycles) {    /* unsigned: wrap safe */
+        s_stats.bounces++;
+        /* The line may stay at this level: have the consumer re-read it once the window ends */
+        uint64_t bit = 1ULL << gpio;
+        if (!(s_settle & bit)) {
+            s_settle |= bit;
+            vTaskNotifyGiveFromISR(s_consumer, &woken);
+            portYIELD_FROM_ISR(woken);
+        }
+        return;
+    }
+    p->level = level;
+    p->last_cycles = now;
+    if (!ring_push(now, gpio, level)) return;
+
+    vTaskNotifyGiveFromISR(s_consumer, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static esp_err_t pin_arm(gpio_num_t gpio)
+{
+    pin_state_t *p = &s_pin[gpio];
+    p->level = (uint8_t)gpio_get_level(gpio);
+    p->last_cycles = esp_cpu_get_cycle_count() - p->debounce_cycles;
+    esp_err_t err = gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+    if (err == ESP_OK) err = gpio_isr_handler_add(gpio, gpio_evt_isr, (void *)(uintptr_t)gpio);
+    return err;
+}
+
+esp_err_t gpio_evt_init(void)
+{
+    if (s_ready) return ESP_OK;
+    s_consumer = xTaskGetCurrentTaskHandle();
+    atomic_store(&s_head, 0);
+    atomic_store(&s_tail, 0);
+    s_settle = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    /* Installed from the consumer task: the ISR runs on the same core */
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "ISR service install failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_ready = true;
+    for (int gpio = 0; gpio < GPIO_NUM_MAX; gpio++) {
+        if (!s_pin[gpio].used) continue;
+        err = pin_arm((gpio_num_t)gpio);
+        if (err != ESP_OK) return err;
+    }
+    ESP_LOGI(TAG, "Event ring: %d entries", RING_LEN);
+    return ESP_OK;
+}
+
+esp_err_t gpio_evt_add_pin(gpio_num_t gpio, uint32_t debounce_us)
+{
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    pin_state_t *p = &s_pin[gpio];
+    p->debounce_cycles = debounce_us * esp_rom_get_cpu_ticks_per_us();
+    p->used = true;
+    return s_ready ? pin_arm(gpio) : ESP_OK;
+}
+
+esp_err_t gpio_evt_remove_pin(gpio_num_t gpio)
+{
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (!s_pin[gpio].used) return ESP_OK;
+    s_pin[gpio].used = false;
+    if (!s_ready) return ESP_OK;
+    gpio_set_intr_type(gpio, GPIO_INTR_DISABLE);
+    return gpio_isr_handler_remove(gpio);
+}
+
+/* Push the settled level of pins whose debounce window swallowed an edge and has since
+ * ended. Returns the ticks until the next pending window ends, portMAX_DELAY if none. */
+static TickType_t settle_pins(void)
+{
+    if (!s_settle) return portMAX_DELAY;
+
+    TickType_t wait = portMAX_DELAY;
+    /* Masks the ISR, which runs on this core: the consumer is the only producer meanwhile */
+    portENTER_CRITICAL(&s_settle_lock);
+    uint32_t now = esp_cpu_get_cycle_count();
+    uint64_t pending = s_settle;
+    while (pending) {
+        gpio_num_t gpio = (gpio_num_t)__builtin_ctzll(pending);
+        pending &= pending - 1;
+        pin_state_t *p = &s_pin[gpio];
+        uint32_t since = now - p->last_cycles;
+        if (p->used && since < p->debounce_cycles) {
+            uint32_t left_us = (p->debounce_cycles - since) / esp_rom_get_cpu_ticks_per_us();
+            TickType_t ticks = pdMS_TO_TICKS(left_us / 1000) + 1;
+            if (ticks < wait) wait = ticks;
+            continue;
+        }
+        s_settle &= ~(1ULL << gpio);
+        uint8_t level = (uint8_t)gpio_get_level(gpio);
+        if (!p->used || level == p->level) continue;
+        p->level = level;
+        p->last_cycles = now;
+        if (ring_push(now, gpio, level)) s_stats.settled++;
+    }
+    portEXIT_CRITICAL(&s_settle_lock);
+    return wait;
+}
+
+size_t gpio_evt_read(gpio_evt_t *out, size_t max, TickType_t timeout)
+{
+    if (!s_ready || !out || max == 0) return 0;
+
+    TimeOut_t to;
+    vTaskSetTimeOutState(&to);
+    size_t n;
+    for (;;) {
+        TickType_t settle = settle_pins();
+        unsigned tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+        n = head - tail;
+        if (n > 0) {
+            if (n > max) n = max;
+            for (size_t i = 0; i < n; i++) {
+                out[i] = s_ring[(tail + i) & RING_MASK];
+            }
+            atomic_store_explicit(&s_tail, tail + n, memory_order_release);
+            break;
+        }
+        if (xTaskCheckForTimeOut(&to, &timeout) == pdTRUE) return 0;
+        /* A push between the check and the wait leaves a pending notification */
+        ulTaskNotifyTake(pdTRUE, settle < timeout ? settle : timeout);
+    }
+    if (n > s_stats.max_batch) s_stats.max_batch = n;
+    return n;
+}
+
+int64_t gpio_evt_age_us(const gpio_evt_t *ev)
+{
+    return (uint32_t)(esp_cpu_get_cycle_count() - ev->cycles) / esp_rom_get_cpu_ticks_per_us();
+}
+
+void gpio_evt_get_stats(gpio_evt_stats_t *out)
+{
+    if (out) *out = s_stats;
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_evt.h
+ * @brief Lock-free ISR -> task ring of timestamped, debounced GPIO edges
+ *
+ * A single GPIO ISR handler serves every registered input pin. It reads the
+ * pin level and the CPU cycle counter, drops edges closer than the pin's
+ * debounce time to the last accepted one, and pushes a gpio_evt_t record into
+ * one single-producer/single-consumer ring shared by all pins. When the ring is
+ * full the edge is counted as an overflow and dropped. One consumer task
+ * drains the ring in batches with gpio_evt_read().
+ *
+ * An edge dropped by the debounce filter marks the pin for a settle check: once
+ * the window has ended, gpio_evt_read() samples the pin again and pushes an
+ * event if the line stayed at a level other than the last reported one, so a
+ * change that bounced inside the window is not lost.
+ *
+ * Pins are armed on any edge: the record carries the level after the edge, so
+ * the consumer does not need to sample the pin again.
+ *
+ * The ISR service is installed from gpio_evt_init(), so the handler runs on the
+ * consumer's core and timestamps (that core's cycle counter) can be compared
+ * with esp_cpu_get_cycle_count() by the consumer. The counter wraps every
+ * 2^32 cycles (about 17 s at 240 MHz).
+ *
+ * The following functions are provided:
+ * - gpio_evt_init(): Install the ISR service and bind the consumer task.
+ * - gpio_evt_add_pin(): Register an input pin with its debounce time.
+ * - gpio_evt_remove_pin(): Unregister a pin.
+ * - gpio_evt_read(): Drain a batch of events, blocking until one is available.
+ * - gpio_evt_age_us(): Time elapsed since an event.
+ * - gpio_evt_get_stats(): Event, bounce and overflow counters.
+ *
+ * @author Marconatale Parise
+ * @date 18 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One accepted GPIO edge
+ */
+typedef struct {
+    uint32_t cycles;    /*!< CPU cycle count at the edge (ISR core) */
+    uint8_t  gpio;      /*!< GPIO number */
+    uint8_t  level;     /*!< Level after the edge */
+    uint16_t reserved;
+} gpio_evt_t;
+
+/**
+ * @brief Ring counters (since gpio_evt_init())
+ */
+typedef struct {
+    uint32_t events;        /*!< Edges pushed into the ring */
+    uint32_t bounces;       /*!< Edges dropped by the debounce filter */
+    uint32_t overflows;     /*!< Edges dropped because the ring was full */
+    uint32_t settled;       /*!< Events pushed by the settle check after a debounce window */
+    uint32_t max_batch;     /*!< Largest batch returned by gpio_evt_read() */
+} gpio_evt_stats_t;
+
+/**
+ * @brief Install the GPIO ISR service and make the calling task the consumer
+ *
+ * Must be called from the consumer task. Pins registered before are armed.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_evt_init(void);
+
+/**
+ * @brief Register an input pin (already configured as input)
+ *
+ * The pin interrupt is set to any edge. It is armed immediately if the ring is
+ * initialized, otherwise by gpio_evt_init().
+ *
+ * @param gpio        GPIO number
+ * @param debounce_us Minimum time between two accepted edges
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_evt_add_pin(gpio_num_t gpio, uint32_t debounce_us);
+
+/**
+ * @brief Unregister a pin and disable its interrupt
+ *
+ * @param gpio GPIO number
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_evt_remove_pin(gpio_num_t gpio);
+
+/**
+ * @brief Drain up to max events, oldest first (consumer task only)
+ *
+ * Also runs the settle check of pins whose debounce window has ended, waking up
+ * early for it when one is pending.
+ *
+ * @param[out] out  Event buffer
+ * @param max       Capacity of out
+ * @param timeout   Ticks to wait when the ring is empty
+ *
+ * @return Number of events copied, 0 on timeout
+ */
+size_t gpio_evt_read(gpio_evt_t *out, size_t max, TickType_t timeout);
+
+/**
+ * @brief Microseconds elapsed since an event (consumer task only)
+ *
+ * @param ev Event returned by gpio_evt_read()
+ *
+ * @return Age of the event
+ */
+int64_t gpio_evt_age_us(const gpio_evt_t *ev);
+
+/**
+ * @brief Read the ring counters
+ *
+ * @param[out] out Counters
+ */
+void gpio_evt_get_stats(gpio_evt_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,522 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file log_ring.c
+ * @brief Asynchronous binary logger: per-core lock-free rings, deferred formatting
+ *
+ * @author Marconatale Parise
+ * @date 24 Mar 2026
+ */
+#include "log_ring.h"
+
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+#include "sys_mon.h"
+
+static const char *TAG = "log_ring";
+
+#if CONFIG_LOG_RING_ENABLE
+
+#define RING_SIZE       CONFIG_LOG_RING_SIZE
+#define RING_MASK       (RING_SIZE - 1)
+#define DRAIN_STACK     3072
+#define DRAIN_PRIO      1                   /* with the application tasks: never ahead of them */
+#define DRAIN_RETRY_MS  5                   /* a producer is between reserve and publish */
+#define HDR_READY       0x80000000u
+#define HDR_PAD         0x40000000u
+#define HDR_LEN_MASK    0x0000FFFFu
+#define REC_MAX         256                 /* largest record, bytes */
+#define LINE_LEN        256
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "CONFIG_LOG_RING_SIZE must be a power of two");
+_Static_assert(REC_MAX <= RING_SIZE / 4, "CONFIG_LOG_RING_SIZE too small");
+
+/* Fixed part of a record, after the header word */
+typedef struct {
+    const char *fmt;
+    const char *tag;
+    int64_t     ts_us;
+    uint8_t     level;
+    uint8_t     nargs;
+} rec_meta_t;
+
+/*
+ * One ring per core. head is advanced by producers (CAS), tail by the drain
+ * task only. A record starts with a header word that is written last; the
+ * drain task zeroes what it consumed, so a header slot reads "not ready"
+ * until its producer publishes it.
+ */
+typedef struct {
+    uint8_t     buf[RING_SIZE] __attribute__((aligned(4)));
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint records;
+    atomic_uint dropped;
+} ring_t;
+
+static ring_t s_ring[portNUM_PROCESSORS];
+static TaskHandle_t s_drain;
+static atomic_uint s_printed;
+static uint32_t s_max_fill;
+static uint8_t s_rec[REC_MAX] __attribute__((aligned(4)));   /* drain task scratch */
+static char s_line[LINE_LEN];
+
+static inline size_t align4(size_t len)
+{
+    return (len + 3) & ~(size_t)3;
+}
+
+static size_t arg_size(const log_ring_arg_t *a, uint8_t *str_len)
+{
+    switch (a->type) {
+    case LOG_RING_T_INT64:
+    case LOG_RING_T_DOUBLE:
+        return 8;
+    case LOG_RING_T_STR:
+        *str_len = a->s ? (uint8_t)strnlen(a->s, LOG_RING_STR_MAX) : 0;
+        return 1 + *str_len;
+    default:
+        return 4;
+    }
+}
+
+/* Reserve len bytes (4-aligned) of contiguous space; a record never wraps, the tail end is padded */
+static uint8_t *ring_reserve(ring_t *r, uint32_t len, bool *was_empty)
+{
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned pad, next;
+    do {
+        unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        unsigned off = head & RING_MASK;
+        pad = (off + len > RING_SIZE) ? RING_SIZE - off : 0;
+        next = head + pad + len;
+        if (next - tail > RING_SIZE) return NULL;
+        *was_empty = head == tail;
+    } while (!atomic_compare_exchange_weak_explicit(&r->head, &head, next,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+    if (pad) {
+        atomic_store_explicit((atomic_uint *)&r->buf[head & RING_MASK], HDR_READY | HDR_PAD | pad,
+                              memory_order_release);
+    }
+    return &r->buf[(head + pad) & RING_MASK];
+}
+
+void log_ring_write(esp_log_level_t level, const char *tag, const char *fmt, const log_ring_arg_t *args,
+                    size_t nargs)
+{
+    if (nargs > LOG_RING_MAX_ARGS) nargs = LOG_RING_MAX_ARGS;
+    uint8_t str_len[LOG_RING_MAX_ARGS] = {0};
+    size_t len = 4 + sizeof(rec_meta_t) + nargs;
+    for (size_t i = 0; i < nargs; i++) len += arg_size(&args[i], &str_len[i]);
+    len = align4(len);
+
+    ring_t *r = &s_ring[esp_cpu_get_core_id()];
+    bool was_empty = false;
+    uint8_t *rec = len <= REC_MAX ? ring_reserve(r, len, &was_empty) : NULL;
+    if (!rec) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    rec_meta_t meta = {
+        .fmt = fmt, .tag = tag, .ts_us = esp_timer_get_time(), .level = (uint8_t)level, .nargs = (uint8_t)nargs,
+    };
+    uint8_t *p = rec + 4;
+    memcpy(p, &meta, sizeof(meta));
+    p += sizeof(meta);
+    for (size_t i = 0; i < nargs; i++) *p++ = args[i].type;
+    for (size_t i = 0; i < nargs; i++) {
+        const log_ring_arg_t *a = &args[i];
+        switch (a->type) {
+        case LOG_RING_T_INT64:
+            memcpy(p, &a->i, 8);
+            p += 8;
+            break;
+        case LOG_RING_T_DOUBLE:
+            memcpy(p, &a->d, 8);
+            p += 8;
+            break;
+        case LOG_RING_T_STR:
+            *p++ = str_len[i];
+            memcpy(p, a->s, str_len[i]);
+            p += str_len[i];
+            break;
+        default: {
+            int32_t v = (int32_t)a->i;
+            memcpy(p, &v, 4);
+            p += 4;
+            break;
+        }
+        }
+    }
+    /* Publish: the drain task reads nothing of the record before this store */
+    atomic_store_explicit((atomic_uint *)rec, HDR_READY | (uint32_t)len, memory_order_release);
+    atomic_fetch_add_explicit(&r->records, 1, memory_order_relaxed);
+    if (was_empty && s_drain) xTaskNotifyGive(s_drain);
+}
+
+/* ---- Drain side ---- */
+
+typedef struct {
+    const uint8_t *types;
+    const uint8_t *vals;
+    size_t         left;
+} arg_cursor_t;
+
+/* Next argument as integer, double or string (str: buffer of LOG_RING_STR_MAX + 1) */
+static uint8_t arg_next(arg_cursor_t *c, int64_t *i, double *d, char *str)
+{
+    if (c->left == 0) return LOG_RING_T_NONE;
+    c->left--;
+    uint8_t type = *c->types++;
+    *i = 0;
+    *d = 0;
+    str[0] = '\0';
+    switch (type) {
+    case LOG_RING_T_INT64:
+        memcpy(i, c->vals, 8);
+        *d = (double)*i;
+        c->vals += 8;
+        break;
+    case LOG_RING_T_DOUBLE:
+        memcpy(d, c->vals, 8);
+        *i = (int64_t)*d;
+        c->vals += 8;
+        break;
+    case LOG_RING_T_STR: {
+        uint8_t n = *c->vals++;
+        memcpy(str, c->vals, n);
+        str[n] = '\0';
+        c->vals += n;
+        break;
+    }
+    default: {
+        int32_t v;
+        memcpy(&v, c->vals, 4);
+        *i = v;
+        *d = v;
+        c->vals += 4;
+        break;
+    }
+    }
+    return type;
+}
+
+/*
+ * printf over the packed arguments, one conversion at a time. Length
+ * modifiers are normalized: integers go out as long long, truncated to the
+ * width the format asked for.
+ */
+static size_t format_record(char *out, size_t cap, const char *fmt, arg_cursor_t *c)
+{
+    char spec[48];
+    char str[LOG_RING_STR_MAX + 1];
+    size_t n = 0;
+    int64_t iv;
+    double dv;
+
+    while (*fmt && n + 1 < cap) {
+        if (*fmt != '%') {
+            out[n++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out[n++] = '%';
+            fmt += 2;
+            continue;
+        }
+        size_t k = 0;
+        spec[k++] = *fmt++;
+        while (*fmt && strchr("-+ #0", *fmt) && k < 8) spec[k++] = *fmt++;
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*fmt != '.') break;
+                spec[k++] = *fmt++;
+            }
+            if (*fmt == '*') {
+                fmt++;
+                arg_next(c, &iv, &dv, str);
+                k += snprintf(spec + k, sizeof(spec) - k, "%d", (int)iv);
+            } else {
+                while (*fmt >= '0' && *fmt <= '9' && k < 20) spec[k++] = *fmt++;
+            }
+        }
+        /* Integer width asked by the length modifier, bytes */
+        size_t width = sizeof(int);
+        while (*fmt && strchr("hlLzjt", *fmt)) {
+            switch (*fmt++) {
+            case 'h': width = width == sizeof(short) ? sizeof(char) : sizeof(short); break;
+            case 'l': width = width == sizeof(long) ? sizeof(long long) : sizeof(long); break;
+            case 'j': width = sizeof(intmax_t); break;
+            case 'z': width = sizeof(size_t); break;
+            case 't': width = sizeof(ptrdiff_t); break;
+            default: break;
+            }
+        }
+        char conv = *fmt;
+        if (!conv) break;
+        fmt++;
+
+        int w = 0;
+        uint8_t type = (conv == 'n') ? LOG_RING_T_NONE : arg_next(c, &iv, &dv, str);
+        if (type == LOG_RING_T_NONE && conv != 'n') {
+            w = snprintf(out + n, cap - n, "?");
+        } else if (strchr("di", conv)) {
+            iv = width == 1 ? (int8_t)iv : width == 2 ? (int16_t)iv : width == 4 ? (int32_t)iv : iv;
+            strcpy(spec + k, "lld");
+            w = snprintf(out + n, cap - n, spec, (long long)iv);
+        } else if (strchr("ouxX", conv)) {
+            uint64_t uv = (uint64_t)iv;
+            uv = width == 1 ? (uint8_t)uv : width == 2 ? (uint16_t)uv : width == 4 ? (uint32_t)uv : uv;
+            spec[k++] = 'l';
+            spec[k++] = 'l';
+            spec[k++] = conv;
+            spec[k] = '\0';
+            w = snprintf(out + n, cap - n, spec, (unsigned long long)uv);
+        } else if (strchr("feEgGaA", conv)) {
+            spec[k++] = conv;
+            spec[k] = '\0';
+            w = snprintf(out + n, cap - n, spec, dv);
+        } else if (conv == 's') {
+            spec[k++] = 's';
+            spec[k] = '\0';
+            w = snprintf(out + n, cap - n, spec, type == LOG_RING_T_STR ? str : "?");
+        } else if (conv == 'c') {
+            spec[k++] = 'c';
+            spec[k] = '\0';
+            w = snprintf(out + n, cap - n, spec, (int)iv);
+        } else if (conv == 'p') {
+            spec[k++] = 'p';
+            spec[k] = '\0';
+            w = snprintf(out + n, cap - n, spec, (void *)(intptr_t)iv);
+        }
+        if (w > 0) n += (size_t)w < cap - n ? (size_t)w : cap - n - 1;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static char level_letter(uint8_t level)
+{
+    static const char letters[] = "NEWIDV";
+    return level < sizeof(letters) - 1 ? letters[level] : '?';
+}
+
+/* Ready record at the tail of r (pads consumed), NULL if none */
+static const uint8_t *ring_peek(ring_t *r, bool *pending)
+{
+    while (true) {
+        unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (tail == head) return NULL;
+        uint32_t fill = head - tail;
+        if (fill > s_max_fill) s_max_fill = fill;
+        uint8_t *rec = &r->buf[tail & RING_MASK];
+        uint32_t hdr = atomic_load_explicit((atomic_uint *)rec, memory_order_acquire);
+        if (!(hdr & HDR_READY)) {
+            *pending = true;    /* reserved, not published yet */
+            return NULL;
+        }
+        if (!(hdr & HDR_PAD)) return rec;
+        memset(rec, 0, hdr & HDR_LEN_MASK);
+        atomic_store_explicit(&r->tail, tail + (hdr & HDR_LEN_MASK), memory_order_release);
+    }
+}
+
+/* Copy the record out, give its space back, then format it */
+static void ring_pop_print(ring_t *r, const uint8_t *rec)
+{
+    uint32_t len = atomic_load_explicit((atomic_uint *)rec, memory_order_relaxed) & HDR_LEN_MASK;
+    memcpy(s_rec, rec, len);
+    memset((uint8_t *)rec, 0, len);
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + len, memory_order_release);
+
+    rec_meta_t meta;
+    memcpy(&meta, s_rec + 4, sizeof(meta));
+    const uint8_t *types = s_rec + 4 + sizeof(meta);
+    arg_cursor_t c = { .types = types, .vals = types + meta.nargs, .left = meta.nargs };
+    format_record(s_line, sizeof(s_line), meta.fmt, &c);
+    esp_log_write((esp_log_level_t)meta.level, meta.tag, "%c (%" PRIu32 ") %s: %s\n", level_letter(meta.level),
+                  (uint32_t)(meta.ts_us / 1000), meta.tag, s_line);
+    atomic_fetch_add_explicit(&s_printed, 1, memory_order_release);
+}
+
+static uint32_t total_records(void)
+{
+    uint32_t sum = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) sum += atomic_load(&s_ring[core].records);
+    return sum;
+}
+
+static uint32_t total_dropped(void)
+{
+    uint32_t sum = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) sum += atomic_load(&s_ring[core].dropped);
+    return sum;
+}
+
+static void drain_task(void *pvParameters)
+{
+    uint32_t dropped_seen = 0;
+    sys_mon_watch_task(NULL, DRAIN_STACK);
+    while (true) {
+        bool pending = false;
+        /* Oldest ready record first: the cores' records come out merged by timestamp */
+        while (true) {
+            const uint8_t *next = NULL;
+            int64_t next_ts = INT64_MAX;
+            int next_core = 0;
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                const uint8_t *rec = ring_peek(&s_ring[core], &pending);
+                if (!rec) continue;
+                rec_meta_t meta;
+                memcpy(&meta, rec + 4, sizeof(meta));
+                if (meta.ts_us < next_ts) {
+                    next = rec;
+                    next_ts = meta.ts_us;
+                    next_core = core;
+                }
+            }
+            if (!next) break;
+            ring_pop_print(&s_ring[next_core], next);
+        }
+        uint32_t dropped = total_dropped();
+        if (dropped != dropped_seen) {
+            ESP_LOGW(TAG, "%" PRIu32 " records dropped (ring full)", dropped - dropped_seen);
+            dropped_seen = dropped;
+        }
+        ulTaskNotifyTake(pdTRUE, pending ? pdMS_TO_TICKS(DRAIN_RETRY_MS) : portMAX_DELAY);
+    }
+}
+
+esp_err_t log_ring_init(void)
+{
+    if (s_drain) return ESP_OK;
+    if (xTaskCreatePinnedToCore(drain_task, "Task Log", DRAIN_STACK, NULL, DRAIN_PRIO, &s_drain,
+                                tskNO_AFFINITY) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Log rings: %d bytes x %d cores", RING_SIZE, portNUM_PROCESSORS);
+    return ESP_OK;
+}
+
+esp_err_t log_ring_flush(TickType_t timeout)
+{
+    if (!s_drain) return ESP_ERR_INVALID_STATE;
+    uint32_t target = total_records();
+    TickType_t t0 = xTaskGetTickCount();
+    while ((int32_t)(atomic_load_explicit(&s_printed, memory_order_acquire) - target) < 0) {
+        if (xTaskGetTickCount() - t0 >= timeout) return ESP_ERR_TIMEOUT;
+        xTaskNotifyGive(s_drain);
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+void log_ring_get_stats(log_ring_stats_t *out)
+{
+    if (!out) return;
+    out->records = total_records();
+    out->dropped = total_dropped();
+    out->max_fill = s_max_fill;
+    out->ring_size = RING_SIZE;
+}
+
+#else /* !CONFIG_LOG_RING_ENABLE */
+
+esp_err_t log_ring_init(void)
+{
+    ESP_LOGD(TAG, "Disabled");
+    return ESP_OK;
+}
+
+void log_ring_write(esp_log_level_t level, const char *tag, const char *fmt, const log_ring_arg_t *args,
+                    size_t nargs)
+{
+}
+
+esp_err_t log_ring_flush(TickType_t timeout)
+{
+    return ESP_OK;
+}
+
+void log_ring_get_stats(log_ring_stats_t *out)
+{
+    if (out) memset(out, 0, sizeof(*out));
+}
+
+#endif
+
+#if CONFIG_LOG_RING_BENCH
+
+#define BENCH_CYCLES CONFIG_LOG_RING_BENCH_CYCLES
+
+volatile bool log_ring_bench_sync = true;   /* first window: the synchronous ESP_LOG path */
+
+static struct {
+    uint32_t n;
+    int64_t  call_sum;
+    int64_t  call_max;
+    int64_t  late_min;
+    int64_t  late_max;
+    double   late_sum;
+    double   late_sq;
+} s_bench;
+
+void log_ring_bench_sample(int64_t call_us, int64_t late_us)
+{
+    if (s_bench.n == 0) {
+        s_bench.late_min = INT64_MAX;
+        s_bench.late_max = INT64_MIN;
+    }
+    s_bench.n++;
+    s_bench.call_sum += call_us;
+    if (call_us > s_bench.call_max) s_bench.call_max = call_us;
+    if (late_us < s_bench.late_min) s_bench.late_min = late_us;
+    if (late_us > s_bench.late_max) s_bench.late_max = late_us;
+    s_bench.late_sum += late_us;
+    s_bench.late_sq += (double)late_us * late_us;
+    if (s_bench.n < BENCH_CYCLES) return;
+
+    /* Integers only: printed from the caller's (small) stack */
+    double mean = s_bench.late_sum / s_bench.n;
+    double var = s_bench.late_sq / s_bench.n - mean * mean;
+    uint32_t sd10 = var > 0 ? (uint32_t)(sqrt(var) * 10) : 0;
+    uint32_t call10 = (uint32_t)(s_bench.call_sum * 10 / s_bench.n);
+    ESP_LOGI(TAG, "LOG_BENCH mode=%s n=%" PRIu32 " call avg=%" PRIu32 ".%" PRIu32 " max=%" PRId64
+             " us | toggle jitter p-p=%" PRId64 " sd=%" PRIu32 ".%" PRIu32 " us",
+             log_ring_bench_sync ? "sync" : "ring", s_bench.n, call10 / 10, call10 % 10, s_bench.call_max,
+             s_bench.late_max - s_bench.late_min, sd10 / 10, sd10 % 10);
+    memset(&s_bench, 0, sizeof(s_bench));
+    log_ring_bench_sync = !log_ring_bench_sync;
+}
+
+#else
+
+void log_ring_bench_sample(int64_t call_us, int64_t late_us)
+{
+}
+
+#endif
@@ -0,0 +1,210 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file log_ring.h
+ * @brief Asynchronous binary logger: per-core lock-free rings, deferred formatting
+ *
+ * A log call does not format anything. LOG_RING() packs a compact binary
+ * record into the ring of the calling core:
+ * - the format string pointer (the record id: format strings are literals)
+ * - the tag pointer and the esp_timer timestamp
+ * - the arguments, typed at compile time with _Generic: 32/64-bit integers,
+ *   doubles, and strings copied inline (up to LOG_RING_STR_MAX bytes)
+ *
+ * The format is checked by the compiler as for printf. A low priority drain
+ * task formats the records and writes them with esp_log_write(), so
+ * vsnprintf and the UART wait leave the caller's real-time path. Records keep
+ * their call-time timestamp.
+ *
+ * Producers reserve space with a compare-and-swap on the ring head and
+ * publish the record by writing its header last. No lock is taken and
+ * nothing blocks: when the ring is full the record is dropped and counted.
+ * The drain task reports drops in the log. The drain waits at a reserved,
+ * unpublished record, so records come out in reservation order per core.
+ * Records of different cores are merged by timestamp on the way out.
+ *
+ * Records written before log_ring_init() wait in the ring until the drain
+ * task starts. %s strings are copied at call time, so stack buffers are fine.
+ * %p arguments must be void pointers; their value is kept.
+ *
+ * With CONFIG_LOG_RING_BENCH, LOG() alternates between the synchronous
+ * ESP_LOG path and the ring every CONFIG_LOG_RING_BENCH_CYCLES samples.
+ * The LED job reports its log call cost and toggle timing with
+ * log_ring_bench_sample(), and one LOG_BENCH line is printed per window.
+ *
+ * The following functions are provided:
+ * - log_ring_init(): Start the drain task.
+ * - log_ring_write(): Record writer behind LOG_RING().
+ * - log_ring_flush(): Wait until the rings are drained.
+ * - log_ring_get_stats(): Record, drop and fill counters.
+ * - log_ring_bench_sample(): Feed one LED job cycle to the benchmark.
+ *
+ * @author Marconatale Parise
+ * @date 24 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_RING_STR_MAX  48    /*!< %s arguments longer than this are truncated */
+#define LOG_RING_MAX_ARGS 10    /*!< Arguments of one LOG_RING() call */
+
+/** @brief Argument type, chosen at compile time */
+typedef enum {
+    LOG_RING_T_NONE = 0,
+    LOG_RING_T_INT,             /*!< Integers up to 32 bits, enums, void pointers */
+    LOG_RING_T_INT64,
+    LOG_RING_T_DOUBLE,
+    LOG_RING_T_STR,
+} log_ring_type_t;
+
+/** @brief One argument of a LOG_RING() call (built on the caller's stack) */
+typedef struct {
+    uint8_t     type;           /*!< log_ring_type_t */
+    int64_t     i;
+    double      d;
+    const char *s;
+} log_ring_arg_t;
+
+/** @brief Logger counters */
+typedef struct {
+    uint32_t records;           /*!< Records written to the rings */
+    uint32_t dropped;           /*!< Records dropped on a full ring */
+    uint32_t max_fill;          /*!< Highest ring fill seen by the drain task, bytes */
+    uint32_t ring_size;         /*!< Bytes per core */
+} log_ring_stats_t;
+
+/* ---- Argument packing: one log_ring_arg_t per argument ---- */
+
+/* The value is taken through a function chosen by _Generic: only the selected conversion is compiled */
+static inline int64_t log_ring_int(int64_t v) { return v; }
+static inline int64_t log_ring_ptr(const void *p) { return (int64_t)(intptr_t)p; }
+static inline int64_t log_ring_dbl(double d) { return 0; }
+static inline int64_t log_ring_str(const char *s) { return 0; }
+
+#define LOG_RING_ARG(x) {                                                                               \
+    .type = _Generic((x), float: LOG_RING_T_DOUBLE, double: LOG_RING_T_DOUBLE,                          \
+                     char *: LOG_RING_T_STR, const char *: LOG_RING_T_STR,                              \
+                     default: sizeof(x) > 4 ? LOG_RING_T_INT64 : LOG_RING_T_INT),                       \
+    .i = _Generic((x), float: log_ring_dbl, double: log_ring_dbl, char *: log_ring_str,                 \
+                  const char *: log_ring_str, void *: log_ring_ptr, const void *: log_ring_ptr,         \
+                  default: log_ring_int)(x),                                                            \
+    .d = _Generic((x), float: (x), double: (x), default: 0.0),                                          \
+    .s = _Generic((x), char *: (x), const char *: (x), default: NULL),                                  \
+}
+
+#define LOG_RING_NARGS(...) LOG_RING_NARGS_(_, ##__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_RING_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, n, ...) n
+#define LOG_RING_CAT(a, b)  LOG_RING_CAT_(a, b)
+#define LOG_RING_CAT_(a, b) a##b
+#define LOG_RING_MAP(...)   LOG_RING_CAT(LOG_RING_MAP_, LOG_RING_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_RING_MAP_0()
+#define LOG_RING_MAP_1(a)       LOG_RING_ARG(a)
+#define LOG_RING_MAP_2(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_1(__VA_ARGS__)
+#define LOG_RING_MAP_3(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_2(__VA_ARGS__)
+#define LOG_RING_MAP_4(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_3(__VA_ARGS__)
+#define LOG_RING_MAP_5(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_4(__VA_ARGS__)
+#define LOG_RING_MAP_6(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_5(__VA_ARGS__)
+#define LOG_RING_MAP_7(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_6(__VA_ARGS__)
+#define LOG_RING_MAP_8(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_7(__VA_ARGS__)
+#define LOG_RING_MAP_9(a, ...)  LOG_RING_ARG(a), LOG_RING_MAP_8(__VA_ARGS__)
+#define LOG_RING_MAP_10(a, ...) LOG_RING_ARG(a), LOG_RING_MAP_9(__VA_ARGS__)
+
+#if CONFIG_LOG_RING_BENCH
+extern volatile bool log_ring_bench_sync;
+#define LOG_RING_SYNC_PATH(level, tag, fmt, ...) \
+    if (log_ring_bench_sync) { ESP_LOG_LEVEL(level, tag, fmt, ##__VA_ARGS__); break; }
+#else
+#define LOG_RING_SYNC_PATH(level, tag, fmt, ...)
+#endif
+
+/**
+ * @brief Log through the ring (level: ESP_LOG_ERROR ... ESP_LOG_VERBOSE)
+ *
+ * The first array entry is a placeholder so a call without arguments still
+ * builds a valid array. Without CONFIG_LOG_RING_ENABLE this is ESP_LOG_LEVEL().
+ */
+#if CONFIG_LOG_RING_ENABLE
+#define LOG_RING(level, tag, fmt, ...) do {                                                     \
+    if (LOG_LOCAL_LEVEL < (level)) break;                                                       \
+    if (0) printf(fmt, ##__VA_ARGS__);      /* format check only */                             \
+    LOG_RING_SYNC_PATH(level, tag, fmt, ##__VA_ARGS__)                                          \
+    const log_ring_arg_t _lr_args[] = { { .type = LOG_RING_T_NONE }, LOG_RING_MAP(__VA_ARGS__) }; \
+    log_ring_write(level, tag, fmt, _lr_args + 1, sizeof(_lr_args) / sizeof(_lr_args[0]) - 1);  \
+} while (0)
+#else
+#define LOG_RING(level, tag, fmt, ...) ESP_LOG_LEVEL(level, tag, fmt, ##__VA_ARGS__)
+#endif
+
+/**
+ * @brief Start the drain task
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t log_ring_init(void);
+
+/**
+ * @brief Pack one record into the ring of the calling core (use LOG_RING())
+ *
+ * Never blocks: a record that does not fit is dropped and counted.
+ *
+ * @param level Log level
+ * @param tag   Tag (must stay valid: a literal)
+ * @param fmt   printf format (must stay valid: a literal)
+ * @param args  Arguments
+ * @param nargs Number of arguments (at most LOG_RING_MAX_ARGS)
+ */
+void log_ring_write(esp_log_level_t level, const char *tag, const char *fmt, const log_ring_arg_t *args,
+                    size_t nargs);
+
+/**
+ * @brief Wait until every record written so far is printed
+ *
+ * @param timeout Maximum wait
+ *
+ * @return ESP_OK, or ESP_ERR_TIMEOUT
+ */
+esp_err_t log_ring_flush(TickType_t timeout);
+
+/**
+ * @brief Get the logger counters (all cores)
+ *
+ * @param[out] out Counters
+ */
+void log_ring_get_stats(log_ring_stats_t *out);
+
+/**
+ * @brief Feed one LED job cycle to the benchmark (CONFIG_LOG_RING_BENCH)
+ *
+ * @param call_us Duration of the cycle's log call
+ * @param late_us Toggle instant minus the tick the task was due at (constant offsets cancel out)
+ */
+void log_ring_bench_sample(int64_t call_us, int64_t late_us);
+
+#ifdef __cplusplus
+}
+#endif
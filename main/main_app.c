@@ -19,6 +19,29 @@
  * 
  * This file contains the main application logic, including task definitions for normal operation (toggling an LED) and OTA handling. 
  * It also sets up GPIO interrupts for a button to trigger OTA updates.
+ *
+ * The system state machine is event driven: the button task blocks on the GPIO event ring and the OTA task on a
+ * task notification, so transitions run as soon as their trigger fires and idle tasks do not wake up. Trigger -> entry hook latency and per-task wakeups are logged after
+ * each OTA cycle.
+ *
+ * Boot does not wait for the network: the tasks start right after the local init and Wi-Fi connects in
+ * its own task (wifi_start_async()). OTA waits for the network ready event; the running image is confirmed
+ * once the network came up. The time from start to the first application action is logged.
+ *
+ * LOG() lines go through the asynchronous log ring (log_ring.h): the LED toggle and the button path do not
+ * wait for the UART. With CONFIG_LOG_RING_BENCH the LED job compares its toggle timing with the synchronous path.
+ *
+ * The periodic work runs as jobs of the "Task App" executor (sys_sched.h): the LED toggle, enabled only in
+ * SYS_RUN, and the periodic timing report. Releases are fixed rate on esp_timer time and each job keeps its
+ * jitter, period error and overrun counters.
+ *
+ * With CONFIG_OTA_BACKGROUND the application keeps running while the image is downloaded, verified and
+ * selected for boot (throttled, Task_ota below the application executor); peripherals are parked only in
+ * SYS_OTA_SWITCH, right before the restart. Otherwise the application stops at the OTA request. Either way
+ * the time the application was stopped is carried over the restart and logged by the new image.
+ *
+ * The application tasks are watched by the runtime monitor (sys_mon.h), which follows the OTA cycle through
+ * its phases and logs the stack and heap peaks of each one.
  * 
  * @author Marconatale Parise
  * @date 28 Feb 2026
@@ -27,8 +50,16 @@
 #include "freertos/task.h"
 #include "nvs_flash.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
 #include "wifi.h"
 #include "ota_hal.h"
+#include "ota_bench.h"
+#include "ota_peer.h"
+#include "gpio_evt.h"
+#include "sys_mon.h"
+#include "sys_sched.h"
 #include "common.h"
 
 typedef enum {
@@ -36,105 +67,297 @@ typedef enum {
   SYS_OTA_REQUESTED,
   SYS_OTA_PREPARE,
   SYS_OTA_RUNNING,
-  SYS_OTA_FAILED
+  SYS_OTA_SWITCH,
+  SYS_OTA_FAILED,
+  SYS_STATE_MAX
 } sys_state_t;
 
-#define TASKPER_TIME 100 //ms
+/* Entry hook of a state, run by Task_ota: returns the next state */
+typedef sys_state_t (*sys_state_hook_t)(void);
+
+typedef struct {
+  const char *name;
+  sys_state_hook_t on_enter;    /* NULL: state owned by the application tasks */
+} sys_state_desc_t;
+
+/* State machine instrumentation */
+typedef struct {
+  uint32_t transitions;
+  int64_t  last_latency_us;     /* trigger -> entry hook started */
+  int64_t  max_latency_us;
+  uint32_t wakeups_app;
+  uint32_t wakeups_per;
+  uint32_t wakeups_ota;
+} sys_sm_stats_t;
+
+/* Application downtime of an update, kept across the restart into the new image */
+typedef struct {
+  uint32_t magic;               /* OTA_DOWNTIME_MAGIC: written by the previous image */
+  uint32_t background;          /* staged in the background (CONFIG_OTA_BACKGROUND) */
+  int64_t  stopped_us;          /* application stopped -> esp_restart() */
+} ota_downtime_t;
+
 #define TASKAPP_TIME CONFIG_TOGGLE_LED_FREQUENCY //ms
-#define TASKOTA_TIME 500 //ms
+#define TASKAPP_REPORT_US ((uint32_t)CONFIG_SYS_SCHED_REPORT_S * 1000000)
+#define TASKAPP_STACK 2048
+#define TASKAPP_PRIO  2         /* above a background OTA download */
+#define TASKOTA_PRIO  5
+#define TASKOTA_BG_PRIO 1       /* Task_ota while downloading in the background */
+#define TASKPER_STACK 2048
+#define TASKOTA_STACK 8192
+#define TASKPER_BATCH 8        /* events drained per wakeup */
+#if CONFIG_OTA_BACKGROUND && !CONFIG_OTA_BENCH_ENABLE
+#define OTA_BACKGROUND 1
+#else
+#define OTA_BACKGROUND 0
+#endif
+#define OTA_DOWNTIME_MAGIC 0x0DD0A7E5u
 #define GPIO_BTN     CONFIG_GPIO_BTN_PIN
 #define GPIO_BTN_PIN_SEL  (1ULL<<GPIO_BTN)
 #define GPIO_OUT    CONFIG_GPIO_OUT_PIN
 #define GPIO_OUT_PIN_SEL  (1ULL<<GPIO_OUT)
-static QueueHandle_t gpio_evt_queue = NULL;
+#if CONFIG_GPIO_BTN_INTR_NEGEDGE
+#define BTN_EDGE_MATCH(level) ((level) == 0)
+#elif CONFIG_GPIO_BTN_INTR_POSEDGE
+#define BTN_EDGE_MATCH(level) ((level) == 1)
+#else
+#define BTN_EDGE_MATCH(level) true
+#endif
+static TaskHandle_t ota_task = NULL;
+static sys_sched_job_t led_job = NULL;
+static portMUX_TYPE sys_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t sys_trigger_us;  /* time of the event behind the pending transition */
+static sys_sm_stats_t sm_stats;
+/* Boot timeline, esp_timer time (starts with the application: ROM and bootloader not included) */
+static int64_t boot_main_us;        /* app_main() entered */
+static int64_t boot_first_action_us; /* first LED toggle */
+static int64_t app_stop_us;         /* application stopped (0: running) */
+static RTC_NOINIT_ATTR ota_downtime_t ota_downtime;
 bool toogle_led = false;
-sys_state_t system_state = SYS_RUN;
+static volatile sys_state_t system_state = SYS_RUN;
 
 static esp_err_t gpio_toggle(uint32_t gpio_num, bool* toogle);
 static esp_err_t gpio_init(void);
 static void peripherals_safe_outputs();
+static void on_network_ready(void);
+static sys_state_t state_ota_requested(void);
+static sys_state_t state_ota_prepare(void);
+static sys_state_t state_ota_running(void);
+static sys_state_t state_ota_switch(void);
+static sys_state_t state_ota_failed(void);
 
+static const sys_state_desc_t sys_sm[SYS_STATE_MAX] = {
+  [SYS_RUN]           = { "RUN",           NULL },
+  [SYS_OTA_REQUESTED] = { "OTA_REQUESTED", state_ota_requested },
+  [SYS_OTA_PREPARE]   = { "OTA_PREPARE",   state_ota_prepare },
+  [SYS_OTA_RUNNING]   = { "OTA_RUNNING",   state_ota_running },
+  [SYS_OTA_SWITCH]    = { "OTA_SWITCH",    state_ota_switch },
+  [SYS_OTA_FAILED]    = { "OTA_FAILED",    state_ota_failed },
+};
 
-static void IRAM_ATTR gpio_isr_handler(void* arg)
+
+/* States in which the application jobs run */
+static bool sys_app_active(sys_state_t st)
 {
-    uint32_t gpio_num = (uint32_t) arg;
-    xQueueSendFromISR(gpio_evt_queue, &gpio_num, NULL);
+#if OTA_BACKGROUND
+    return st != SYS_OTA_SWITCH;
+#else
+    return st == SYS_RUN;
+#endif
+}
+
+/**
+ * Move the state machine to next. trigger_us is the time of the event that caused
+ * the transition (0: now). Task_ota is woken for the states that have an entry hook,
+ * the LED job runs only in the states sys_app_active() accepts.
+ */
+static void sys_set_state(sys_state_t next, int64_t trigger_us)
+{
+    bool active = sys_app_active(next);
+    portENTER_CRITICAL(&sys_lock);
+    system_state = next;
+    sys_trigger_us = trigger_us ? trigger_us : esp_timer_get_time();
+    sm_stats.transitions++;
+    if (!active && !app_stop_us) app_stop_us = sys_trigger_us;
+    if (active) app_stop_us = 0;
+    portEXIT_CRITICAL(&sys_lock);
+
+    sys_sched_enable(led_job, active);
+    /* Task_ota chains its own transitions without a notification */
+    if (sys_sm[next].on_enter && ota_task && xTaskGetCurrentTaskHandle() != ota_task) {
+        xTaskNotifyGive(ota_task);
+    }
+}
+
+static void sys_sm_report(void)
+{
+    LOG("SM: %"PRIu32" transitions, latency last %"PRId64" us max %"PRId64" us, wakeups app=%"PRIu32
+        " per=%"PRIu32" ota=%"PRIu32, sm_stats.transitions, sm_stats.last_latency_us, sm_stats.max_latency_us,
+        sm_stats.wakeups_app, sm_stats.wakeups_per, sm_stats.wakeups_ota);
+    gpio_evt_stats_t ev;
+    gpio_evt_get_stats(&ev);
+    LOG("GPIO events: %"PRIu32" accepted (%"PRIu32" settled), %"PRIu32" bounces, %"PRIu32" overflows, max batch %"PRIu32,
+        ev.events, ev.settled, ev.bounces, ev.overflows, ev.max_batch);
+    sys_sched_log_stats();
 }
 
 void Task_per(void *pvParameters) {
-    const TickType_t period = pdMS_TO_TICKS(TASKPER_TIME);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-    uint32_t io_num;
+    gpio_evt_t evts[TASKPER_BATCH];
+    /* The ring binds its ISR to this task's core */
+    ESP_ERROR_CHECK(gpio_evt_init());
     while (true) {
-        if(system_state == SYS_RUN) {
-            // Normal operation code here
-            if (xQueueReceive(gpio_evt_queue, &io_num, portMAX_DELAY)) {
-                const bool level = (gpio_get_level(io_num) != 0);
-                uint8_t ev = level ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE;
-                if (ev == GPIO_INTR_POSEDGE) {
-                    LOG("Button pushed - Rising Edge Interrupt");
-                    system_state = SYS_OTA_REQUESTED;
-                }
-            }
+        /* Blocked until a button edge, no polling */
+        size_t n = gpio_evt_read(evts, TASKPER_BATCH, portMAX_DELAY);
+        sm_stats.wakeups_per++;
+        for (size_t i = 0; i < n; i++) {
+            if (evts[i].gpio != GPIO_BTN || !BTN_EDGE_MATCH(evts[i].level)) continue;
+            if (system_state != SYS_RUN) continue;
+            LOG("Button pushed - level %u", evts[i].level);
+            sys_set_state(SYS_OTA_REQUESTED, esp_timer_get_time() - gpio_evt_age_us(&evts[i]));
         }
-        xLastWakeTime = xTaskGetTickCount();
-        vTaskDelayUntil(&xLastWakeTime, period);
     }
 }
 
-void Task_app(void *pvParameters) {
-    const TickType_t period = pdMS_TO_TICKS(TASKAPP_TIME);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+/* Downtime of the update that installed this image, logged once after the first action */
+static void ota_downtime_report(void)
+{
+    if (ota_downtime.magic != OTA_DOWNTIME_MAGIC || esp_reset_reason() != ESP_RST_SW) return;
+    ota_downtime.magic = 0;
+    LOG("OTA downtime: %"PRId64" ms (%s update): application stopped %"PRId64" ms before the restart, "
+        "first action %"PRId64" ms after app start (ROM and bootloader not included)",
+        (ota_downtime.stopped_us + boot_first_action_us) / 1000, ota_downtime.background ? "background" : "foreground",
+        ota_downtime.stopped_us / 1000, boot_first_action_us / 1000);
+}
 
-    while (true) {
-        if(system_state == SYS_RUN){
-            ESP_ERROR_CHECK(gpio_toggle(GPIO_OUT, &toogle_led));
-            toogle_led = !toogle_led;
-        }
-        xLastWakeTime = xTaskGetTickCount();
-        vTaskDelayUntil(&xLastWakeTime, period);
+/* LED job of the "Task App" executor, every TASKAPP_TIME ms while the application is active */
+static void job_led(int64_t due_us, void *arg) {
+    if (!sys_app_active(system_state)) return;
+    sm_stats.wakeups_app++;
+#if CONFIG_LOG_RING_BENCH
+    int64_t t0 = esp_timer_get_time();
+#endif
+    ESP_ERROR_CHECK(gpio_toggle(GPIO_OUT, &toogle_led));
+#if CONFIG_LOG_RING_BENCH
+    /* Log call cost, and the toggle instant against the time the job was due at */
+    int64_t t1 = esp_timer_get_time();
+    log_ring_bench_sample(t1 - t0, t1 - due_us);
+#endif
+    if (!boot_first_action_us) {
+        boot_first_action_us = esp_timer_get_time();
+        LOG("Boot: app_main at %"PRId64" ms, first application action at %"PRId64" ms (network %s)",
+            boot_main_us / 1000, boot_first_action_us / 1000, wifi_is_ready() ? "up" : "pending");
+        ota_downtime_report();
     }
+    toogle_led = !toogle_led;
 }
 
-void Task_ota(void *pvParameters) {
-    const TickType_t period = pdMS_TO_TICKS(TASKOTA_TIME);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+/* Report job: timing of every periodic job, through the log ring */
+static void job_report(int64_t due_us, void *arg) {
+    sys_sched_log_stats();
+}
 
+void Task_ota(void *pvParameters) {
     while (true) {
-        switch(system_state){
-            case SYS_OTA_REQUESTED:
-                LOG("OTA requested, preparing...\n");
-                ESP_ERROR_CHECK(ota_hal_init());
-                system_state = SYS_OTA_PREPARE;
-                break;
-            case SYS_OTA_PREPARE:
-                LOG("Starting OTA process...\n");
-                peripherals_safe_outputs();
-                system_state = SYS_OTA_RUNNING;
-                break;
-            case SYS_OTA_RUNNING:
-                esp_err_t err = ota_hal_start();
-                if (err != ESP_OK)system_state = SYS_OTA_FAILED;
-                break;
-            case SYS_OTA_FAILED:
-                LOG("OTA failed, reverting to previous state...\n");
-                // Handle OTA failure here
-                ESP_ERROR_CHECK(gpio_init());
-                system_state = SYS_RUN;
-                break;
-            case SYS_RUN:
-            default:
-                // Normal operation
-                break;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        sm_stats.wakeups_ota++;
+
+        /* Run the entry hooks back to back until the system is back in normal operation */
+        sys_state_t st;
+        while (sys_sm[st = system_state].on_enter) {
+            int64_t latency = esp_timer_get_time() - sys_trigger_us;
+            sm_stats.last_latency_us = latency;
+            if (latency > sm_stats.max_latency_us) sm_stats.max_latency_us = latency;
+            LOG("SM: enter %s (%"PRId64" us after trigger)", sys_sm[st].name, latency);
+            sys_set_state(sys_sm[st].on_enter(), 0);
         }
-        xLastWakeTime = xTaskGetTickCount();
-        vTaskDelayUntil(&xLastWakeTime, period);
-    }   
+        sys_mon_set_phase(SYS_MON_PHASE_RUN);
+        sys_sm_report();
+    }
+}
+
+static sys_state_t state_ota_requested(void)
+{
+    LOG("OTA requested, preparing...\n");
+    sys_mon_set_phase(SYS_MON_PHASE_OTA_CHECK);
+    if (wifi_wait_ready(pdMS_TO_TICKS(CONFIG_OTA_NET_WAIT_S * 1000)) != ESP_OK) {
+        LOG("Network not ready, OTA dropped");
+        return SYS_RUN;
+    }
+    ESP_ERROR_CHECK(ota_hal_init());
+#if CONFIG_OTA_CHECK_ENABLE && !CONFIG_OTA_BENCH_ENABLE
+    /* One small request: peripherals keep running when there is nothing to download */
+    ota_hal_check_t chk;
+    if (ota_hal_check(&chk) == ESP_OK && chk.result == OTA_CHECK_UP_TO_DATE) {
+        LOG("Firmware up to date, OTA skipped");
+        return SYS_RUN;
+    }
+#endif
+#if OTA_BACKGROUND
+    /* Peripherals keep running: they are parked only for the switch */
+    return SYS_OTA_RUNNING;
+#else
+    return SYS_OTA_PREPARE;
+#endif
+}
+
+static sys_state_t state_ota_prepare(void)
+{
+    LOG("Starting OTA process...\n");
+    peripherals_safe_outputs();
+    return SYS_OTA_RUNNING;
+}
+
+static sys_state_t state_ota_running(void)
+{
+#if CONFIG_OTA_BENCH_ENABLE
+    /* Benchmark mode: the running image is kept, restore peripherals afterwards */
+    if (ota_bench_run() != ESP_OK) {
+        LOG("OTA benchmark had failed runs\n");
+    }
+    return SYS_OTA_FAILED;
+#elif OTA_BACKGROUND
+    static const ota_hal_throttle_t throttle = {
+        .rate_kbps = CONFIG_OTA_BG_RATE_KBPS,
+        .flash_pct = CONFIG_OTA_BG_FLASH_PCT,
+    };
+    /* Below the application executor (the range workers inherit it): jobs keep their timing */
+    vTaskPrioritySet(NULL, TASKOTA_BG_PRIO);
+    esp_err_t err = ota_hal_stage(&throttle);
+    vTaskPrioritySet(NULL, TASKOTA_PRIO);
+    return err == ESP_OK ? SYS_OTA_SWITCH : SYS_OTA_FAILED;
+#else
+    return ota_hal_stage(NULL) == ESP_OK ? SYS_OTA_SWITCH : SYS_OTA_FAILED;
+#endif
+}
+
+static sys_state_t state_ota_switch(void)
+{
+#if OTA_BACKGROUND
+    peripherals_safe_outputs();
+#endif
+    /* The new image logs the downtime once its application runs again */
+    ota_downtime.stopped_us = esp_timer_get_time() - app_stop_us;
+    ota_downtime.background = OTA_BACKGROUND;
+    ota_downtime.magic = OTA_DOWNTIME_MAGIC;
+    LOG("OTA: image selected, restarting (application stopped for %"PRId64" ms)", ota_downtime.stopped_us / 1000);
+    log_ring_flush(pdMS_TO_TICKS(100));
+    esp_restart();
+    return SYS_RUN; /* unreachable */
+}
+
+static sys_state_t state_ota_failed(void)
+{
+    LOG("OTA failed, reverting to previous state...\n");
+#if !OTA_BACKGROUND
+    ESP_ERROR_CHECK(gpio_init());
+#endif
+    return SYS_RUN;
 }
 
 
 void app_main(void)
 {
+    boot_main_us = esp_timer_get_time();
     /* Initialize NVS — it is used to store PHY calibration data */
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -145,14 +368,47 @@ void app_main(void)
     ESP_ERROR_CHECK(gpio_init());
 
     ESP_ERROR_CHECK(wifi_init_connection());
-    ESP_ERROR_CHECK(wifi_connect_sta());
-    ESP_ERROR_CHECK(wifi_disable_powersave());
-    /* If rollback is enabled, confirm the running image when needed */
-    ESP_ERROR_CHECK(ota_hal_mark_app_valid_if_needed());
+    /* After the network stack init: the lwIP and event tasks are watched too */
+    if (sys_mon_init() != ESP_OK) {
+        ESP_LOGE("APP", "Runtime monitor not started");
+    }
+    if (log_ring_init() != ESP_OK) {
+        ESP_LOGE("APP", "Log drain task not started");
+    }
 
-    xTaskCreatePinnedToCore(Task_app, "Task App", 2048, NULL, 1 , NULL, 1); //Core 1
-    xTaskCreatePinnedToCore(Task_per, "Task Peripheral", 2048, NULL, 1 , NULL, 1); //Core 1
-    xTaskCreatePinnedToCore(Task_ota, "Task OTA", 8192, NULL, 5 , NULL, 1); //Core 1
+    sys_sched_handle_t app_sched = NULL;
+    ESP_ERROR_CHECK(sys_sched_create("Task App", TASKAPP_STACK, TASKAPP_PRIO, 1, &app_sched)); //Core 1
+    ESP_ERROR_CHECK(sys_sched_add(app_sched, "led", TASKAPP_TIME * 1000, job_led, NULL, true, &led_job));
+    ESP_ERROR_CHECK(sys_sched_add(app_sched, "report", TASKAPP_REPORT_US, job_report, NULL, true, NULL));
+    TaskHandle_t per_task = NULL;
+    xTaskCreatePinnedToCore(Task_per, "Task Peripheral", TASKPER_STACK, NULL, 1 , &per_task, 1); //Core 1
+    xTaskCreatePinnedToCore(Task_ota, "Task OTA", TASKOTA_STACK, NULL, TASKOTA_PRIO, &ota_task, 1); //Core 1
+    sys_mon_watch_task(per_task, TASKPER_STACK);
+    sys_mon_watch_task(ota_task, TASKOTA_STACK);
+
+    /* Network comes up in the background: an unreachable AP no longer stops the application */
+    if (wifi_start_async(on_network_ready) != ESP_OK) {
+        ESP_LOGE("APP", "Wi-Fi task not started");
+    }
+}
+
+/* Wi-Fi task, after every (re)connect */
+static void on_network_ready(void)
+{
+    static bool confirmed;
+    wifi_disable_powersave();
+    if (!confirmed) {
+        /* If rollback is enabled, confirm the running image once it reached the network */
+        confirmed = ota_hal_mark_app_valid_if_needed() == ESP_OK;
+        wifi_conn_stats_t ws;
+        if (wifi_get_conn_stats(&ws) == ESP_OK) {
+            LOG("Boot: network ready at %"PRId64" ms (connect %"PRId64" ms)", ws.ready_us / 1000, ws.total_us / 1000);
+        }
+    }
+#if CONFIG_OTA_PEER_SERVE
+    /* Only a confirmed image is offered to the neighbours */
+    if (confirmed) ota_peer_server_start();
+#endif
 }
 
 static esp_err_t gpio_init(void)
@@ -196,22 +452,8 @@ static esp_err_t gpio_init(void)
     #endif
     gpio_config(&io_conf);
 
-    //change gpio interrupt type for one pin
-    gpio_set_intr_type(GPIO_BTN, GPIO_INTR_POSEDGE);
-
-    //create a queue to handle gpio event from isr
-    gpio_evt_queue = xQueueCreate(10, sizeof(uint32_t));
-
-    int isr_flags = 0;
-    esp_err_t err = gpio_install_isr_service(isr_flags);
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        return err;
-    }
-    err = gpio_isr_handler_add(GPIO_BTN, gpio_isr_handler, (void *)GPIO_BTN);
-    if (err != ESP_OK) {
-        return err;
-    }
-    return ESP_OK;
+    //button edges go to the event ring (any edge, filtered on the level in Task_per)
+    return gpio_evt_add_pin(GPIO_BTN, CONFIG_GPIO_BTN_DEBOUNCE_MS * 1000);
 }
 
 static esp_err_t gpio_toggle(uint32_t gpio_num, bool* toogle){
@@ -222,7 +464,6 @@ static esp_err_t gpio_toggle(uint32_t gpio_num, bool* toogle){
 
 static void peripherals_safe_outputs() {
     gpio_set_level(GPIO_OUT, 0);
-    gpio_isr_handler_remove(GPIO_BTN);
-    gpio_set_intr_type(GPIO_BTN, GPIO_INTR_DISABLE);
+    gpio_evt_remove_pin(GPIO_BTN);
     ESP_LOGI("OTA", "Peripherals put in safe");
 }
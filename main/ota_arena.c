@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_arena.c
+ * @brief Fixed memory arena for the per-session OTA allocations
+ *
+ * @author Marconatale Parise
+ * @date 27 Mar 2026
+ */
+#include "ota_arena.h"
+
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "ota_arena";
+
+#define ARENA_SIZE      ((size_t)CONFIG_OTA_ARENA_KB * 1024)
+#define ARENA_ALIGN     16      /* any type, and task stacks on every port */
+
+static uint8_t s_arena[ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+static size_t   s_used;
+static size_t   s_peak;         /* this session */
+static uint32_t s_fail;         /* this session */
+static uint32_t s_session = 1;  /* 0: a zeroed ota_arena_block_t never matches */
+static uint32_t s_tasks;        /* arena tasks not joined yet */
+static ota_arena_stats_t s_stats;
+
+static inline size_t align_up(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static inline bool in_arena(const void *ptr)
+{
+    return (const uint8_t *)ptr >= s_arena && (const uint8_t *)ptr < s_arena + ARENA_SIZE;
+}
+
+void *ota_arena_alloc(size_t size)
+{
+    size_t len = align_up(size);
+    if (len <= ARENA_SIZE - s_used) {
+        void *ptr = &s_arena[s_used];
+        s_used += len;
+        if (s_used > s_peak) s_peak = s_used;
+        return ptr;
+    }
+    s_fail++;
+    ESP_LOGW(TAG, "%u B do not fit (%u of %u B used), using the heap",
+             (unsigned)size, (unsigned)s_used, (unsigned)ARENA_SIZE);
+    /* Internal RAM, like the heap allocations it replaces (task stacks) */
+    return heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+void ota_arena_free(void *ptr)
+{
+    if (ptr && !in_arena(ptr)) free(ptr);
+}
+
+void *ota_arena_get(ota_arena_block_t *blk, size_t size)
+{
+    if (blk->ptr && blk->session == s_session && blk->size >= size) return blk->ptr;
+    /* Carved in an earlier session: the arena one is gone, the heap one is retried in the arena */
+    if (blk->heap) free(blk->ptr);
+    blk->ptr = ota_arena_alloc(size);
+    blk->size = size;
+    blk->session = s_session;
+    blk->heap = blk->ptr && !in_arena(blk->ptr);
+    return blk->ptr;
+}
+
+QueueHandle_t ota_arena_queue_create(ota_arena_block_t *blk, UBaseType_t length, UBaseType_t item_size)
+{
+    size_t head = align_up(sizeof(StaticQueue_t));
+    uint8_t *mem = ota_arena_get(blk, head + (size_t)length * item_size);
+    if (!mem) return NULL;
+    return xQueueCreateStatic(length, item_size, mem + head, (StaticQueue_t *)mem);
+}
+
+esp_err_t ota_arena_task_create(ota_arena_task_t *task, TaskFunction_t fn, const char *name,
+                                uint32_t stack_size, void *arg, UBaseType_t prio, BaseType_t core)
+{
+    if (task->handle) return ESP_ERR_INVALID_STATE;
+    size_t head = align_up(sizeof(StaticTask_t));
+    uint8_t *mem = ota_arena_get(&task->mem, head + stack_size);
+    if (!mem) return ESP_ERR_NO_MEM;
+    task->handle = xTaskCreateStaticPinnedToCore(fn, name, stack_size, arg, prio, (StackType_t *)(mem + head),
+                                                 (StaticTask_t *)mem, core);
+    if (!task->handle) return ESP_ERR_NO_MEM;
+    s_tasks++;
+    return ESP_OK;
+}
+
+void ota_arena_task_exit(void)
+{
+    for (;;) vTaskSuspend(NULL);
+}
+
+void ota_arena_task_join(ota_arena_task_t *task)
+{
+    if (!task->handle) return;
+    /* Suspended is only reported once the task is off its core: deleting it from
+     * here then frees it at once, nothing touches the memory afterwards */
+    while (eTaskGetState(task->handle) != eSuspended) vTaskDelay(1);
+    vTaskDelete(task->handle);
+    task->handle = NULL;
+    s_tasks--;
+}
+
+void ota_arena_reset(void)
+{
+    if (s_tasks) {
+        /* Their stacks would be handed out again: keep the session (and its leak) */
+        ESP_LOGE(TAG, "%u arena tasks still running, not reset", (unsigned)s_tasks);
+        return;
+    }
+    s_stats.sessions++;
+    s_stats.peak = s_peak;
+    if (s_peak > s_stats.peak_max) s_stats.peak_max = s_peak;
+    s_stats.last_failures = s_fail;
+    s_stats.failures += s_fail;
+    if (s_fail) {
+        ESP_LOGW(TAG, "Session memory: peak %u of %u B, %u requests served by the heap (raise CONFIG_OTA_ARENA_KB)",
+                 (unsigned)s_peak, (unsigned)ARENA_SIZE, (unsigned)s_fail);
+    } else {
+        ESP_LOGI(TAG, "Session memory: peak %u of %u B (%u%%)",
+                 (unsigned)s_peak, (unsigned)ARENA_SIZE, (unsigned)(s_peak * 100 / ARENA_SIZE));
+    }
+
+    s_used = 0;
+    s_peak = 0;
+    s_fail = 0;
+    if (++s_session == 0) s_session = 1;
+}
+
+void ota_arena_get_stats(ota_arena_stats_t *out)
+{
+    *out = s_stats;
+    out->size = ARENA_SIZE;
+    out->used = s_used;
+}
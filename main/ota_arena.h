@@ -0,0 +1,194 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_arena.h
+ * @brief Fixed memory arena for the per-session OTA allocations
+ *
+ * Everything an OTA session creates for itself comes from one static block
+ * (CONFIG_OTA_ARENA_KB) reserved in .bss at link time, instead of the general
+ * heap:
+ * - the stacks and TCBs of the pipeline writer and eraser and of the parallel
+ *   range workers
+ * - the storage of their queues
+ * - the block sync hash tables and read buffer
+ *
+ * Allocation is a bump of an offset and the whole session is released at once
+ * by ota_arena_reset() when it ends, in O(1): there is no per-block free, no
+ * fragmentation, and a session allocates the same blocks at the same addresses
+ * as the previous one. The owner of a resettable object keeps it in an
+ * ota_arena_block_t: it is carved on first use and reused by the next retries
+ * of the same session.
+ *
+ * A request the arena cannot serve falls back to the heap and is counted as a
+ * failure; the session log reports the peak use against the size so the arena
+ * can be tuned. The HTTP client and mbedTLS allocate their buffers themselves
+ * and are not covered (the client and its connection are kept between sessions,
+ * see CONFIG_OTA_CONN_REUSE).
+ *
+ * Tasks with their stack in the arena must not delete themselves: a deleted
+ * task is freed later by the idle task, possibly after the memory was reused.
+ * They end with ota_arena_task_exit() and their owner reclaims them with
+ * ota_arena_task_join().
+ *
+ * Allocations and resets are made by the OTA task only.
+ *
+ * The following functions are provided:
+ * - ota_arena_alloc() / ota_arena_free(): Session block.
+ * - ota_arena_get(): Session block kept across the retries of a session.
+ * - ota_arena_queue_create(): Queue with its storage in the arena.
+ * - ota_arena_task_create() / ota_arena_task_exit() / ota_arena_task_join():
+ *   Task with its stack and TCB in the arena.
+ * - ota_arena_reset(): End the session: release everything and log the use.
+ * - ota_arena_get_stats(): Size, peak use and failures.
+ *
+ * @author Marconatale Parise
+ * @date 27 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Block owned by a module for the rest of the session
+ */
+typedef struct {
+    void    *ptr;
+    size_t   size;
+    uint32_t session;   /*!< Session the block was carved in */
+    bool     heap;      /*!< Arena exhausted: taken from the heap */
+} ota_arena_block_t;
+
+/**
+ * @brief Task created with ota_arena_task_create()
+ */
+typedef struct {
+    ota_arena_block_t mem;      /*!< TCB + stack */
+    TaskHandle_t      handle;   /*!< NULL: not running */
+} ota_arena_task_t;
+
+/**
+ * @brief Arena statistics (bytes)
+ */
+typedef struct {
+    size_t   size;          /*!< Arena size */
+    size_t   used;          /*!< In use by the current session */
+    size_t   peak;          /*!< Peak use of the last finished session */
+    size_t   peak_max;      /*!< Peak use since boot */
+    uint32_t sessions;      /*!< Sessions ended since boot */
+    uint32_t failures;      /*!< Requests served by the heap since boot */
+    uint32_t last_failures; /*!< Requests served by the heap in the last finished session */
+} ota_arena_stats_t;
+
+/**
+ * @brief Allocate a block for the current session
+ *
+ * @param size Bytes
+ *
+ * @return Block (aligned for any type and for task stacks), or NULL if the
+ *         arena is full and the heap fallback failed too
+ */
+void *ota_arena_alloc(size_t size);
+
+/**
+ * @brief Release a block of ota_arena_alloc()
+ *
+ * Arena blocks are only released by ota_arena_reset(); heap fallbacks are freed.
+ */
+void ota_arena_free(void *ptr);
+
+/**
+ * @brief Block of the current session, carved on first use
+ *
+ * @param blk  Owner's block
+ * @param size Bytes (the same on every call)
+ *
+ * @return Block, or NULL if out of memory
+ */
+void *ota_arena_get(ota_arena_block_t *blk, size_t size);
+
+/**
+ * @brief Create a queue with its storage in the arena
+ *
+ * Deleted with vQueueDelete() as usual.
+ *
+ * @param blk       Owner's block
+ * @param length    Queue length
+ * @param item_size Item size
+ *
+ * @return Queue, or NULL if out of memory
+ */
+QueueHandle_t ota_arena_queue_create(ota_arena_block_t *blk, UBaseType_t length, UBaseType_t item_size);
+
+/**
+ * @brief Create a task with its stack and TCB in the arena
+ *
+ * The task ends with ota_arena_task_exit() and is reclaimed with
+ * ota_arena_task_join() before it can be created again.
+ *
+ * @param task       Owner's task slot (task->handle is set)
+ * @param fn         Task function
+ * @param name       Task name
+ * @param stack_size Stack size in bytes
+ * @param arg        Task argument
+ * @param prio       Priority
+ * @param core       Core, or tskNO_AFFINITY
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if the slot still holds a task,
+ *         ESP_ERR_NO_MEM
+ */
+esp_err_t ota_arena_task_create(ota_arena_task_t *task, TaskFunction_t fn, const char *name,
+                                uint32_t stack_size, void *arg, UBaseType_t prio, BaseType_t core);
+
+/**
+ * @brief End the calling arena task (instead of vTaskDelete(NULL))
+ *
+ * Called after the owner was told the task is done; does not return.
+ */
+void ota_arena_task_exit(void);
+
+/**
+ * @brief Wait for an arena task to reach ota_arena_task_exit() and delete it
+ *
+ * On return its memory can be reused. No-op if the slot holds no task.
+ */
+void ota_arena_task_join(ota_arena_task_t *task);
+
+/**
+ * @brief End the session: release all its blocks and log the peak use
+ *
+ * Refused (error logged) while an arena task is still running.
+ */
+void ota_arena_reset(void);
+
+/**
+ * @brief Get the arena statistics
+ */
+void ota_arena_get_stats(ota_arena_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,251 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_bench.c
+ * @brief On-device OTA download benchmark
+ *
+ * @author Marconatale Parise
+ * @date 10 Mar 2026
+ */
+#include "ota_bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "esp_ota_ops.h"
+#include "esp_http_client.h"
+
+#include "ota_hal.h"
+#include "ota_pipeline.h"
+#include "ota_resume.h"
+#include "ota_decomp.h"
+#include "ota_parallel.h"
+#include "ota_arena.h"
+
+static const char *TAG = "ota_bench";
+
+#define BENCH_REPEAT    CONFIG_OTA_BENCH_REPEAT
+#define ARRAY_LEN(a)    (sizeof(a) / sizeof((a)[0]))
+
+/* Sweep: every combination is run BENCH_REPEAT times */
+static const int      s_rx_buf[]     = { 1024, 4096, 16384 };
+static const int      s_tx_buf[]     = { 1024, 8192 };
+static const bool     s_keep_alive[] = { false, true };
+static const uint32_t s_size_kb[]    = { 128, 512, 0 };     /* 0: whole image */
+
+typedef struct {
+    int      rx_buf;
+    int      tx_buf;
+    bool     keep_alive;
+    uint32_t limit;         /* bytes to fetch, 0 for the whole image */
+    int      conns;         /* parallel ranged connections (1: single stream) */
+} bench_case_t;
+
+static uint32_t s_image_len;    /* learnt from the first whole image run */
+
+/* Idle task run time of all cores, in run time counter ticks (us with esp_timer) */
+static uint32_t idle_time(void)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint32_t idle = 0;
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+        idle += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+    return idle;
+#else
+    return 0;
+#endif
+}
+
+/* Receive up to limit bytes into the pipeline, sampling free heap on the way */
+static esp_err_t bench_stream(esp_http_client_handle_t client, uint32_t limit,
+                              uint32_t *received, size_t *heap_min)
+{
+    while (limit == 0 || *received < limit) {
+        size_t cap = 0;
+        uint8_t *buf = ota_pipeline_acquire(&cap);
+        if (!buf) return ESP_ERR_INVALID_STATE;
+        if (limit && cap > limit - *received) cap = limit - *received;
+
+        size_t fill = 0;
+        int n = 0;
+        while (fill < cap) {
+            n = esp_http_client_read(client, (char *)buf + fill, cap - fill);
+            if (n == -ESP_ERR_HTTP_EAGAIN) continue;
+            if (n <= 0) break;
+            fill += n;
+        }
+        *received += fill;
+        esp_err_t err = ota_pipeline_submit(buf, fill);
+        size_t heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        if (heap < *heap_min) *heap_min = heap;
+
+        if (n < 0) return ESP_FAIL;
+        if (err != ESP_OK) return err;
+        if (fill < cap) break;      /* end of body */
+    }
+    return ESP_OK;
+}
+
+/* Parallel progress callback: free heap with the worker connections open */
+static void bench_heap_sample(void *arg)
+{
+    size_t *heap_min = arg;
+    size_t heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (heap < *heap_min) *heap_min = heap;
+}
+
+static esp_err_t bench_case(int run, const bench_case_t *bc, const char *url, const esp_partition_t *update)
+{
+    esp_http_client_config_t cfg;
+    esp_err_t err = ota_hal_http_config(&cfg, url);
+    if (err != ESP_OK) return err;
+    cfg.buffer_size = bc->rx_buf;
+    cfg.buffer_size_tx = bc->tx_buf;
+    cfg.keep_alive_enable = bc->keep_alive;
+
+    size_t heap0 = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t heap_min = heap0;
+    uint32_t idle0 = idle_time();
+    int64_t t0 = esp_timer_get_time();
+    uint32_t received = 0;
+    size_t flashed = 0;
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) return ESP_ERR_NO_MEM;
+    /* Parallel runs open with the first range, like the HAL does */
+    uint32_t first = bc->conns > 1 ? (uint32_t)ota_parallel_range_size() : bc->limit;
+    if (first) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=0-%" PRIu32, first - 1);
+        esp_http_client_set_header(client, "Range", range);
+    }
+
+    int64_t content_len = 0;
+    err = esp_http_client_open(client, 0);
+    if (err == ESP_OK) {
+        content_len = esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status != 200 && status != 206) {
+            ESP_LOGE(TAG, "Unexpected HTTP status %d", status);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    if (err == ESP_OK) {
+        const ota_pipeline_filter_t *filter = NULL;
+#if CONFIG_OTA_DECOMP_ENABLE
+        ota_decomp_reset();
+        filter = &ota_decomp_filter;
+#endif
+        err = ota_pipeline_begin(update, OTA_SIZE_UNKNOWN, 0, filter);
+        if (err == ESP_OK && bc->conns > 1) {
+            err = ota_parallel_download(client, url, NULL, 0, (size_t)content_len, s_image_len, bc->conns,
+                                        bench_heap_sample, &heap_min);
+            ota_pipeline_abort();
+            flashed = ota_pipeline_written();
+            received = err == ESP_OK ? s_image_len : (uint32_t)flashed;
+        } else if (err == ESP_OK) {
+            err = bench_stream(client, bc->limit, &received, &heap_min);
+            /* abort() drains the ring: pending writes are part of the measurement */
+            ota_pipeline_abort();
+            flashed = ota_pipeline_written();
+        }
+    }
+    esp_http_client_cleanup(client);
+    ota_arena_reset();      /* one session per run: its peak is reported below */
+    ota_arena_stats_t arena;
+    ota_arena_get_stats(&arena);
+    if (err == ESP_OK && bc->limit == 0 && bc->conns <= 1 && s_image_len == 0) s_image_len = received;
+
+    int64_t us = esp_timer_get_time() - t0;
+    int64_t cpu_us = -1;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    cpu_us = us * portNUM_PROCESSORS - (int64_t)(uint32_t)(idle_time() - idle0);
+#else
+    (void)idle0;
+#endif
+    printf("OTA_BENCH {\"run\":%d,\"rx_buf\":%d,\"tx_buf\":%d,\"keep_alive\":%d,\"conns\":%d,\"size\":%" PRIu32
+           ",\"bytes\":%" PRIu32 ",\"flashed\":%u,\"ms\":%" PRId64 ",\"kbps\":%.1f,\"peak_heap\":%u"
+           ",\"arena\":%u,\"cpu_us\":%" PRId64 ",\"err\":\"%s\"}\n",
+           run, bc->rx_buf, bc->tx_buf, bc->keep_alive, bc->conns, bc->limit, received, (unsigned)flashed, us / 1000,
+           us > 0 ? received * 1e6 / 1024.0 / us : 0.0, (unsigned)(heap0 - heap_min),
+           (unsigned)arena.peak, cpu_us, esp_err_to_name(err));
+    return err;
+}
+
+esp_err_t ota_bench_run(void)
+{
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    if (!update) return ESP_ERR_NOT_FOUND;
+
+    /* The sweep overwrites the update partition: an interrupted download can't resume into it */
+    ota_resume_clear();
+
+    const char *url = ota_cfg.url;
+    ESP_LOGI(TAG, "Benchmarking %s into %s", url, update->label);
+    const esp_app_desc_t *app = esp_app_get_description();
+    printf("OTA_BENCH_BEGIN {\"version\":\"%s\",\"idf\":\"%s\",\"pipe_bufs\":%d,\"pipe_buf_size\":%d,\"repeat\":%d}\n",
+           app->version, app->idf_ver,
+           CONFIG_OTA_PIPELINE_BUF_COUNT, CONFIG_OTA_PIPELINE_BUF_SIZE, BENCH_REPEAT);
+
+    int run = 0;
+    int failed = 0;
+    for (int rep = 0; rep < BENCH_REPEAT; rep++) {
+        for (size_t s = 0; s < ARRAY_LEN(s_size_kb); s++) {
+            for (size_t r = 0; r < ARRAY_LEN(s_rx_buf); r++) {
+                for (size_t t = 0; t < ARRAY_LEN(s_tx_buf); t++) {
+                    for (size_t k = 0; k < ARRAY_LEN(s_keep_alive); k++) {
+                        const bench_case_t bc = {
+                            .rx_buf = s_rx_buf[r],
+                            .tx_buf = s_tx_buf[t],
+                            .keep_alive = s_keep_alive[k],
+                            .limit = s_size_kb[s] * 1024,
+                            .conns = 1,
+                        };
+                        if (bench_case(run++, &bc, url, update) != ESP_OK) failed++;
+                    }
+                }
+            }
+        }
+    }
+
+    /* Throughput curve over parallel connections: whole image, HAL buffer sizes */
+    int max_conns = ota_parallel_conns(CONFIG_OTA_PARALLEL_CONN);
+    for (int rep = 0; rep < BENCH_REPEAT && max_conns > 1 && s_image_len > ota_parallel_range_size(); rep++) {
+        for (int n = 1; n <= max_conns; n++) {
+            const bench_case_t bc = {
+                .rx_buf = 4096,
+                .tx_buf = 1024,
+                .keep_alive = ota_cfg.keep_alive,
+                .limit = 0,
+                .conns = n,
+            };
+            if (bench_case(run++, &bc, url, update) != ESP_OK) failed++;
+        }
+    }
+
+    printf("OTA_BENCH_END {\"runs\":%d,\"failed\":%d}\n", run, failed);
+    return failed ? ESP_FAIL : ESP_OK;
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_bench.h
+ * @brief On-device OTA download benchmark
+ *
+ * Runs the OTA data path (HTTP client -> pipeline -> update partition) over a
+ * sweep of HTTP client receive/transmit buffer sizes, keep-alive and image
+ * sizes, without ever switching the boot partition. Each run prints one line
+ *
+ *     OTA_BENCH {"run":..,"rx_buf":..,"tx_buf":..,"keep_alive":..,"conns":..,"size":..,
+ *                "bytes":..,"flashed":..,"ms":..,"kbps":..,"peak_heap":..,
+ *                "arena":..,"cpu_us":..,"err":".."}
+ *
+ * framed by OTA_BENCH_BEGIN / OTA_BENCH_END lines. Image sizes are limited with
+ * "Range: bytes=0-<n>", so the benchmark URL may serve any full image.
+ * With CONFIG_OTA_PARALLEL_CONN > 1 a second sweep downloads the whole image
+ * over 1..N parallel ranged connections (conns), giving the throughput curve as
+ * N grows; tools/ota_test_server.py is a local server with added latency for it.
+ * peak_heap is the heap taken by the run (HTTP client and TLS), arena the peak
+ * of the OTA session arena (pipeline and range worker tasks, see ota_arena.h).
+ * cpu_us is the busy time of all cores (needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS,
+ * -1 otherwise). tools/ota_bench_report.py turns a serial log into CSV and
+ * compares it against a baseline.
+ *
+ * The benchmark overwrites the update partition and drops any resume checkpoint.
+ *
+ * The following functions are provided:
+ * - ota_bench_run(): Run the whole sweep (blocking).
+ *
+ * @author Marconatale Parise
+ * @date 10 Mar 2026
+ */
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run the OTA benchmark sweep against the firmware URL (blocking)
+ *
+ * Assumes the network is already connected.
+ *
+ * @return ESP_OK if every run completed, ESP_FAIL if at least one failed
+ */
+esp_err_t ota_bench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,299 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_blocksync.c
+ * @brief Block level differential OTA (zsync style) against the running image
+ *
+ * @author Marconatale Parise
+ * @date 12 Mar 2026
+ */
+#include "ota_blocksync.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+#include "mbedtls/sha256.h"
+
+#include "ota_arena.h"
+#include "ota_pipeline.h"
+#include "ota_verify.h"
+#include "ota_stats.h"
+
+static const char *TAG = "ota_blocksync";
+
+#define BS_BLOCK    OTA_BLOCKSYNC_BLOCK_SIZE
+#define BS_NO_SRC   (-1)
+
+static struct {
+    uint64_t *run_hash;     /* truncated SHA-256 of each running image block */
+    uint32_t run_blocks;
+    uint32_t run_len;
+    int16_t  *src;          /* per new block: running block to copy, or BS_NO_SRC */
+    uint32_t blocks;
+    uint8_t  *buf;          /* pipeline buffer being filled */
+    size_t   cap;
+    size_t   fill;
+    uint32_t ranges;        /* ranged requests sent */
+} s_bs;
+
+static size_t block_len(uint32_t block, uint32_t image_len)
+{
+    size_t start = (size_t)block * BS_BLOCK;
+    return image_len - start < BS_BLOCK ? image_len - start : BS_BLOCK;
+}
+
+/* Truncated to 64 bits: collisions are caught by the whole image SHA-256 only (see ota_blocksync.h) */
+static uint64_t block_hash(const uint8_t *sha)
+{
+    uint64_t h;
+    memcpy(&h, sha, sizeof(h));
+    return h;
+}
+
+/* Fill buf completely (or up to end of body) */
+static int http_read_full(esp_http_client_handle_t client, uint8_t *buf, size_t len)
+{
+    size_t fill = 0;
+    while (fill < len) {
+        int n = esp_http_client_read(client, (char *)buf + fill, len - fill);
+        if (n == -ESP_ERR_HTTP_EAGAIN) continue;
+        if (n <= 0) return n < 0 ? n : (int)fill;
+        fill += n;
+    }
+    return (int)fill;
+}
+
+static esp_err_t hash_running(const esp_partition_t *running)
+{
+    const esp_partition_pos_t pos = { .offset = running->address, .size = running->size };
+    esp_image_metadata_t meta;
+    esp_err_t err = esp_image_get_metadata(&pos, &meta);
+    if (err != ESP_OK) return err;
+
+    s_bs.run_len = meta.image_len;
+    s_bs.run_blocks = (meta.image_len + BS_BLOCK - 1) / BS_BLOCK;
+    s_bs.run_hash = ota_arena_alloc(s_bs.run_blocks * sizeof(uint64_t));
+    uint8_t *blk = ota_arena_alloc(BS_BLOCK);
+    if (!s_bs.run_hash || !blk) {
+        ota_arena_free(blk);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    uint8_t sha[HASH_LEN];
+    for (uint32_t i = 0; i < s_bs.run_blocks && err == ESP_OK; i++) {
+        size_t len = block_len(i, s_bs.run_len);
+        err = esp_partition_read(running, (size_t)i * BS_BLOCK, blk, len);
+        if (err == ESP_OK) {
+            mbedtls_sha256(blk, len, sha, 0);
+            s_bs.run_hash[i] = block_hash(sha);
+        }
+    }
+    ota_arena_free(blk);
+    ESP_LOGI(TAG, "Hashed %" PRIu32 " running blocks in %" PRId64 " ms",
+             s_bs.run_blocks, (esp_timer_get_time() - t0) / 1000);
+    return err;
+}
+
+/* Same position first (unchanged block), then any block aligned position */
+static int16_t find_block(uint64_t h, uint32_t block)
+{
+    if (block < s_bs.run_blocks && s_bs.run_hash[block] == h) return (int16_t)block;
+    for (uint32_t i = 0; i < s_bs.run_blocks; i++) {
+        if (s_bs.run_hash[i] == h) return (int16_t)i;
+    }
+    return BS_NO_SRC;
+}
+
+static esp_err_t load_manifest(esp_http_client_handle_t client, const esp_partition_t *update,
+                               ota_blocksync_header_t *hdr)
+{
+    esp_err_t err = ota_hal_http_open(client, NULL);
+    if (err != ESP_OK) return err;
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGW(TAG, "No block manifest available (HTTP %d)", status);
+        int len = 0;
+        if (esp_http_client_flush_response(client, &len) != ESP_OK) return ESP_FAIL;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (http_read_full(client, (uint8_t *)hdr, sizeof(*hdr)) != sizeof(*hdr)) return ESP_FAIL;
+    if (memcmp(hdr->magic, OTA_BLOCKSYNC_MAGIC, 4) != 0 || hdr->block_size != BS_BLOCK ||
+        hdr->image_len == 0 || hdr->image_len > update->size) {
+        ESP_LOGE(TAG, "Invalid block manifest");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_bs.blocks = (hdr->image_len + BS_BLOCK - 1) / BS_BLOCK;
+    s_bs.src = ota_arena_alloc(s_bs.blocks * sizeof(int16_t));
+    if (!s_bs.src) return ESP_ERR_NO_MEM;
+
+    uint8_t sha[HASH_LEN];
+    for (uint32_t i = 0; i < s_bs.blocks; i++) {
+        if (http_read_full(client, sha, sizeof(sha)) != sizeof(sha)) return ESP_FAIL;
+        s_bs.src[i] = find_block(block_hash(sha), i);
+    }
+    ota_stats_add_rx(sizeof(*hdr) + s_bs.blocks * HASH_LEN);
+    return ESP_OK;
+}
+
+/* Make room in the current pipeline buffer, handing a full one to the writer */
+static esp_err_t out_room(void)
+{
+    if (s_bs.buf && s_bs.fill < s_bs.cap) return ESP_OK;
+    if (s_bs.buf) {
+        esp_err_t err = ota_pipeline_submit(s_bs.buf, s_bs.fill);
+        s_bs.buf = NULL;
+        if (err != ESP_OK) return err;
+    }
+    s_bs.fill = 0;
+    s_bs.buf = ota_pipeline_acquire(&s_bs.cap);
+    return s_bs.buf ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+static esp_err_t emit_copy(const esp_partition_t *running, size_t src, size_t len)
+{
+    while (len > 0) {
+        esp_err_t err = out_room();
+        if (err != ESP_OK) return err;
+        size_t n = len < s_bs.cap - s_bs.fill ? len : s_bs.cap - s_bs.fill;
+        err = esp_partition_read(running, src, s_bs.buf + s_bs.fill, n);
+        if (err != ESP_OK) return err;
+        s_bs.fill += n;
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/* The previous response was read to the end, so the request reuses the connection */
+static esp_err_t range_request(esp_http_client_handle_t client, const char *range, size_t len)
+{
+    int64_t content_len = 0;
+    esp_err_t err = ota_hal_http_open(client, &content_len);
+    if (err != ESP_OK) return err;
+    int status = esp_http_client_get_status_code(client);
+    if (status != 206 || content_len != (int64_t)len) {
+        ESP_LOGE(TAG, "Range request %s not honored (HTTP %d, %" PRId64 " B)", range, status, content_len);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t emit_fetch(esp_http_client_handle_t client, size_t offset, size_t len)
+{
+    char range[40];
+    snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)offset, (unsigned)(offset + len - 1));
+    esp_http_client_set_header(client, "Range", range);
+    s_bs.ranges++;
+
+    esp_err_t err = range_request(client, range, len);
+    if (err != ESP_OK) return err;
+
+    while (len > 0) {
+        err = out_room();
+        if (err != ESP_OK) return err;
+        size_t want = len < s_bs.cap - s_bs.fill ? len : s_bs.cap - s_bs.fill;
+        int n = http_read_full(client, s_bs.buf + s_bs.fill, want);
+        if (n <= 0) return ESP_FAIL;
+        ota_stats_add_rx(n);
+        s_bs.fill += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sync_image(esp_http_client_handle_t client, const esp_partition_t *running,
+                            const esp_partition_t *update, const ota_blocksync_header_t *hdr)
+{
+    uint32_t local = 0;
+    for (uint32_t i = 0; i < s_bs.blocks; i++) {
+        if (s_bs.src[i] != BS_NO_SRC) local++;
+    }
+    ESP_LOGI(TAG, "%" PRIu32 " of %" PRIu32 " blocks available locally", local, s_bs.blocks);
+    if (local == 0) return ESP_ERR_NOT_FOUND;
+
+    ota_verify_set_expected(hdr->image_sha256);
+    esp_err_t err = ota_pipeline_begin(update, hdr->image_len, 0, NULL);
+    if (err != ESP_OK) return err;
+
+    s_bs.buf = NULL;
+    s_bs.ranges = 0;
+    uint32_t i = 0;
+    while (i < s_bs.blocks && err == ESP_OK) {
+        if (s_bs.src[i] != BS_NO_SRC) {
+            err = emit_copy(running, (size_t)s_bs.src[i] * BS_BLOCK, block_len(i, hdr->image_len));
+            i++;
+            continue;
+        }
+        /* One request per run of missing blocks */
+        uint32_t j = i;
+        while (j < s_bs.blocks && s_bs.src[j] == BS_NO_SRC) j++;
+        size_t start = (size_t)i * BS_BLOCK;
+        size_t end = (size_t)j * BS_BLOCK < hdr->image_len ? (size_t)j * BS_BLOCK : hdr->image_len;
+        err = emit_fetch(client, start, end - start);
+        i = j;
+    }
+    if (err == ESP_OK && s_bs.buf) {
+        err = ota_pipeline_submit(s_bs.buf, s_bs.fill);
+        s_bs.buf = NULL;
+    }
+    if (err != ESP_OK) {
+        if (s_bs.buf) ota_pipeline_submit(s_bs.buf, 0);
+        ota_pipeline_abort();
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Copied %" PRIu32 " KB locally, fetched %" PRIu32 " KB in %" PRIu32 " range requests",
+             local * BS_BLOCK / 1024, (hdr->image_len - local * BS_BLOCK) / 1024, s_bs.ranges);
+    return ota_pipeline_finish();
+}
+
+esp_err_t ota_blocksync_download(esp_http_client_handle_t client, const char *manifest_url,
+                                 const char *image_url, const esp_partition_t *update)
+{
+    if (!client || !manifest_url || !image_url || !update) return ESP_ERR_INVALID_ARG;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    ota_blocksync_header_t hdr;
+
+    esp_http_client_delete_header(client, "Range");
+    esp_http_client_delete_header(client, "If-Range");
+    esp_http_client_set_url(client, manifest_url);
+
+    esp_err_t err = hash_running(running);
+    if (err == ESP_OK) err = load_manifest(client, update, &hdr);
+    if (err == ESP_OK) {
+        /* Same host: set_url keeps the connection open */
+        esp_http_client_set_url(client, image_url);
+        err = sync_image(client, running, update, &hdr);
+    }
+    /* ESP_ERR_NOT_FOUND: responses were read to the end, the connection stays usable */
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) esp_http_client_close(client);
+    esp_http_client_delete_header(client, "Range");
+
+    ota_arena_free(s_bs.run_hash);
+    ota_arena_free(s_bs.src);
+    s_bs.run_hash = NULL;
+    s_bs.src = NULL;
+    return err;
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_blocksync.h
+ * @brief Block level differential OTA (zsync style) against the running image
+ *
+ * The server publishes, next to the raw firmware image, a manifest with the
+ * SHA-256 of every 4 KB block of the image (tools/ota_blockmap.py):
+ * - header: "OBM1" | block_size u32 | image_len u32 | reserved u32 | image_sha256[32]
+ * - one SHA-256 per block (the last block is hashed over its actual length)
+ *
+ * The device hashes the blocks of its running image, copies every block of the
+ * new image that it already has (at any block aligned position) flash to flash
+ * and fetches the remaining runs of blocks from the image URL with
+ * "Range: bytes=<a>-<b>" requests on the same kept-alive connection. Any static
+ * file server with Range support works; no per-version patch is needed.
+ *
+ * Blocks are matched on the first 64 bits of their SHA-256 only (8 bytes per
+ * running block in the session arena). A collision copies the wrong local
+ * block: the only guard against it is the SHA-256 of the whole image from the
+ * manifest, checked by ota_verify before the boot switch. A collision then
+ * fails that check and the update falls back to the full image; it can never
+ * produce a bad image.
+ *
+ * The following functions are provided:
+ * - ota_blocksync_download(): Build the new image from local and fetched blocks.
+ *
+ * @author Marconatale Parise
+ * @date 12 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_http_client.h"
+#include "ota_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_BLOCKSYNC_MAGIC      "OBM1"
+#define OTA_BLOCKSYNC_BLOCK_SIZE 4096
+
+/**
+ * @brief Block manifest header (48 bytes, little endian)
+ */
+typedef struct __attribute__((packed)) {
+    char     magic[4];                  /*!< OTA_BLOCKSYNC_MAGIC */
+    uint32_t block_size;                /*!< OTA_BLOCKSYNC_BLOCK_SIZE */
+    uint32_t image_len;                 /*!< Length of the new image */
+    uint32_t reserved;
+    uint8_t  image_sha256[HASH_LEN];    /*!< SHA-256 of the whole new image */
+} ota_blocksync_header_t;
+
+/**
+ * @brief Download an image by block sync and select it for boot
+ *
+ * @param client       HTTP client (the connection is reused for all requests)
+ * @param manifest_url URL of the block manifest
+ * @param image_url    URL of the raw image (must support Range requests)
+ * @param update       Update partition
+ *
+ * @return ESP_OK if the new image is set as boot partition,
+ *         ESP_ERR_NOT_FOUND if no manifest or no common block (use a full download),
+ *         ESP_ERR_NOT_SUPPORTED if the server ignores Range requests
+ */
+esp_err_t ota_blocksync_download(esp_http_client_handle_t client, const char *manifest_url,
+                                 const char *image_url, const esp_partition_t *update);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_check.c
+ * @brief Update availability check: cached validators and manifest parsing
+ *
+ * @author Marconatale Parise
+ * @date 19 Mar 2026
+ */
+#include "ota_check.h"
+
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "cJSON.h"
+
+static const char *TAG = "ota_check";
+
+#define CHECK_NVS_NS    "ota_check"
+#define CHECK_NVS_KEY   "cache"
+#define CHECK_VERSION   1
+
+typedef struct {
+    uint32_t version;
+    ota_check_cache_t cache;
+} check_blob_t;
+
+static bool blob_read(check_blob_t *blob)
+{
+    nvs_handle_t h;
+    if (nvs_open(CHECK_NVS_NS, NVS_READONLY, &h) != ESP_OK) return false;
+    size_t len = sizeof(*blob);
+    esp_err_t err = nvs_get_blob(h, CHECK_NVS_KEY, blob, &len);
+    nvs_close(h);
+    return err == ESP_OK && len == sizeof(*blob) && blob->version == CHECK_VERSION;
+}
+
+void ota_check_load(ota_check_cache_t *cache)
+{
+    check_blob_t blob;
+    if (!blob_read(&blob)) {
+        memset(cache, 0, sizeof(*cache));
+        return;
+    }
+    blob.cache.image_validator[OTA_RESUME_VALIDATOR_LEN - 1] = '\0';
+    blob.cache.manifest_etag[OTA_RESUME_VALIDATOR_LEN - 1] = '\0';
+    blob.cache.manifest_version[OTA_CHECK_VERSION_LEN - 1] = '\0';
+    *cache = blob.cache;
+}
+
+esp_err_t ota_check_save(const ota_check_cache_t *cache)
+{
+    /* Checks run often: only write flash when something changed */
+    check_blob_t blob;
+    if (blob_read(&blob) && memcmp(&blob.cache, cache, sizeof(*cache)) == 0) return ESP_OK;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CHECK_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = CHECK_VERSION;
+    blob.cache = *cache;
+    err = nvs_set_blob(h, CHECK_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Cache save failed: %s", esp_err_to_name(err));
+    return err;
+}
+
+void ota_check_set_installed(const char *validator)
+{
+    ota_check_cache_t cache;
+    ota_check_load(&cache);
+    strlcpy(cache.image_validator, validator ? validator : "", sizeof(cache.image_validator));
+    ota_check_save(&cache);
+}
+
+static bool hex_to_bin(const char *hex, uint8_t *out, size_t len)
+{
+    if (strlen(hex) != len * 2) return false;
+    for (size_t i = 0; i < len; i++) {
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        if (!isxdigit((unsigned char)byte[0]) || !isxdigit((unsigned char)byte[1])) return false;
+        out[i] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    return true;
+}
+
+esp_err_t ota_check_parse_manifest(const char *json, size_t len, ota_check_cache_t *cache)
+{
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    if (!root) {
+        ESP_LOGE(TAG, "Manifest is not valid JSON");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    esp_err_t err = ESP_ERR_INVALID_RESPONSE;
+    const cJSON *version = cJSON_GetObjectItemCaseSensitive(root, "version");
+    if (cJSON_IsString(version) && version->valuestring[0]) {
+        strlcpy(cache->manifest_version, version->valuestring, sizeof(cache->manifest_version));
+        memset(cache->manifest_sha256, 0, sizeof(cache->manifest_sha256));
+        const cJSON *sha = cJSON_GetObjectItemCaseSensitive(root, "sha256");
+        if (cJSON_IsString(sha) && !hex_to_bin(sha->valuestring, cache->manifest_sha256,
+                                               sizeof(cache->manifest_sha256))) {
+            ESP_LOGW(TAG, "Ignoring malformed manifest sha256");
+            memset(cache->manifest_sha256, 0, sizeof(cache->manifest_sha256));
+        }
+        err = ESP_OK;
+    } else {
+        ESP_LOGE(TAG, "Manifest has no \"version\" string");
+    }
+    cJSON_Delete(root);
+    return err;
+}
+
+int ota_check_version_cmp(const char *a, const char *b)
+{
+    if (*a == 'v' || *a == 'V') a++;
+    if (*b == 'v' || *b == 'V') b++;
+    while (*a || *b) {
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b)) {
+            char *ea, *eb;
+            unsigned long na = strtoul(a, &ea, 10);
+            unsigned long nb = strtoul(b, &eb, 10);
+            if (na != nb) return na < nb ? -1 : 1;
+            a = ea;
+            b = eb;
+            continue;
+        }
+        if (*a != *b) return (unsigned char)*a - (unsigned char)*b;
+        a++;
+        b++;
+    }
+    return 0;
+}
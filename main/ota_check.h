@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_check.h
+ * @brief Update availability check: cached validators and manifest parsing
+ *
+ * ota_hal_check() answers "is there a newer firmware?" with one small request
+ * and without touching the update partition:
+ * - with a manifest URL (CONFIG_OTA_CHECK_MANIFEST_URL) it fetches a small JSON
+ *   document, conditional on the manifest ETag seen last time, e.g.
+ *   {"version": "1.4.0", "sha256": "<64 hex digits>"}; a 304 reuses the cached
+ *   version. The version is compared with esp_app_get_description()->version.
+ * - otherwise it sends HEAD to the firmware URL with If-None-Match (or
+ *   If-Modified-Since) set to the validator of the image installed last; 304
+ *   means the installed image is still the current one.
+ *
+ * This module keeps those validators in NVS (written only when they change) and
+ * holds the manifest/version helpers; the requests are sent by the OTA HAL.
+ *
+ * The following functions are provided:
+ * - ota_check_load() / ota_check_save(): Cached validators and manifest version.
+ * - ota_check_set_installed(): Remember the validator of the image just installed.
+ * - ota_check_parse_manifest(): Extract version and digest from a JSON manifest.
+ * - ota_check_version_cmp(): Compare two dotted version strings.
+ *
+ * @author Marconatale Parise
+ * @date 19 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ota_resume.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_CHECK_VERSION_LEN 32
+
+/**
+ * @brief Validators cached between checks
+ */
+typedef struct {
+    char image_validator[OTA_RESUME_VALIDATOR_LEN];  /*!< ETag/Last-Modified of the installed image */
+    char manifest_etag[OTA_RESUME_VALIDATOR_LEN];    /*!< ETag of the last manifest received */
+    char manifest_version[OTA_CHECK_VERSION_LEN];    /*!< Version announced by that manifest */
+    uint8_t manifest_sha256[32];                     /*!< Image digest announced by it (zero if none) */
+} ota_check_cache_t;
+
+/**
+ * @brief Load the cache from NVS (zeroed if there is none)
+ *
+ * @param[out] cache Cache
+ */
+void ota_check_load(ota_check_cache_t *cache);
+
+/**
+ * @brief Store the cache in NVS if it differs from the stored copy
+ *
+ * @param cache Cache
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_check_save(const ota_check_cache_t *cache);
+
+/**
+ * @brief Remember the validator of the image that was just installed
+ *
+ * @param validator ETag or Last-Modified of the firmware URL (NULL/empty: unknown)
+ */
+void ota_check_set_installed(const char *validator);
+
+/**
+ * @brief Parse a JSON manifest
+ *
+ * @param json        Manifest text (need not be NUL terminated)
+ * @param len         Length of json
+ * @param[out] cache  manifest_version and manifest_sha256 are filled
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_RESPONSE if there is no "version" string
+ */
+esp_err_t ota_check_parse_manifest(const char *json, size_t len, ota_check_cache_t *cache);
+
+/**
+ * @brief Compare two versions ("v1.10.2" > "1.9"): numeric fields as numbers
+ *
+ * @return <0, 0 or >0 like strcmp()
+ */
+int ota_check_version_cmp(const char *a, const char *b);
+
+#ifdef __cplusplus
+}
+#endif
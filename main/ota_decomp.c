@@ -0,0 +1,244 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_decomp.c
+ * @brief Streaming decompression of compressed firmware images (heatshrink LZSS)
+ *
+ * @author Marconatale Parise
+ * @date 06 Mar 2026
+ */
+#include "ota_decomp.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ota_stats.h"
+
+static const char *TAG = "ota_decomp";
+
+#define DECOMP_WINDOW_SIZE  (1u << CONFIG_OTA_DECOMP_WINDOW_SZ2)
+#define DECOMP_OUT_SIZE     4096    /* one flash sector */
+/* The window doubles as the output buffer: whole sectors are emitted straight from it */
+#define DECOMP_BUF_SIZE     (DECOMP_WINDOW_SIZE > DECOMP_OUT_SIZE ? DECOMP_WINDOW_SIZE : DECOMP_OUT_SIZE)
+#define DECOMP_BUF_MASK     (DECOMP_BUF_SIZE - 1)
+
+typedef enum {
+    DEC_ST_DETECT = 0,  /* first payload bytes not seen yet */
+    DEC_ST_RAW,         /* raw image: pass-through */
+    DEC_ST_TAG,
+    DEC_ST_LITERAL,
+    DEC_ST_INDEX,
+    DEC_ST_COUNT,
+    DEC_ST_COPY,
+    DEC_ST_DONE,
+} dec_state_t;
+
+static struct {
+    dec_state_t state;
+    uint8_t  window_sz2;
+    uint8_t  lookahead_sz2;
+    uint32_t image_len;
+    uint32_t produced;
+    uint32_t consumed;          /* compressed bytes, header included */
+    uint32_t bitbuf;
+    uint8_t  bitcnt;
+    uint16_t index;             /* back-reference distance - 1 */
+    uint16_t count;             /* bytes left to copy */
+    uint32_t head;              /* window write position (bytes produced since the header) */
+    uint32_t flushed;           /* window bytes already emitted */
+    int64_t  busy_us;           /* time spent decoding */
+    uint8_t  window[DECOMP_BUF_SIZE];
+} s_dec;
+
+void ota_decomp_reset(void)
+{
+    s_dec.state = DEC_ST_DETECT;
+    s_dec.produced = 0;
+    s_dec.consumed = 0;
+    s_dec.busy_us = 0;
+    s_dec.image_len = 0;
+}
+
+bool ota_decomp_active(void)
+{
+    return s_dec.state != DEC_ST_DETECT && s_dec.state != DEC_ST_RAW;
+}
+
+/* Emit the bytes produced since the last flush: they never cross a sector boundary of the window */
+static esp_err_t out_flush(ota_pipeline_emit_t emit)
+{
+    size_t n = s_dec.head - s_dec.flushed;
+    if (n == 0) return ESP_OK;
+    esp_err_t err = emit(&s_dec.window[s_dec.flushed & DECOMP_BUF_MASK], n);
+    s_dec.flushed = s_dec.head;
+    return err;
+}
+
+static inline esp_err_t out_byte(uint8_t c, ota_pipeline_emit_t emit)
+{
+    s_dec.window[s_dec.head++ & DECOMP_BUF_MASK] = c;
+    s_dec.produced++;
+    if (s_dec.produced == s_dec.image_len) s_dec.state = DEC_ST_DONE;
+    return (s_dec.head & (DECOMP_OUT_SIZE - 1)) == 0 ? out_flush(emit) : ESP_OK;
+}
+
+/* Returns true when n bits are available, pulling bytes from the input */
+static bool get_bits(uint8_t n, const uint8_t **data, size_t *len, uint16_t *val)
+{
+    while (s_dec.bitcnt < n) {
+        if (*len == 0) return false;
+        s_dec.bitbuf = (s_dec.bitbuf << 8) | **data;
+        s_dec.bitcnt += 8;
+        (*data)++;
+        (*len)--;
+    }
+    s_dec.bitcnt -= n;
+    *val = (uint16_t)((s_dec.bitbuf >> s_dec.bitcnt) & ((1u << n) - 1));
+    return true;
+}
+
+static esp_err_t decode(const uint8_t *data, size_t len, ota_pipeline_emit_t emit)
+{
+    esp_err_t err = ESP_OK;
+    uint16_t v;
+
+    while (err == ESP_OK) {
+        switch (s_dec.state) {
+            case DEC_ST_TAG:
+                if (!get_bits(1, &data, &len, &v)) return ESP_OK;
+                s_dec.state = v ? DEC_ST_LITERAL : DEC_ST_INDEX;
+                break;
+            case DEC_ST_LITERAL:
+                if (!get_bits(8, &data, &len, &v)) return ESP_OK;
+                s_dec.state = DEC_ST_TAG;
+                err = out_byte((uint8_t)v, emit);
+                break;
+            case DEC_ST_INDEX:
+                if (!get_bits(s_dec.window_sz2, &data, &len, &v)) return ESP_OK;
+                s_dec.index = v;
+                s_dec.state = DEC_ST_COUNT;
+                break;
+            case DEC_ST_COUNT:
+                if (!get_bits(s_dec.lookahead_sz2, &data, &len, &v)) return ESP_OK;
+                if ((uint32_t)s_dec.index >= s_dec.produced) {
+                    ESP_LOGE(TAG, "Back-reference before start of image");
+                    return ESP_ERR_INVALID_ARG;
+                }
+                s_dec.count = v + 1;
+                s_dec.state = DEC_ST_COPY;
+                break;
+            case DEC_ST_COPY:
+                s_dec.state = DEC_ST_TAG;
+                while (s_dec.count > 0 && err == ESP_OK && s_dec.state != DEC_ST_DONE) {
+                    uint8_t c = s_dec.window[(s_dec.head - s_dec.index - 1) & DECOMP_BUF_MASK];
+                    s_dec.count--;
+                    err = out_byte(c, emit);
+                }
+                break;
+            case DEC_ST_DONE:
+                /* The encoder pads the last byte with zero bits: ignore them */
+                if (len > 0) {
+                    ESP_LOGE(TAG, "Trailing data after end of image");
+                    return ESP_ERR_INVALID_SIZE;
+                }
+                return ESP_OK;
+            default:
+                return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return err;
+}
+
+static esp_err_t detect(const uint8_t *data, size_t len, size_t *hdr_len)
+{
+    ota_decomp_header_t hdr;
+    *hdr_len = 0;
+    if (len < sizeof(hdr) || memcmp(data, OTA_DECOMP_MAGIC, 4) != 0) {
+        s_dec.state = DEC_ST_RAW;
+        return ESP_OK;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+    if (hdr.window_sz2 < 4 || hdr.window_sz2 > CONFIG_OTA_DECOMP_WINDOW_SZ2 ||
+        hdr.lookahead_sz2 < 2 || hdr.lookahead_sz2 >= hdr.window_sz2 || hdr.image_len == 0) {
+        ESP_LOGE(TAG, "Unsupported compressed image (w=%u l=%u, max w=%d)",
+                 hdr.window_sz2, hdr.lookahead_sz2, CONFIG_OTA_DECOMP_WINDOW_SZ2);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    s_dec.window_sz2 = hdr.window_sz2;
+    s_dec.lookahead_sz2 = hdr.lookahead_sz2;
+    s_dec.image_len = hdr.image_len;
+    s_dec.bitbuf = 0;
+    s_dec.bitcnt = 0;
+    s_dec.head = 0;
+    s_dec.flushed = 0;
+    s_dec.state = DEC_ST_TAG;
+    *hdr_len = sizeof(hdr);
+
+    ota_pipeline_set_image_len(hdr.image_len);
+    ESP_LOGI(TAG, "Compressed image: %" PRIu32 " B, window 2^%u, lookahead 2^%u",
+             hdr.image_len, hdr.window_sz2, hdr.lookahead_sz2);
+    return ESP_OK;
+}
+
+static esp_err_t decomp_feed(const uint8_t *data, size_t len, ota_pipeline_emit_t emit)
+{
+    if (s_dec.state == DEC_ST_DETECT) {
+        size_t hdr_len;
+        esp_err_t err = detect(data, len, &hdr_len);
+        if (err != ESP_OK) return err;
+        data += hdr_len;
+        len -= hdr_len;
+        s_dec.consumed += hdr_len;
+    }
+    if (s_dec.state == DEC_ST_RAW) return emit(data, len);
+
+    int64_t t0 = esp_timer_get_time();
+    uint32_t head0 = s_dec.head;
+    esp_err_t err = decode(data, len, emit);
+    s_dec.busy_us += esp_timer_get_time() - t0;
+    s_dec.consumed += len;
+    ota_stats_add_copy(s_dec.head - head0);    /* each output byte is stored once, in the window */
+    return err;
+}
+
+static esp_err_t decomp_finish(ota_pipeline_emit_t emit)
+{
+    if (!ota_decomp_active()) return ESP_OK;
+    if (s_dec.state != DEC_ST_DONE) {
+        ESP_LOGE(TAG, "Compressed stream truncated (%" PRIu32 " of %" PRIu32 " B)", s_dec.produced, s_dec.image_len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return out_flush(emit);
+}
+
+const ota_pipeline_filter_t ota_decomp_filter = {
+    .feed = decomp_feed,
+    .finish = decomp_finish,
+};
+
+void ota_decomp_report(void)
+{
+    if (!ota_decomp_active() || s_dec.consumed == 0) return;
+    double ratio = (double)s_dec.produced / s_dec.consumed;
+    double mbps = s_dec.busy_us > 0 ? (double)s_dec.produced / s_dec.busy_us : 0.0;   /* bytes/us == MB/s */
+    ESP_LOGI(TAG, "Decompressed %" PRIu32 " -> %" PRIu32 " B (ratio %.2f), %.2f MB/s, %" PRId64 " ms decoding",
+             s_dec.consumed, s_dec.produced, ratio, mbps, s_dec.busy_us / 1000);
+}
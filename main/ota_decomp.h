@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_decomp.h
+ * @brief Streaming decompression of compressed firmware images (heatshrink LZSS)
+ *
+ * A compressed image (tools/ota_compress.py) is a 12 byte header followed by a
+ * heatshrink compatible LZSS bitstream:
+ * - header: "OHS1" | window_sz2 u8 | lookahead_sz2 u8 | reserved u16 | image_len u32
+ * - bitstream (MSB first): 1 + 8 bit literal, or 0 + (window_sz2 bit distance-1)
+ *   + (lookahead_sz2 bit length-1) back-reference
+ *
+ * The filter recognizes the header on the first payload bytes; a raw image
+ * (0xE9 magic) is passed through untouched, so the same endpoint may serve
+ * either format. The history window is a static buffer of
+ * 2^CONFIG_OTA_DECOMP_WINDOW_SZ2 bytes (at least one sector): no heap is used
+ * while decompressing. Decoded bytes go to the window only, and each completed
+ * sector is handed to the flash writer straight from it.
+ *
+ * The following functions are provided:
+ * - ota_decomp_filter: Pipeline filter (raw pass-through or decompression).
+ * - ota_decomp_active(): True if the current payload is compressed.
+ * - ota_decomp_report(): Log ratio and decompression throughput.
+ *
+ * @author Marconatale Parise
+ * @date 06 Mar 2026
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ota_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_DECOMP_MAGIC "OHS1"
+
+/**
+ * @brief Compressed image header (12 bytes, little endian)
+ */
+typedef struct __attribute__((packed)) {
+    char     magic[4];          /*!< OTA_DECOMP_MAGIC */
+    uint8_t  window_sz2;        /*!< log2 of the LZSS window */
+    uint8_t  lookahead_sz2;     /*!< log2 of the maximum match length */
+    uint16_t reserved;
+    uint32_t image_len;         /*!< Decompressed image length */
+} ota_decomp_header_t;
+
+/**
+ * @brief Pipeline filter: decompresses OHS1 payloads, passes raw images through
+ */
+extern const ota_pipeline_filter_t ota_decomp_filter;
+
+/**
+ * @brief Reset the filter before a new session
+ */
+void ota_decomp_reset(void);
+
+/**
+ * @brief Whether the payload of the current session is compressed
+ */
+bool ota_decomp_active(void);
+
+/**
+ * @brief Log compression ratio and decompression throughput of the last session
+ */
+void ota_decomp_report(void);
+
+#ifdef __cplusplus
+}
+#endif
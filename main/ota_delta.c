@@ -0,0 +1,235 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_delta.c
+ * @brief Streaming delta (binary patch) applier for OTA updates
+ *
+ * @author Marconatale Parise
+ * @date 05 Mar 2026
+ */
+#include "ota_delta.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+
+#include "ota_stats.h"
+
+static const char *TAG = "ota_delta";
+
+#define DELTA_OP_END     0x00
+#define DELTA_OP_COPY    0x01
+#define DELTA_OP_INSERT  0x02
+#define DELTA_OP_MAX_LEN 9          /* opcode + 2 x u32 */
+#define DELTA_OUT_SIZE   4096       /* one flash sector */
+
+typedef enum {
+    DELTA_ST_OP = 0,
+    DELTA_ST_INSERT,
+    DELTA_ST_DONE,
+} delta_state_t;
+
+static struct {
+    const esp_partition_t *base;
+    uint32_t base_len;
+    uint32_t target_len;
+    uint32_t produced;              /* image bytes emitted so far */
+    delta_state_t state;
+    uint8_t  op[DELTA_OP_MAX_LEN];
+    size_t   op_fill;
+    size_t   op_need;
+    uint32_t insert_left;
+    size_t   out_fill;
+    uint8_t  out[DELTA_OUT_SIZE];   /* output staging, flushed one sector at a time */
+} s_d;
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t out_flush(ota_pipeline_emit_t emit)
+{
+    if (s_d.out_fill == 0) return ESP_OK;
+    esp_err_t err = emit(s_d.out, s_d.out_fill);
+    s_d.out_fill = 0;
+    return err;
+}
+
+/* Account produced bytes before staging so an oversize patch stops early */
+static esp_err_t out_reserve(size_t len)
+{
+    if (s_d.produced + len > s_d.target_len) {
+        ESP_LOGE(TAG, "Patch produces more than %" PRIu32 " bytes", s_d.target_len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_d.produced += len;
+    return ESP_OK;
+}
+
+static esp_err_t out_push(const uint8_t *data, size_t len, ota_pipeline_emit_t emit)
+{
+    esp_err_t err = out_reserve(len);
+    while (err == ESP_OK && len > 0) {
+        size_t n = DELTA_OUT_SIZE - s_d.out_fill;
+        if (s_d.out_fill == 0 && len >= DELTA_OUT_SIZE) {
+            /* Staging empty: write whole sectors straight from the pipeline buffer */
+            n = len & ~(size_t)(DELTA_OUT_SIZE - 1);
+            err = emit(data, n);
+            data += n;
+            len -= n;
+            continue;
+        }
+        if (n > len) n = len;
+        memcpy(&s_d.out[s_d.out_fill], data, n);
+        ota_stats_add_copy(n);
+        s_d.out_fill += n;
+        data += n;
+        len -= n;
+        if (s_d.out_fill == DELTA_OUT_SIZE) err = out_flush(emit);
+    }
+    return err;
+}
+
+static esp_err_t out_copy_base(uint32_t src, uint32_t len, ota_pipeline_emit_t emit)
+{
+    if (src > s_d.base_len || len > s_d.base_len - src) {
+        ESP_LOGE(TAG, "COPY 0x%" PRIx32 "+%" PRIu32 " outside base image", src, len);
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = out_reserve(len);
+    while (err == ESP_OK && len > 0) {
+        size_t n = DELTA_OUT_SIZE - s_d.out_fill;
+        if (n > len) n = len;
+        err = esp_partition_read(s_d.base, src, &s_d.out[s_d.out_fill], n);
+        if (err != ESP_OK) break;
+        s_d.out_fill += n;
+        src += n;
+        len -= n;
+        if (s_d.out_fill == DELTA_OUT_SIZE) err = out_flush(emit);
+    }
+    return err;
+}
+
+static esp_err_t op_execute(ota_pipeline_emit_t emit)
+{
+    switch (s_d.op[0]) {
+        case DELTA_OP_COPY:
+            return out_copy_base(get_u32(&s_d.op[1]), get_u32(&s_d.op[5]), emit);
+        case DELTA_OP_INSERT:
+            s_d.insert_left = get_u32(&s_d.op[1]);
+            if (s_d.insert_left > 0) s_d.state = DELTA_ST_INSERT;
+            return ESP_OK;
+        case DELTA_OP_END:
+        default:
+            s_d.state = DELTA_ST_DONE;
+            return ESP_OK;
+    }
+}
+
+static esp_err_t delta_feed(const uint8_t *data, size_t len, ota_pipeline_emit_t emit)
+{
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK && len > 0) {
+        switch (s_d.state) {
+            case DELTA_ST_OP: {
+                if (s_d.op_fill == 0) {
+                    switch (data[0]) {
+                        case DELTA_OP_COPY:   s_d.op_need = 9; break;
+                        case DELTA_OP_INSERT: s_d.op_need = 5; break;
+                        case DELTA_OP_END:    s_d.op_need = 1; break;
+                        default:
+                            ESP_LOGE(TAG, "Unknown patch opcode 0x%02x", data[0]);
+                            return ESP_ERR_INVALID_ARG;
+                    }
+                }
+                size_t n = s_d.op_need - s_d.op_fill;
+                if (n > len) n = len;
+                memcpy(&s_d.op[s_d.op_fill], data, n);
+                s_d.op_fill += n;
+                data += n;
+                len -= n;
+                if (s_d.op_fill == s_d.op_need) {
+                    s_d.op_fill = 0;
+                    err = op_execute(emit);
+                }
+                break;
+            }
+            case DELTA_ST_INSERT: {
+                size_t n = s_d.insert_left < len ? s_d.insert_left : len;
+                err = out_push(data, n, emit);
+                data += n;
+                len -= n;
+                s_d.insert_left -= n;
+                if (s_d.insert_left == 0) s_d.state = DELTA_ST_OP;
+                break;
+            }
+            case DELTA_ST_DONE:
+            default:
+                ESP_LOGE(TAG, "Trailing data after END");
+                return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    return err;
+}
+
+static esp_err_t delta_finish(ota_pipeline_emit_t emit)
+{
+    if (s_d.state != DELTA_ST_DONE) {
+        ESP_LOGE(TAG, "Patch truncated");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = out_flush(emit);
+    if (err == ESP_OK && s_d.produced != s_d.target_len) {
+        ESP_LOGE(TAG, "Patch produced %" PRIu32 " of %" PRIu32 " bytes", s_d.produced, s_d.target_len);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    return err;
+}
+
+const ota_pipeline_filter_t ota_delta_filter = {
+    .feed = delta_feed,
+    .finish = delta_finish,
+};
+
+esp_err_t ota_delta_check_header(const ota_delta_header_t *hdr, const uint8_t *running_sha)
+{
+    if (!hdr || !running_sha) return ESP_ERR_INVALID_ARG;
+    if (memcmp(hdr->magic, OTA_DELTA_MAGIC, sizeof(hdr->magic)) != 0 || hdr->target_len == 0) {
+        ESP_LOGW(TAG, "Not a delta patch");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (memcmp(hdr->base_sha256, running_sha, HASH_LEN) != 0) {
+        ESP_LOGW(TAG, "Patch base does not match the running image");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_delta_begin(const esp_partition_t *base, const ota_delta_header_t *hdr)
+{
+    if (!base || !hdr || hdr->base_len > base->size) return ESP_ERR_INVALID_ARG;
+
+    memset(&s_d, 0, sizeof(s_d));
+    s_d.base = base;
+    s_d.base_len = hdr->base_len;
+    s_d.target_len = hdr->target_len;
+    s_d.state = DELTA_ST_OP;
+    ESP_LOGI(TAG, "Applying patch: base %" PRIu32 " B -> target %" PRIu32 " B", hdr->base_len, hdr->target_len);
+    return ESP_OK;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_delta.h
+ * @brief Streaming delta (binary patch) applier for OTA updates
+ *
+ * A patch is generated on the host (tools/ota_delta_gen.py) against the image
+ * currently running on the device. It is a header followed by a list of
+ * operations:
+ * - COPY  (0x01, u32 src_offset, u32 len): copy bytes from the running image
+ * - INSERT(0x02, u32 len, <len bytes>):    bytes carried by the patch
+ * - END   (0x00)
+ *
+ * All integers are little endian. The applier runs as a pipeline filter: it
+ * reads the running partition and emits the new image in sector sized chunks,
+ * so the image is never buffered in RAM.
+ *
+ * The following functions are provided:
+ * - ota_delta_check_header(): Validate magic and base image hash.
+ * - ota_delta_begin(): Prepare the applier for a patch.
+ * - ota_delta_filter: Pipeline filter applying the patch stream.
+ *
+ * @author Marconatale Parise
+ * @date 05 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ota_hal.h"
+#include "ota_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_DELTA_MAGIC "ODP1"
+
+/**
+ * @brief Patch header (76 bytes, little endian)
+ */
+typedef struct __attribute__((packed)) {
+    char     magic[4];                   /*!< OTA_DELTA_MAGIC */
+    uint8_t  base_sha256[HASH_LEN];      /*!< SHA-256 of the image the patch applies to */
+    uint32_t base_len;                   /*!< Length of the base image */
+    uint32_t target_len;                 /*!< Length of the resulting image */
+    uint8_t  target_sha256[HASH_LEN];    /*!< SHA-256 of the resulting image */
+} ota_delta_header_t;
+
+/**
+ * @brief Check that a patch can be applied to the running image
+ *
+ * @param hdr          Received patch header
+ * @param running_sha  SHA-256 of the running image
+ *
+ * @return ESP_OK if applicable, ESP_ERR_INVALID_VERSION on base mismatch,
+ *         ESP_ERR_INVALID_ARG on a malformed header
+ */
+esp_err_t ota_delta_check_header(const ota_delta_header_t *hdr, const uint8_t *running_sha);
+
+/**
+ * @brief Reset the applier for a new patch
+ *
+ * @param base Partition holding the base (running) image
+ * @param hdr  Validated patch header
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_delta_begin(const esp_partition_t *base, const ota_delta_header_t *hdr);
+
+/**
+ * @brief Pipeline filter applying the patch body (pass to ota_pipeline_begin())
+ */
+extern const ota_pipeline_filter_t ota_delta_filter;
+
+#ifdef __cplusplus
+}
+#endif
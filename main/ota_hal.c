@@ -25,15 +25,37 @@
 #include "ota_hal.h"
 
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "esp_app_desc.h"
+#include "esp_random.h"
 
 #include "wifi.h"
+#include "ota_pipeline.h"
+#include "ota_resume.h"
+#include "ota_delta.h"
+#include "ota_decomp.h"
+#include "ota_stats.h"
+#include "ota_verify.h"
+#include "ota_blocksync.h"
+#include "ota_check.h"
+#include "ota_parallel.h"
+#include "ota_sign.h"
+#include "ota_peer.h"
+#include "ota_mirror.h"
+#include "ota_arena.h"
+#include "sys_mon.h"
 
 #include <sys/socket.h>
 #include <net/if.h>
@@ -46,8 +68,24 @@
 static const char *TAG = "ota_hal";
 
 static bool s_inited;
+static esp_http_client_handle_t s_client;   /* kept between OTA checks (CONFIG_OTA_CONN_REUSE) */
+#if CONFIG_OTA_CONN_REUSE
+static esp_timer_handle_t s_idle_timer;     /* frees the kept client once idle for CONFIG_OTA_CONN_IDLE_S */
+static bool s_client_busy;                  /* taken by ota_client_get(): the timer leaves it alone */
+static portMUX_TYPE s_client_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
 #define OTA_URL_SIZE 256
+#define OTA_SECTOR_SIZE       4096
+#define OTA_CHECKPOINT_BYTES  (CONFIG_OTA_RESUME_CHECKPOINT_KB * 1024)
+#define OTA_MAX_RETRIES       CONFIG_OTA_RESUME_MAX_RETRIES
+#define OTA_RETRY_DELAY_MS    1000
+#define OTA_CONN_IDLE_US      ((int64_t)CONFIG_OTA_CONN_IDLE_S * 1000000)
+#define OTA_CHECK_MANIFEST_MAX 1024
+#define OTA_PEER_BUSY_WAIT_MS 2000      /* + random up to as much again, when every LAN peer is full */
+#define OTA_HTTP_TIMEOUT_MS   30000
+#define OTA_PROBE_BYTES       (CONFIG_OTA_MIRROR_PROBE_KB * 1024)
+#define OTA_PROBE_TIMEOUT_MS  CONFIG_OTA_MIRROR_PROBE_TIMEOUT_MS
 
 static void stdio_prepare(void)
 {
@@ -75,8 +113,14 @@ static void print_sha256(const uint8_t *image_hash, const char *label)
     ESP_LOGI("OTA", "%s %s", label, hash_print);
 }
 
+static uint8_t s_running_sha[HASH_LEN];   /* SHA-256 of the running image */
+static bool s_running_sha_valid;
+static bool s_partitions_hashed;        /* done once per boot: the running partitions do not change */
+
+/* Full flash read of both regions: ota_hal_init() runs on every OTA request, the hashes are kept */
 static void get_sha256_of_partitions(void)
 {
+    if (s_partitions_hashed) return;
     uint8_t sha_256[HASH_LEN] = { 0 };
     esp_partition_t partition;
 
@@ -88,8 +132,40 @@ static void get_sha256_of_partitions(void)
     print_sha256(sha_256, "SHA-256 for bootloader:");
 
     /* SHA256 for running firmware */
-    esp_partition_get_sha256(esp_ota_get_running_partition(), sha_256);
+    s_running_sha_valid = (esp_partition_get_sha256(esp_ota_get_running_partition(), sha_256) == ESP_OK);
+    memcpy(s_running_sha, sha_256, HASH_LEN);
     print_sha256(sha_256, "SHA-256 for current firmware:");
+    s_partitions_hashed = true;
+}
+
+/* Response headers of the current request, captured by http_event_handler */
+static struct {
+    char validator[OTA_RESUME_VALIDATOR_LEN];  /* ETag, or Last-Modified if no ETag */
+    bool has_etag;
+    int64_t range_total;                       /* total size from Content-Range */
+} s_resp;
+static bool s_checking;     /* update check in flight: keep it out of the session stats */
+static ota_stats_conn_t s_conn;     /* stats user_data of the HAL's clients (one open at a time) */
+#if CONFIG_OTA_PEER_FETCH
+static const uint8_t *s_pinned_sha; /* digest the image must have, whatever the server sends */
+#endif
+
+static void capture_header(const char *key, const char *value)
+{
+    if (!key || !value) return;
+    if (ota_verify_parse_header(key, value)) return;
+    if (strcasecmp(key, "ETag") == 0) {
+        strlcpy(s_resp.validator, value, sizeof(s_resp.validator));
+        s_resp.has_etag = true;
+    } else if (strcasecmp(key, "Last-Modified") == 0 && !s_resp.has_etag) {
+        strlcpy(s_resp.validator, value, sizeof(s_resp.validator));
+    } else if (strcasecmp(key, "Content-Range") == 0) {
+        /* "bytes <first>-<last>/<total>" */
+        const char *slash = strrchr(value, '/');
+        if (slash && slash[1] != '*') {
+            s_resp.range_total = strtoll(slash + 1, NULL, 10);
+        }
+    }
 }
 
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
@@ -100,12 +176,16 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_CONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            if (!s_checking) ota_stats_on_connected(evt->user_data);
             break;
         case HTTP_EVENT_HEADER_SENT:
             ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
+            if (!s_checking) ota_stats_on_request_sent(evt->user_data);
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (!s_checking) ota_stats_on_header(evt->user_data);
+            capture_header(evt->header_key, evt->header_value);
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -125,6 +205,460 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+/* Fill one pipeline buffer completely (or up to end of body) */
+static int read_full(esp_http_client_handle_t client, uint8_t *buf, size_t cap)
+{
+    size_t fill = 0;
+    while (fill < cap) {
+        int n = esp_http_client_read(client, (char *)buf + fill, cap - fill);
+        if (n == -ESP_ERR_HTTP_EAGAIN) continue;
+        if (n < 0) return n;
+        if (n == 0) break;
+        fill += n;
+    }
+    return (int)fill;
+}
+
+esp_err_t ota_hal_http_open(esp_http_client_handle_t client, int64_t *content_len)
+{
+    esp_err_t err = ESP_FAIL;
+    void *conn = NULL;
+    esp_http_client_get_user_data(client, &conn);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (attempt > 0) {
+            /* The kept-alive connection was closed by the server: reconnect once */
+            esp_http_client_close(client);
+        }
+        ota_stats_connect_begin(conn);
+        err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) continue;
+        int64_t len = esp_http_client_fetch_headers(client);
+        if (len < 0) {
+            err = ESP_FAIL;
+            continue;
+        }
+        if (content_len) *content_len = len;
+        /* Range workers open theirs during the download: only the first connection moves on */
+        if (sys_mon_get_phase() == SYS_MON_PHASE_OTA_CONNECT) sys_mon_set_phase(SYS_MON_PHASE_OTA_DOWNLOAD);
+        return ESP_OK;
+    }
+    return err;
+}
+
+/* Drop the body of an unwanted response, keeping the connection for the next request */
+static void ota_http_discard(esp_http_client_handle_t client)
+{
+    int len = 0;
+    if (esp_http_client_flush_response(client, &len) != ESP_OK) {
+        esp_http_client_close(client);
+    }
+}
+
+#if CONFIG_OTA_CHECK_ENABLE
+/* Conditional request on a cached validator: an ETag goes in If-None-Match, a date in If-Modified-Since */
+static esp_err_t ota_check_request(esp_http_client_handle_t client, const char *validator, bool head,
+                                   int64_t *content_len)
+{
+    const char *cond = NULL;
+    if (validator && validator[0]) {
+        cond = (validator[0] == '"' || strncmp(validator, "W/", 2) == 0) ? "If-None-Match" : "If-Modified-Since";
+        esp_http_client_set_header(client, cond, validator);
+    }
+    esp_http_client_delete_header(client, "Range");
+    esp_http_client_delete_header(client, "If-Range");
+    if (head) esp_http_client_set_method(client, HTTP_METHOD_HEAD);
+    memset(&s_resp, 0, sizeof(s_resp));
+    s_resp.range_total = -1;
+
+    s_checking = true;
+    esp_err_t err = ota_hal_http_open(client, content_len);
+    s_checking = false;
+
+    if (head) esp_http_client_set_method(client, HTTP_METHOD_GET);
+    if (cond) esp_http_client_delete_header(client, cond);
+    return err;
+}
+
+/* Remember the validator of the installed image for the next HEAD check (asks the server if unknown) */
+static void ota_record_installed(esp_http_client_handle_t client, const char *url, const char *validator)
+{
+    if (!validator || !validator[0]) {
+        esp_http_client_set_url(client, url);
+        validator = (ota_check_request(client, NULL, true, NULL) == ESP_OK &&
+                     esp_http_client_get_status_code(client) == 200) ? s_resp.validator : NULL;
+    }
+    ota_check_set_installed(validator);
+}
+#endif
+
+#if CONFIG_OTA_RESUME_ENABLE
+/* Store a sector aligned checkpoint once enough new data has reached flash */
+static void ota_checkpoint(ota_resume_state_t *ckpt, bool force)
+{
+    if (!ckpt->validator[0] || ckpt->image_len == 0) return;   /* server gave no validator */
+#if CONFIG_OTA_DECOMP_ENABLE
+    if (ota_decomp_active()) return;    /* flash offset != payload offset */
+#endif
+#if CONFIG_OTA_SIGN_ENABLE
+    if (ota_sign_active()) return;      /* the header is needed again to resume */
+#endif
+    uint32_t done = (uint32_t)ota_pipeline_written() & ~(uint32_t)(OTA_SECTOR_SIZE - 1);
+    if (done == ckpt->offset) return;
+    if (!force && done < ckpt->offset + OTA_CHECKPOINT_BYTES) return;
+    ckpt->offset = done;
+    ota_resume_save(ckpt);
+}
+#endif
+
+/* Only network level failures are worth a ranged retry */
+static bool ota_err_is_transient(esp_err_t err)
+{
+    return err == ESP_FAIL || err == ESP_ERR_HTTP_CONNECT || err == ESP_ERR_TIMEOUT;
+}
+
+/* Failures another mirror may not have: network errors and error statuses */
+static bool ota_err_is_mirror(esp_err_t err)
+{
+    return ota_err_is_transient(err) || err == ESP_ERR_INVALID_RESPONSE;
+}
+
+/* Producer side of the pipeline: receive on this task, write on the writer core */
+static esp_err_t ota_stream_body(esp_http_client_handle_t client, size_t received, ota_resume_state_t *ckpt)
+{
+    esp_err_t err = ESP_OK;
+    while (true) {
+        size_t cap = 0;
+        uint8_t *buf = ota_pipeline_acquire(&cap);
+        if (!buf) {
+            err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        int n = read_full(client, buf, cap);
+        if (n < 0) {
+            ESP_LOGE(TAG, "HTTP read error after %u bytes", (unsigned)received);
+            ota_pipeline_submit(buf, 0);
+            err = ESP_FAIL;
+            break;
+        }
+        received += n;
+        ota_stats_add_rx(n);
+        err = ota_pipeline_submit(buf, n);
+        if (err != ESP_OK || (size_t)n < cap) break;
+#if CONFIG_OTA_RESUME_ENABLE
+        if (ckpt) ota_checkpoint(ckpt, false);
+#endif
+    }
+
+    if (err == ESP_OK && !esp_http_client_is_complete_data_received(client)) {
+        ESP_LOGE(TAG, "Connection closed early (%u bytes received)", (unsigned)received);
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+#if CONFIG_OTA_PARALLEL_CONN > 1 && CONFIG_OTA_RESUME_ENABLE
+static void ota_parallel_checkpoint(void *arg)
+{
+    ota_checkpoint((ota_resume_state_t *)arg, false);
+}
+#endif
+
+/* Latency (connect + TTFB) and a short ranged read of one mirror */
+static void ota_mirror_probe_one(esp_http_client_handle_t client, size_t rank)
+{
+    static uint8_t buf[1024];
+    char range[32];
+    size_t got = 0;
+    int64_t ttfb = -1, body_us = 0;
+
+    esp_http_client_set_url(client, ota_mirror_url(rank));
+    esp_http_client_delete_header(client, "If-Range");
+    snprintf(range, sizeof(range), "bytes=0-%u", (unsigned)OTA_PROBE_BYTES - 1);
+    esp_http_client_set_header(client, "Range", range);
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ota_hal_http_open(client, NULL);
+    if (err == ESP_OK) {
+        int64_t t1 = esp_timer_get_time();
+        ttfb = t1 - t0;
+        int status = esp_http_client_get_status_code(client);
+        if (status == 206 || status == 200) {
+            while (got < OTA_PROBE_BYTES) {
+                size_t want = OTA_PROBE_BYTES - got < sizeof(buf) ? OTA_PROBE_BYTES - got : sizeof(buf);
+                int n = read_full(client, buf, want);
+                if (n <= 0) break;
+                got += n;
+            }
+            body_us = esp_timer_get_time() - t1;
+            if (got < OTA_PROBE_BYTES && !esp_http_client_is_complete_data_received(client)) err = ESP_FAIL;
+        } else {
+            ESP_LOGW(TAG, "Mirror %s answered %d", ota_mirror_url(rank), status);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+        /* Keep the connection only when the whole (ranged) body was read */
+        if (err != ESP_OK || !esp_http_client_is_complete_data_received(client)) esp_http_client_close(client);
+    }
+    esp_http_client_delete_header(client, "Range");
+    ota_mirror_record(rank, err, ttfb, got, body_us);
+}
+
+/* Probe every mirror and rank them; the likely winner goes last and keeps its connection */
+static void ota_mirror_probe_all(esp_http_client_handle_t client)
+{
+    esp_http_client_set_timeout_ms(client, OTA_PROBE_TIMEOUT_MS);
+    for (size_t i = ota_mirror_count(); i-- > 0;) {
+        ota_mirror_probe_one(client, i);
+    }
+    esp_http_client_set_timeout_ms(client, OTA_HTTP_TIMEOUT_MS);
+    ota_mirror_rank();
+}
+
+/* Full image download, resuming from the checkpoint when possible */
+static esp_err_t ota_download(esp_http_client_handle_t client, const char *url, const esp_partition_t *update,
+                              ota_resume_state_t *ckpt)
+{
+    size_t offset = 0;
+    memset(&s_resp, 0, sizeof(s_resp));
+    s_resp.range_total = -1;
+    ota_verify_reset();
+
+    esp_http_client_delete_header(client, "Range");
+    esp_http_client_delete_header(client, "If-Range");
+#if CONFIG_OTA_RESUME_ENABLE && !CONFIG_OTA_SIGN_REQUIRED
+    /* A resumed request skips the signed header: with signatures required always start over */
+    if (ckpt->offset > 0 && ckpt->part_addr == update->address && ckpt->validator[0]) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%" PRIu32 "-", ckpt->offset);
+        esp_http_client_set_header(client, "Range", range);
+        /* If-Range: the server answers 200 with the full image if it changed */
+        esp_http_client_set_header(client, "If-Range", ckpt->validator);
+        offset = ckpt->offset;
+    }
+#endif
+#if CONFIG_OTA_PARALLEL_CONN > 1
+    /* Parallel mode: ask for the first range only, the 206 tells the image size */
+    int par_conns = ota_parallel_conns(CONFIG_OTA_PARALLEL_CONN);
+    if (par_conns < CONFIG_OTA_PARALLEL_CONN) {
+        ESP_LOGW(TAG, "Pipeline ring holds %d parallel ranges only (raise OTA_PIPELINE_BUF_COUNT)", par_conns);
+    }
+    size_t par_range = par_conns > 1 ? ota_parallel_range_size() : 0;
+    if (par_range) {
+        char range[48];
+        snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)offset, (unsigned)(offset + par_range - 1));
+        esp_http_client_set_header(client, "Range", range);
+    }
+#endif
+
+    /* Erase the first sectors while connecting (length known only when resuming) */
+    ota_pipeline_prepare(update, offset ? ckpt->image_len : OTA_SIZE_UNKNOWN, offset);
+    int64_t content_len = 0;
+    esp_err_t err = ota_hal_http_open(client, &content_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP connection failed: %s", esp_err_to_name(err));
+        ota_pipeline_abort();
+        return err;
+    }
+
+    int status = esp_http_client_get_status_code(client);
+    size_t image_len;
+
+    if (status == 206 && offset > 0) {
+        if (s_resp.range_total != (int64_t)ckpt->image_len) {
+            ESP_LOGW(TAG, "Content-Range total %" PRId64 " does not match checkpoint, restarting", s_resp.range_total);
+            ota_resume_clear();
+            memset(ckpt, 0, sizeof(*ckpt));
+            ota_http_discard(client);
+            ota_pipeline_abort();
+            return ESP_FAIL;
+        }
+        image_len = ckpt->image_len;
+        ESP_LOGI(TAG, "Resuming download at %u of %u bytes", (unsigned)offset, (unsigned)image_len);
+    } else if (status == 200 || (status == 206 && offset == 0 && s_resp.range_total > 0)) {
+        if (offset > 0) {
+            ESP_LOGW(TAG, "Server sent the full image (changed or no Range support), restarting from 0");
+        }
+        offset = 0;
+        /* 206 here answers the first parallel range: the image size is in Content-Range */
+        int64_t total = status == 206 ? s_resp.range_total : content_len;
+        image_len = total > 0 ? (size_t)total : OTA_SIZE_UNKNOWN;
+        memset(ckpt, 0, sizeof(*ckpt));
+        strlcpy(ckpt->validator, s_resp.validator, sizeof(ckpt->validator));
+        ckpt->image_len = total > 0 ? (uint32_t)total : 0;
+        ckpt->part_addr = update->address;
+    } else {
+        ESP_LOGE(TAG, "Unexpected HTTP status %d", status);
+        ota_http_discard(client);
+        ota_pipeline_abort();
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    /* A resumed download is always a raw image (compressed and signed ones are not checkpointed) */
+    const ota_pipeline_filter_t *filter = NULL;
+#if CONFIG_OTA_DECOMP_ENABLE
+    if (offset == 0) {
+        ota_decomp_reset();
+        filter = &ota_decomp_filter;
+    }
+#endif
+#if CONFIG_OTA_SIGN_ENABLE
+    if (offset == 0) {
+        ota_sign_reset(filter);
+        filter = &ota_sign_filter;
+    }
+#endif
+#if CONFIG_OTA_PEER_FETCH
+    /* LAN peers are not trusted: only the digest of the origin manifest counts */
+    if (s_pinned_sha) ota_verify_set_expected(s_pinned_sha);
+#endif
+    err = ota_pipeline_begin(update, image_len, offset, filter);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "OTA pipeline start failed: %s", esp_err_to_name(err));
+        esp_http_client_close(client);
+        ota_pipeline_abort();
+        return err;
+    }
+
+#if CONFIG_OTA_PARALLEL_CONN > 1
+    if (status == 206 && content_len > 0 && offset + (size_t)content_len < image_len) {
+        ota_parallel_progress_t progress = NULL;
+#if CONFIG_OTA_RESUME_ENABLE
+        progress = ota_parallel_checkpoint;
+#endif
+        err = ota_parallel_download(client, url, ckpt->validator, offset, (size_t)content_len, image_len,
+                                    CONFIG_OTA_PARALLEL_CONN, progress, ckpt);
+    } else
+#endif
+    err = ota_stream_body(client, offset, ckpt);
+    esp_http_client_close(client);
+
+    if (err != ESP_OK) {
+        ota_pipeline_abort();
+#if CONFIG_OTA_RESUME_ENABLE
+        if (ota_err_is_transient(err)) {
+            ota_checkpoint(ckpt, true);
+        } else {
+            ota_resume_clear();
+            memset(ckpt, 0, sizeof(*ckpt));
+        }
+#endif
+        return err;
+    }
+
+    err = ota_pipeline_finish();
+#if CONFIG_OTA_DECOMP_ENABLE
+    ota_decomp_report();
+#endif
+    /* Either done or the image is bad: never resume into it again */
+    ota_resume_clear();
+    return err;
+}
+
+#if CONFIG_OTA_PEER_FETCH
+/* The published image from LAN peers; the cached origin manifest names it and its digest */
+static esp_err_t ota_peer_download(const esp_partition_t *update, ota_resume_state_t *ckpt)
+{
+    static const uint8_t no_sha[HASH_LEN];
+    ota_check_cache_t cache;
+    ota_check_load(&cache);
+    if (!cache.manifest_version[0] || memcmp(cache.manifest_sha256, no_sha, HASH_LEN) == 0) {
+        ESP_LOGD(TAG, "No manifest digest to check LAN peers against");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    for (int attempt = 0; attempt < CONFIG_OTA_PEER_MAX_TRIES; attempt++) {
+        ota_peer_t peers[OTA_PEER_MAX];
+        size_t busy;
+        size_t n = ota_peer_discover(cache.manifest_version, cache.manifest_sha256, peers, OTA_PEER_MAX, &busy);
+        if (n == 0) {
+            if (busy == 0) break;   /* nobody on the LAN has the image yet */
+            /* A LAN transfer takes seconds: wait for a slot rather than joining the crowd at the origin */
+            vTaskDelay(pdMS_TO_TICKS(OTA_PEER_BUSY_WAIT_MS + esp_random() % OTA_PEER_BUSY_WAIT_MS));
+            continue;
+        }
+        char url[48];
+        ota_peer_url(&peers[0], url, sizeof(url));
+        esp_http_client_config_t http_cfg;
+        if (ota_hal_http_config(&http_cfg, url) != ESP_OK) break;
+        esp_http_client_handle_t client = esp_http_client_init(&http_cfg);
+        if (!client) break;
+
+        ESP_LOGI(TAG, "Downloading %s from LAN peer %s (%u free slots)", cache.manifest_version, url,
+                 peers[0].free_slots);
+        ota_stats_probe(url);
+        s_pinned_sha = cache.manifest_sha256;
+        err = ota_download(client, url, update, ckpt);
+        s_pinned_sha = NULL;
+        esp_http_client_cleanup(client);
+        if (err == ESP_OK) return ESP_OK;
+
+        ESP_LOGW(TAG, "LAN peer %s failed: %s", url, esp_err_to_name(err));
+        /* The checkpoint holds the peer's ETag: the next source starts over */
+        ota_resume_clear();
+        memset(ckpt, 0, sizeof(*ckpt));
+    }
+    return err;
+}
+#endif
+
+#if CONFIG_OTA_DELTA_ENABLE
+/* Delta download: a patch against the running image, applied on the writer task */
+static esp_err_t ota_delta_download(esp_http_client_handle_t client, const esp_partition_t *update)
+{
+    if (!s_running_sha_valid) return ESP_ERR_INVALID_STATE;
+
+    char sha_hex[HASH_LEN * 2 + 1];
+    for (int i = 0; i < HASH_LEN; ++i) {
+        sprintf(&sha_hex[i * 2], "%02x", s_running_sha[i]);
+    }
+    esp_http_client_delete_header(client, "Range");
+    esp_http_client_delete_header(client, "If-Range");
+    /* Lets a smart server pick the right patch; static servers just ignore it */
+    esp_http_client_set_header(client, "X-Running-SHA256", sha_hex);
+    ota_verify_reset();
+
+    ota_pipeline_prepare(update, OTA_SIZE_UNKNOWN, 0);
+    esp_err_t err = ota_hal_http_open(client, NULL);
+    esp_http_client_delete_header(client, "X-Running-SHA256");
+    if (err != ESP_OK) {
+        ota_pipeline_abort();
+        return err;
+    }
+
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGW(TAG, "No delta patch available (HTTP %d)", status);
+        ota_http_discard(client);
+        ota_pipeline_abort();
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    ota_delta_header_t hdr;
+    if (read_full(client, (uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+        esp_http_client_close(client);
+        ota_pipeline_abort();
+        return ESP_FAIL;
+    }
+    ota_verify_set_expected(hdr.target_sha256);
+    err = ota_delta_check_header(&hdr, s_running_sha);
+    if (err == ESP_OK) err = ota_delta_begin(esp_ota_get_running_partition(), &hdr);
+    if (err == ESP_OK) err = ota_pipeline_begin(update, hdr.target_len, 0, &ota_delta_filter);
+    if (err != ESP_OK) {
+        esp_http_client_close(client);
+        ota_pipeline_abort();
+        return err;
+    }
+
+    err = ota_stream_body(client, sizeof(hdr), NULL);
+    esp_http_client_close(client);
+    if (err != ESP_OK) {
+        ota_pipeline_abort();
+        return err;
+    }
+    return ota_pipeline_finish();
+}
+#endif
+
 esp_err_t ota_hal_init()
 {
     const ota_hal_cfg_t *cfg = &ota_cfg;
@@ -134,6 +668,7 @@ esp_err_t ota_hal_init()
         return ESP_ERR_INVALID_ARG;
     }
     //memset(&ota_cfg, 0, sizeof(ota_cfg));
+    get_sha256_of_partitions();
     s_inited = true;
     
     return ESP_OK;
@@ -154,30 +689,13 @@ esp_err_t ota_hal_mark_app_valid_if_needed(void)
     return ESP_OK;
 }
 
-esp_err_t ota_hal_start(void)
+esp_err_t ota_hal_http_config(esp_http_client_config_t *http_cfg, const char *url)
 {
-    if (!s_inited){
-        ESP_LOGI(TAG, "OTA HAL not initialized");
-        return ESP_ERR_INVALID_STATE;
-    } 
-
-    const char *url = ota_cfg.url;
-    char url_buf[OTA_URL_SIZE] = {0};
-
-#ifdef CONFIG_EXAMPLE_FIRMWARE_UPGRADE_URL_FROM_STDIN
-    if (strcmp(url, "FROM_STDIN") == 0) {
-        stdio_prepare();
-        printf("Enter OTA URL:\n");
-        if (!fgets(url_buf, sizeof(url_buf), stdin)) {
-            return ESP_FAIL;
-        }
-        strip_newline(url_buf);
-        url = url_buf;
-    }
-#endif
+    if (!http_cfg || !url) return ESP_ERR_INVALID_ARG;
 
 #ifdef CONFIG_EXAMPLE_FIRMWARE_UPGRADE_BIND_IF
-    struct ifreq ifr = {0};
+    static struct ifreq ifr;    /* referenced by the client config after return */
+    memset(&ifr, 0, sizeof(ifr));
     esp_netif_t *netif = wifi_get_netif_sta();
     if (!netif) {
         ESP_LOGE(TAG, "Bind-if enabled but Wi-Fi netif is NULL");
@@ -187,49 +705,336 @@ esp_err_t ota_hal_start(void)
     ESP_LOGI(TAG, "Bind interface name is %s", ifr.ifr_name);
 #endif
 
-    esp_http_client_config_t http_cfg = {
+    *http_cfg = (esp_http_client_config_t){
         .url = url,
         .event_handler = http_event_handler,
+        .user_data = &s_conn,
         .keep_alive_enable = ota_cfg.keep_alive,
-        .buffer_size_tx = 8192,   // request line + headers
-        .buffer_size    = 4096,   // response headers/data chunk (puoi anche lasciare 2048)
-        .timeout_ms     = 30000,  // opzionale ma utile su rete “lenta”
+        .buffer_size_tx = 1024,   // request line + headers (longer requests are sent in pieces)
+        .buffer_size    = 4096,   // response headers / transport read size; the body lands in the pipeline buffers
+        .timeout_ms     = OTA_HTTP_TIMEOUT_MS,  // opzionale ma utile su rete “lenta”
 #ifdef CONFIG_EXAMPLE_FIRMWARE_UPGRADE_BIND_IF
         .if_name = &ifr,
 #endif
     };
 
 #ifdef CONFIG_USE_CERT_BUNDLE
-    http_cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    http_cfg->crt_bundle_attach = esp_crt_bundle_attach;
 #else
     /* Fallback: embed server_certs/ca_cert.pem with EMBED_TXTFILES in main/CMakeLists.txt */
     extern const uint8_t ca_cert_pem_start[] asm("_binary_ca_cert_pem_start");
-    http_cfg.cert_pem = (const char *)ca_cert_pem_start;
+    http_cfg->cert_pem = (const char *)ca_cert_pem_start;
 #endif
 
 #ifdef CONFIG_EXAMPLE_SKIP_COMMON_NAME_CHECK
     /* Match original example behavior: force skip when Kconfig says so */
-    http_cfg.skip_cert_common_name_check = true;
+    http_cfg->skip_cert_common_name_check = true;
 #else
     /* Optional runtime override (keep default secure behavior if false) */
     if (ota_cfg.skip_cn_check) {
-        http_cfg.skip_cert_common_name_check = true;
+        http_cfg->skip_cert_common_name_check = true;
     }
 #endif
+    return ESP_OK;
+}
 
-    esp_https_ota_config_t https_ota_cfg = {
-        .http_config = &http_cfg,
-    };
+#if CONFIG_OTA_CONN_REUSE
+/* esp_timer task: the kept client went unused for CONFIG_OTA_CONN_IDLE_S, the
+ * server has most likely dropped it. Free the TLS context instead of holding it
+ * until the next request. */
+static void ota_client_idle_cb(void *arg)
+{
+    esp_http_client_handle_t client = NULL;
+    portENTER_CRITICAL(&s_client_lock);
+    if (!s_client_busy) {
+        client = s_client;
+        s_client = NULL;
+    }
+    portEXIT_CRITICAL(&s_client_lock);
+    if (client) {
+        ESP_LOGI(TAG, "Idle connection closed after %d s", CONFIG_OTA_CONN_IDLE_S);
+        esp_http_client_cleanup(client);
+    }
+}
+#endif
+
+/* The client (and its TLS connection) outlives ota_hal_start() so the next
+ * request to the same host skips the handshake */
+static esp_http_client_handle_t ota_client_get(const char *url)
+{
+#if CONFIG_OTA_CONN_REUSE
+    if (s_idle_timer) esp_timer_stop(s_idle_timer);
+    /* The idle callback may be freeing it right now: then it is gone once we hold it */
+    portENTER_CRITICAL(&s_client_lock);
+    s_client_busy = true;
+    portEXIT_CRITICAL(&s_client_lock);
+    if (s_client) {
+        esp_http_client_set_url(s_client, url);     /* closes the connection if the host differs */
+        return s_client;
+    }
+#endif
+    esp_http_client_config_t http_cfg;
+    if (ota_hal_http_config(&http_cfg, url) != ESP_OK) return NULL;
+    s_client = esp_http_client_init(&http_cfg);
+    return s_client;
+}
+
+static void ota_client_put(bool keep)
+{
+#if CONFIG_OTA_CONN_REUSE
+    if (keep && s_client) {
+        if (!s_idle_timer) {
+            const esp_timer_create_args_t args = { .callback = ota_client_idle_cb, .name = "ota_idle" };
+            if (esp_timer_create(&args, &s_idle_timer) != ESP_OK) s_idle_timer = NULL;
+        }
+        if (s_idle_timer && esp_timer_start_once(s_idle_timer, OTA_CONN_IDLE_US) == ESP_OK) {
+            portENTER_CRITICAL(&s_client_lock);
+            s_client_busy = false;
+            portEXIT_CRITICAL(&s_client_lock);
+            return;
+        }
+        /* No timer, nothing would free it: do not keep it */
+    }
+    portENTER_CRITICAL(&s_client_lock);
+    s_client_busy = false;
+    portEXIT_CRITICAL(&s_client_lock);
+#endif
+    if (!s_client) return;
+    esp_http_client_cleanup(s_client);
+    s_client = NULL;
+}
+
+#if CONFIG_OTA_CHECK_ENABLE
+static char s_manifest[OTA_CHECK_MANIFEST_MAX];    /* not on the caller's stack */
+
+static esp_err_t check_manifest(esp_http_client_handle_t client, ota_hal_check_t *out, ota_check_cache_t *cache)
+{
+    if (out->status == 200) {
+        int n = read_full(client, (uint8_t *)s_manifest, sizeof(s_manifest));
+        if (n < 0 || !esp_http_client_is_complete_data_received(client)) {
+            ESP_LOGE(TAG, "Manifest read failed or larger than %d bytes", OTA_CHECK_MANIFEST_MAX);
+            esp_http_client_close(client);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = ota_check_parse_manifest(s_manifest, n, cache);
+        if (err != ESP_OK) return err;
+        strlcpy(cache->manifest_etag, s_resp.has_etag ? s_resp.validator : "", sizeof(cache->manifest_etag));
+        ota_check_save(cache);
+    } else if (out->status != 304 || !cache->manifest_version[0]) {
+        ota_http_discard(client);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    strlcpy(out->version, cache->manifest_version, sizeof(out->version));
+    static const uint8_t no_sha[HASH_LEN];
+    bool same_image = s_running_sha_valid && memcmp(cache->manifest_sha256, no_sha, HASH_LEN) != 0 &&
+                      memcmp(cache->manifest_sha256, s_running_sha, HASH_LEN) == 0;
+    bool newer = ota_check_version_cmp(cache->manifest_version, esp_app_get_description()->version) > 0;
+    out->result = (newer && !same_image) ? OTA_CHECK_AVAILABLE : OTA_CHECK_UP_TO_DATE;
+    return ESP_OK;
+}
+
+static esp_err_t check_image(ota_hal_check_t *out, const ota_check_cache_t *cache)
+{
+    if (out->status == 304) {
+        out->result = OTA_CHECK_UP_TO_DATE;
+    } else if (out->status == 200) {
+        /* A server ignoring the condition still reports the same validator */
+        bool same = cache->image_validator[0] && strcmp(s_resp.validator, cache->image_validator) == 0;
+        out->result = same ? OTA_CHECK_UP_TO_DATE : OTA_CHECK_AVAILABLE;
+    } else {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+#endif
+
+esp_err_t ota_hal_check(ota_hal_check_t *out)
+{
+#if CONFIG_OTA_CHECK_ENABLE
+    if (!out) return ESP_ERR_INVALID_ARG;
+    memset(out, 0, sizeof(*out));
+    bool manifest = ota_cfg.check_url && ota_cfg.check_url[0];
+    const char *url = manifest ? ota_cfg.check_url : ota_cfg.url;
+    if (!url || !url[0]) return ESP_ERR_INVALID_ARG;
+
+    ota_check_cache_t cache;
+    ota_check_load(&cache);
+    esp_http_client_handle_t client = ota_client_get(url);
+    if (!client) return ESP_FAIL;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ota_check_request(client, manifest ? cache.manifest_etag : cache.image_validator, !manifest, NULL);
+    if (err == ESP_OK) {
+        out->status = esp_http_client_get_status_code(client);
+        err = manifest ? check_manifest(client, out, &cache) : check_image(out, &cache);
+    }
+    ota_client_put(true);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Update check failed (HTTP %d): %s", out->status, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Update check: %s%s%s (HTTP %d, %" PRId64 " ms)",
+             out->result == OTA_CHECK_AVAILABLE ? "update available" : "up to date",
+             out->version[0] ? ", published " : "", out->version, out->status, (esp_timer_get_time() - t0) / 1000);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/* Download, verify and select the image for boot; the caller restarts */
+static esp_err_t ota_stage(void)
+{
+    if (!s_inited){
+        ESP_LOGI(TAG, "OTA HAL not initialized");
+        return ESP_ERR_INVALID_STATE;
+    } 
+
+    const char *url = ota_cfg.url;
+    char url_buf[OTA_URL_SIZE] = {0};
+
+#ifdef CONFIG_EXAMPLE_FIRMWARE_UPGRADE_URL_FROM_STDIN
+    if (strcmp(url, "FROM_STDIN") == 0) {
+        stdio_prepare();
+        printf("Enter OTA URL:\n");
+        if (!fgets(url_buf, sizeof(url_buf), stdin)) {
+            return ESP_FAIL;
+        }
+        strip_newline(url_buf);
+        url = url_buf;
+    }
+#endif
 
     ESP_LOGI(TAG, "Attempting to download update from %s", url);
-    esp_err_t ret = esp_https_ota(&https_ota_cfg);
+    ota_stats_session_begin();
+    sys_mon_set_phase(SYS_MON_PHASE_OTA_CONNECT);
+    esp_http_client_handle_t client = ota_client_get(url);
+    if (!client) {
+        ESP_LOGE(TAG, "HTTP client init failed");
+        ota_stats_session_end(ESP_FAIL);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    ota_resume_state_t ckpt = {0};
+#if CONFIG_OTA_RESUME_ENABLE
+    if (ota_resume_load(&ckpt) == ESP_OK) {
+        ESP_LOGI(TAG, "Found OTA checkpoint at %" PRIu32 " of %" PRIu32 " bytes", ckpt.offset, ckpt.image_len);
+    }
+#endif
+    /* Patch based updates rewrite the slot from 0: not while a resumable download is pending */
+    bool from_scratch = update && ckpt.offset == 0;
+#if CONFIG_OTA_DELTA_ENABLE
+    if (from_scratch && ota_cfg.delta_url && ota_cfg.delta_url[0]) {
+        ESP_LOGI(TAG, "Trying delta update from %s", ota_cfg.delta_url);
+        esp_http_client_set_url(client, ota_cfg.delta_url);
+        ota_stats_probe(ota_cfg.delta_url);
+        ret = ota_delta_download(client, update);
+        if (ret == ESP_OK) {
+            ota_stats_session_end(ret);
+#if CONFIG_OTA_CHECK_ENABLE
+            ota_record_installed(client, url, NULL);
+#endif
+            ESP_LOGI(TAG, "OTA (delta) Succeed, image selected for the next boot");
+            ota_client_put(false);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Delta update not applied (%s), falling back to full image", esp_err_to_name(ret));
+        esp_http_client_set_url(client, url);
+    }
+#endif
+#if CONFIG_OTA_BLOCKSYNC_ENABLE
+    if (from_scratch && ota_cfg.manifest_url && ota_cfg.manifest_url[0]) {
+        ESP_LOGI(TAG, "Trying block sync with manifest %s", ota_cfg.manifest_url);
+        ota_stats_probe(ota_cfg.manifest_url);
+        ret = ota_blocksync_download(client, ota_cfg.manifest_url, url, update);
+        if (ret == ESP_OK) {
+            ota_stats_session_end(ret);
+#if CONFIG_OTA_CHECK_ENABLE
+            ota_record_installed(client, url, NULL);
+#endif
+            ESP_LOGI(TAG, "OTA (block sync) Succeed, image selected for the next boot");
+            ota_client_put(false);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Block sync not applied (%s), falling back to full image", esp_err_to_name(ret));
+        esp_http_client_set_url(client, url);
+    }
+#endif
+#if CONFIG_OTA_PEER_FETCH
+    if (from_scratch) {
+        ret = ota_peer_download(update, &ckpt);
+        if (ret == ESP_OK) {
+            ota_stats_session_end(ret);
+            ota_record_installed(client, url, NULL);
+            ESP_LOGI(TAG, "OTA (LAN peer) Succeed, image selected for the next boot");
+            ota_client_put(false);
+            return ESP_OK;
+        }
+        if (ret != ESP_ERR_NOT_FOUND) ESP_LOGW(TAG, "No LAN peer delivered the image, using the origin");
+        esp_http_client_set_url(client, url);
+    }
+#endif
+    /* Full image: from the best mirror, failing over to the next one */
+    size_t mirrors = ota_mirror_load(url, ota_cfg.mirror_urls);
+    if (mirrors > 1) ota_mirror_probe_all(client);
+    size_t m = 0;
+    ota_stats_probe(ota_mirror_url(m));
+    for (int attempt = 0; update; attempt++) {
+        const char *src = ota_mirror_url(m);
+        sys_mon_set_phase(SYS_MON_PHASE_OTA_CONNECT);
+        esp_http_client_set_url(client, src);
+        uint32_t rx0 = ota_stats_rx_bytes();
+        int64_t t0 = esp_timer_get_time();
+        ret = ota_download(client, src, update, &ckpt);
+        if (mirrors > 1) ota_mirror_record(m, ret, -1, ota_stats_rx_bytes() - rx0, esp_timer_get_time() - t0);
+        if (ret == ESP_OK || attempt >= OTA_MAX_RETRIES + (int)mirrors - 1) break;
+        if (mirrors > 1 && ota_err_is_mirror(ret)) {
+            m = (m + 1) % mirrors;
+            ESP_LOGW(TAG, "Download failed (%s), failing over to %s at offset %" PRIu32,
+                     esp_err_to_name(ret), ota_mirror_url(m), ckpt.offset);
+            continue;
+        }
+        if (!ota_err_is_transient(ret) || attempt >= OTA_MAX_RETRIES) break;
+        ESP_LOGW(TAG, "Download interrupted, retry %d/%d from offset %" PRIu32,
+                 attempt + 1, OTA_MAX_RETRIES, ckpt.offset);
+        vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_DELAY_MS * (attempt + 1)));
+    }
+    if (mirrors > 1) ota_mirror_rank();
+#if CONFIG_OTA_CHECK_ENABLE
+    if (ret == ESP_OK) ota_record_installed(client, url, ckpt.validator);
+#endif
+    /* No update or failed: keep the connection for the next check */
+    ota_client_put(ret != ESP_OK);
+    ota_stats_session_end(ret);
 
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "OTA Succeed, Rebooting...");
-        esp_restart();
-        return ESP_OK; /* unreachable */
+        ESP_LOGI(TAG, "OTA Succeed, image selected for the next boot");
+        return ESP_OK;
     }
 
     ESP_LOGE(TAG, "Firmware upgrade failed: %s", esp_err_to_name(ret));
     return ret;
 }
+
+esp_err_t ota_hal_stage(const ota_hal_throttle_t *throttle)
+{
+    if (throttle) ota_pipeline_set_throttle(throttle->rate_kbps * 1024, throttle->flash_pct);
+    esp_err_t ret = ota_stage();
+    if (throttle) ota_pipeline_set_throttle(0, 100);
+    ota_arena_reset();
+    return ret;
+}
+
+esp_err_t ota_hal_start(void)
+{
+    esp_err_t ret = ota_hal_stage(NULL);
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Rebooting...");
+        esp_restart();
+    }
+    return ret;
+}
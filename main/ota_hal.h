@@ -23,10 +23,22 @@
  * 
  * The following functions are provided:
  * - ota_hal_init(): Initialize the OTA HAL with configuration checks.
+ * - ota_hal_check(): Ask the server whether a newer firmware exists (one small
+ *  request, no flash writes, see ota_check.h).
  * - ota_hal_start(): Start the OTA update process (blocking, calls esp_restart() on
- *  success).
+ *  success). Data is received on the calling task and written to flash by the
+ *  pipeline writer task (see ota_pipeline.h). With several mirrors the image
+ *  comes from the best ranked one, failing over to the next (see ota_mirror.h).
+ * - ota_hal_stage(): Same update without the restart, optionally throttled so the
+ *  application keeps its timing while the image is downloaded in the background.
  * - ota_hal_mark_app_valid_if_needed(): Mark the running app as valid if it's pending
  * verification (call early on boot after self-test).
+ * - ota_hal_get_stats() / ota_hal_get_stats_history(): per-phase timings of the last
+ * sessions (see ota_stats.h).
+ * - ota_hal_http_config(): HTTP client configuration used for OTA downloads (TLS,
+ * bind interface), shared with the benchmark (see ota_bench.h).
+ * - ota_hal_http_open(): Send the request and read the response headers, reconnecting
+ * once if a kept-alive connection was dropped by the server.
  * 
  * 
  * @author Marconatale Parise   
@@ -36,6 +48,8 @@
 
 #include <stdbool.h>
 #include "esp_err.h"
+#include "esp_http_client.h"
+#include "ota_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,6 +64,11 @@ extern "C" {
  * - url: HTTPS endpoint hosting the firmware binary
  * - keep_alive: keep-alive generally improves OTA stability
  * - skip_cn_check: debug only
+ * - delta_url: patch endpoint tried before url (NULL/empty disables delta updates)
+ * - manifest_url: block manifest for block sync against url (NULL/empty disables it)
+ * - check_url: version manifest used by ota_hal_check() (NULL/empty: HEAD on url)
+ * - mirror_urls: comma separated mirrors of url, ranked and used for failover
+ *   (NULL/empty: url only, see ota_mirror.h)
  *
  * Notes:
  * - TLS server verification is controlled by Kconfig:
@@ -60,8 +79,37 @@ typedef struct {
     const char *url;        /*!< 🔧 USER MODIFIABLE: OTA firmware URL */
     bool keep_alive;        /*!< Enable HTTP keep-alive */
     bool skip_cn_check;     /*!< Debug only: skip CN check */
+    const char *delta_url;  /*!< 🔧 USER MODIFIABLE: delta patch URL (optional) */
+    const char *manifest_url; /*!< 🔧 USER MODIFIABLE: block sync manifest URL (optional) */
+    const char *check_url;  /*!< 🔧 USER MODIFIABLE: version manifest URL for update checks (optional) */
+    const char *mirror_urls; /*!< 🔧 USER MODIFIABLE: comma separated firmware mirrors (optional) */
 } ota_hal_cfg_t;
 
+/**
+ * @brief Result of an update check
+ */
+typedef enum {
+    OTA_CHECK_UP_TO_DATE = 0,   /*!< The running firmware is the current one */
+    OTA_CHECK_AVAILABLE,        /*!< A different (newer) firmware is published */
+} ota_hal_check_result_t;
+
+/**
+ * @brief Update check details
+ */
+typedef struct {
+    ota_hal_check_result_t result;
+    int  status;                /*!< HTTP status (304 when answered from the cached validator) */
+    char version[32];           /*!< Published version (manifest mode only) */
+} ota_hal_check_t;
+
+/**
+ * @brief Limits of a background update (see ota_pipeline_set_throttle())
+ */
+typedef struct {
+    uint32_t rate_kbps;         /*!< Payload rate cap in KB/s, 0: unlimited */
+    uint8_t  flash_pct;         /*!< Max share of time in flash erase/write, 100: unlimited */
+} ota_hal_throttle_t;
+
 
 /* =========================
  * USER CONFIGURATION TABLE
@@ -72,6 +120,16 @@ typedef struct {
         .url = CONFIG_FIRMWARE_UPGRADE_URL,
         .keep_alive = true,
         .skip_cn_check = false,
+#if CONFIG_OTA_DELTA_ENABLE
+        .delta_url = CONFIG_OTA_DELTA_URL,
+#endif
+#if CONFIG_OTA_BLOCKSYNC_ENABLE
+        .manifest_url = CONFIG_OTA_BLOCKSYNC_MANIFEST_URL,
+#endif
+#if CONFIG_OTA_CHECK_ENABLE
+        .check_url = CONFIG_OTA_CHECK_MANIFEST_URL,
+#endif
+        .mirror_urls = CONFIG_OTA_MIRROR_URLS,
     };
 #else
     extern ota_hal_cfg_t ota_cfg;
@@ -81,12 +139,30 @@ typedef struct {
 /**
  * @brief Initialize OTA HAL
  *
- * Checks that configuration is valid.
+ * Checks that configuration is valid. The SHA-256 of the bootloader and of
+ * the running image is computed on the first call only and kept until reboot.
  * 
  * @return ESP_OK on success
  */
 esp_err_t ota_hal_init(void);
 
+/**
+ * @brief Check whether a newer firmware is published (blocking, one round trip)
+ *
+ * With ota_cfg.check_url a small JSON manifest is fetched (If-None-Match on the
+ * cached manifest ETag) and its version compared with the running app version.
+ * Otherwise a HEAD request with If-None-Match/If-Modified-Since on the validator
+ * of the installed image is sent to ota_cfg.url. Nothing is downloaded and the
+ * update partition is not touched; the connection is kept for a following
+ * ota_hal_start() (CONFIG_OTA_CONN_REUSE), and freed by a timer once it has been
+ * idle for CONFIG_OTA_CONN_IDLE_S.
+ *
+ * @param[out] out Result
+ *
+ * @return ESP_OK if the server answered, otherwise an error code
+ */
+esp_err_t ota_hal_check(ota_hal_check_t *out);
+
 /**
  * @brief Start OTA update (blocking)
  *
@@ -97,6 +173,45 @@ esp_err_t ota_hal_init(void);
  */
 esp_err_t ota_hal_start(void);
 
+/**
+ * @brief Download, verify and select the new image for boot, without restarting (blocking)
+ *
+ * Same sources and fallbacks as ota_hal_start(). On success the new image boots
+ * on the next esp_restart(), which the caller issues when the application is
+ * ready to stop; on failure the running image stays selected.
+ *
+ * @param throttle Rate and flash limits for this session, NULL: full speed
+ *
+ * @return ESP_OK if the new image is selected for the next boot, otherwise an error code
+ */
+esp_err_t ota_hal_stage(const ota_hal_throttle_t *throttle);
+
+/**
+ * @brief Fill the HTTP client configuration used for OTA downloads
+ *
+ * Sets TLS verification, keep-alive, buffer sizes and bind interface from
+ * ota_cfg and Kconfig. Callers may override fields before esp_http_client_init().
+ *
+ * @param[out] http_cfg Client configuration
+ * @param url           Request URL
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_hal_http_config(esp_http_client_config_t *http_cfg, const char *url);
+
+/**
+ * @brief Send the request and read the response headers
+ *
+ * With keep-alive the client may still hold a connection the server has since
+ * closed: on failure the connection is reopened once.
+ *
+ * @param client           HTTP client with URL and headers set
+ * @param[out] content_len Content-Length of the response (optional)
+ *
+ * @return ESP_OK when the response headers were received
+ */
+esp_err_t ota_hal_http_open(esp_http_client_handle_t client, int64_t *content_len);
+
 /**
  * @brief Mark running app as valid (cancel rollback) if pending verify
  *
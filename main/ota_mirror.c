@@ -0,0 +1,227 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_mirror.c
+ * @brief Firmware mirror list, ranking and failover order
+ *
+ * @author Marconatale Parise
+ * @date 26 Mar 2026
+ */
+#include "ota_mirror.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "ota_mirror";
+
+#define MIRROR_NVS_NS       "ota_mirror"
+#define MIRROR_NVS_KEY      "rank"
+#define MIRROR_VERSION      1
+#define MIRROR_URL_LEN      256
+#define MIRROR_REF_BYTES    (1024 * 1024)   /* reference image for the expected download time */
+#define MIRROR_MIN_BYTES    4096            /* shorter bodies say nothing about throughput */
+#define MIRROR_UNKNOWN_US   1000000         /* latency assumed before the first measurement */
+#define MIRROR_UNKNOWN_BPS  (32 * 1024)     /* throughput assumed before the first measurement */
+#define MIRROR_FAIL_CAP     8
+
+typedef struct {
+    uint32_t hash;              /* FNV-1a of the URL */
+    uint32_t ttfb_us;           /* smoothed latency, 0: unknown */
+    uint32_t rate_bps;          /* smoothed throughput, 0: unknown */
+    uint16_t fails;             /* consecutive failed requests */
+    uint16_t reserved;
+} mirror_meas_t;
+
+typedef struct {
+    uint32_t version;
+    mirror_meas_t meas[OTA_MIRROR_MAX];
+} mirror_blob_t;
+
+typedef struct {
+    char url[MIRROR_URL_LEN];
+    mirror_meas_t meas;
+    bool down;                  /* nothing received from it this session */
+} mirror_t;
+
+static mirror_t s_mirror[OTA_MIRROR_MAX];
+static size_t s_count;
+
+static uint32_t url_hash(const char *url)
+{
+    uint32_t h = 2166136261u;
+    while (*url) {
+        h ^= (uint8_t)*url++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t smooth(uint32_t old, uint32_t sample)
+{
+    return old ? (uint32_t)(((uint64_t)old * 3 + sample) / 4) : sample;
+}
+
+/* Expected time to fetch the reference image, stretched by the failures in a row */
+static uint64_t score(const mirror_t *m)
+{
+    uint64_t ttfb = m->meas.ttfb_us ? m->meas.ttfb_us : MIRROR_UNKNOWN_US;
+    uint64_t rate = m->meas.rate_bps ? m->meas.rate_bps : MIRROR_UNKNOWN_BPS;
+    uint64_t t = ttfb + (uint64_t)MIRROR_REF_BYTES * 1000000 / rate;
+    uint32_t fails = m->meas.fails < MIRROR_FAIL_CAP ? m->meas.fails : MIRROR_FAIL_CAP;
+    return t * (1 + fails);
+}
+
+static bool ranks_before(const mirror_t *a, const mirror_t *b)
+{
+    if (a->down != b->down) return !a->down;
+    return score(a) < score(b);
+}
+
+/* Stable: equal mirrors keep the configured order */
+static void sort_mirrors(void)
+{
+    for (size_t i = 1; i < s_count; i++) {
+        mirror_t m = s_mirror[i];
+        size_t j = i;
+        while (j > 0 && ranks_before(&m, &s_mirror[j - 1])) {
+            s_mirror[j] = s_mirror[j - 1];
+            j--;
+        }
+        s_mirror[j] = m;
+    }
+}
+
+static void add_mirror(const char *url, size_t len)
+{
+    while (len && (*url == ' ' || *url == '\t')) {
+        url++;
+        len--;
+    }
+    while (len && (url[len - 1] == ' ' || url[len - 1] == '\t')) len--;
+    if (len == 0) return;
+    if (len >= MIRROR_URL_LEN) {
+        ESP_LOGW(TAG, "Mirror URL too long, skipped");
+        return;
+    }
+    if (s_count == OTA_MIRROR_MAX) {
+        ESP_LOGW(TAG, "More than %d mirrors, the rest is ignored", OTA_MIRROR_MAX);
+        return;
+    }
+    mirror_t *m = &s_mirror[s_count];
+    memcpy(m->url, url, len);
+    m->url[len] = '\0';
+    for (size_t i = 0; i < s_count; i++) {
+        if (strcmp(s_mirror[i].url, m->url) == 0) return;   /* listed twice */
+    }
+    memset(&m->meas, 0, sizeof(m->meas));
+    m->meas.hash = url_hash(m->url);
+    m->down = false;
+    s_count++;
+}
+
+static bool blob_read(mirror_blob_t *blob)
+{
+    nvs_handle_t h;
+    if (nvs_open(MIRROR_NVS_NS, NVS_READONLY, &h) != ESP_OK) return false;
+    size_t len = sizeof(*blob);
+    esp_err_t err = nvs_get_blob(h, MIRROR_NVS_KEY, blob, &len);
+    nvs_close(h);
+    return err == ESP_OK && len == sizeof(*blob) && blob->version == MIRROR_VERSION;
+}
+
+size_t ota_mirror_load(const char *primary, const char *list)
+{
+    s_count = 0;
+    if (primary) add_mirror(primary, strlen(primary));
+    while (list && *list) {
+        const char *end = strchr(list, ',');
+        size_t len = end ? (size_t)(end - list) : strlen(list);
+        add_mirror(list, len);
+        list = end ? end + 1 : NULL;
+    }
+
+    mirror_blob_t blob;
+    if (s_count > 1 && blob_read(&blob)) {
+        for (size_t i = 0; i < s_count; i++) {
+            for (size_t k = 0; k < OTA_MIRROR_MAX; k++) {
+                if (blob.meas[k].hash == s_mirror[i].meas.hash) {
+                    s_mirror[i].meas = blob.meas[k];
+                    break;
+                }
+            }
+        }
+        sort_mirrors();
+    }
+    return s_count;
+}
+
+size_t ota_mirror_count(void)
+{
+    return s_count;
+}
+
+const char *ota_mirror_url(size_t rank)
+{
+    return rank < s_count ? s_mirror[rank].url : NULL;
+}
+
+void ota_mirror_record(size_t rank, esp_err_t result, int64_t ttfb_us, size_t bytes, int64_t body_us)
+{
+    if (rank >= s_count) return;
+    mirror_t *m = &s_mirror[rank];
+    if (result == ESP_OK) {
+        m->meas.fails = 0;
+        m->down = false;
+    } else {
+        if (m->meas.fails < UINT16_MAX) m->meas.fails++;
+        if (bytes == 0) m->down = true;
+    }
+    if (ttfb_us >= 0) m->meas.ttfb_us = smooth(m->meas.ttfb_us, ttfb_us < UINT32_MAX ? (uint32_t)ttfb_us : UINT32_MAX);
+    if (bytes >= MIRROR_MIN_BYTES && body_us > 0) {
+        uint64_t rate = (uint64_t)bytes * 1000000 / (uint64_t)body_us;
+        m->meas.rate_bps = smooth(m->meas.rate_bps, rate < UINT32_MAX ? (uint32_t)rate : UINT32_MAX);
+    }
+}
+
+void ota_mirror_rank(void)
+{
+    if (s_count < 2) return;
+    sort_mirrors();
+
+    mirror_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = MIRROR_VERSION;
+    for (size_t i = 0; i < s_count; i++) {
+        blob.meas[i] = s_mirror[i].meas;
+        ESP_LOGI(TAG, "#%u %s: latency %" PRIu32 " ms, %" PRIu32 " KB/s, %u failures%s", (unsigned)i + 1,
+                 s_mirror[i].url, s_mirror[i].meas.ttfb_us / 1000, s_mirror[i].meas.rate_bps / 1024,
+                 s_mirror[i].meas.fails, s_mirror[i].down ? ", not answering" : "");
+    }
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(MIRROR_NVS_NS, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, MIRROR_NVS_KEY, &blob, sizeof(blob));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) ESP_LOGW(TAG, "Ranking save failed: %s", esp_err_to_name(err));
+}
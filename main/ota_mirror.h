@@ -0,0 +1,108 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_mirror.h
+ * @brief Firmware mirror list, ranking and failover order
+ *
+ * The firmware image can be published on several mirrors: the primary URL
+ * (ota_cfg.url) and the comma separated list in ota_cfg.mirror_urls
+ * (CONFIG_OTA_MIRROR_URLS). Before a full image download the OTA HAL probes
+ * every mirror with a small ranged GET and records:
+ * - latency: request start -> response headers (connect and TLS included on a
+ *   new connection)
+ * - throughput: rate of the probe body, then of every download attempt
+ *
+ * Mirrors are ranked by the expected download time, latency plus a reference
+ * image at the measured rate, stretched by consecutive failures; mirrors that
+ * did not answer the probe go last. Latency and throughput are smoothed over
+ * sessions and kept in NVS, so a session whose probes all fail still uses the
+ * last known ranking.
+ *
+ * When a download attempt fails on a network error or a bad response, the HAL
+ * moves to the next mirror and resumes at the checkpoint. Resuming only works
+ * if the mirrors serve the same validator (ETag/Last-Modified): If-Range makes
+ * any other mirror send the whole image, and the download restarts from 0.
+ *
+ * This module keeps the list and the measurements; the requests are sent by
+ * the OTA HAL.
+ *
+ * The following functions are provided:
+ * - ota_mirror_load(): Parse the mirror list and load the stored measurements.
+ * - ota_mirror_count() / ota_mirror_url(): Mirrors in rank order.
+ * - ota_mirror_record(): Record a probe or a download attempt.
+ * - ota_mirror_rank(): Sort by the measurements, store them and log the ranking.
+ *
+ * @author Marconatale Parise
+ * @date 26 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_MIRROR_MAX 4    /*!< Primary URL included */
+
+/**
+ * @brief Set up the mirror list, ordered by the stored ranking
+ *
+ * @param primary Primary firmware URL
+ * @param list    Comma separated extra mirrors (NULL or empty: none)
+ *
+ * @return Number of mirrors (at least 1 with a primary URL)
+ */
+size_t ota_mirror_load(const char *primary, const char *list);
+
+/**
+ * @brief Number of mirrors
+ */
+size_t ota_mirror_count(void);
+
+/**
+ * @brief URL of a mirror
+ *
+ * @param rank Position in the ranking (0: best)
+ *
+ * @return URL, or NULL if rank is out of range
+ */
+const char *ota_mirror_url(size_t rank);
+
+/**
+ * @brief Record a probe or a download attempt
+ *
+ * Positions stay the same until the next ota_mirror_rank().
+ *
+ * @param rank    Position of the mirror
+ * @param result  ESP_OK, or the error of the request
+ * @param ttfb_us Request start -> response headers, < 0 when not measured
+ * @param bytes   Body bytes received
+ * @param body_us Time spent receiving them
+ */
+void ota_mirror_record(size_t rank, esp_err_t result, int64_t ttfb_us, size_t bytes, int64_t body_us);
+
+/**
+ * @brief Sort the mirrors, store the measurements in NVS and log the ranking
+ */
+void ota_mirror_rank(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,329 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_parallel.c
+ * @brief Parallel ranged OTA download over several HTTP connections
+ *
+ * @author Marconatale Parise
+ * @date 20 Mar 2026
+ */
+#include "ota_parallel.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ota_hal.h"
+#include "ota_arena.h"
+#include "ota_pipeline.h"
+#include "ota_stats.h"
+#include "sys_mon.h"
+
+static const char *TAG = "ota_par";
+
+#define PAR_MAX_CONN     4
+#define PAR_BUF_SIZE     CONFIG_OTA_PIPELINE_BUF_SIZE
+#define PAR_BUF_COUNT    CONFIG_OTA_PIPELINE_BUF_COUNT
+/* Ranges are whole pipeline buffers: only the last buffer of the image is short */
+#define PAR_RANGE_BUFS   ((CONFIG_OTA_PARALLEL_RANGE_KB * 1024 + PAR_BUF_SIZE - 1) / PAR_BUF_SIZE)
+#define PAR_RANGE_SIZE   ((size_t)PAR_RANGE_BUFS * PAR_BUF_SIZE)
+#define PAR_WORKER_STACK 8192   /* TLS handshake */
+#define PAR_WAIT_MS      1000
+
+/* One range in flight: its pipeline buffers are taken when it is dispatched */
+typedef struct {
+    size_t   start;
+    size_t   len;
+    int      nbufs;
+    uint8_t *buf[PAR_RANGE_BUFS];
+    size_t   fill[PAR_RANGE_BUFS];
+    volatile esp_err_t err;
+    volatile bool done;
+} par_job_t;
+
+static struct {
+    const char   *url;
+    const char   *validator;
+    SemaphoreHandle_t wake;         /* a job finished or a worker exited (not a task notification:
+                                       Task_ota's belongs to the state machine) */
+    QueueHandle_t job_q;            /* par_job_t *, NULL stops a worker */
+    par_job_t     job[PAR_MAX_CONN];
+    volatile bool stop;
+    volatile bool alive[PAR_MAX_CONN];
+    uint32_t      ranges[PAR_MAX_CONN];   /* ranges fetched by each worker */
+    ota_stats_conn_t conn[PAR_MAX_CONN];  /* stats user_data of each worker client */
+    ota_arena_task_t  worker[PAR_MAX_CONN];
+    ota_arena_block_t job_q_mem;
+} s_par;
+
+int ota_parallel_conns(int conns)
+{
+    int window = PAR_BUF_COUNT / PAR_RANGE_BUFS;
+    if (conns > PAR_MAX_CONN) conns = PAR_MAX_CONN;
+    return conns < window ? conns : window;
+}
+
+size_t ota_parallel_range_size(void)
+{
+    return PAR_RANGE_SIZE;
+}
+
+/* Receive the body of the current response into the buffers of job */
+static esp_err_t par_read(esp_http_client_handle_t client, par_job_t *job)
+{
+    size_t left = job->len;
+    for (int i = 0; i < job->nbufs; i++) {
+        size_t want = left < PAR_BUF_SIZE ? left : PAR_BUF_SIZE;
+        size_t fill = 0;
+        while (fill < want) {
+            int n = esp_http_client_read(client, (char *)job->buf[i] + fill, want - fill);
+            if (n == -ESP_ERR_HTTP_EAGAIN) continue;
+            if (n <= 0) return ESP_FAIL;
+            fill += n;
+        }
+        job->fill[i] = fill;
+        left -= fill;
+    }
+    return ESP_OK;
+}
+
+/* Request one range on a worker connection and receive it */
+static esp_err_t par_fetch(esp_http_client_handle_t client, par_job_t *job)
+{
+    char range[48];
+    snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)job->start, (unsigned)(job->start + job->len - 1));
+    esp_http_client_set_header(client, "Range", range);
+
+    int64_t len = 0;
+    esp_err_t err = ota_hal_http_open(client, &len);
+    if (err != ESP_OK) return err;
+
+    int status = esp_http_client_get_status_code(client);
+    if (status != 206 || len != (int64_t)job->len) {
+        /* 200 after If-Range: the image changed under us */
+        ESP_LOGE(TAG, "Range %s: HTTP %d, %" PRId64 " bytes", range, status, len);
+        esp_http_client_close(client);
+        return status == 200 ? ESP_ERR_INVALID_RESPONSE : ESP_FAIL;
+    }
+    err = par_read(client, job);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Range %s: read error", range);
+        esp_http_client_close(client);  /* the response is not drained: never reuse it */
+    }
+    return err;
+}
+
+/* Worker connections count in the session stats; the response headers belong to the HAL's parser */
+static esp_err_t par_event_handler(esp_http_client_event_t *evt)
+{
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            ota_stats_on_connected(evt->user_data);
+            break;
+        case HTTP_EVENT_HEADER_SENT:
+            ota_stats_on_request_sent(evt->user_data);
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+static void par_worker(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    esp_http_client_config_t cfg;
+    esp_http_client_handle_t client = NULL;
+    sys_mon_watch_task(NULL, PAR_WORKER_STACK);
+
+    if (ota_hal_http_config(&cfg, s_par.url) == ESP_OK) {
+        s_par.conn[id] = (ota_stats_conn_t){ 0 };
+        cfg.event_handler = par_event_handler;
+        cfg.user_data = &s_par.conn[id];
+        client = esp_http_client_init(&cfg);
+    }
+    if (client && s_par.validator[0]) {
+        esp_http_client_set_header(client, "If-Range", s_par.validator);
+    }
+
+    par_job_t *job;
+    while (xQueueReceive(s_par.job_q, &job, portMAX_DELAY) == pdTRUE && job) {
+        esp_err_t err = ESP_ERR_INVALID_STATE;
+        if (!client) {
+            err = ESP_ERR_NO_MEM;
+        } else if (!s_par.stop) {
+            err = par_fetch(client, job);
+            /* One more try on a fresh connection before failing the session */
+            if (err == ESP_FAIL && !s_par.stop) err = par_fetch(client, job);
+        }
+        if (err == ESP_OK) s_par.ranges[id]++;
+        job->err = err;
+        job->done = true;
+        xSemaphoreGive(s_par.wake);
+    }
+
+    if (client) esp_http_client_cleanup(client);
+    sys_mon_unwatch_task(NULL);
+    s_par.alive[id] = false;
+    xSemaphoreGive(s_par.wake);
+    ota_arena_task_exit();
+}
+
+/* Take the buffers of a range from the ring, in image order */
+static esp_err_t par_job_setup(par_job_t *job, size_t start, size_t len)
+{
+    job->start = start;
+    job->len = len;
+    job->nbufs = (int)((len + PAR_BUF_SIZE - 1) / PAR_BUF_SIZE);
+    job->err = ESP_OK;
+    job->done = false;
+    for (int i = 0; i < job->nbufs; i++) {
+        job->buf[i] = ota_pipeline_acquire(NULL);
+        if (!job->buf[i]) return ESP_ERR_INVALID_STATE;
+        job->fill[i] = 0;
+    }
+    return ESP_OK;
+}
+
+static bool par_workers_alive(int workers)
+{
+    for (int i = 0; i < workers; i++) {
+        if (s_par.alive[i]) return true;
+    }
+    return false;
+}
+
+esp_err_t ota_parallel_download(esp_http_client_handle_t client, const char *url, const char *validator,
+                                size_t offset, size_t first_len, size_t total_len, int conns,
+                                ota_parallel_progress_t progress, void *arg)
+{
+    int window = ota_parallel_conns(conns);
+    if (window < 2 || first_len == 0 || first_len % PAR_BUF_SIZE != 0 || offset + first_len >= total_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t rest = total_len - offset - first_len;
+    int nranges = 1 + (int)((rest + PAR_RANGE_SIZE - 1) / PAR_RANGE_SIZE);
+    int64_t t0 = esp_timer_get_time();
+
+    s_par.url = url;
+    s_par.validator = validator ? validator : "";
+    s_par.stop = false;
+    if (!s_par.wake) s_par.wake = xSemaphoreCreateBinary();
+    s_par.job_q = ota_arena_queue_create(&s_par.job_q_mem, window, sizeof(par_job_t *));
+    if (!s_par.wake || !s_par.job_q) {
+        if (s_par.job_q) vQueueDelete(s_par.job_q);
+        s_par.job_q = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    int workers = 0;
+    for (int i = 0; i < window; i++) {
+        s_par.alive[i] = true;
+        s_par.ranges[i] = 0;
+        if (ota_arena_task_create(&s_par.worker[i], par_worker, "Task OTA range", PAR_WORKER_STACK,
+                                  (void *)(intptr_t)i, uxTaskPriorityGet(NULL), tskNO_AFFINITY) != ESP_OK) {
+            s_par.alive[i] = false;
+            break;
+        }
+        workers++;
+    }
+
+    esp_err_t err = workers > 0 ? ESP_OK : ESP_ERR_NO_MEM;
+    int next_job = 0;       /* next range to dispatch */
+    int next_submit = 0;    /* next range to hand to the writer */
+    size_t next_start = offset;
+
+    /* Range 0 is the response already open on the main connection */
+    if (err == ESP_OK) {
+        err = par_job_setup(&s_par.job[0], offset, first_len);
+        next_job = 1;
+        next_start += first_len;
+    }
+
+    while (err == ESP_OK && next_submit < nranges) {
+        /* Keep the window full: the ring holds every buffer in flight */
+        while (err == ESP_OK && next_job < nranges && next_job - next_submit < window) {
+            par_job_t *job = &s_par.job[next_job % window];
+            size_t len = total_len - next_start < PAR_RANGE_SIZE ? total_len - next_start : PAR_RANGE_SIZE;
+            err = par_job_setup(job, next_start, len);
+            if (err == ESP_OK) {
+                xQueueSend(s_par.job_q, &job, portMAX_DELAY);
+                next_start += len;
+                next_job++;
+            }
+        }
+        if (err != ESP_OK) break;
+
+        par_job_t *job = &s_par.job[next_submit % window];
+        if (next_submit == 0 && !job->done) {
+            /* Read range 0 here while the workers fetch the next ones */
+            job->err = par_read(client, job);
+            job->done = true;
+        }
+        if (!job->done) {
+            xSemaphoreTake(s_par.wake, pdMS_TO_TICKS(PAR_WAIT_MS));
+            continue;
+        }
+        if (job->err != ESP_OK) {
+            ESP_LOGE(TAG, "Range at %u failed: %s", (unsigned)job->start, esp_err_to_name(job->err));
+            err = job->err;
+            break;
+        }
+        for (int i = 0; i < job->nbufs && err == ESP_OK; i++) {
+            ota_stats_add_rx(job->fill[i]);
+            err = ota_pipeline_submit(job->buf[i], job->fill[i]);
+        }
+        next_submit++;
+        if (err == ESP_OK && progress) progress(arg);
+    }
+
+    /* Stop the workers; buffers still held are reclaimed by ota_pipeline_abort() */
+    s_par.stop = true;
+    par_job_t *none = NULL;
+    for (int i = 0; i < workers; i++) {
+        xQueueSend(s_par.job_q, &none, portMAX_DELAY);
+    }
+    while (par_workers_alive(workers)) {
+        xSemaphoreTake(s_par.wake, pdMS_TO_TICKS(PAR_WAIT_MS));
+    }
+    for (int i = 0; i < workers; i++) {
+        ota_arena_task_join(&s_par.worker[i]);
+    }
+    vQueueDelete(s_par.job_q);
+    s_par.job_q = NULL;
+
+    if (err == ESP_OK) {
+        int64_t us = esp_timer_get_time() - t0;
+        ESP_LOGI(TAG, "%d ranges of %u KB over %d+1 connections in %" PRId64 " ms (%.1f KB/s)",
+                 nranges, (unsigned)(PAR_RANGE_SIZE / 1024), workers, us / 1000,
+                 us > 0 ? (double)(total_len - offset) * 1000000.0 / us / 1024.0 : 0.0);
+        for (int i = 0; i < workers; i++) {
+            ESP_LOGD(TAG, "Worker %d: %" PRIu32 " ranges", i, s_par.ranges[i]);
+        }
+    }
+    return err;
+}
@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_parallel.h
+ * @brief Parallel ranged OTA download over several HTTP connections
+ *
+ * A single TLS stream is often limited by round trip time and window size
+ * rather than by the radio. In parallel mode the image is split into ranges of
+ * CONFIG_OTA_PARALLEL_RANGE_KB; up to CONFIG_OTA_PARALLEL_CONN worker tasks,
+ * each with its own connection, fetch different ranges with "Range" requests.
+ *
+ * Every range is received straight into pipeline buffers taken from the ring in
+ * image order when the range is dispatched, so completed ranges only need to be
+ * handed to the writer in order: no reassembly copy. The number of ranges in
+ * flight is bounded by the ring (CONFIG_OTA_PIPELINE_BUF_COUNT buffers must hold
+ * them), which also bounds the memory used.
+ *
+ * The first range is the response to the HAL's own request on the main
+ * connection: it carries the image size (Content-Range) and proves Range
+ * support. Workers send If-Range with the image validator, so an image replaced
+ * during the download fails the session instead of mixing two images.
+ *
+ * The following functions are provided:
+ * - ota_parallel_conns(): Connections usable with the current ring size.
+ * - ota_parallel_range_size(): Range size (a multiple of the pipeline buffer).
+ * - ota_parallel_download(): Download the rest of the image (blocking).
+ *
+ * @author Marconatale Parise
+ * @date 20 Mar 2026
+ */
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Called after each range is handed to the writer (e.g. to store a checkpoint)
+ */
+typedef void (*ota_parallel_progress_t)(void *arg);
+
+/**
+ * @brief Number of connections that can run in parallel
+ *
+ * @param conns Requested connections
+ *
+ * @return conns limited by the pipeline ring and the worker limit (< 2: use a single stream)
+ */
+int ota_parallel_conns(int conns);
+
+/**
+ * @brief Size of one range in bytes
+ */
+size_t ota_parallel_range_size(void);
+
+/**
+ * @brief Download the image with parallel ranged requests into the pipeline
+ *
+ * The pipeline must be started. client holds the 206 response for the first
+ * range [offset, offset + first_len), with headers already read.
+ *
+ * @param client     Main connection
+ * @param url        Image URL (for the worker connections)
+ * @param validator  ETag/Last-Modified of the image, sent as If-Range (may be empty)
+ * @param offset     Payload offset of the first range
+ * @param first_len  Length of the first range
+ * @param total_len  Payload length (from Content-Range)
+ * @param conns      Worker connections (see ota_parallel_conns())
+ * @param progress   Progress callback (optional)
+ * @param arg        Argument of progress
+ *
+ * @return ESP_OK when the whole payload was handed to the writer
+ */
+esp_err_t ota_parallel_download(esp_http_client_handle_t client, const char *url, const char *validator,
+                                size_t offset, size_t first_len, size_t total_len, int conns,
+                                ota_parallel_progress_t progress, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,490 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_peer.c
+ * @brief LAN peer firmware distribution: serve the running image, fetch from neighbours
+ *
+ * @author Marconatale Parise
+ * @date 22 Mar 2026
+ */
+#include "ota_peer.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_image_format.h"
+#include "esp_http_server.h"
+#include "mbedtls/sha256.h"
+#include "lwip/sockets.h"
+
+#include "sys_mon.h"
+
+static const char *TAG = "ota_peer";
+
+/* ===================== Server ===================== */
+
+#if CONFIG_OTA_PEER_SERVE
+#define PEER_TASK_STACK     4096
+#define PEER_TASK_PRIO      1                   /* same as the application tasks: serving never starves them */
+#define PEER_WORKER_STACK   3072
+#define PEER_CHUNK          4096
+#define PEER_MAX_SOCKETS    7                   /* httpd default; also bounds the queued requests */
+#define PEER_SLOT_IDLE_US   (10 * 1000 * 1000)  /* a client silent this long frees its slot */
+#define PEER_RETRY_AFTER_S  "5"
+
+static struct {
+    bool started;
+    const esp_partition_t *part;
+    uint32_t image_len;
+    char etag[20];                      /* quoted first 16 hex digits of the digest */
+    char sha_hex[2 * 32 + 1];
+    ota_peer_announce_t announce;
+    httpd_handle_t httpd;
+    QueueHandle_t work_q;               /* async requests of admitted clients */
+    struct {
+        uint32_t ip;
+        int64_t  last_us;
+    } slots[CONFIG_OTA_PEER_MAX_CLIENTS];
+    atomic_uint served;                 /* responses sent (ranges count one each), by every worker */
+    atomic_uint rejected;               /* 503 answers */
+    uint8_t buf[CONFIG_OTA_PEER_MAX_CLIENTS][PEER_CHUNK];   /* one per worker */
+} s_srv;
+static portMUX_TYPE s_slot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool is_zero(const uint8_t *p, size_t len)
+{
+    while (len--) {
+        if (*p++) return false;
+    }
+    return true;
+}
+
+/* Take or refresh the slot of ip; false when every slot is held by another client. *added: a new slot */
+static bool slot_take(uint32_t ip, bool *added)
+{
+    int64_t now = esp_timer_get_time();
+    int free_idx = -1;
+    bool ok = false;
+    portENTER_CRITICAL(&s_slot_lock);
+    for (int i = 0; i < CONFIG_OTA_PEER_MAX_CLIENTS; i++) {
+        if (s_srv.slots[i].ip == ip) {
+            s_srv.slots[i].last_us = now;
+            ok = true;
+            break;
+        }
+        if (free_idx < 0 && (s_srv.slots[i].ip == 0 || now - s_srv.slots[i].last_us >= PEER_SLOT_IDLE_US)) {
+            free_idx = i;
+        }
+    }
+    if (!ok && free_idx >= 0) {
+        s_srv.slots[free_idx].ip = ip;
+        s_srv.slots[free_idx].last_us = now;
+        ok = true;
+        if (added) *added = true;
+    }
+    portEXIT_CRITICAL(&s_slot_lock);
+    return ok;
+}
+
+/* The client has the end of the image: it is done (or comes back through slot_take) */
+static void slot_release(uint32_t ip)
+{
+    portENTER_CRITICAL(&s_slot_lock);
+    for (int i = 0; i < CONFIG_OTA_PEER_MAX_CLIENTS; i++) {
+        if (s_srv.slots[i].ip == ip) s_srv.slots[i].ip = 0;
+    }
+    portEXIT_CRITICAL(&s_slot_lock);
+}
+
+static uint8_t slots_free(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint8_t n = 0;
+    portENTER_CRITICAL(&s_slot_lock);
+    for (int i = 0; i < CONFIG_OTA_PEER_MAX_CLIENTS; i++) {
+        if (s_srv.slots[i].ip == 0 || now - s_srv.slots[i].last_us >= PEER_SLOT_IDLE_US) n++;
+    }
+    portEXIT_CRITICAL(&s_slot_lock);
+    return n;
+}
+
+static uint32_t client_ip(httpd_req_t *req)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(httpd_req_to_sockfd(req), (struct sockaddr *)&addr, &len) != 0) return 0;
+    if (addr.ss_family == AF_INET) return ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+#if CONFIG_LWIP_IPV6
+    if (addr.ss_family == AF_INET6) return ((struct sockaddr_in6 *)&addr)->sin6_addr.un.u32_addr[3];   /* v4 mapped */
+#endif
+    return 0;
+}
+
+/*
+ * "bytes=a-b", "bytes=a-" or "bytes=-n": 1 and the range, 0 to send it all, -1 if unsatisfiable.
+ * A range ending before it starts is invalid, not unsatisfiable: it is ignored (RFC 9110 14.1.1).
+ */
+static int parse_range(const char *v, uint32_t len, uint32_t *first, uint32_t *last)
+{
+    if (strncmp(v, "bytes=", 6) != 0 || strchr(v, ',')) return 0;   /* multi-range: ignore, as Range allows */
+    v += 6;
+    char *end;
+    if (*v == '-') {
+        unsigned long n = strtoul(v + 1, &end, 10);
+        if (end == v + 1 || n == 0) return -1;
+        *first = n >= len ? 0 : len - (uint32_t)n;
+        *last = len - 1;
+        return 1;
+    }
+    unsigned long a = strtoul(v, &end, 10);
+    if (end == v || *end != '-') return 0;
+    v = end + 1;
+    unsigned long b = *v ? strtoul(v, &end, 10) : ULONG_MAX;     /* "a-": to the end */
+    if (a > b) return 0;
+    if (a >= len) return -1;
+    *first = (uint32_t)a;
+    *last = b >= len ? len - 1 : (uint32_t)b;
+    return 1;
+}
+
+static esp_err_t send_all(httpd_req_t *req, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        int n = httpd_send(req, p, len);
+        if (n <= 0) return ESP_FAIL;
+        p += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/* Worker side of a request: headers and the (partial) image */
+static esp_err_t serve_image(httpd_req_t *req, uint8_t *buf)
+{
+    uint32_t ip = client_ip(req);
+    uint32_t first = 0, last = s_srv.image_len - 1;
+    int ranged = 0;
+    char hdr[64];
+    if (httpd_req_get_hdr_value_str(req, "Range", hdr, sizeof(hdr)) == ESP_OK) {
+        char cond[sizeof(s_srv.etag) + 8];
+        bool changed = httpd_req_get_hdr_value_str(req, "If-Range", cond, sizeof(cond)) == ESP_OK &&
+                       strcmp(cond, s_srv.etag) != 0;
+        if (!changed) ranged = parse_range(hdr, s_srv.image_len, &first, &last);
+    }
+    if (ranged < 0) {
+        snprintf(hdr, sizeof(hdr), "bytes */%" PRIu32, s_srv.image_len);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(req, "Content-Range", hdr);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    /* Written by hand: httpd_resp_send_chunk() would drop Content-Length for chunked encoding */
+    char head[320];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\nContent-Type: application/octet-stream\r\nContent-Length: %" PRIu32 "\r\n"
+                     "Accept-Ranges: bytes\r\nETag: %s\r\nX-Image-SHA256: %s\r\n",
+                     ranged ? "206 Partial Content" : "200 OK", last - first + 1, s_srv.etag, s_srv.sha_hex);
+    if (ranged) {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Range: bytes %" PRIu32 "-%" PRIu32 "/%" PRIu32 "\r\n",
+                      first, last, s_srv.image_len);
+    }
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    if (send_all(req, head, n) != ESP_OK) return ESP_FAIL;
+    atomic_fetch_add_explicit(&s_srv.served, 1, memory_order_relaxed);
+    if (req->method == HTTP_HEAD) return ESP_OK;
+
+    for (uint32_t pos = first; pos <= last; pos += PEER_CHUNK) {
+        size_t len = last + 1 - pos < PEER_CHUNK ? last + 1 - pos : PEER_CHUNK;
+        if (esp_partition_read(s_srv.part, pos, buf, len) != ESP_OK) return ESP_FAIL;
+        if (send_all(req, buf, len) != ESP_OK) return ESP_FAIL;     /* closes the socket */
+        slot_take(ip, NULL);
+    }
+    if (last == s_srv.image_len - 1) slot_release(ip);
+    return ESP_OK;
+}
+
+static void peer_worker(void *pvParameters)
+{
+    uint8_t *buf = s_srv.buf[(intptr_t)pvParameters];
+    httpd_req_t *req;
+    sys_mon_watch_task(NULL, PEER_WORKER_STACK);
+    while (xQueueReceive(s_srv.work_q, &req, portMAX_DELAY) == pdTRUE) {
+        serve_image(req, buf);
+        httpd_req_async_handler_complete(req);
+    }
+}
+
+/*
+ * httpd runs one handler at a time: the transfer is handed to a worker so the
+ * server keeps answering, and a client over the fan-out gets its 503 at once.
+ */
+static esp_err_t firmware_handler(httpd_req_t *req)
+{
+    httpd_req_t *async = NULL;
+    uint32_t ip = client_ip(req);
+    bool added = false;
+    if (uxQueueSpacesAvailable(s_srv.work_q) > 0 && slot_take(ip, &added)) {
+        if (httpd_req_async_handler_begin(req, &async) == ESP_OK) {
+            xQueueSend(s_srv.work_q, &async, 0);    /* only this task sends: the space is still there */
+            return ESP_OK;
+        }
+        if (added) slot_release(ip);            /* a slot this request took must not wait for the idle timeout */
+    }
+    atomic_fetch_add_explicit(&s_srv.rejected, 1, memory_order_relaxed);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", PEER_RETRY_AFTER_S);
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* Length and SHA-256 of the running image, as the origin serves it (.bin file) */
+static esp_err_t image_info(void)
+{
+    s_srv.part = esp_ota_get_running_partition();
+    const esp_partition_pos_t pos = { .offset = s_srv.part->address, .size = s_srv.part->size };
+    esp_image_metadata_t meta;
+    esp_err_t err = esp_image_get_metadata(&pos, &meta);
+    if (err != ESP_OK) return err;
+    s_srv.image_len = meta.image_len;
+
+    int64_t t0 = esp_timer_get_time();
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    for (uint32_t p = 0; p < s_srv.image_len && err == ESP_OK; p += PEER_CHUNK) {
+        size_t len = s_srv.image_len - p < PEER_CHUNK ? s_srv.image_len - p : PEER_CHUNK;
+        err = esp_partition_read(s_srv.part, p, s_srv.buf[0], len);
+        if (err == ESP_OK) mbedtls_sha256_update(&sha, s_srv.buf[0], len);
+    }
+    ota_peer_announce_t *a = &s_srv.announce;
+    mbedtls_sha256_finish(&sha, a->sha256);
+    mbedtls_sha256_free(&sha);
+    if (err != ESP_OK) return err;
+
+    for (int i = 0; i < 32; i++) sprintf(&s_srv.sha_hex[2 * i], "%02x", a->sha256[i]);
+    snprintf(s_srv.etag, sizeof(s_srv.etag), "\"%.16s\"", s_srv.sha_hex);
+    memcpy(a->magic, OTA_PEER_ANNOUNCE_MAGIC, 4);
+    a->port = CONFIG_OTA_PEER_HTTP_PORT;
+    a->max_slots = CONFIG_OTA_PEER_MAX_CLIENTS;
+    a->image_len = s_srv.image_len;
+    strncpy(a->version, esp_app_get_description()->version, sizeof(a->version));
+    ESP_LOGI(TAG, "Running image %.32s: %" PRIu32 " B, SHA-256 %.16s... (%" PRId64 " ms)",
+             a->version, s_srv.image_len, s_srv.sha_hex, (esp_timer_get_time() - t0) / 1000);
+    return ESP_OK;
+}
+
+static esp_err_t http_start(void)
+{
+    s_srv.work_q = xQueueCreate(PEER_MAX_SOCKETS, sizeof(httpd_req_t *));
+    if (!s_srv.work_q) return ESP_ERR_NO_MEM;
+    for (int i = 0; i < CONFIG_OTA_PEER_MAX_CLIENTS; i++) {
+        if (xTaskCreatePinnedToCore(peer_worker, "Task OTA peer tx", PEER_WORKER_STACK, (void *)(intptr_t)i,
+                                    PEER_TASK_PRIO, NULL, tskNO_AFFINITY) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
+    cfg.server_port = CONFIG_OTA_PEER_HTTP_PORT;
+    cfg.task_priority = PEER_TASK_PRIO;
+    cfg.max_open_sockets = PEER_MAX_SOCKETS;
+    cfg.lru_purge_enable = true;        /* a dead client never pins a socket */
+    esp_err_t err = httpd_start(&s_srv.httpd, &cfg);
+    if (err != ESP_OK) return err;
+
+    httpd_uri_t uri = { .uri = OTA_PEER_PATH, .method = HTTP_GET, .handler = firmware_handler };
+    err = httpd_register_uri_handler(s_srv.httpd, &uri);
+    uri.method = HTTP_HEAD;
+    if (err == ESP_OK) err = httpd_register_uri_handler(s_srv.httpd, &uri);
+    return err;
+}
+
+/* Answers discovery probes for the running image */
+static void peer_task(void *pvParameters)
+{
+    sys_mon_watch_task(NULL, PEER_TASK_STACK);
+    esp_err_t err = image_info();
+    if (err == ESP_OK) err = http_start();
+    int sock = err == ESP_OK ? socket(AF_INET, SOCK_DGRAM, IPPROTO_IP) : -1;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_OTA_PEER_DISCOVERY_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "Peer server not started: %s", err != ESP_OK ? esp_err_to_name(err) : "UDP socket");
+        if (sock >= 0) close(sock);
+        if (s_srv.httpd) httpd_stop(s_srv.httpd);
+        s_srv.httpd = NULL;
+        sys_mon_unwatch_task(NULL);
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Serving the running image on port %d (%d clients), discovery on UDP %d",
+             CONFIG_OTA_PEER_HTTP_PORT, CONFIG_OTA_PEER_MAX_CLIENTS, CONFIG_OTA_PEER_DISCOVERY_PORT);
+
+    for (;;) {
+        ota_peer_probe_t probe;
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        int n = recvfrom(sock, &probe, sizeof(probe), 0, (struct sockaddr *)&from, &flen);
+        if (n != sizeof(probe) || memcmp(probe.magic, OTA_PEER_PROBE_MAGIC, 4) != 0) continue;
+        if (!is_zero(probe.sha256, sizeof(probe.sha256)) &&
+            memcmp(probe.sha256, s_srv.announce.sha256, sizeof(probe.sha256)) != 0) {
+            continue;   /* looking for another image */
+        }
+        s_srv.announce.free_slots = slots_free();
+        sendto(sock, &s_srv.announce, sizeof(s_srv.announce), 0, (struct sockaddr *)&from, flen);
+        ESP_LOGD(TAG, "Probe from %s: %u free slots, %" PRIu32 " served, %" PRIu32 " rejected",
+                 inet_ntoa(from.sin_addr), s_srv.announce.free_slots,
+                 (uint32_t)atomic_load(&s_srv.served), (uint32_t)atomic_load(&s_srv.rejected));
+    }
+}
+#endif
+
+esp_err_t ota_peer_server_start(void)
+{
+#if CONFIG_OTA_PEER_SERVE
+    if (s_srv.started) return ESP_OK;
+    s_srv.started = true;
+    if (xTaskCreatePinnedToCore(peer_task, "Task OTA peer", PEER_TASK_STACK, NULL, PEER_TASK_PRIO, NULL,
+                                tskNO_AFFINITY) != pdPASS) {
+        s_srv.started = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/* ===================== Client ===================== */
+
+#if CONFIG_OTA_PEER_FETCH
+#define PEER_PROBES         2       /* broadcasts get lost: probe again halfway */
+
+static void add_peer(ota_peer_t *out, size_t *n, size_t max, uint32_t ip, const ota_peer_announce_t *a)
+{
+    for (size_t i = 0; i < *n; i++) {
+        if (out[i].ip == ip) {
+            out[i].free_slots = a->free_slots;  /* latest answer */
+            return;
+        }
+    }
+    if (*n == max) return;
+    out[*n] = (ota_peer_t){ .ip = ip, .port = a->port, .free_slots = a->free_slots, .image_len = a->image_len };
+    (*n)++;
+}
+
+/* Least loaded first, random among equals so a site does not converge on one peer */
+static void order_peers(ota_peer_t *p, size_t n)
+{
+    for (size_t i = n; i > 1; i--) {
+        size_t j = esp_random() % i;
+        ota_peer_t t = p[i - 1];
+        p[i - 1] = p[j];
+        p[j] = t;
+    }
+    for (size_t i = 1; i < n; i++) {
+        ota_peer_t t = p[i];
+        size_t j = i;
+        for (; j > 0 && p[j - 1].free_slots < t.free_slots; j--) p[j] = p[j - 1];
+        p[j] = t;
+    }
+}
+#endif
+
+size_t ota_peer_discover(const char *version, const uint8_t *sha256, ota_peer_t *out, size_t max, size_t *busy)
+{
+    if (busy) *busy = 0;
+#if CONFIG_OTA_PEER_FETCH
+    if (!version || !sha256 || !out || max == 0) return 0;
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) return 0;
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+
+    ota_peer_probe_t probe;
+    memcpy(probe.magic, OTA_PEER_PROBE_MAGIC, 4);
+    memcpy(probe.sha256, sha256, sizeof(probe.sha256));
+    struct sockaddr_in bcast = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_OTA_PEER_DISCOVERY_PORT),
+        .sin_addr.s_addr = htonl(INADDR_BROADCAST),
+    };
+
+    size_t n = 0, full = 0;
+    int probes = 0;
+    int64_t t0 = esp_timer_get_time();
+    int64_t deadline = t0 + CONFIG_OTA_PEER_DISCOVER_MS * 1000LL;
+    int64_t next_probe = t0;
+    int64_t now;
+    while ((now = esp_timer_get_time()) < deadline) {
+        if (probes < PEER_PROBES && now >= next_probe) {
+            sendto(sock, &probe, sizeof(probe), 0, (struct sockaddr *)&bcast, sizeof(bcast));
+            probes++;
+            next_probe = t0 + (deadline - t0) * probes / PEER_PROBES;
+        }
+        int64_t wait = (probes < PEER_PROBES ? next_probe : deadline) - now;
+        if (wait < 1000) wait = 1000;   /* a zero timeout would block forever */
+        struct timeval tv = { .tv_sec = wait / 1000000, .tv_usec = wait % 1000000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        ota_peer_announce_t a;
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        int r = recvfrom(sock, &a, sizeof(a), 0, (struct sockaddr *)&from, &flen);
+        if (r != sizeof(a) || memcmp(a.magic, OTA_PEER_ANNOUNCE_MAGIC, 4) != 0) continue;
+        if (memcmp(a.sha256, sha256, sizeof(a.sha256)) != 0 || strncmp(a.version, version, sizeof(a.version)) != 0) {
+            continue;
+        }
+        if (a.free_slots > 0) {
+            add_peer(out, &n, max, from.sin_addr.s_addr, &a);
+        } else {
+            full++;     /* may count a peer twice (two probes): only zero/non-zero matters */
+        }
+    }
+    close(sock);
+
+    order_peers(out, n);
+    if (busy) *busy = full;
+    ESP_LOGI(TAG, "Discovery: %u peer(s) with free slots serving %s%s (%" PRId64 " ms)",
+             (unsigned)n, version, full ? ", others full" : "", (esp_timer_get_time() - t0) / 1000);
+    return n;
+#else
+    return 0;
+#endif
+}
+
+void ota_peer_url(const ota_peer_t *peer, char *buf, size_t len)
+{
+    const uint8_t *ip = (const uint8_t *)&peer->ip;    /* network order: a.b.c.d in memory */
+    snprintf(buf, len, "http://%u.%u.%u.%u:%u" OTA_PEER_PATH, ip[0], ip[1], ip[2], ip[3], peer->port);
+}
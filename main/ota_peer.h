@@ -0,0 +1,131 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_peer.h
+ * @brief LAN peer firmware distribution: serve the running image, fetch from neighbours
+ *
+ * When many devices of one site update, each of them would download the same
+ * image from the origin (CONFIG_FIRMWARE_UPGRADE_URL). With this module a device
+ * that runs a confirmed image can serve it to its neighbours, and a device about
+ * to update asks the LAN first:
+ *
+ * - Discovery: the updating device broadcasts an ota_peer_probe_t with the
+ *   SHA-256 announced by the version manifest (ota_check.h) on UDP port
+ *   CONFIG_OTA_PEER_DISCOVERY_PORT. Peers running that image answer with an
+ *   ota_peer_announce_t (HTTP port, version, length, free download slots).
+ * - Transfer: GET /firmware.bin on the peer, a read-only view of
+ *   esp_ota_get_running_partition() with single Range support, ETag and If-Range,
+ *   so resume and parallel ranged downloads work as with the origin.
+ * - Trust: the image is checked against the digest of the origin manifest, never
+ *   against anything the peer sends; any failure falls back to the origin.
+ * - Fan-out: a peer serves at most CONFIG_OTA_PEER_MAX_CLIENTS distinct clients
+ *   at a time (others get 503 + Retry-After) and announces its free slots;
+ *   clients try the least loaded peers first, in random order among equals, and
+ *   skip full ones. When every peer with the image is full the client waits and
+ *   asks again rather than joining the crowd at the origin.
+ *
+ * tools/ota_peer_sim.py speaks the same protocol: it simulates a site of devices
+ * on the host, or probes/serves a real LAN.
+ *
+ * The following functions are provided:
+ * - ota_peer_server_start(): Serve the running image to LAN peers (background task).
+ * - ota_peer_discover(): Find LAN peers serving a given image.
+ * - ota_peer_url(): Firmware URL of a discovered peer.
+ *
+ * @author Marconatale Parise
+ * @date 22 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_PEER_PROBE_MAGIC    "OPQ1"
+#define OTA_PEER_ANNOUNCE_MAGIC "OPA1"
+#define OTA_PEER_PATH           "/firmware.bin"
+#define OTA_PEER_MAX            8       /*!< Peers kept by one discovery */
+
+/**
+ * @brief Discovery request, broadcast by a device about to update
+ */
+typedef struct __attribute__((packed)) {
+    char    magic[4];               /*!< OTA_PEER_PROBE_MAGIC */
+    uint8_t sha256[32];             /*!< Wanted image (all zero: any) */
+} ota_peer_probe_t;
+
+/**
+ * @brief Discovery answer, sent back by a peer serving the wanted image (little endian)
+ */
+typedef struct __attribute__((packed)) {
+    char     magic[4];              /*!< OTA_PEER_ANNOUNCE_MAGIC */
+    uint16_t port;                  /*!< HTTP port of OTA_PEER_PATH */
+    uint8_t  free_slots;            /*!< Clients the peer can take now */
+    uint8_t  max_slots;             /*!< CONFIG_OTA_PEER_MAX_CLIENTS of the peer */
+    uint32_t image_len;             /*!< Served image length */
+    char     version[32];           /*!< App version (NUL padded) */
+    uint8_t  sha256[32];            /*!< SHA-256 of the served image */
+} ota_peer_announce_t;
+
+/**
+ * @brief A peer found by ota_peer_discover()
+ */
+typedef struct {
+    uint32_t ip;                    /*!< IPv4 address (network order) */
+    uint16_t port;                  /*!< HTTP port */
+    uint8_t  free_slots;            /*!< Free slots when it answered */
+    uint32_t image_len;             /*!< Image length */
+} ota_peer_t;
+
+/**
+ * @brief Serve the running image to LAN peers
+ *
+ * Hashes the running image and starts the HTTP server and the discovery
+ * responder on a low priority task. Call once the running image is confirmed
+ * (after ota_hal_mark_app_valid_if_needed()) and the network is up; later
+ * calls do nothing.
+ *
+ * @return ESP_OK if the server task runs, ESP_ERR_NOT_SUPPORTED if
+ *         CONFIG_OTA_PEER_SERVE is disabled
+ */
+esp_err_t ota_peer_server_start(void);
+
+/**
+ * @brief Find LAN peers serving an image (blocking, up to CONFIG_OTA_PEER_DISCOVER_MS)
+ *
+ * @param version   Expected app version
+ * @param sha256    Expected SHA-256 of the image (from the origin manifest)
+ * @param[out] out  Peers with free slots, least loaded first
+ * @param max       Capacity of out
+ * @param[out] busy Peers serving the image without a free slot (may be NULL)
+ *
+ * @return Number of peers with free slots
+ */
+size_t ota_peer_discover(const char *version, const uint8_t *sha256, ota_peer_t *out, size_t max, size_t *busy);
+
+/**
+ * @brief Firmware URL of a peer ("http://a.b.c.d:port/firmware.bin")
+ */
+void ota_peer_url(const ota_peer_t *peer, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,442 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_pipeline.c
+ * @brief Double-core OTA pipeline (download side -> ring of buffers -> flash writer)
+ *
+ * @author Marconatale Parise
+ * @date 02 Mar 2026
+ */
+#include "ota_pipeline.h"
+
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+#include "esp_timer.h"
+
+#include "ota_arena.h"
+#include "ota_stats.h"
+#include "ota_verify.h"
+#include "sys_mon.h"
+
+static const char *TAG = "ota_pipe";
+
+#define PIPE_BUF_COUNT  CONFIG_OTA_PIPELINE_BUF_COUNT
+#define PIPE_BUF_SIZE   CONFIG_OTA_PIPELINE_BUF_SIZE
+#define PIPE_SLOT_EOF   0xFF
+#define WRITER_STACK    4096
+#define WRITER_PRIO     5
+#define ERASER_STACK    3072
+#define ERASER_PRIO     (WRITER_PRIO - 1)   /* writes free ring slots first */
+#define ERASE_AHEAD     (CONFIG_OTA_PREERASE_AHEAD_KB * 1024)
+#define ERASE_WAIT_MS   100
+#define ERASE_STALL_MS  10000               /* no erase progress for this long fails the write */
+#define FLASH_SEC_SIZE  4096
+#define THR_BURST_US    100000              /* rate credit kept after a network stall */
+
+/* Ring storage is static so the session never depends on heap fragmentation */
+static uint8_t s_ring[PIPE_BUF_COUNT][PIPE_BUF_SIZE];
+static size_t  s_len[PIPE_BUF_COUNT];
+
+static QueueHandle_t s_free_q;      /* slot indexes ready to be filled */
+static QueueHandle_t s_filled_q;    /* slot indexes ready to be written */
+static TaskHandle_t  s_owner;       /* task waiting in finish/abort */
+static TaskHandle_t  s_writer;      /* cleared by the writer when it is done */
+static TaskHandle_t  s_eraser;
+static TaskHandle_t  s_eraser_owner; /* task waiting in eraser_stop() */
+/* Session memory: the tasks and queues are rebuilt in the same blocks on every attempt */
+static ota_arena_task_t  s_writer_task;
+static ota_arena_task_t  s_eraser_task;
+static ota_arena_block_t s_free_q_mem;
+static ota_arena_block_t s_filled_q_mem;
+
+static const esp_partition_t *s_part;
+static const ota_pipeline_filter_t *s_filter;
+static size_t s_image_len;
+static volatile size_t s_erased;    /* erase frontier (sector aligned) */
+static volatile size_t s_erase_end; /* never erase past this (image length, sector aligned) */
+static volatile size_t s_erase_need; /* end of the write waiting for erased sectors */
+static volatile esp_err_t s_erase_err;
+static volatile bool s_erase_stop;
+static volatile bool s_writer_waiting;
+static volatile esp_err_t s_err;
+static volatile size_t s_written;   /* write pointer inside the partition */
+static bool s_active;
+static bool s_finishing;            /* EOF comes from finish(), not abort() */
+
+/* Throttle (background updates) */
+static portMUX_TYPE s_thr_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_thr_rate;         /* payload B/s, 0: unlimited */
+static uint8_t s_thr_pct = 100;     /* flash duty cycle, 100: unlimited */
+static int64_t s_thr_t0;            /* rate clock */
+static uint64_t s_thr_bytes;        /* payload submitted since s_thr_t0 */
+static int64_t s_flash_next_us;     /* no flash operation starts before this */
+
+static size_t sector_align_up(size_t len)
+{
+    return (len + FLASH_SEC_SIZE - 1) & ~(size_t)(FLASH_SEC_SIZE - 1);
+}
+
+static void delay_us(int64_t us)
+{
+    TickType_t ticks = pdMS_TO_TICKS((us + 999) / 1000);
+    vTaskDelay(ticks ? ticks : 1);
+}
+
+/* Called by the writer and the eraser before a flash operation: one duty cycle for both */
+static void flash_pace_wait(void)
+{
+    if (s_thr_pct >= 100) return;
+    int64_t wait = s_flash_next_us - esp_timer_get_time();
+    if (wait > 0) delay_us(wait);
+}
+
+/* An operation that kept the flash busy from t0 to t1 buys (100 - pct) / pct of that idle */
+static void flash_pace_done(int64_t t0, int64_t t1)
+{
+    uint8_t pct = s_thr_pct;
+    if (pct >= 100) return;
+    int64_t next = t1 + (t1 - t0) * (100 - pct) / pct;
+    portENTER_CRITICAL(&s_thr_lock);
+    if (next > s_flash_next_us) s_flash_next_us = next;
+    portEXIT_CRITICAL(&s_thr_lock);
+}
+
+/* Producer side: hold the submitter back to the payload rate */
+static void rate_pace(size_t len)
+{
+    if (!s_thr_rate) return;
+    s_thr_bytes += len;
+    int64_t now = esp_timer_get_time();
+    int64_t due = s_thr_t0 + (int64_t)(s_thr_bytes * 1000000ULL / s_thr_rate);
+    if (now - due > THR_BURST_US) {
+        s_thr_t0 += now - due - THR_BURST_US;   /* stalled: drop the credit beyond the burst */
+    } else if (due > now) {
+        delay_us(due - now);
+    }
+}
+
+/* Keep the erase frontier up to ERASE_AHEAD bytes ahead of the write pointer, and past
+ * the end of a waiting write that is longer than the lookahead */
+static void eraser_task(void *pvParameters)
+{
+    sys_mon_watch_task(NULL, ERASER_STACK);
+    while (!s_erase_stop) {
+        size_t target = s_written + ERASE_AHEAD;
+        if (s_erase_need > target) target = s_erase_need;
+        if (target > s_erase_end) target = s_erase_end;
+        if (s_erased >= target || s_erase_err != ESP_OK) {
+            /* Woken by the writer after each write, or by eraser_stop() */
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        flash_pace_wait();
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = esp_partition_erase_range(s_part, s_erased, FLASH_SEC_SIZE);
+        int64_t t1 = esp_timer_get_time();
+        flash_pace_done(t0, t1);
+        ota_stats_add_flash(t1 - t0, 0, 0);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Erase failed at %u: %s", (unsigned)s_erased, esp_err_to_name(err));
+            s_erase_err = err;
+        } else {
+            s_erased += FLASH_SEC_SIZE;
+        }
+        if (s_writer_waiting && s_writer) xTaskNotifyGive(s_writer);
+    }
+    sys_mon_unwatch_task(NULL);
+    s_eraser = NULL;    /* before waking the owner: it may start a new eraser */
+    xTaskNotifyGive(s_eraser_owner);
+    ota_arena_task_exit();
+}
+
+static esp_err_t eraser_start(const esp_partition_t *part, size_t offset, size_t image_len)
+{
+    s_part = part;
+    s_written = offset;
+    s_erased = offset;
+    s_erase_need = 0;
+    s_erase_end = (image_len != OTA_SIZE_UNKNOWN) ? sector_align_up(image_len) : part->size;
+    s_erase_err = ESP_OK;
+    s_erase_stop = false;
+    s_writer_waiting = false;
+    esp_err_t err = ota_arena_task_create(&s_eraser_task, eraser_task, "Task OTA eraser", ERASER_STACK, NULL,
+                                          ERASER_PRIO, CONFIG_OTA_WRITER_CORE);
+    if (err == ESP_OK) s_eraser = s_eraser_task.handle;
+    return err;
+}
+
+static void eraser_stop(void)
+{
+    if (!s_eraser) return;
+    s_eraser_owner = xTaskGetCurrentTaskHandle();
+    s_erase_stop = true;
+    xTaskNotifyGive(s_eraser);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    ota_arena_task_join(&s_eraser_task);     /* its stack is reused by the next eraser */
+}
+
+/* Sectors are erased by the eraser task; only wait here if it fell behind */
+static esp_err_t flash_write(const uint8_t *data, size_t len)
+{
+    size_t end = s_written + len;
+    if (end > s_part->size) return ESP_ERR_INVALID_SIZE;
+    if (s_written == 0 && data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "Invalid image magic 0x%02x", data[0]);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    if (end > s_erase_end) s_erase_end = sector_align_up(end);  /* length grew (unknown/short) */
+    s_erase_need = end;     /* published before the wait: the eraser's target covers it */
+    flash_pace_wait();
+    int64_t t0 = esp_timer_get_time();
+    int64_t t_progress = t0;
+    size_t erased = s_erased;
+    while (s_erased < end) {
+        if (s_erase_err != ESP_OK) return s_erase_err;
+        int64_t now = esp_timer_get_time();
+        if (s_erased != erased) {
+            erased = s_erased;
+            t_progress = now;
+        } else if (now - t_progress > ERASE_STALL_MS * 1000LL) {
+            ESP_LOGE(TAG, "Eraser stalled at %u, write needs %u", (unsigned)erased, (unsigned)end);
+            return ESP_ERR_TIMEOUT;
+        }
+        s_writer_waiting = true;
+        if (s_erased < end) {   /* re-check: the eraser only notifies once the flag is set */
+            xTaskNotifyGive(s_eraser);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ERASE_WAIT_MS));
+        }
+        s_writer_waiting = false;
+    }
+    /* Hashed before writing: a block failing its signed digest never reaches flash */
+    esp_err_t err = ota_verify_update(data, len);
+    if (err != ESP_OK) return err;
+    int64_t t1 = esp_timer_get_time();
+    err = esp_partition_write(s_part, s_written, data, len);
+    int64_t t2 = esp_timer_get_time();
+    flash_pace_done(t1, t2);
+    if (err == ESP_OK) {
+        s_written = end;
+        xTaskNotifyGive(s_eraser);      /* room for the next sectors */
+    }
+    ota_stats_add_flash(0, t2 - t1, len);
+    ota_stats_add_erase_wait(t1 - t0);
+    return err;
+}
+
+static void writer_task(void *pvParameters)
+{
+    uint8_t idx;
+    sys_mon_watch_task(NULL, WRITER_STACK);
+    while (xQueueReceive(s_filled_q, &idx, portMAX_DELAY) == pdTRUE) {
+        if (idx == PIPE_SLOT_EOF) break;
+        if (s_err == ESP_OK && s_len[idx] > 0) {
+            esp_err_t err = s_filter ? s_filter->feed(s_ring[idx], s_len[idx], flash_write)
+                                     : flash_write(s_ring[idx], s_len[idx]);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Flash write failed at %u: %s", (unsigned)s_written, esp_err_to_name(err));
+                s_err = err;
+            }
+        }
+        /* Always recycle the slot so the producer never deadlocks on error */
+        xQueueSend(s_free_q, &idx, portMAX_DELAY);
+    }
+    if (s_err == ESP_OK && s_filter && s_filter->finish && s_finishing) {
+        s_err = s_filter->finish(flash_write);
+    }
+    sys_mon_unwatch_task(NULL);
+    s_writer = NULL;
+    xTaskNotifyGive(s_owner);
+    ota_arena_task_exit();
+}
+
+static void writer_join(void)
+{
+    if (!s_writer) return;
+    const uint8_t eof = PIPE_SLOT_EOF;
+    s_owner = xTaskGetCurrentTaskHandle();
+    xQueueSend(s_filled_q, &eof, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    ota_arena_task_join(&s_writer_task);
+}
+
+static void pipeline_release(void)
+{
+    if (s_free_q) vQueueDelete(s_free_q);
+    if (s_filled_q) vQueueDelete(s_filled_q);
+    s_free_q = NULL;
+    s_filled_q = NULL;
+    s_active = false;
+    eraser_stop();
+}
+
+esp_err_t ota_pipeline_prepare(const esp_partition_t *part, size_t image_len, size_t offset)
+{
+    if (!part || (offset % FLASH_SEC_SIZE) != 0 || offset >= part->size) return ESP_ERR_INVALID_ARG;
+    if (s_active) return ESP_ERR_INVALID_STATE;
+    eraser_stop();
+    return eraser_start(part, offset, image_len);
+}
+
+esp_err_t ota_pipeline_begin(const esp_partition_t *part, size_t image_len, size_t offset,
+                             const ota_pipeline_filter_t *filter)
+{
+    if (!part || (offset % FLASH_SEC_SIZE) != 0 || offset >= part->size) return ESP_ERR_INVALID_ARG;
+    if (s_active) return ESP_ERR_INVALID_STATE;
+    if (image_len != OTA_SIZE_UNKNOWN && image_len > part->size) return ESP_ERR_INVALID_SIZE;
+
+    /* Keep the eraser started by ota_pipeline_prepare() for the same offset */
+    esp_err_t err = ESP_OK;
+    if (!s_eraser || s_part != part || s_written != offset) {
+        eraser_stop();
+        err = eraser_start(part, offset, image_len);
+    } else if (image_len != OTA_SIZE_UNKNOWN) {
+        s_erase_end = sector_align_up(image_len);
+    }
+    if (err == ESP_OK) err = ota_verify_begin(part, offset);
+    if (err != ESP_OK) {
+        eraser_stop();
+        return err;
+    }
+
+    s_free_q = ota_arena_queue_create(&s_free_q_mem, PIPE_BUF_COUNT, sizeof(uint8_t));
+    s_filled_q = ota_arena_queue_create(&s_filled_q_mem, PIPE_BUF_COUNT + 1, sizeof(uint8_t));
+    if (!s_free_q || !s_filled_q) {
+        ota_verify_abort();
+        pipeline_release();
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint8_t i = 0; i < PIPE_BUF_COUNT; i++) {
+        xQueueSend(s_free_q, &i, 0);
+    }
+
+    s_filter = filter;
+    s_finishing = false;
+    s_image_len = image_len;
+    s_err = ESP_OK;
+    s_active = true;
+
+    err = ota_arena_task_create(&s_writer_task, writer_task, "Task OTA writer", WRITER_STACK, NULL,
+                                WRITER_PRIO, CONFIG_OTA_WRITER_CORE);
+    if (err != ESP_OK) {
+        ota_verify_abort();
+        pipeline_release();
+        return err;
+    }
+    s_writer = s_writer_task.handle;
+
+    ESP_LOGI(TAG, "Writing to partition %s at 0x%" PRIx32 "+0x%x (%d x %d B ring, writer on core %d, %u B pre-erased)",
+             part->label, part->address, (unsigned)offset, PIPE_BUF_COUNT, PIPE_BUF_SIZE, CONFIG_OTA_WRITER_CORE,
+             (unsigned)(s_erased - offset));
+    return ESP_OK;
+}
+
+uint8_t *ota_pipeline_acquire(size_t *cap)
+{
+    uint8_t idx;
+    if (!s_active || xQueueReceive(s_free_q, &idx, portMAX_DELAY) != pdTRUE) return NULL;
+    if (s_err != ESP_OK) {
+        xQueueSend(s_free_q, &idx, 0);
+        return NULL;
+    }
+    if (cap) *cap = PIPE_BUF_SIZE;
+    return s_ring[idx];
+}
+
+esp_err_t ota_pipeline_submit(uint8_t *buf, size_t len)
+{
+    if (!s_active || !buf || len > PIPE_BUF_SIZE) return ESP_ERR_INVALID_ARG;
+    uint8_t idx = (uint8_t)((buf - &s_ring[0][0]) / PIPE_BUF_SIZE);
+    if (idx >= PIPE_BUF_COUNT) return ESP_ERR_INVALID_ARG;
+
+    s_len[idx] = len;
+    xQueueSend(s_filled_q, &idx, portMAX_DELAY);
+    rate_pace(len);
+    return s_err;
+}
+
+esp_err_t ota_pipeline_finish(void)
+{
+    if (!s_active) return ESP_ERR_INVALID_STATE;
+    s_finishing = true;
+    writer_join();
+    sys_mon_set_phase(SYS_MON_PHASE_OTA_VERIFY);
+
+    esp_err_t err = s_err;
+    if (err == ESP_OK && s_image_len != OTA_SIZE_UNKNOWN && s_written != s_image_len) {
+        ESP_LOGE(TAG, "Image truncated: %u of %u bytes", (unsigned)s_written, (unsigned)s_image_len);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        ota_verify_abort();
+        pipeline_release();
+        return err;
+    }
+
+    /* Digest computed while writing, then the image is validated from flash */
+    int64_t t0 = esp_timer_get_time();
+    err = ota_verify_finish(s_part);
+    ota_stats_set_verify(esp_timer_get_time() - t0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Image finalize failed: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Image written (%u bytes), boot partition set to %s", (unsigned)s_written, s_part->label);
+    }
+    pipeline_release();
+    return err;
+}
+
+void ota_pipeline_abort(void)
+{
+    if (!s_active) {
+        eraser_stop();      /* prepared, never started */
+        return;
+    }
+    writer_join();
+    ota_verify_abort();
+    /* Written sectors are kept: a resumed download continues from them */
+    pipeline_release();
+}
+
+void ota_pipeline_set_image_len(size_t image_len)
+{
+    s_image_len = image_len;
+    if (image_len != OTA_SIZE_UNKNOWN) s_erase_end = sector_align_up(image_len);
+}
+
+void ota_pipeline_set_throttle(uint32_t rate_bps, uint8_t flash_pct)
+{
+    s_thr_t0 = esp_timer_get_time();
+    s_thr_bytes = 0;
+    s_thr_rate = rate_bps;
+    s_thr_pct = (flash_pct == 0 || flash_pct > 100) ? 100 : flash_pct;
+    if (rate_bps || s_thr_pct < 100) {
+        ESP_LOGI(TAG, "Throttle: %" PRIu32 " B/s, flash duty %u%%", rate_bps, s_thr_pct);
+    }
+}
+
+size_t ota_pipeline_written(void)
+{
+    return s_written;
+}
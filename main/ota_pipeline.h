@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_pipeline.h
+ * @brief Double-core OTA pipeline (download side -> ring of buffers -> flash writer)
+ *
+ * The download task (producer) fills buffers taken from a fixed ring and hands
+ * them to a writer task pinned on the other core (consumer), which writes them
+ * to the update partition. Network receive and flash erase/write overlap.
+ *
+ * Sectors are erased by an eraser task that stays up to
+ * CONFIG_OTA_PREERASE_AHEAD_KB ahead of the write pointer, never past the
+ * announced image length, instead of erasing the whole slot up front. A single
+ * write longer than the lookahead (large buffers, multi-sector filter output)
+ * extends the target to its end; a write whose sectors see no erase progress for
+ * 10 s fails with ESP_ERR_TIMEOUT. An
+ * interrupted download keeps the already written prefix and can continue from a
+ * sector aligned offset. ota_pipeline_prepare() starts erasing before the
+ * connection is open, so the first sectors are ready when data arrives.
+ *
+ * An optional filter (e.g. delta patch applier) can sit between the received
+ * payload and flash: the writer task feeds it the payload and the filter emits
+ * the image bytes to be written.
+ *
+ * The ring is static; the writer and eraser stacks and the queues are session
+ * memory from the OTA arena (ota_arena.h), no heap is taken per download.
+ *
+ * A background update (the application keeps running) can be throttled with
+ * ota_pipeline_set_throttle(): ota_pipeline_submit() paces the producer to a
+ * payload rate, so the TCP window closes and the receive/TLS work follows the
+ * cap, and the writer and eraser keep flash erase/write, which stall the cache
+ * of both cores, below a share of the time.
+ *
+ * The following functions are provided:
+ * - ota_pipeline_prepare(): Start pre-erasing while the connection is set up.
+ * - ota_pipeline_begin(): Open the update partition (optionally at a resume
+ *   offset) and start the writer task.
+ * - ota_pipeline_acquire(): Get a free buffer to fill (blocking).
+ * - ota_pipeline_submit(): Queue a filled buffer for the writer.
+ * - ota_pipeline_finish(): Drain the ring, close the image and set boot partition.
+ * - ota_pipeline_abort(): Stop the writer, keeping the written prefix for resume.
+ * - ota_pipeline_set_throttle(): Payload rate and flash duty cycle limits.
+ *
+ * @author Marconatale Parise
+ * @date 02 Mar 2026
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Callback used by a filter to write image bytes to the update partition
+ */
+typedef esp_err_t (*ota_pipeline_emit_t)(const uint8_t *data, size_t len);
+
+/**
+ * @brief Payload transformation run on the writer task
+ */
+typedef struct {
+    esp_err_t (*feed)(const uint8_t *data, size_t len, ota_pipeline_emit_t emit);  /*!< Consume payload bytes */
+    esp_err_t (*finish)(ota_pipeline_emit_t emit);                                 /*!< Flush at end of payload */
+} ota_pipeline_filter_t;
+
+/**
+ * @brief Start erasing the update partition before the download begins
+ *
+ * Optional: call before opening the connection. ota_pipeline_begin() with the
+ * same partition and offset keeps the erase progress; ota_pipeline_abort()
+ * stops the eraser if the session never starts.
+ *
+ * @param part      Update partition
+ * @param image_len Image length if already known (resume), otherwise OTA_SIZE_UNKNOWN
+ * @param offset    Sector aligned offset the download will continue from
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_pipeline_prepare(const esp_partition_t *part, size_t image_len, size_t offset);
+
+/**
+ * @brief Start a pipelined OTA session
+ *
+ * @param part      Update partition (usually esp_ota_get_next_update_partition())
+ * @param image_len Image length if known, otherwise OTA_SIZE_UNKNOWN
+ * @param offset    Flash offset to continue from (0 for a fresh download,
+ *                  otherwise a sector aligned resume checkpoint)
+ * @param filter    Payload filter, or NULL when the payload is the raw image
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_pipeline_begin(const esp_partition_t *part, size_t image_len, size_t offset,
+                             const ota_pipeline_filter_t *filter);
+
+/**
+ * @brief Take a free buffer from the ring (blocks until the writer releases one)
+ *
+ * @param[out] cap Capacity of the returned buffer
+ *
+ * @return Buffer to fill, or NULL if the writer already failed
+ */
+uint8_t *ota_pipeline_acquire(size_t *cap);
+
+/**
+ * @brief Hand a filled buffer to the writer task
+ *
+ * Only the last buffer of the image may be partially filled.
+ *
+ * @param buf Buffer returned by ota_pipeline_acquire()
+ * @param len Number of valid bytes in buf
+ *
+ * @return ESP_OK on success, or the writer error if it already failed
+ */
+esp_err_t ota_pipeline_submit(uint8_t *buf, size_t len);
+
+/**
+ * @brief Wait for pending writes, finalize the image and select it for boot
+ *
+ * @return ESP_OK if the new image is set as boot partition
+ */
+esp_err_t ota_pipeline_finish(void);
+
+/**
+ * @brief Stop the writer and eraser tasks (already written sectors are left in place)
+ */
+void ota_pipeline_abort(void);
+
+/**
+ * @brief Update the expected image length (for filters that learn it from the payload)
+ *
+ * @param image_len Final image length written to flash
+ */
+void ota_pipeline_set_image_len(size_t image_len);
+
+/**
+ * @brief Limit the payload rate and the flash duty cycle
+ *
+ * Applies from the next submitted buffer and flash operation, until changed.
+ * Credit left by a stalled network is capped, so the rate never bursts above
+ * the limit to catch up.
+ *
+ * @param rate_bps  Payload bytes per second accepted by ota_pipeline_submit(), 0: unlimited
+ * @param flash_pct Max share of time spent in flash erase/write (1-100), 100: unlimited
+ */
+void ota_pipeline_set_throttle(uint32_t rate_bps, uint8_t flash_pct);
+
+/**
+ * @brief Image offset written to flash so far (includes the resume offset)
+ */
+size_t ota_pipeline_written(void);
+
+#ifdef __cplusplus
+}
+#endif
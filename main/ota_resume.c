@@ -0,0 +1,93 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_resume.c
+ * @brief Persistent OTA download checkpoint (NVS) used to resume with HTTP Range
+ *
+ * @author Marconatale Parise
+ * @date 03 Mar 2026
+ */
+#include "ota_resume.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "ota_resume";
+
+#define RESUME_NVS_NS   "ota_resume"
+#define RESUME_NVS_KEY  "ckpt"
+#define RESUME_VERSION  1
+
+typedef struct {
+    uint32_t version;
+    ota_resume_state_t st;
+} resume_blob_t;
+
+esp_err_t ota_resume_load(ota_resume_state_t *st)
+{
+    if (!st) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(RESUME_NVS_NS, NVS_READONLY, &h);
+    if (err != ESP_OK) return ESP_ERR_NOT_FOUND;
+
+    resume_blob_t blob;
+    size_t len = sizeof(blob);
+    err = nvs_get_blob(h, RESUME_NVS_KEY, &blob, &len);
+    nvs_close(h);
+
+    if (err != ESP_OK || len != sizeof(blob) || blob.version != RESUME_VERSION) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    blob.st.validator[OTA_RESUME_VALIDATOR_LEN - 1] = '\0';
+    *st = blob.st;
+    return ESP_OK;
+}
+
+esp_err_t ota_resume_save(const ota_resume_state_t *st)
+{
+    if (!st) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(RESUME_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    resume_blob_t blob = { .version = RESUME_VERSION, .st = *st };
+    err = nvs_set_blob(h, RESUME_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Checkpoint save failed: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGD(TAG, "Checkpoint %" PRIu32 "/%" PRIu32, st->offset, st->image_len);
+    }
+    return err;
+}
+
+void ota_resume_clear(void)
+{
+    nvs_handle_t h;
+    if (nvs_open(RESUME_NVS_NS, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_erase_key(h, RESUME_NVS_KEY) == ESP_OK) {
+        nvs_commit(h);
+    }
+    nvs_close(h);
+}
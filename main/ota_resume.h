@@ -0,0 +1,80 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_resume.h
+ * @brief Persistent OTA download checkpoint (NVS) used to resume with HTTP Range
+ *
+ * A checkpoint records how much of the image is already written to the update
+ * partition, together with the image validator (ETag or Last-Modified), the
+ * image length and the target partition. After a disconnect or a reboot the
+ * download restarts from the checkpoint with "Range: bytes=<offset>-".
+ *
+ * The following functions are provided:
+ * - ota_resume_load(): Read the checkpoint from NVS.
+ * - ota_resume_save(): Store the checkpoint in NVS.
+ * - ota_resume_clear(): Drop the checkpoint (image completed or changed).
+ *
+ * @author Marconatale Parise
+ * @date 03 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_RESUME_VALIDATOR_LEN 64
+
+/**
+ * @brief OTA resume checkpoint
+ */
+typedef struct {
+    char     validator[OTA_RESUME_VALIDATOR_LEN]; /*!< ETag (preferred) or Last-Modified of the image */
+    uint32_t image_len;                           /*!< Full image length announced by the server */
+    uint32_t offset;                              /*!< Bytes already written to flash (sector aligned) */
+    uint32_t part_addr;                           /*!< Flash address of the target update partition */
+} ota_resume_state_t;
+
+/**
+ * @brief Load the checkpoint from NVS
+ *
+ * @param[out] st Checkpoint
+ *
+ * @return ESP_OK if a checkpoint exists, ESP_ERR_NOT_FOUND otherwise
+ */
+esp_err_t ota_resume_load(ota_resume_state_t *st);
+
+/**
+ * @brief Store the checkpoint in NVS
+ *
+ * @param st Checkpoint
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_resume_save(const ota_resume_state_t *st);
+
+/**
+ * @brief Remove the checkpoint from NVS
+ */
+void ota_resume_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,225 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_sign.c
+ * @brief Signed OTA image header, checked before the first flash write
+ *
+ * @author Marconatale Parise
+ * @date 21 Mar 2026
+ */
+#include "ota_sign.h"
+
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_app_desc.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+
+#include "ota_hal.h"
+#include "ota_verify.h"
+#include "ota_check.h"
+#include "ota_decomp.h"
+
+static const char *TAG = "ota_sign";
+
+#define SIGNED_LEN  offsetof(ota_sign_header_t, sig_len)    /* bytes covered by the signature */
+
+
+typedef enum {
+    SIGN_ST_DETECT = 0,     /* first payload bytes not seen yet */
+    SIGN_ST_HEADER,         /* collecting the header */
+    SIGN_ST_TABLE,          /* collecting the block digests */
+    SIGN_ST_LEAD,           /* gathering the first payload bytes for the inner filter */
+    SIGN_ST_PASS,           /* header verified, or unsigned image allowed */
+} sign_state_t;
+
+static struct {
+    sign_state_t state;
+    bool signed_image;
+    const ota_pipeline_filter_t *inner;
+    size_t have;            /* header/table bytes collected */
+    ota_sign_header_t hdr;
+    uint8_t lead[sizeof(ota_decomp_header_t)];  /* inner filters detect their header in one call */
+    uint8_t table[OTA_SIGN_MAX_BLOCKS][HASH_LEN];
+} s_sign;
+
+void ota_sign_reset(const ota_pipeline_filter_t *inner)
+{
+    s_sign.state = SIGN_ST_DETECT;
+    s_sign.signed_image = false;
+    s_sign.inner = inner;
+    s_sign.have = 0;
+}
+
+bool ota_sign_active(void)
+{
+    return s_sign.signed_image;
+}
+
+#if CONFIG_OTA_SIGN_ENABLE
+/* Release public key, embedded from CONFIG_OTA_SIGN_PUBKEY_FILE (NUL terminated) */
+extern const uint8_t ota_sign_pub_pem_start[] asm("_binary_ota_sign_pub_pem_start");
+extern const uint8_t ota_sign_pub_pem_end[]   asm("_binary_ota_sign_pub_pem_end");
+
+static esp_err_t check_signature(const ota_sign_header_t *hdr)
+{
+    uint8_t hash[HASH_LEN];
+    mbedtls_sha256((const unsigned char *)hdr, SIGNED_LEN, hash, 0);
+
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+    int ret = mbedtls_pk_parse_public_key(&pk, ota_sign_pub_pem_start,
+                                          ota_sign_pub_pem_end - ota_sign_pub_pem_start);
+    if (ret == 0) {
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, hash, sizeof(hash), hdr->signature, hdr->sig_len);
+    } else {
+        ESP_LOGE(TAG, "Bad public key (-0x%04x)", (unsigned)-ret);
+    }
+    mbedtls_pk_free(&pk);
+    return ret == 0 ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+#else
+static esp_err_t check_signature(const ota_sign_header_t *hdr)
+{
+    return ESP_ERR_NOT_SUPPORTED;   /* no key built in */
+}
+#endif
+
+/* Everything but the block table: target, version, length, signature */
+static esp_err_t check_header(const ota_sign_header_t *hdr)
+{
+    if (hdr->header_ver != OTA_SIGN_HEADER_VER) {
+        ESP_LOGE(TAG, "Unsupported header version %u", hdr->header_ver);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (hdr->sig_len == 0 || hdr->sig_len > OTA_SIGN_SIG_MAX) {
+        ESP_LOGE(TAG, "Bad signature length %u", hdr->sig_len);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    /* The signature first: the other fields mean nothing until it holds */
+    if (check_signature(hdr) != ESP_OK) {
+        ESP_LOGE(TAG, "Signature check failed, image rejected before writing");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (hdr->chip_id != CONFIG_IDF_FIRMWARE_CHIP_ID) {
+        ESP_LOGE(TAG, "Image built for chip id %u, this is %d", hdr->chip_id, CONFIG_IDF_FIRMWARE_CHIP_ID);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    size_t block = (size_t)1 << hdr->block_sz2;
+    if (hdr->block_sz2 < 12 || hdr->block_sz2 > 24 || hdr->image_len == 0 ||
+        hdr->block_count != (hdr->image_len + block - 1) / block || hdr->block_count > OTA_SIGN_MAX_BLOCKS) {
+        ESP_LOGE(TAG, "Bad block layout: %" PRIu32 " B in %u blocks of 2^%u (max %d blocks)",
+                 hdr->image_len, hdr->block_count, hdr->block_sz2, OTA_SIGN_MAX_BLOCKS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    char version[sizeof(hdr->version) + 1];
+    memcpy(version, hdr->version, sizeof(hdr->version));
+    version[sizeof(hdr->version)] = '\0';
+#if CONFIG_OTA_SIGN_ANTI_DOWNGRADE
+    const char *running = esp_app_get_description()->version;
+    if (ota_check_version_cmp(version, running) < 0) {
+        ESP_LOGE(TAG, "Image version %s is older than the running %s", version, running);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+#endif
+    ota_pipeline_set_image_len(hdr->image_len);
+    ESP_LOGI(TAG, "Signed image %s: %" PRIu32 " B, %u blocks of %u KB, header verified before writing",
+             version, hdr->image_len, hdr->block_count, (unsigned)(block / 1024));
+    return ESP_OK;
+}
+
+/* Collect header/table bytes into dst; returns true once want bytes are there */
+static bool collect(void *dst, size_t want, const uint8_t **data, size_t *len)
+{
+    size_t n = want - s_sign.have < *len ? want - s_sign.have : *len;
+    memcpy((uint8_t *)dst + s_sign.have, *data, n);
+    s_sign.have += n;
+    *data += n;
+    *len -= n;
+    return s_sign.have == want;
+}
+
+static esp_err_t sign_feed(const uint8_t *data, size_t len, ota_pipeline_emit_t emit)
+{
+    esp_err_t err = ESP_OK;
+    if (s_sign.state == SIGN_ST_DETECT) {
+        if (len >= 4 && memcmp(data, OTA_SIGN_MAGIC, 4) == 0) {
+            s_sign.state = SIGN_ST_HEADER;
+        } else {
+#if CONFIG_OTA_SIGN_REQUIRED
+            ESP_LOGE(TAG, "Unsigned image rejected before writing");
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+#else
+            ESP_LOGW(TAG, "Unsigned image");
+            s_sign.state = SIGN_ST_PASS;
+#endif
+        }
+    }
+    if (s_sign.state == SIGN_ST_HEADER) {
+        if (!collect(&s_sign.hdr, sizeof(s_sign.hdr), &data, &len)) return ESP_OK;
+        err = check_header(&s_sign.hdr);
+        if (err != ESP_OK) return err;
+        s_sign.have = 0;
+        s_sign.state = SIGN_ST_TABLE;
+    }
+    if (s_sign.state == SIGN_ST_TABLE) {
+        if (!collect(s_sign.table, (size_t)s_sign.hdr.block_count * HASH_LEN, &data, &len)) return ESP_OK;
+        uint8_t hash[HASH_LEN];
+        mbedtls_sha256(&s_sign.table[0][0], (size_t)s_sign.hdr.block_count * HASH_LEN, hash, 0);
+        if (memcmp(hash, s_sign.hdr.blocks_sha256, HASH_LEN) != 0) {
+            ESP_LOGE(TAG, "Block table does not match the signed header");
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        /* The signed digests take over from any digest sent in the response headers */
+        ota_verify_set_expected(s_sign.hdr.image_sha256);
+        ota_verify_set_blocks(&s_sign.table[0][0], s_sign.hdr.block_count, s_sign.hdr.block_sz2, s_sign.hdr.image_len);
+        s_sign.signed_image = true;
+        s_sign.have = 0;
+        s_sign.state = s_sign.inner ? SIGN_ST_LEAD : SIGN_ST_PASS;
+    }
+    if (s_sign.state == SIGN_ST_LEAD) {
+        /* The payload may start a few bytes before the end of a buffer */
+        if (!collect(s_sign.lead, sizeof(s_sign.lead), &data, &len)) return ESP_OK;
+        s_sign.state = SIGN_ST_PASS;
+        err = s_sign.inner->feed(s_sign.lead, sizeof(s_sign.lead), emit);
+        if (err != ESP_OK) return err;
+    }
+    if (len == 0) return ESP_OK;
+    return s_sign.inner ? s_sign.inner->feed(data, len, emit) : emit(data, len);
+}
+
+static esp_err_t sign_finish(ota_pipeline_emit_t emit)
+{
+    if (s_sign.state == SIGN_ST_LEAD && s_sign.have > 0) {
+        s_sign.state = SIGN_ST_PASS;
+        esp_err_t err = s_sign.inner->feed(s_sign.lead, s_sign.have, emit);
+        if (err != ESP_OK) return err;
+    }
+    if (s_sign.state != SIGN_ST_PASS) {
+        ESP_LOGE(TAG, "Payload ended inside the signed header");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return s_sign.inner && s_sign.inner->finish ? s_sign.inner->finish(emit) : ESP_OK;
+}
+
+const ota_pipeline_filter_t ota_sign_filter = {
+    .feed = sign_feed,
+    .finish = sign_finish,
+};
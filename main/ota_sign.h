@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_sign.h
+ * @brief Signed OTA image header, checked before the first flash write
+ *
+ * A signed image is the payload (raw or compressed image) prefixed with an
+ * ota_sign_header_t and a table of per-block SHA-256 digests of the raw image
+ * (tools/ota_sign.py). The header carries the chip target, version and length of
+ * the image, the digest of the whole image, the digest of the block table and an
+ * ECDSA P-256 signature over all of it, made with the release key whose public
+ * half is built into the firmware (CONFIG_OTA_SIGN_PUBKEY_FILE).
+ *
+ * The header is verified on the writer task before anything reaches flash: a
+ * wrong target, a downgrade, a bad signature or an unsigned image (with
+ * CONFIG_OTA_SIGN_REQUIRED) is rejected within the first kilobytes. Each block
+ * of the raw image is then hashed while it is written and compared with the
+ * signed table (ota_verify), so a tampered block stops the writer at that block
+ * instead of at the end of the image. The signed image digest replaces any
+ * digest sent in response headers.
+ *
+ * Signed downloads are not checkpointed: the header is needed again to resume.
+ *
+ * The following functions are provided:
+ * - ota_sign_reset(): Prepare for a new download, chaining an inner filter.
+ * - ota_sign_filter: Pipeline filter that checks and strips the header.
+ * - ota_sign_active(): Whether the current download carries a verified header.
+ *
+ * @author Marconatale Parise
+ * @date 21 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ota_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_SIGN_MAGIC       "OSG1"
+#define OTA_SIGN_HEADER_VER  1
+#define OTA_SIGN_SIG_MAX     72      /* DER encoded ECDSA P-256 signature */
+#define OTA_SIGN_MAX_BLOCKS  128     /* block digest table kept in RAM (4 KB) */
+
+/**
+ * @brief Signed image header (little endian), followed by block_count SHA-256 digests
+ */
+typedef struct __attribute__((packed)) {
+    char     magic[4];               /*!< OTA_SIGN_MAGIC */
+    uint8_t  header_ver;             /*!< OTA_SIGN_HEADER_VER */
+    uint8_t  block_sz2;              /*!< log2 of the block size */
+    uint16_t chip_id;                /*!< esp_chip_id_t of the target */
+    uint32_t image_len;              /*!< Raw image length */
+    uint16_t block_count;            /*!< Entries of the block digest table */
+    uint16_t reserved;
+    char     version[32];            /*!< App version of the image (NUL padded) */
+    uint8_t  image_sha256[32];       /*!< SHA-256 of the raw image */
+    uint8_t  blocks_sha256[32];      /*!< SHA-256 of the block digest table */
+    uint8_t  sig_len;                /*!< Length of signature */
+    uint8_t  signature[OTA_SIGN_SIG_MAX]; /*!< ECDSA P-256 over SHA-256 of the bytes before sig_len */
+} ota_sign_header_t;
+
+/**
+ * @brief Prepare for a new download
+ *
+ * @param inner Filter fed with the payload after the header (NULL: write it as is)
+ */
+void ota_sign_reset(const ota_pipeline_filter_t *inner);
+
+/**
+ * @brief Whether the current download started with a verified signed header
+ */
+bool ota_sign_active(void);
+
+/**
+ * @brief Pipeline filter: verifies and strips the signed header, then feeds the inner filter
+ */
+extern const ota_pipeline_filter_t ota_sign_filter;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,346 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_stats.c
+ * @brief Per-phase OTA timing and throughput instrumentation
+ *
+ * @author Marconatale Parise
+ * @date 09 Mar 2026
+ */
+#include "ota_stats.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "sys_mon.h"
+
+static const char *TAG = "ota_stats";
+
+#define STATS_NVS_NS        "ota_stats"
+#define STATS_NVS_KEY       "hist"
+#define STATS_HISTORY_VER   2       /* bump when ota_hal_stats_t changes: old history is dropped */
+#define STATS_HISTORY_LEN   CONFIG_OTA_STATS_HISTORY_LEN
+#define STATS_WINDOW_US     (250 * 1000)    /* throughput sample window */
+#define PROBE_TIMEOUT_MS    5000
+#define HOST_LEN            128
+#define RX_COPIES_TLS       3   /* lwIP pbuf -> TLS record -> client buffer -> pipeline buffer */
+#define RX_COPIES_TCP       2   /* lwIP pbuf -> client buffer -> pipeline buffer */
+
+typedef struct {
+    uint32_t version;
+    uint32_t count;
+    uint32_t head;                              /* index of the newest entry */
+    ota_hal_stats_t entry[STATS_HISTORY_LEN];
+} stats_history_t;
+
+static ota_hal_stats_t s_cur;
+static ota_hal_stats_t s_last;     /* snapshot of the last session, read by the application */
+static stats_history_t s_hist;     /* NVS history scratch of the OTA task, too large for its stack */
+static portMUX_TYPE s_last_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE s_conn_lock = portMUX_INITIALIZER_UNLOCKED;    /* counters shared with range workers */
+static bool s_have_last;
+static bool s_probed;
+static bool s_tls;
+static bool s_first_conn_done;
+static bool s_first_header;
+static int64_t s_session_t0;
+static int64_t s_win_t0;
+static uint32_t s_win_bytes;
+
+static void hist_add(uint32_t kbps)
+{
+    int b = 0;
+    uint32_t edge = 16;
+    while (b < OTA_STATS_HIST_BUCKETS - 1 && kbps >= edge) {
+        edge <<= 1;
+        b++;
+    }
+    if (s_cur.hist[b] < UINT16_MAX) s_cur.hist[b]++;
+}
+
+static bool url_host_port(const char *url, char *host, size_t len, int *port, bool *tls)
+{
+    const char *p = strstr(url, "://");
+    if (!p) return false;
+    *tls = (strncmp(url, "https", 5) == 0);
+    p += 3;
+    size_t n = strcspn(p, ":/?");
+    if (n == 0 || n >= len) return false;
+    memcpy(host, p, n);
+    host[n] = '\0';
+    *port = (p[n] == ':') ? atoi(&p[n + 1]) : (*tls ? 443 : 80);
+    return *port > 0;
+}
+
+#if CONFIG_OTA_STATS_TCP_PROBE
+static int64_t tcp_probe(const struct addrinfo *ai)
+{
+    int s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (s < 0) return 0;
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+
+    int64_t t0 = esp_timer_get_time();
+    int64_t us = 0;
+    if (connect(s, ai->ai_addr, ai->ai_addrlen) == 0) {
+        us = esp_timer_get_time() - t0;
+    } else if (errno == EINPROGRESS) {
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(s, &wfds);
+        struct timeval tv = { .tv_sec = PROBE_TIMEOUT_MS / 1000, .tv_usec = 0 };
+        int so_err = -1;
+        socklen_t so_len = sizeof(so_err);
+        if (select(s + 1, NULL, &wfds, NULL, &tv) > 0 &&
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &so_err, &so_len) == 0 && so_err == 0) {
+            us = esp_timer_get_time() - t0;
+        }
+    }
+    close(s);
+    return us;
+}
+#endif
+
+void ota_stats_session_begin(void)
+{
+    memset(&s_cur, 0, sizeof(s_cur));
+    s_probed = false;
+    s_tls = false;
+    s_first_conn_done = false;
+    s_first_header = false;
+    s_session_t0 = esp_timer_get_time();
+    s_win_t0 = 0;
+    s_win_bytes = 0;
+}
+
+void ota_stats_probe(const char *url)
+{
+    if (s_probed || !url) return;
+    s_probed = true;
+
+    char host[HOST_LEN];
+    char port_str[12];
+    int port;
+    bool tls;
+    if (!url_host_port(url, host, sizeof(host), &port, &tls)) return;
+    s_tls = tls;
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    int64_t t0 = esp_timer_get_time();
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || !res) {
+        ESP_LOGW(TAG, "DNS lookup of %s failed", host);
+        return;
+    }
+    s_cur.dns_us = esp_timer_get_time() - t0;
+#if CONFIG_OTA_STATS_TCP_PROBE
+    s_cur.tcp_connect_us = tcp_probe(res);
+#endif
+    freeaddrinfo(res);
+}
+
+void ota_stats_connect_begin(ota_stats_conn_t *conn)
+{
+    if (conn) conn->connect_t0 = esp_timer_get_time();
+}
+
+void ota_stats_on_connected(ota_stats_conn_t *conn)
+{
+    if (!conn) return;
+    int64_t connect_us = conn->connect_t0 ? esp_timer_get_time() - conn->connect_t0 : 0;
+    conn->connect_t0 = 0;
+    conn->fresh = true;
+
+    /* Range workers connect at the same time: only the first connection is timed */
+    portENTER_CRITICAL(&s_conn_lock);
+    s_cur.connections++;
+    bool first = !s_first_conn_done && connect_us > 0;
+    if (first) s_first_conn_done = true;
+    portEXIT_CRITICAL(&s_conn_lock);
+    if (!first) return;
+
+    /* The client resolves again (lwIP DNS cache hit) and opens its own TCP session */
+    if (!s_tls) {
+        s_cur.tcp_connect_us = connect_us;
+        return;
+    }
+    int64_t tls_us = connect_us - s_cur.tcp_connect_us;
+    s_cur.tls_handshake_us = tls_us > 0 ? tls_us : 0;
+}
+
+void ota_stats_on_request_sent(ota_stats_conn_t *conn)
+{
+    if (!conn) return;
+    conn->request_t0 = esp_timer_get_time();
+    if (conn->fresh) {
+        conn->fresh = false;
+        return;
+    }
+    portENTER_CRITICAL(&s_conn_lock);
+    s_cur.reused++;
+    portEXIT_CRITICAL(&s_conn_lock);
+}
+
+void ota_stats_on_header(ota_stats_conn_t *conn)
+{
+    if (!conn || s_first_header || conn->request_t0 == 0) return;
+    s_first_header = true;
+    s_cur.ttfb_us = esp_timer_get_time() - conn->request_t0;
+}
+
+void ota_stats_add_rx(size_t bytes)
+{
+    int64_t now = esp_timer_get_time();
+    s_cur.bytes_received += bytes;
+    s_cur.bytes_copied += bytes * (s_tls ? RX_COPIES_TLS : RX_COPIES_TCP);
+    if (s_win_t0 == 0) s_win_t0 = now;
+    s_win_bytes += bytes;
+
+    int64_t dt = now - s_win_t0;
+    if (dt >= STATS_WINDOW_US) {
+        /* bytes/us * 1e6 / 1024 = KB/s */
+        hist_add((uint32_t)(((uint64_t)s_win_bytes * 1000000ULL) / ((uint64_t)dt * 1024ULL)));
+        s_win_t0 = now;
+        s_win_bytes = 0;
+    }
+}
+
+uint32_t ota_stats_rx_bytes(void)
+{
+    return s_cur.bytes_received;
+}
+
+void ota_stats_add_copy(size_t bytes)
+{
+    s_cur.bytes_copied += bytes;
+}
+
+void ota_stats_add_flash(int64_t erase_us, int64_t write_us, size_t bytes)
+{
+    /* Erase and write are reported by different tasks: only touch the fields given */
+    if (erase_us) s_cur.flash_erase_us += erase_us;
+    if (write_us) s_cur.flash_write_us += write_us;
+    if (bytes) s_cur.bytes_written += bytes;
+}
+
+void ota_stats_add_erase_wait(int64_t us)
+{
+    s_cur.erase_wait_us += us;
+}
+
+void ota_stats_set_verify(int64_t us)
+{
+    s_cur.verify_us = us;
+}
+
+static void history_store(const ota_hal_stats_t *st)
+{
+    nvs_handle_t h;
+    if (nvs_open(STATS_NVS_NS, NVS_READWRITE, &h) != ESP_OK) return;
+
+    size_t len = sizeof(s_hist);
+    if (nvs_get_blob(h, STATS_NVS_KEY, &s_hist, &len) != ESP_OK || len != sizeof(s_hist) ||
+        s_hist.version != STATS_HISTORY_VER) {
+        memset(&s_hist, 0, sizeof(s_hist));
+        s_hist.version = STATS_HISTORY_VER;
+    }
+    s_hist.head = (s_hist.count == 0) ? 0 : (s_hist.head + 1) % STATS_HISTORY_LEN;
+    s_hist.entry[s_hist.head] = *st;
+    if (s_hist.count < STATS_HISTORY_LEN) s_hist.count++;
+
+    if (nvs_set_blob(h, STATS_NVS_KEY, &s_hist, sizeof(s_hist)) == ESP_OK) {
+        nvs_commit(h);
+    }
+    nvs_close(h);
+}
+
+void ota_stats_session_end(esp_err_t result)
+{
+    s_cur.total_us = esp_timer_get_time() - s_session_t0;
+    s_cur.result = result;
+    portENTER_CRITICAL(&s_last_lock);
+    s_last = s_cur;
+    s_have_last = true;
+    portEXIT_CRITICAL(&s_last_lock);
+
+    double secs = s_cur.total_us / 1e6;
+    ESP_LOGI(TAG, "OTA %s: %" PRIu32 " B rx, %" PRIu32 " B flash in %.2f s (%.1f KB/s), conn=%u reused=%u",
+             result == ESP_OK ? "ok" : esp_err_to_name(result), s_cur.bytes_received, s_cur.bytes_written,
+             secs, secs > 0 ? s_cur.bytes_received / 1024.0 / secs : 0.0, s_cur.connections, s_cur.reused);
+    ESP_LOGI(TAG, "  dns=%" PRId64 " tcp=%" PRId64 " tls=%" PRId64 " ttfb=%" PRId64 " ms | erase=%" PRId64
+             " (wait %" PRId64 ") write=%" PRId64 " verify=%" PRId64 " ms",
+             s_cur.dns_us / 1000, s_cur.tcp_connect_us / 1000, s_cur.tls_handshake_us / 1000, s_cur.ttfb_us / 1000,
+             s_cur.flash_erase_us / 1000, s_cur.erase_wait_us / 1000, s_cur.flash_write_us / 1000,
+             s_cur.verify_us / 1000);
+    ESP_LOGI(TAG, "  copies: %" PRIu32 " B (%.2f per image byte)", s_cur.bytes_copied,
+             s_cur.bytes_written ? (double)s_cur.bytes_copied / s_cur.bytes_written : 0.0);
+    ESP_LOGI(TAG, "  KB/s hist <16:%u <32:%u <64:%u <128:%u <256:%u <512:%u <1024:%u >=1024:%u",
+             s_cur.hist[0], s_cur.hist[1], s_cur.hist[2], s_cur.hist[3],
+             s_cur.hist[4], s_cur.hist[5], s_cur.hist[6], s_cur.hist[7]);
+
+    sys_mon_log_phases();
+    history_store(&s_cur);
+}
+
+esp_err_t ota_hal_get_stats(ota_hal_stats_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    /* s_cur belongs to the running session: hand out the snapshot taken at its end */
+    portENTER_CRITICAL(&s_last_lock);
+    bool have = s_have_last;
+    if (have) *out = s_last;
+    portEXIT_CRITICAL(&s_last_lock);
+    return have ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+size_t ota_hal_get_stats_history(ota_hal_stats_t *out, size_t max)
+{
+    if (!out || max == 0) return 0;
+
+    /* Own buffer: s_hist is the OTA task's scratch and may be mid-update. Each NVS blob
+     * read/write is atomic, so this sees either the old or the new ring, never a mix. */
+    stats_history_t *hist = malloc(sizeof(*hist));
+    if (!hist) return 0;
+
+    size_t n = 0;
+    nvs_handle_t h;
+    if (nvs_open(STATS_NVS_NS, NVS_READONLY, &h) == ESP_OK) {
+        size_t len = sizeof(*hist);
+        esp_err_t err = nvs_get_blob(h, STATS_NVS_KEY, hist, &len);
+        nvs_close(h);
+        if (err == ESP_OK && len == sizeof(*hist) && hist->version == STATS_HISTORY_VER) {
+            n = hist->count < max ? hist->count : max;
+            for (size_t i = 0; i < n; i++) {
+                out[i] = hist->entry[(hist->head + STATS_HISTORY_LEN - i) % STATS_HISTORY_LEN];
+            }
+        }
+    }
+    free(hist);
+    return n;
+}
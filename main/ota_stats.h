@@ -0,0 +1,166 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_stats.h
+ * @brief Per-phase OTA timing and throughput instrumentation
+ *
+ * Every OTA session (one ota_hal_start() call) fills an ota_hal_stats_t with
+ * network, TLS and flash timings. The last session is available through
+ * ota_hal_get_stats(); the last CONFIG_OTA_STATS_HISTORY_LEN sessions are kept
+ * in NVS and can be read back with ota_hal_get_stats_history().
+ *
+ * Connection timings are measured on the first connection opened in a session
+ * (the main one, or the first range worker's when the main connection was kept
+ * from an earlier session):
+ * - dns_us: name resolution (getaddrinfo)
+ * - tcp_connect_us: HTTP client connect time on http; on https a bare TCP
+ *   connect probe to the resolved address (CONFIG_OTA_STATS_TCP_PROBE, off by
+ *   default: an extra connection per session), 0 without it
+ * - tls_handshake_us: HTTP client connect time minus the TCP connect (https only,
+ *   includes the TCP connect without the probe)
+ * - ttfb_us: request sent -> first response header
+ *
+ * Requests sent on a connection kept open from an earlier request (or an earlier
+ * session, see CONFIG_OTA_CONN_REUSE) are counted in reused. They skip the TCP
+ * connect and TLS handshake entirely; there is no TLS session resumption, so
+ * every new connection is a full handshake. Each HTTP client carries its own
+ * ota_stats_conn_t as user_data, so the range workers of a parallel download
+ * are counted like the main connection without racing on its timestamps.
+ *
+ * bytes_copied counts CPU copies of payload bytes between the socket and flash.
+ * Every received byte costs the HTTP client hops (lwIP -> TLS record -> client
+ * buffer -> pipeline buffer, one less on plain http); filters add the bytes
+ * they stage. The summary reports it per image byte written.
+ *
+ * The following functions are provided to the application:
+ * - ota_hal_get_stats(): Stats of the last session.
+ * - ota_hal_get_stats_history(): Stats of the last sessions stored in NVS.
+ * Both are safe to call from any task while a session is running; they never
+ * return the session in progress.
+ *
+ * The remaining functions are the recording hooks used by the OTA HAL.
+ *
+ * @author Marconatale Parise
+ * @date 09 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_STATS_HIST_BUCKETS 8    /*!< <16, <32, <64, <128, <256, <512, <1024, >=1024 KB/s */
+
+/**
+ * @brief OTA session statistics (all times in microseconds)
+ */
+typedef struct {
+    int64_t  dns_us;             /*!< DNS resolution */
+    int64_t  tcp_connect_us;     /*!< TCP connect */
+    int64_t  tls_handshake_us;   /*!< TLS handshake */
+    int64_t  ttfb_us;            /*!< Request sent -> first response header */
+    int64_t  flash_erase_us;     /*!< Time spent erasing the update partition */
+    int64_t  flash_write_us;     /*!< Time spent writing the update partition */
+    int64_t  erase_wait_us;      /*!< Time the writer waited for the background eraser */
+    int64_t  verify_us;          /*!< Image validation before the boot switch */
+    int64_t  total_us;           /*!< Wall time of the whole session */
+    uint32_t bytes_received;     /*!< Payload bytes received (all attempts) */
+    uint32_t bytes_written;      /*!< Image bytes written to flash */
+    uint32_t bytes_copied;       /*!< Payload bytes copied by the CPU on the way to flash */
+    uint16_t connections;        /*!< HTTP connections opened (full TLS handshakes on https) */
+    uint16_t reused;             /*!< Requests sent on an already open connection */
+    uint16_t hist[OTA_STATS_HIST_BUCKETS]; /*!< Throughput histogram (count of sample windows) */
+    int32_t  result;             /*!< esp_err_t of the session */
+} ota_hal_stats_t;
+
+/**
+ * @brief Get the statistics of the last OTA session
+ *
+ * @param[out] out Statistics
+ *
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if no session ran since boot
+ */
+esp_err_t ota_hal_get_stats(ota_hal_stats_t *out);
+
+/**
+ * @brief Read the stored statistics of the last sessions (newest first)
+ *
+ * @param[out] out Array of at least max entries
+ * @param max      Capacity of out
+ *
+ * @return Number of entries copied
+ */
+size_t ota_hal_get_stats_history(ota_hal_stats_t *out, size_t max);
+
+/* ---- Recording hooks (OTA HAL internal) ---- */
+
+/**
+ * @brief Recording state of one HTTP connection (user_data of its client)
+ */
+typedef struct {
+    int64_t connect_t0;     /*!< Connect started, 0 when no connect is pending */
+    int64_t request_t0;     /*!< Last request sent */
+    bool    fresh;          /*!< HTTP_EVENT_ON_CONNECTED seen since the last request */
+} ota_stats_conn_t;
+
+/** @brief Start a new session */
+void ota_stats_session_begin(void);
+
+/** @brief Resolve and probe the server of url (DNS + TCP timing) once per session */
+void ota_stats_probe(const char *url);
+
+/** @brief An HTTP connection is about to be opened (conn may be NULL: not recorded) */
+void ota_stats_connect_begin(ota_stats_conn_t *conn);
+
+/** @brief HTTP client connected, new connection (HTTP_EVENT_ON_CONNECTED) */
+void ota_stats_on_connected(ota_stats_conn_t *conn);
+
+/** @brief Request headers sent (HTTP_EVENT_HEADER_SENT), on a new or reused connection */
+void ota_stats_on_request_sent(ota_stats_conn_t *conn);
+
+/** @brief Response header received (HTTP_EVENT_ON_HEADER), main connection only */
+void ota_stats_on_header(ota_stats_conn_t *conn);
+
+/** @brief Payload bytes received (feeds the throughput histogram) */
+void ota_stats_add_rx(size_t bytes);
+
+/** @brief Payload bytes received so far in this session */
+uint32_t ota_stats_rx_bytes(void);
+
+/** @brief Payload bytes copied by a filter (staging, decode window) */
+void ota_stats_add_copy(size_t bytes);
+
+/** @brief Flash erase/write time spent by the writer */
+void ota_stats_add_flash(int64_t erase_us, int64_t write_us, size_t bytes);
+
+/** @brief Time the writer was blocked waiting for erased sectors */
+void ota_stats_add_erase_wait(int64_t us);
+
+/** @brief Image validation time */
+void ota_stats_set_verify(int64_t us);
+
+/** @brief Close the session: log a summary and store it in NVS */
+void ota_stats_session_end(esp_err_t result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_verify.c
+ * @brief Streaming SHA-256 of the OTA image and boot switch-over
+ *
+ * @author Marconatale Parise
+ * @date 11 Mar 2026
+ */
+#include "ota_verify.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/base64.h"
+
+#include "ota_hal.h"
+
+static const char *TAG = "ota_verify";
+
+#define VERIFY_READ_CHUNK   1024
+
+static mbedtls_sha256_context s_sha;
+static uint8_t s_expected[HASH_LEN];
+static bool s_have_expected;
+static bool s_hashing;
+
+/* Per-block digests of a signed image */
+static struct {
+    const uint8_t *table;
+    uint16_t count;
+    uint16_t next;          /* block being hashed */
+    uint32_t block_len;
+    uint32_t image_len;
+    uint32_t pos;           /* image bytes hashed */
+    mbedtls_sha256_context sha;
+} s_blk;
+
+void ota_verify_reset(void)
+{
+    s_have_expected = false;
+}
+
+void ota_verify_set_expected(const uint8_t *sha256)
+{
+    if (!sha256) return;
+    memcpy(s_expected, sha256, HASH_LEN);
+    s_have_expected = true;
+}
+
+static bool parse_hex(const char *hex, uint8_t *out)
+{
+    for (int i = 0; i < HASH_LEN; i++) {
+        if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1])) return false;
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        out[i] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    return hex[2 * HASH_LEN] == '\0' || isspace((unsigned char)hex[2 * HASH_LEN]);
+}
+
+void ota_verify_set_blocks(const uint8_t *table, uint16_t count, uint8_t block_sz2, uint32_t image_len)
+{
+    if (s_blk.table) mbedtls_sha256_free(&s_blk.sha);
+    s_blk.table = table;
+    s_blk.count = count;
+    s_blk.next = 0;
+    s_blk.block_len = 1u << block_sz2;
+    s_blk.image_len = image_len;
+    s_blk.pos = 0;
+    mbedtls_sha256_init(&s_blk.sha);
+    mbedtls_sha256_starts(&s_blk.sha, 0);
+}
+
+bool ota_verify_parse_header(const char *key, const char *value)
+{
+    if (!key || !value) return false;
+    uint8_t sha[HASH_LEN];
+
+    if (strcasecmp(key, "X-Image-SHA256") == 0) {
+        while (isspace((unsigned char)*value) || *value == '"') value++;
+        if (strlen(value) < 2 * HASH_LEN || !parse_hex(value, sha)) {
+            ESP_LOGW(TAG, "Malformed X-Image-SHA256 header");
+            return true;
+        }
+    } else if (strcasecmp(key, "Digest") == 0) {
+        /* "SHA-256=<base64>[,<other algorithm>=...]" */
+        const char *p = value;
+        while (*p && strncasecmp(p, "sha-256=", 8) != 0) p++;
+        if (!*p) return true;
+        p += 8;
+        size_t b64_len = strcspn(p, ", ");
+        size_t olen = 0;
+        uint8_t buf[HASH_LEN + 2];
+        if (mbedtls_base64_decode(buf, sizeof(buf), &olen, (const unsigned char *)p, b64_len) != 0 ||
+            olen != HASH_LEN) {
+            ESP_LOGW(TAG, "Malformed Digest header");
+            return true;
+        }
+        memcpy(sha, buf, HASH_LEN);
+    } else {
+        return false;
+    }
+    ota_verify_set_expected(sha);
+    return true;
+}
+
+esp_err_t ota_verify_begin(const esp_partition_t *part, size_t offset)
+{
+    ota_verify_abort();
+    mbedtls_sha256_init(&s_sha);
+    mbedtls_sha256_starts(&s_sha, 0);
+    s_hashing = true;
+
+    /* Resumed download: the prefix was written by an earlier session */
+    uint8_t buf[VERIFY_READ_CHUNK];
+    for (size_t pos = 0; pos < offset; pos += VERIFY_READ_CHUNK) {
+        size_t n = offset - pos < VERIFY_READ_CHUNK ? offset - pos : VERIFY_READ_CHUNK;
+        esp_err_t err = esp_partition_read(part, pos, buf, n);
+        if (err != ESP_OK) {
+            ota_verify_abort();
+            return err;
+        }
+        mbedtls_sha256_update(&s_sha, buf, n);
+    }
+    return ESP_OK;
+}
+
+void ota_verify_abort(void)
+{
+    /* Releases the SHA engine if the context held it */
+    if (s_hashing) mbedtls_sha256_free(&s_sha);
+    s_hashing = false;
+    if (s_blk.table) mbedtls_sha256_free(&s_blk.sha);
+    s_blk.table = NULL;
+}
+
+static esp_err_t blocks_update(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        if (s_blk.next >= s_blk.count) {
+            ESP_LOGE(TAG, "Data past the signed image length (%" PRIu32 " B)", s_blk.image_len);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint32_t block_end = (s_blk.next + 1) * s_blk.block_len;
+        if (block_end > s_blk.image_len) block_end = s_blk.image_len;
+        size_t n = block_end - s_blk.pos < len ? block_end - s_blk.pos : len;
+        mbedtls_sha256_update(&s_blk.sha, data, n);
+        s_blk.pos += n;
+        data += n;
+        len -= n;
+        if (s_blk.pos < block_end) break;
+
+        uint8_t sha[HASH_LEN];
+        mbedtls_sha256_finish(&s_blk.sha, sha);
+        if (memcmp(sha, s_blk.table + (size_t)s_blk.next * HASH_LEN, HASH_LEN) != 0) {
+            ESP_LOGE(TAG, "Block %u/%u does not match the signed digest, stopping at %" PRIu32 " B",
+                     s_blk.next + 1, s_blk.count, s_blk.pos);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        s_blk.next++;
+        mbedtls_sha256_starts(&s_blk.sha, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_verify_update(const uint8_t *data, size_t len)
+{
+    if (s_hashing) mbedtls_sha256_update(&s_sha, data, len);
+    return s_blk.table ? blocks_update(data, len) : ESP_OK;
+}
+
+esp_err_t ota_verify_finish(const esp_partition_t *part)
+{
+    if (!s_hashing) return ESP_ERR_INVALID_STATE;
+    uint8_t sha[HASH_LEN];
+    mbedtls_sha256_finish(&s_sha, sha);
+    bool blocks_missing = s_blk.table && s_blk.next < s_blk.count;
+    ota_verify_abort();
+
+    if (blocks_missing) {
+        ESP_LOGE(TAG, "Image shorter than the signed length, update rejected");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (!s_have_expected) {
+        ESP_LOGW(TAG, "No image digest from server, validating from flash only");
+    } else if (memcmp(sha, s_expected, HASH_LEN) != 0) {
+        ESP_LOGE(TAG, "Image SHA-256 mismatch, update rejected");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    } else {
+        ESP_LOGI(TAG, "Image SHA-256 verified while streaming");
+    }
+    /* The server digest only proves the transfer: esp_image_verify() inside still checks
+     * the header, segments, checksum, signature and secure version before the switch */
+    return esp_ota_set_boot_partition(part);
+}
@@ -0,0 +1,136 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_verify.h
+ * @brief Streaming SHA-256 of the OTA image and boot switch-over
+ *
+ * The pipeline writer hashes every byte it writes to the update partition, so
+ * the digest of the new image is known as soon as the last chunk reaches flash.
+ * The expected digest comes from the server:
+ * - "X-Image-SHA256: <64 hex digits>" response header, or
+ * - "Digest: SHA-256=<base64>" response header (RFC 3230), or
+ * - the target_sha256 field of a delta patch header.
+ * It always refers to the raw (uncompressed, patched) image.
+ *
+ * A mismatch rejects the update before the boot slot is touched. A match only
+ * proves the transfer: the slot is always switched with
+ * esp_ota_set_boot_partition(), whose esp_image_verify() pass checks the image
+ * header, segments, checksum, signature and secure version from flash. The
+ * bootloader checks the image again on the next boot.
+ *
+ * Signed images (ota_sign) also carry a digest per block: each block is checked
+ * as soon as its last byte arrives, before that byte is written, and a mismatch
+ * fails the writer at once.
+ *
+ * The following functions are provided:
+ * - ota_verify_reset(): Forget the expected digest (new request).
+ * - ota_verify_set_expected(): Expected image digest.
+ * - ota_verify_set_blocks(): Expected per-block digests (signed images).
+ * - ota_verify_parse_header(): Take the expected digest from a response header.
+ * - ota_verify_begin() / ota_verify_update(): Streaming hash (writer task).
+ * - ota_verify_finish(): Compare digests and select the image for boot.
+ * - ota_verify_abort(): Drop the streaming hash (download aborted).
+ *
+ * @author Marconatale Parise
+ * @date 11 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Forget the expected digest (call before each request)
+ */
+void ota_verify_reset(void);
+
+/**
+ * @brief Set the expected SHA-256 of the image being written
+ *
+ * @param sha256 32 byte digest
+ */
+void ota_verify_set_expected(const uint8_t *sha256);
+
+/**
+ * @brief Set the expected SHA-256 of every block of the image being written
+ *
+ * Call after ota_verify_begin(), before the first image byte is hashed. The table
+ * must stay valid until ota_verify_finish() or ota_verify_abort().
+ *
+ * @param table     count digests of 32 bytes, back to back
+ * @param count     Number of blocks
+ * @param block_sz2 log2 of the block size (the last block may be shorter)
+ * @param image_len Image length
+ */
+void ota_verify_set_blocks(const uint8_t *table, uint16_t count, uint8_t block_sz2, uint32_t image_len);
+
+/**
+ * @brief Take the expected digest from a response header, if it carries one
+ *
+ * @param key   Header name
+ * @param value Header value
+ *
+ * @return true if the header was a digest header
+ */
+bool ota_verify_parse_header(const char *key, const char *value);
+
+/**
+ * @brief Start hashing a new image
+ *
+ * On a resumed download the prefix already in flash is hashed here.
+ *
+ * @param part   Update partition
+ * @param offset Bytes already written
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ota_verify_begin(const esp_partition_t *part, size_t offset);
+
+/**
+ * @brief Hash image bytes about to be written to flash
+ *
+ * @return ESP_OK, or ESP_ERR_OTA_VALIDATE_FAILED if they complete a block whose
+ *         digest does not match the expected one
+ */
+esp_err_t ota_verify_update(const uint8_t *data, size_t len);
+
+/**
+ * @brief Check the digest and select the image for the next boot
+ *
+ * @param part Update partition holding the complete image
+ *
+ * @return ESP_OK if the image is set as boot partition,
+ *         ESP_ERR_OTA_VALIDATE_FAILED on digest mismatch or an invalid image,
+ *         ESP_ERR_INVALID_SIZE if expected blocks were never written
+ */
+esp_err_t ota_verify_finish(const esp_partition_t *part);
+
+/**
+ * @brief Drop the streaming hash of an aborted download
+ */
+void ota_verify_abort(void);
+
+#ifdef __cplusplus
+}
+#endif
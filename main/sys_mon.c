@@ -0,0 +1,412 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sys_mon.c
+ * @brief Runtime stack, heap and CPU high-water monitor
+ *
+ * @author Marconatale Parise
+ * @date 23 Mar 2026
+ */
+#include "sys_mon.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+
+static const char *TAG = "sys_mon";
+
+#if CONFIG_SYS_MON_ENABLE
+
+#define MON_TASK_STACK  3072
+#define MON_TASK_PRIO   6                   /* above the OTA writer: samples the download too */
+#define MON_SAMPLE_MS   CONFIG_SYS_MON_SAMPLE_MS
+#define MON_LOG_US      ((int64_t)CONFIG_SYS_MON_LOG_PERIOD_S * 1000000)
+#define MON_HEAP_CAPS   MALLOC_CAP_8BIT
+#define MON_LINE_LEN    384
+#define MON_NAME_SKIP   "Task "             /* common prefix dropped from the log lines */
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define MON_CPU         1                   /* run time counters: CPU shares */
+#else
+#define MON_CPU         0                   /* no counters: CPU figures left out */
+#endif
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#define MON_LOCAL_MIN   1                   /* exact minimum free heap per phase */
+#else
+#define MON_LOCAL_MIN   0
+#endif
+
+typedef struct {
+    TaskHandle_t handle;        /* NULL: unwatched, record kept */
+    uint32_t     cpu_last;      /* run time counter at the last sample */
+    uint32_t     cpu_win;       /* run time since the last periodic sample */
+} mon_task_t;
+
+static const char *const s_phase_name[SYS_MON_PHASE_MAX] = {
+    [SYS_MON_PHASE_RUN]          = "run",
+    [SYS_MON_PHASE_OTA_CHECK]    = "check",
+    [SYS_MON_PHASE_OTA_CONNECT]  = "connect",
+    [SYS_MON_PHASE_OTA_DOWNLOAD] = "download",
+    [SYS_MON_PHASE_OTA_VERIFY]   = "verify",
+};
+
+static SemaphoreHandle_t s_lock;
+static sys_mon_report_t s_rep;      /* live state, copied out by sys_mon_get_report() */
+static mon_task_t s_task[SYS_MON_MAX_TASKS];
+static sys_mon_phase_t s_phase;
+static int64_t s_phase_t0;
+static int64_t s_win_t0;            /* start of the CPU share window */
+static uint32_t s_idle_last;
+static char s_line[MON_LINE_LEN];   /* log line scratch, used under s_lock */
+
+static const char *short_name(const char *name)
+{
+    size_t n = strlen(MON_NAME_SKIP);
+    return strncmp(name, MON_NAME_SKIP, n) == 0 ? name + n : name;
+}
+
+/* Run time counter of a task, in run time counter ticks (us with esp_timer) */
+static uint32_t run_time(TaskHandle_t task)
+{
+#if MON_CPU
+    return (uint32_t)ulTaskGetRunTimeCounter(task);
+#else
+    return 0;
+#endif
+}
+
+static uint32_t idle_time(void)
+{
+    uint32_t idle = 0;
+#if MON_CPU
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+        idle += (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+#endif
+    return idle;
+}
+
+static void sample_task(size_t i)
+{
+    sys_mon_task_stats_t *t = &s_rep.tasks[i];
+    uint32_t free = uxTaskGetStackHighWaterMark(s_task[i].handle);
+    if (free < t->stack_free_min) t->stack_free_min = free;
+    if (free < t->phase_free_min[s_phase]) t->phase_free_min[s_phase] = free;
+
+    uint32_t cpu = run_time(s_task[i].handle);
+    uint32_t d = cpu - s_task[i].cpu_last;
+    s_task[i].cpu_last = cpu;
+    s_task[i].cpu_win += d;
+    t->cpu_us += d;
+    t->phase_cpu_us[s_phase] += d;
+}
+
+static void sample_heap(void)
+{
+    uint32_t free = heap_caps_get_free_size(MON_HEAP_CAPS);
+    uint32_t block = heap_caps_get_largest_free_block(MON_HEAP_CAPS);
+#if MON_LOCAL_MIN
+    uint32_t low = heap_caps_get_minimum_free_size(MON_HEAP_CAPS);  /* since the phase began */
+#else
+    uint32_t low = free;
+#endif
+    sys_mon_phase_stats_t *ph = &s_rep.phases[s_phase];
+    if (low < ph->heap_min) ph->heap_min = low;
+    if (block < ph->block_min) ph->block_min = block;
+    if (low < s_rep.heap_min) s_rep.heap_min = low;
+    s_rep.heap_free = free;
+    s_rep.block_largest = block;
+}
+
+/* Fold a sample into the current phase; CPU shares are computed on the periodic ones only */
+static void sample_all(bool periodic)
+{
+    sample_heap();
+    for (size_t i = 0; i < s_rep.task_count; i++) {
+        if (s_task[i].handle) sample_task(i);
+    }
+    if (!periodic || !MON_CPU) return;
+
+    int64_t now = esp_timer_get_time();
+    uint32_t window = (uint32_t)(now - s_win_t0);
+    s_win_t0 = now;
+    if (window == 0) return;
+    for (size_t i = 0; i < s_rep.task_count; i++) {
+        uint64_t pct = (uint64_t)s_task[i].cpu_win * 100 / window;
+        s_rep.tasks[i].cpu_pct = pct > 100 ? 100 : (uint8_t)pct;
+        s_task[i].cpu_win = 0;
+    }
+    uint32_t idle = idle_time();
+    uint64_t idle_pct = (uint64_t)(idle - s_idle_last) * 100 / ((uint64_t)window * portNUM_PROCESSORS);
+    s_idle_last = idle;
+    s_rep.cpu_load_pct = idle_pct > 100 ? 0 : (uint8_t)(100 - idle_pct);
+}
+
+static void mon_task(void *pvParameters)
+{
+    TickType_t last = xTaskGetTickCount();
+    int64_t last_log = esp_timer_get_time();
+    while (true) {
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(MON_SAMPLE_MS));
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        sample_all(true);
+        xSemaphoreGive(s_lock);
+        int64_t now = esp_timer_get_time();
+        if (MON_LOG_US > 0 && now - last_log >= MON_LOG_US) {
+            last_log = now;
+            sys_mon_log();
+        }
+    }
+}
+
+static void watch_system_task(const char *name, uint32_t stack_size)
+{
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task) sys_mon_watch_task(task, stack_size);
+}
+
+esp_err_t sys_mon_init(void)
+{
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    for (int p = 0; p < SYS_MON_PHASE_MAX; p++) {
+        s_rep.phases[p].heap_min = UINT32_MAX;
+        s_rep.phases[p].block_min = UINT32_MAX;
+    }
+    s_rep.heap_min = heap_caps_get_minimum_free_size(MON_HEAP_CAPS);   /* boot so far */
+    s_phase = SYS_MON_PHASE_RUN;
+    s_rep.phase = s_phase;
+    s_rep.cpu_valid = MON_CPU;
+    s_rep.phases[s_phase].entries = 1;
+    s_phase_t0 = esp_timer_get_time();
+    s_win_t0 = s_phase_t0;
+    s_idle_last = idle_time();
+#if MON_LOCAL_MIN
+    heap_caps_monitor_local_minimum_free_size_start();
+#endif
+
+#ifdef CONFIG_LWIP_TCPIP_TASK_STACK_SIZE
+    watch_system_task("tiT", CONFIG_LWIP_TCPIP_TASK_STACK_SIZE);
+#endif
+#ifdef CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE
+    watch_system_task("sys_evt", CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE);
+#endif
+#ifdef CONFIG_ESP_TIMER_TASK_STACK_SIZE
+    watch_system_task("esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE);
+#endif
+
+    TaskHandle_t task;
+    if (xTaskCreatePinnedToCore(mon_task, "Task Monitor", MON_TASK_STACK, NULL, MON_TASK_PRIO, &task,
+                                tskNO_AFFINITY) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    sys_mon_watch_task(task, MON_TASK_STACK);
+    ESP_LOGI(TAG, "Sampling every %d ms, log every %d s", MON_SAMPLE_MS, CONFIG_SYS_MON_LOG_PERIOD_S);
+    return ESP_OK;
+}
+
+esp_err_t sys_mon_watch_task(TaskHandle_t task, uint32_t stack_size)
+{
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    const char *name = pcTaskGetName(task);
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t slot = s_rep.task_count;
+    for (size_t i = 0; i < s_rep.task_count; i++) {
+        if (s_task[i].handle == task) {
+            xSemaphoreGive(s_lock);
+            return ESP_OK;
+        }
+        /* A task started again under the same name continues its record */
+        if (!s_task[i].handle && slot == s_rep.task_count &&
+            strncmp(s_rep.tasks[i].name, name, SYS_MON_NAME_LEN - 1) == 0) {
+            slot = i;
+        }
+    }
+    if (slot == s_rep.task_count) {
+        if (slot == SYS_MON_MAX_TASKS) {
+            err = ESP_ERR_NO_MEM;
+        } else {
+            sys_mon_task_stats_t *t = &s_rep.tasks[slot];
+            memset(t, 0, sizeof(*t));
+            strlcpy(t->name, name, sizeof(t->name));
+            t->stack_free_min = UINT32_MAX;
+            for (int p = 0; p < SYS_MON_PHASE_MAX; p++) t->phase_free_min[p] = UINT32_MAX;
+            s_rep.task_count++;
+        }
+    }
+    if (err == ESP_OK) {
+        s_task[slot].handle = task;
+        s_task[slot].cpu_last = run_time(task);
+        s_task[slot].cpu_win = 0;
+        s_rep.tasks[slot].stack_size = stack_size;
+        s_rep.tasks[slot].alive = true;
+        sample_task(slot);
+    }
+    xSemaphoreGive(s_lock);
+    if (err != ESP_OK) ESP_LOGW(TAG, "No room to watch %s (raise SYS_MON_MAX_TASKS)", name);
+    return err;
+}
+
+void sys_mon_unwatch_task(TaskHandle_t task)
+{
+    if (!s_lock) return;
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_rep.task_count; i++) {
+        if (s_task[i].handle != task) continue;
+        sample_task(i);
+        s_task[i].handle = NULL;
+        s_rep.tasks[i].alive = false;
+        s_rep.tasks[i].cpu_pct = 0;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void sys_mon_set_phase(sys_mon_phase_t phase)
+{
+    if (!s_lock || phase >= SYS_MON_PHASE_MAX) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (phase != s_phase) {
+        /* Close the old phase with a last sample, so a short one is never missed */
+        sample_all(false);
+        int64_t now = esp_timer_get_time();
+        s_rep.phases[s_phase].time_us += now - s_phase_t0;
+        s_phase = phase;
+        s_phase_t0 = now;
+        s_rep.phase = phase;
+        s_rep.phases[phase].entries++;
+#if MON_LOCAL_MIN
+        heap_caps_monitor_local_minimum_free_size_stop();
+        heap_caps_monitor_local_minimum_free_size_start();
+#endif
+        sample_heap();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+sys_mon_phase_t sys_mon_get_phase(void)
+{
+    return s_phase;
+}
+
+esp_err_t sys_mon_get_report(sys_mon_report_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_rep;
+    out->phases[s_phase].time_us += esp_timer_get_time() - s_phase_t0;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+void sys_mon_log(void)
+{
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = snprintf(s_line, sizeof(s_line), "%s heap %" PRIu32 " min %" PRIu32 " blk %" PRIu32,
+                     s_phase_name[s_phase], s_rep.heap_free, s_rep.heap_min, s_rep.block_largest);
+    if (MON_CPU && n > 0 && n < (int)sizeof(s_line)) {
+        n += snprintf(s_line + n, sizeof(s_line) - n, " cpu %u%%", s_rep.cpu_load_pct);
+    }
+    if (n > 0 && n < (int)sizeof(s_line)) n += snprintf(s_line + n, sizeof(s_line) - n, " |");
+    /* Stack: peak use / size, then the CPU share of the last window */
+    for (size_t i = 0; i < s_rep.task_count && n > 0 && n < (int)sizeof(s_line); i++) {
+        const sys_mon_task_stats_t *t = &s_rep.tasks[i];
+        if (!t->alive) continue;
+        n += snprintf(s_line + n, sizeof(s_line) - n, " %s %" PRIu32 "/%" PRIu32, short_name(t->name),
+                      t->stack_size - t->stack_free_min, t->stack_size);
+        if (MON_CPU && n > 0 && n < (int)sizeof(s_line)) {
+            n += snprintf(s_line + n, sizeof(s_line) - n, " %u%%", t->cpu_pct);
+        }
+    }
+    ESP_LOGI(TAG, "%s", s_line);
+    xSemaphoreGive(s_lock);
+}
+
+void sys_mon_log_phases(void)
+{
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int p = 0; p < SYS_MON_PHASE_MAX; p++) {
+        const sys_mon_phase_stats_t *ph = &s_rep.phases[p];
+        if (ph->heap_min == UINT32_MAX) continue;
+        int64_t time_us = ph->time_us + ((sys_mon_phase_t)p == s_phase ? esp_timer_get_time() - s_phase_t0 : 0);
+        int n = snprintf(s_line, sizeof(s_line), "%-8s %7" PRId64 " ms heap min %" PRIu32 " blk min %" PRIu32
+                         " | stack peak", s_phase_name[p], time_us / 1000, ph->heap_min, ph->block_min);
+        for (size_t i = 0; i < s_rep.task_count && n > 0 && n < (int)sizeof(s_line); i++) {
+            const sys_mon_task_stats_t *t = &s_rep.tasks[i];
+            if (t->phase_free_min[p] == UINT32_MAX) continue;
+            n += snprintf(s_line + n, sizeof(s_line) - n, " %s %" PRIu32, short_name(t->name),
+                          t->stack_size - t->phase_free_min[p]);
+        }
+        ESP_LOGI(TAG, "%s", s_line);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+#else /* !CONFIG_SYS_MON_ENABLE */
+
+esp_err_t sys_mon_init(void)
+{
+    ESP_LOGD(TAG, "Disabled");
+    return ESP_OK;
+}
+
+esp_err_t sys_mon_watch_task(TaskHandle_t task, uint32_t stack_size)
+{
+    return ESP_OK;
+}
+
+void sys_mon_unwatch_task(TaskHandle_t task)
+{
+}
+
+void sys_mon_set_phase(sys_mon_phase_t phase)
+{
+}
+
+sys_mon_phase_t sys_mon_get_phase(void)
+{
+    return SYS_MON_PHASE_RUN;
+}
+
+esp_err_t sys_mon_get_report(sys_mon_report_t *out)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void sys_mon_log(void)
+{
+}
+
+void sys_mon_log_phases(void)
+{
+}
+
+#endif
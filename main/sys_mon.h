@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sys_mon.h
+ * @brief Runtime stack, heap and CPU high-water monitor
+ *
+ * A monitor task samples, every CONFIG_SYS_MON_SAMPLE_MS:
+ * - the stack high-water mark (uxTaskGetStackHighWaterMark) of the watched tasks
+ * - free heap and the largest free block (fragmentation) of 8-bit capable RAM
+ * - the run time of every watched task (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+ *
+ * Without run time stats the CPU fields stay 0 and cpu_valid is false; the log
+ * line leaves them out instead of reporting a 100% load. sdkconfig.defaults
+ * turns the run time stats on.
+ *
+ * Samples are folded into the current phase. The application moves the
+ * monitor through the OTA phases (check, connect, download, verify), so the
+ * peaks of a TLS handshake or of a download can be told apart from normal
+ * operation. Phase boundaries take a sample too, short phases are never
+ * missed. With ESP-IDF 5.3 or newer the per-phase minimum free heap is exact
+ * (heap_caps_monitor_local_minimum_free_size_start()); older versions report
+ * the lowest sampled value.
+ *
+ * Tasks are watched by handle with the stack size they were created with, so
+ * the report shows peak use against the allocation. A task that deletes
+ * itself calls sys_mon_unwatch_task() first: its last sample is kept, and a
+ * task started again under the same name continues the same record.
+ *
+ * A high-water mark never rises again: a phase reports a lower value than the
+ * phases before it only when it used more stack itself.
+ *
+ * The monitor task runs above the OTA tasks so it keeps sampling during a
+ * download; one sample takes a few hundred microseconds.
+ *
+ * Stack sizes and high-water marks are in bytes (ESP-IDF stack unit).
+ *
+ * The following functions are provided:
+ * - sys_mon_init(): Start the monitor task and watch the system tasks.
+ * - sys_mon_watch_task(): Watch a task.
+ * - sys_mon_unwatch_task(): Take a last sample and stop watching a task.
+ * - sys_mon_set_phase(): Enter a phase.
+ * - sys_mon_get_phase(): Current phase.
+ * - sys_mon_get_report(): Copy the collected peaks.
+ * - sys_mon_log(): Log the compact status line.
+ * - sys_mon_log_phases(): Log the peaks of every phase.
+ *
+ * Without CONFIG_SYS_MON_ENABLE the functions do nothing.
+ *
+ * @author Marconatale Parise
+ * @date 23 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_SYS_MON_MAX_TASKS
+#define SYS_MON_MAX_TASKS CONFIG_SYS_MON_MAX_TASKS
+#else
+#define SYS_MON_MAX_TASKS 1
+#endif
+#define SYS_MON_NAME_LEN  16
+
+/**
+ * @brief Monitor phases
+ */
+typedef enum {
+    SYS_MON_PHASE_RUN = 0,          /*!< Normal operation */
+    SYS_MON_PHASE_OTA_CHECK,        /*!< Update check */
+    SYS_MON_PHASE_OTA_CONNECT,      /*!< OTA connection set up (TLS handshake) */
+    SYS_MON_PHASE_OTA_DOWNLOAD,     /*!< Image transfer and flash writes */
+    SYS_MON_PHASE_OTA_VERIFY,       /*!< Image validation and boot switch */
+    SYS_MON_PHASE_MAX
+} sys_mon_phase_t;
+
+/**
+ * @brief Heap peaks and time of one phase
+ */
+typedef struct {
+    uint32_t heap_min;          /*!< Lowest free heap, bytes (UINT32_MAX: phase never entered) */
+    uint32_t block_min;         /*!< Lowest largest free block, bytes */
+    int64_t  time_us;           /*!< Time spent in the phase */
+    uint32_t entries;           /*!< Times the phase was entered */
+} sys_mon_phase_stats_t;
+
+/**
+ * @brief Peaks of one watched task
+ */
+typedef struct {
+    char     name[SYS_MON_NAME_LEN];
+    uint32_t stack_size;                            /*!< Stack allocated at creation, bytes */
+    uint32_t stack_free_min;                        /*!< High-water mark: least free stack seen, bytes */
+    uint32_t phase_free_min[SYS_MON_PHASE_MAX];     /*!< High-water mark seen in each phase (UINT32_MAX: none) */
+    uint64_t cpu_us;                                /*!< Run time while watched (0 without cpu_valid) */
+    uint32_t phase_cpu_us[SYS_MON_PHASE_MAX];       /*!< Run time in each phase */
+    uint8_t  cpu_pct;                               /*!< Share of one core over the last sample window */
+    bool     alive;                                 /*!< Still running and watched */
+} sys_mon_task_stats_t;
+
+/**
+ * @brief Monitor report
+ */
+typedef struct {
+    sys_mon_phase_t       phase;                        /*!< Current phase */
+    uint32_t              heap_free;                    /*!< Free heap at the last sample */
+    uint32_t              heap_min;                     /*!< Lowest free heap since boot */
+    uint32_t              block_largest;                /*!< Largest free block at the last sample */
+    uint8_t               cpu_load_pct;                 /*!< Load of all cores over the last window (non idle) */
+    bool                  cpu_valid;                    /*!< CPU fields measured (run time stats enabled) */
+    sys_mon_phase_stats_t phases[SYS_MON_PHASE_MAX];
+    size_t                task_count;
+    sys_mon_task_stats_t  tasks[SYS_MON_MAX_TASKS];
+} sys_mon_report_t;
+
+/**
+ * @brief Start the monitor task
+ *
+ * Watches the lwIP, event loop and esp_timer tasks as well: call it once the
+ * network stack is initialized, before the application tasks are created.
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t sys_mon_init(void);
+
+/**
+ * @brief Watch a task
+ *
+ * @param task       Task handle (NULL: calling task)
+ * @param stack_size Stack size given at creation, bytes
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM when CONFIG_SYS_MON_MAX_TASKS records are in use
+ */
+esp_err_t sys_mon_watch_task(TaskHandle_t task, uint32_t stack_size);
+
+/**
+ * @brief Take a last sample of a task and stop watching it
+ *
+ * Must be called before the task is deleted.
+ *
+ * @param task Task handle (NULL: calling task)
+ */
+void sys_mon_unwatch_task(TaskHandle_t task);
+
+/**
+ * @brief Enter a phase (samples once at the boundary)
+ *
+ * @param phase Phase
+ */
+void sys_mon_set_phase(sys_mon_phase_t phase);
+
+/**
+ * @brief Current phase
+ */
+sys_mon_phase_t sys_mon_get_phase(void);
+
+/**
+ * @brief Copy the collected peaks
+ *
+ * @param[out] out Report (about 1 KB: not for small stacks)
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_NOT_SUPPORTED without CONFIG_SYS_MON_ENABLE
+ */
+esp_err_t sys_mon_get_report(sys_mon_report_t *out);
+
+/**
+ * @brief Log the compact status line (also logged every CONFIG_SYS_MON_LOG_PERIOD_S)
+ */
+void sys_mon_log(void);
+
+/**
+ * @brief Log heap and stack peaks of every phase entered since boot
+ */
+void sys_mon_log_phases(void);
+
+#ifdef __cplusplus
+}
+#endif
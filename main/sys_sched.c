@@ -0,0 +1,270 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sys_sched.c
+ * @brief Fixed-rate periodic job executor with period, jitter and overrun stats
+ *
+ * @author Marconatale Parise
+ * @date 25 Mar 2026
+ */
+#include "sys_sched.h"
+
+#include <inttypes.h>
+
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "log_ring.h"
+#include "sys_mon.h"
+
+static const char *TAG = "sys_sched";
+
+#ifdef CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#define SCHED_TIMER_ISR 1                   /* wake the executor from the timer ISR */
+#else
+#define SCHED_TIMER_ISR 0
+#endif
+
+struct sys_sched_job {
+    struct sys_sched *sched;
+    struct sys_sched_job *volatile next; /* registration order */
+    const char *name;
+    sys_sched_fn_t fn;
+    void *arg;
+    uint32_t period_us;
+    volatile bool enabled;
+    volatile bool restart;              /* set by sys_sched_enable(): release now, new phase */
+    int64_t due_us;                     /* next release, absolute */
+    int64_t prev_start_us;              /* 0: no previous run in this phase */
+    int64_t late_sum_us;
+    int64_t exec_sum_us;
+    sys_sched_stats_t st;               /* late/exec averages filled on read */
+};
+
+struct sys_sched {
+    const char *name;
+    uint32_t stack_size;
+    TaskHandle_t task;
+    esp_timer_handle_t timer;
+    struct sys_sched_job *volatile head; /* jobs are only appended */
+    struct sys_sched_job *tail;
+};
+
+static struct sys_sched s_sched[CONFIG_SYS_SCHED_MAX_EXECUTORS];
+static struct sys_sched_job s_job[CONFIG_SYS_SCHED_MAX_JOBS];
+static size_t s_sched_count;
+static size_t s_job_count;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;   /* pools, job list, stats */
+
+#if SCHED_TIMER_ISR
+static void IRAM_ATTR wake_cb(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(((struct sys_sched *)arg)->task, &woken);
+    if (woken) esp_timer_isr_dispatch_need_yield();
+}
+#else
+static void wake_cb(void *arg)
+{
+    xTaskNotifyGive(((struct sys_sched *)arg)->task);
+}
+#endif
+
+static void run_job(struct sys_sched_job *j)
+{
+    int64_t start = esp_timer_get_time();
+    j->fn(j->due_us, j->arg);
+    int64_t end = esp_timer_get_time();
+
+    int64_t late = start - j->due_us;
+    int64_t exec = end - start;
+    int64_t err = 0;
+    if (j->prev_start_us) {
+        err = start - j->prev_start_us - j->period_us;
+        if (err < 0) err = -err;
+    }
+    j->prev_start_us = start;
+
+    /* Fixed rate: the next release keeps the phase; releases already missed are dropped */
+    uint32_t skipped = 0;
+    j->due_us += j->period_us;
+    if (end - j->due_us >= (int64_t)j->period_us) {
+        skipped = (uint32_t)((end - j->due_us) / j->period_us);
+        j->due_us += (int64_t)skipped * j->period_us;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    sys_sched_stats_t *st = &j->st;
+    st->runs++;
+    st->overruns += skipped;
+    st->late_last_us = late;
+    if (late > st->late_max_us) st->late_max_us = late;
+    j->late_sum_us += late;
+    if (err > st->period_err_max_us) st->period_err_max_us = err;
+    st->exec_last_us = exec;
+    if (exec > st->exec_max_us) st->exec_max_us = exec;
+    j->exec_sum_us += exec;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void sched_task(void *arg)
+{
+    struct sys_sched *s = arg;
+    sys_mon_watch_task(NULL, s->stack_size);
+
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        int64_t next = INT64_MAX;
+
+        for (struct sys_sched_job *j = s->head; j; j = j->next) {
+            if (!j->enabled) continue;
+            if (j->restart) {
+                j->restart = false;
+                j->due_us = now;
+                j->prev_start_us = 0;
+            }
+            if (j->due_us <= now) {
+                run_job(j);
+                now = esp_timer_get_time();
+            }
+            if (j->due_us < next) next = j->due_us;
+        }
+
+        now = esp_timer_get_time();
+        if (next <= now) continue;
+        if (next == INT64_MAX) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    /* no enabled job: wait for sys_sched_enable() */
+            continue;
+        }
+        esp_timer_start_once(s->timer, (uint64_t)(next - now));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_timer_stop(s->timer);                       /* woken early by sys_sched_enable() */
+    }
+}
+
+esp_err_t sys_sched_create(const char *name, uint32_t stack_size, UBaseType_t prio, BaseType_t core,
+                           sys_sched_handle_t *out)
+{
+    if (!name || !out) return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&s_lock);
+    struct sys_sched *s = s_sched_count < CONFIG_SYS_SCHED_MAX_EXECUTORS ? &s_sched[s_sched_count++] : NULL;
+    portEXIT_CRITICAL(&s_lock);
+    if (!s) {
+        ESP_LOGE(TAG, "No free executor (CONFIG_SYS_SCHED_MAX_EXECUTORS=%d)", CONFIG_SYS_SCHED_MAX_EXECUTORS);
+        return ESP_ERR_NO_MEM;
+    }
+    s->name = name;
+    s->stack_size = stack_size;
+
+    esp_timer_create_args_t targs = {
+        .callback = wake_cb,
+        .arg = s,
+#if SCHED_TIMER_ISR
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = name,
+    };
+    esp_err_t err = esp_timer_create(&targs, &s->timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: timer create failed: %s", name, esp_err_to_name(err));
+        return err;
+    }
+    /* The timer callback reads s->task: create the task last, it arms the timer itself */
+    if (xTaskCreatePinnedToCore(sched_task, name, stack_size, s, prio, &s->task, core) != pdPASS) {
+        ESP_LOGE(TAG, "%s: task create failed", name);
+        esp_timer_delete(s->timer);
+        s->timer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    *out = s;
+    ESP_LOGI(TAG, "Executor '%s' started (prio %u, timer %s dispatch)", name, (unsigned)prio,
+             SCHED_TIMER_ISR ? "ISR" : "task");
+    return ESP_OK;
+}
+
+esp_err_t sys_sched_add(sys_sched_handle_t sched, const char *name, uint32_t period_us, sys_sched_fn_t fn,
+                        void *arg, bool enabled, sys_sched_job_t *out)
+{
+    if (!sched || !name || !fn || period_us == 0) return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&s_lock);
+    struct sys_sched_job *j = s_job_count < CONFIG_SYS_SCHED_MAX_JOBS ? &s_job[s_job_count++] : NULL;
+    if (j) {
+        j->sched = sched;
+        j->name = name;
+        j->fn = fn;
+        j->arg = arg;
+        j->period_us = period_us;
+        j->st.period_us = period_us;
+        j->restart = true;
+        j->enabled = enabled;
+        /* Publish last: the executor walks the list without the lock */
+        if (sched->tail) sched->tail->next = j;
+        else sched->head = j;
+        sched->tail = j;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!j) {
+        ESP_LOGE(TAG, "%s: no free job (CONFIG_SYS_SCHED_MAX_JOBS=%d)", name, CONFIG_SYS_SCHED_MAX_JOBS);
+        return ESP_ERR_NO_MEM;
+    }
+    if (out) *out = j;
+    if (enabled) xTaskNotifyGive(sched->task);
+    return ESP_OK;
+}
+
+void sys_sched_enable(sys_sched_job_t job, bool enable)
+{
+    if (!job || job->enabled == enable) return;
+    if (enable) job->restart = true;
+    job->enabled = enable;
+    xTaskNotifyGive(job->sched->task);
+}
+
+esp_err_t sys_sched_get_stats(sys_sched_job_t job, sys_sched_stats_t *out)
+{
+    if (!job || !out) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&s_lock);
+    *out = job->st;
+    if (out->runs) {
+        out->late_avg_us = job->late_sum_us / out->runs;
+        out->exec_avg_us = job->exec_sum_us / out->runs;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void sys_sched_log_stats(void)
+{
+    for (size_t i = 0; i < s_sched_count; i++) {
+        for (struct sys_sched_job *j = s_sched[i].head; j; j = j->next) {
+            sys_sched_stats_t st;
+            sys_sched_get_stats(j, &st);
+            LOG_RING(ESP_LOG_INFO, TAG,
+                     "%s/%s: %" PRIu32 " us, runs %" PRIu32 " overruns %" PRIu32
+                     ", late avg/max %" PRId64 "/%" PRId64 " us, period err max %" PRId64
+                     " us, exec avg/max %" PRId64 "/%" PRId64 " us",
+                     s_sched[i].name, j->name, st.period_us, st.runs, st.overruns,
+                     st.late_avg_us, st.late_max_us, st.period_err_max_us, st.exec_avg_us, st.exec_max_us);
+        }
+    }
+}
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sys_sched.h
+ * @brief Fixed-rate periodic job executor with period, jitter and overrun stats
+ *
+ * An executor is one FreeRTOS task that runs any number of short periodic
+ * jobs, so several control loops share one stack. Release times are
+ * absolute: the k-th release of a job is due at start + k x period, no
+ * matter how long the job or its neighbours ran. Execution time and
+ * blocking therefore never accumulate into drift.
+ *
+ * The executor sleeps on a task notification until the earliest due job.
+ * A one-shot esp_timer gives the notification, so periods are kept to the
+ * microsecond rather than to the tick. With
+ * CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD the timer notifies straight
+ * from its ISR. Jobs due at the same time run in registration order.
+ *
+ * A job that is still late when its next release comes does not run twice
+ * to catch up. The missed releases are skipped and counted as overruns, and
+ * the job keeps its phase.
+ *
+ * Per job the executor records:
+ * - late: start time minus due time (release jitter), last/avg/max
+ * - period error: time between two starts minus the period, max |error|
+ * - execution time: last/avg/max
+ * - overruns: releases skipped
+ *
+ * A disabled job keeps its stats. When it is enabled again it runs at once
+ * and its phase restarts from that moment.
+ *
+ * Executors and jobs are allocated from static pools
+ * (CONFIG_SYS_SCHED_MAX_EXECUTORS, CONFIG_SYS_SCHED_MAX_JOBS).
+ *
+ * The following functions are provided:
+ * - sys_sched_create(): Start an executor task.
+ * - sys_sched_add(): Register a periodic job on an executor.
+ * - sys_sched_enable(): Enable or pause a job.
+ * - sys_sched_get_stats(): Timing stats of a job.
+ * - sys_sched_log_stats(): Log the stats of every job.
+ *
+ * @author Marconatale Parise
+ * @date 25 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sys_sched *sys_sched_handle_t;      /*!< Executor */
+typedef struct sys_sched_job *sys_sched_job_t;      /*!< Job */
+
+/**
+ * @brief Job body
+ *
+ * @param due_us esp_timer time this release was due at
+ * @param arg    Argument given to sys_sched_add()
+ */
+typedef void (*sys_sched_fn_t)(int64_t due_us, void *arg);
+
+/**
+ * @brief Timing stats of one job (microseconds)
+ */
+typedef struct {
+    uint32_t runs;              /*!< Releases run */
+    uint32_t overruns;          /*!< Releases skipped: the job was still late at its next due time */
+    int64_t  late_last_us;      /*!< Start - due of the last run */
+    int64_t  late_max_us;       /*!< Max start - due (release jitter) */
+    int64_t  late_avg_us;       /*!< Mean start - due */
+    int64_t  period_err_max_us; /*!< Max |start - previous start - period| */
+    int64_t  exec_last_us;      /*!< Execution time of the last run */
+    int64_t  exec_max_us;
+    int64_t  exec_avg_us;
+    uint32_t period_us;         /*!< Nominal period */
+} sys_sched_stats_t;
+
+/**
+ * @brief Start an executor task
+ *
+ * @param name       Task name
+ * @param stack_size Task stack, bytes (must fit the deepest job)
+ * @param prio       Task priority
+ * @param core       Core, or tskNO_AFFINITY
+ * @param[out] out   Executor
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM (pool exhausted or task not created)
+ */
+esp_err_t sys_sched_create(const char *name, uint32_t stack_size, UBaseType_t prio, BaseType_t core,
+                           sys_sched_handle_t *out);
+
+/**
+ * @brief Register a periodic job
+ *
+ * @param sched     Executor
+ * @param name      Job name (must stay valid: a literal)
+ * @param period_us Period
+ * @param fn        Job body, must return well within the period
+ * @param arg       Argument of fn
+ * @param enabled   First release now (true) or on sys_sched_enable()
+ * @param[out] out  Job (may be NULL)
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_NO_MEM when the job pool is exhausted
+ */
+esp_err_t sys_sched_add(sys_sched_handle_t sched, const char *name, uint32_t period_us, sys_sched_fn_t fn,
+                        void *arg, bool enabled, sys_sched_job_t *out);
+
+/**
+ * @brief Enable or pause a job (takes effect after its current run)
+ *
+ * @param job    Job
+ * @param enable true: release now, then every period; false: no more releases
+ */
+void sys_sched_enable(sys_sched_job_t job, bool enable);
+
+/**
+ * @brief Get the timing stats of a job
+ *
+ * @param job      Job
+ * @param[out] out Stats
+ *
+ * @return ESP_OK or ESP_ERR_INVALID_ARG
+ */
+esp_err_t sys_sched_get_stats(sys_sched_job_t job, sys_sched_stats_t *out);
+
+/**
+ * @brief Log the stats of every job (through the log ring: cheap enough for a job)
+ */
+void sys_sched_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,6 +24,22 @@
  */
 #include "wifi.h"
 
+#include <inttypes.h>
+
+#include "freertos/task.h"
+
+#include "nvs.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include "sys_mon.h"
+
+#if CONFIG_WIFI_FAST_REUSE_IP
+#include "esp_netif_net_stack.h"
+#include "lwip/etharp.h"
+#endif
+
 static const char *TAG = "WIFI";
 
 static esp_netif_t *s_netif_sta;
@@ -31,9 +47,56 @@ static esp_netif_t *s_netif_sta;
 static EventGroupHandle_t s_wifi_event_group;
 static const int WIFI_CONNECTED_BIT = BIT0;
 static const int WIFI_FAIL_BIT      = BIT1;
+static const int WIFI_STARTED_BIT   = BIT2;
+static const int WIFI_READY_BIT     = BIT3;     /* IP address up: published to the application */
+static const int WIFI_LOST_BIT      = BIT4;     /* link dropped after a connect */
+static const int WIFI_ASSOC_BIT     = BIT5;     /* associated, waiting for the address */
 
 static int s_retry_num = 0;
 
+#define WIFI_NVS_NS         "wifi_fast"
+#define WIFI_NVS_KEY        "ap"
+#define WIFI_CACHE_VERSION  1
+#define WIFI_SCAN_MAX       8
+#define WIFI_TASK_STACK     4096
+#define WIFI_TASK_PRIO      3
+#define WIFI_ARP_TRIES      3       /* gateway ARP requests before a reused lease is dropped */
+#define WIFI_ARP_WAIT_MS    100     /* wait for the reply to each request */
+
+/* Last good access point and lease, kept in NVS */
+typedef struct {
+    uint32_t version;
+    char     ssid[33];
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint8_t  has_ip;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_cache_t;
+
+typedef enum {
+    WIFI_PHASE_IDLE = 0,    /* between attempts: disconnects are ours */
+    WIFI_PHASE_FAST,        /* directed connect to the cached AP: no retries */
+    WIFI_PHASE_FULL,        /* scan path: retry up to CONFIG_WIFI_MAX_RETRY */
+    WIFI_PHASE_UP,          /* connected: a disconnect is a lost link */
+} wifi_phase_t;
+
+static volatile wifi_phase_t s_phase;
+static wifi_config_t s_sta_cfg;
+static wifi_cache_t s_conn;             /* AP and lease of the current connection */
+static wifi_conn_stats_t s_stats;
+static bool s_stats_valid;
+static int64_t s_t_connect;             /* esp_wifi_connect() of the current attempt */
+static int64_t s_t_assoc;               /* associated (0: not yet) */
+static bool s_started;                  /* esp_wifi_start() done */
+static bool s_dhcp_stopped;             /* DHCP client stopped by us for a reused lease */
+static char s_ssid[33];
+static char s_pwd[65];
+static bool s_creds;                    /* credentials read (stdin is asked once) */
+static wifi_ready_cb_t s_ready_cb;
+
 static void stdio_prepare(void)
 {
     /* Make stdin/stdout unbuffered to work nicely with idf.py monitor */
@@ -51,20 +114,76 @@ static void strip_newline(char *s)
     }
 }
 
+#if CONFIG_WIFI_FAST_CONNECT
+static bool cache_load(wifi_cache_t *cache)
+{
+    nvs_handle_t h;
+    if (nvs_open(WIFI_NVS_NS, NVS_READONLY, &h) != ESP_OK) return false;
+    size_t len = sizeof(*cache);
+    esp_err_t err = nvs_get_blob(h, WIFI_NVS_KEY, cache, &len);
+    nvs_close(h);
+    cache->ssid[sizeof(cache->ssid) - 1] = '\0';
+    return err == ESP_OK && len == sizeof(*cache) && cache->version == WIFI_CACHE_VERSION && cache->channel != 0;
+}
+
+static void cache_save(const wifi_cache_t *cache)
+{
+    /* Every boot connects: only write flash when the AP or the lease changed */
+    wifi_cache_t old;
+    if (cache_load(&old) && memcmp(&old, cache, sizeof(old)) == 0) return;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WIFI_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return;
+    err = nvs_set_blob(h, WIFI_NVS_KEY, cache, sizeof(*cache));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) ESP_LOGW(TAG, "AP cache save failed: %s", esp_err_to_name(err));
+}
+#endif
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
     (void)arg;
-    (void)event_data;
 
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        xEventGroupSetBits(s_wifi_event_group, WIFI_STARTED_BIT);
+        return;
+    }
+
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        const wifi_event_sta_connected_t *ev = event_data;
+        s_t_assoc = esp_timer_get_time();
+        memcpy(s_conn.bssid, ev->bssid, sizeof(s_conn.bssid));
+        s_conn.channel = ev->channel;
+        xEventGroupSetBits(s_wifi_event_group, WIFI_ASSOC_BIT);
         return;
     }
 
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < CONFIG_WIFI_MAX_RETRY) {
+        s_t_assoc = 0;
+        xEventGroupClearBits(s_wifi_event_group, WIFI_ASSOC_BIT);
+        if (s_phase == WIFI_PHASE_UP) {
+            ESP_LOGW(TAG, "Link lost");
+            s_phase = WIFI_PHASE_IDLE;
+            xEventGroupClearBits(s_wifi_event_group, WIFI_READY_BIT);
+            xEventGroupSetBits(s_wifi_event_group, WIFI_LOST_BIT);
+        } else if (s_phase == WIFI_PHASE_FAST) {
+            /* Cached AP gone or moved: let wifi_connect_sta() fall back to a scan */
+            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        } else if (s_phase != WIFI_PHASE_FULL) {
+            return;
+        } else if (s_retry_num < CONFIG_WIFI_MAX_RETRY) {
             s_retry_num++;
             ESP_LOGW(TAG, "Retry to connect to AP (%d/%d)...", s_retry_num, CONFIG_WIFI_MAX_RETRY);
+            if (s_sta_cfg.sta.bssid_set) {
+                /* The strongest AP of the scan refused us: let the driver pick one */
+                s_sta_cfg.sta.bssid_set = false;
+                s_sta_cfg.sta.channel = 0;
+                s_sta_cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+                esp_wifi_set_config(WIFI_IF_STA, &s_sta_cfg);
+            }
+            s_t_connect = esp_timer_get_time();
             esp_wifi_connect();
         } else {
             xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
@@ -73,8 +192,15 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
     }
 
     if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        const ip_event_got_ip_t *ev = event_data;
+        s_conn.ip = ev->ip_info.ip.addr;
+        s_conn.netmask = ev->ip_info.netmask.addr;
+        s_conn.gw = ev->ip_info.gw.addr;
         s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        s_phase = WIFI_PHASE_UP;
+        /* A reused lease is published by wifi_connect_cached() once the gateway answered */
+        xEventGroupSetBits(s_wifi_event_group, s_dhcp_stopped ? WIFI_CONNECTED_BIT
+                                                              : WIFI_CONNECTED_BIT | WIFI_READY_BIT);
         return;
     }
 }
@@ -99,85 +225,327 @@ esp_err_t wifi_init_connection(void){
     ret = esp_wifi_init(&cfg);
     if (ret != ESP_OK) return ret;
 
-    return ESP_OK;
+    /* Kept for the whole uptime: link loss is tracked after the connect */
+    ret = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL);
+    if (ret != ESP_OK) return ret;
+    return esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL);
 }
 
-esp_err_t wifi_connect_sta(void)
+/*
+ * Start one connect attempt and wait for an IP address or a failure. The timeout
+ * bounds the association; once associated the address gets CONFIG_WIFI_DHCP_TIMEOUT_MS,
+ * after which the attempt is dropped so the caller can back off.
+ */
+static EventBits_t wifi_attempt(wifi_phase_t phase, TickType_t timeout)
 {
-    /* Assumes esp_netif_init() and esp_event_loop_create_default() were called in app_main */
+    const EventBits_t done = WIFI_CONNECTED_BIT | WIFI_FAIL_BIT;
+    xEventGroupClearBits(s_wifi_event_group, done | WIFI_ASSOC_BIT);
+    s_t_assoc = 0;
+    s_phase = phase;
+    s_t_connect = esp_timer_get_time();
+    esp_wifi_connect();
+
+    EventBits_t bits;
+    while (true) {
+        bits = xEventGroupWaitBits(s_wifi_event_group, done | WIFI_ASSOC_BIT, pdFALSE, pdFALSE, timeout);
+        if ((bits & done) || !(bits & WIFI_ASSOC_BIT)) break;
+
+        /* Associated, the address is on its way: no reason to drop this AP unless DHCP is silent */
+        bits = xEventGroupWaitBits(s_wifi_event_group, done, pdFALSE, pdFALSE,
+                                   pdMS_TO_TICKS(CONFIG_WIFI_DHCP_TIMEOUT_MS));
+        if (bits & done) break;
+        if (xEventGroupGetBits(s_wifi_event_group) & WIFI_ASSOC_BIT) {
+            ESP_LOGW(TAG, "No IP address %d ms after association, disconnecting", CONFIG_WIFI_DHCP_TIMEOUT_MS);
+            s_phase = WIFI_PHASE_IDLE;      /* our disconnect: no retry from the event handler */
+            esp_wifi_disconnect();
+            bits = 0;
+            break;
+        }
+        /* The link dropped while waiting and the event handler retries: wait for that attempt */
+    }
+    if (s_phase != WIFI_PHASE_UP) s_phase = WIFI_PHASE_IDLE;
+    return bits;
+}
 
-    char ssid[33] = {0};
-    char pwd[65]  = {0};
+/* Give the interface back to the DHCP client if a reused lease stopped it */
+static void dhcp_restore(void)
+{
+    if (!s_dhcp_stopped) return;
+    esp_err_t err = esp_netif_dhcpc_start(s_netif_sta);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED) {
+        ESP_LOGW(TAG, "DHCP client restart failed: %s", esp_err_to_name(err));
+        return;
+    }
+    s_dhcp_stopped = false;
+}
+
+#if CONFIG_WIFI_FAST_REUSE_IP
+/* etharp is not thread safe: both run in the TCP/IP task */
+static esp_err_t arp_request(void *ctx)
+{
+    struct netif *netif = esp_netif_get_netif_impl(s_netif_sta);
+    return etharp_request(netif, (const ip4_addr_t *)ctx) == ERR_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t arp_lookup(void *ctx)
+{
+    struct netif *netif = esp_netif_get_netif_impl(s_netif_sta);
+    struct eth_addr *eth;
+    const ip4_addr_t *ip;
+    return etharp_find_addr(netif, (const ip4_addr_t *)ctx, &eth, &ip) >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/* A lease from another network (or a reassigned gateway) does not get an ARP reply */
+static bool gateway_reachable(uint32_t gw)
+{
+    ip4_addr_t addr = { .addr = gw };
+    if (gw == 0) return false;
+    for (int i = 0; i < WIFI_ARP_TRIES; i++) {
+        if (esp_netif_tcpip_exec(arp_request, &addr) != ESP_OK) return false;
+        vTaskDelay(pdMS_TO_TICKS(WIFI_ARP_WAIT_MS));
+        if (esp_netif_tcpip_exec(arp_lookup, &addr) == ESP_OK) return true;
+    }
+    return false;
+}
+#endif
+
+#if CONFIG_WIFI_FAST_CONNECT
+/* Directed connect to the cached AP on its channel, optionally on the cached lease */
+static esp_err_t wifi_connect_cached(const wifi_cache_t *cache)
+{
+    s_sta_cfg.sta.bssid_set = true;
+    memcpy(s_sta_cfg.sta.bssid, cache->bssid, sizeof(cache->bssid));
+    s_sta_cfg.sta.channel = cache->channel;
+    s_sta_cfg.sta.scan_method = WIFI_FAST_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &s_sta_cfg);
+
+#if CONFIG_WIFI_FAST_REUSE_IP
+    esp_err_t err = cache->has_ip ? esp_netif_dhcpc_stop(s_netif_sta) : ESP_FAIL;
+    if (err == ESP_OK || err == ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        s_dhcp_stopped = true;
+        esp_netif_ip_info_t ip = { .ip.addr = cache->ip, .netmask.addr = cache->netmask, .gw.addr = cache->gw };
+        esp_netif_dns_info_t dns = { .ip.u_addr.ip4.addr = cache->dns, .ip.type = ESP_IPADDR_TYPE_V4 };
+        esp_netif_set_ip_info(s_netif_sta, &ip);
+        if (cache->dns) esp_netif_set_dns_info(s_netif_sta, ESP_NETIF_DNS_MAIN, &dns);
+        s_stats.lease_reused = true;
+    }
+#endif
+
+    ESP_LOGI(TAG, "Directed connect to " MACSTR " on channel %u", MAC2STR(cache->bssid), cache->channel);
+    EventBits_t bits = wifi_attempt(WIFI_PHASE_FAST, pdMS_TO_TICKS(CONFIG_WIFI_FAST_CONNECT_TIMEOUT_MS));
+#if CONFIG_WIFI_FAST_REUSE_IP
+    if ((bits & WIFI_CONNECTED_BIT) && s_stats.lease_reused) {
+        if (gateway_reachable(cache->gw)) {
+            xEventGroupSetBits(s_wifi_event_group, WIFI_READY_BIT);
+        } else {
+            ESP_LOGW(TAG, "Gateway of the cached lease not answering, asking DHCP");
+            s_stats.lease_reused = false;
+            xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            dhcp_restore();
+            bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_LOST_BIT,
+                                       pdFALSE, pdFALSE, pdMS_TO_TICKS(CONFIG_WIFI_DHCP_TIMEOUT_MS));
+            if (!(bits & WIFI_CONNECTED_BIT)) {
+                s_phase = WIFI_PHASE_IDLE;
+                bits = 0;
+            }
+        }
+    }
+#endif
+    if (bits & WIFI_CONNECTED_BIT) {
+        s_stats.fast = true;
+        return ESP_OK;
+    }
 
+    ESP_LOGW(TAG, "Cached AP not reachable, scanning");
+    if (!(bits & WIFI_FAIL_BIT)) esp_wifi_disconnect();
+    dhcp_restore();
+    s_stats.lease_reused = false;
+    s_stats.fallback = true;
+    return ESP_FAIL;
+}
+#endif
+
+/* Scan for the SSID, then connect to its strongest AP (the driver picks one if the scan fails) */
+static esp_err_t wifi_connect_scan(const char *ssid)
+{
+    wifi_scan_config_t scan = { .ssid = (uint8_t *)ssid, .show_hidden = true };
+    static wifi_ap_record_t recs[WIFI_SCAN_MAX];
+    uint16_t n = WIFI_SCAN_MAX;
+    int best = -1;
+
+    int64_t t0 = esp_timer_get_time();
+    if (esp_wifi_scan_start(&scan, true) == ESP_OK && esp_wifi_scan_get_ap_records(&n, recs) == ESP_OK) {
+        for (int i = 0; i < n; i++) {
+            if (best < 0 || recs[i].rssi > recs[best].rssi) best = i;
+        }
+    }
+    s_stats.scan_us = esp_timer_get_time() - t0;
+
+    s_sta_cfg.sta.bssid_set = best >= 0;
+    s_sta_cfg.sta.channel = best >= 0 ? recs[best].primary : 0;
+    s_sta_cfg.sta.scan_method = best >= 0 ? WIFI_FAST_SCAN : WIFI_ALL_CHANNEL_SCAN;
+    if (best >= 0) memcpy(s_sta_cfg.sta.bssid, recs[best].bssid, sizeof(s_sta_cfg.sta.bssid));
+    esp_wifi_set_config(WIFI_IF_STA, &s_sta_cfg);
+
+    s_retry_num = 0;
+    /* Every failed association ends in a disconnect event, retried at most CONFIG_WIFI_MAX_RETRY times */
+    EventBits_t bits = wifi_attempt(WIFI_PHASE_FULL, portMAX_DELAY);
+    return (bits & WIFI_CONNECTED_BIT) ? ESP_OK : ESP_FAIL;
+}
+
+static void wifi_log_stats(void)
+{
+    ESP_LOGI(TAG, "Connected in %" PRId64 " ms (%s%s): start %" PRId64 " ms, scan %" PRId64 " ms, "
+             "auth+assoc %" PRId64 " ms, %s %" PRId64 " ms, IP at %" PRId64 " ms after boot",
+             s_stats.total_us / 1000, s_stats.fast ? "cached AP" : "scan",
+             s_stats.fallback ? ", after fallback" : "", s_stats.start_us / 1000, s_stats.scan_us / 1000,
+             s_stats.assoc_us / 1000, s_stats.lease_reused ? "cached lease" : "DHCP", s_stats.dhcp_us / 1000,
+             s_stats.ready_us / 1000);
+}
+
+/* SSID and password from Kconfig, or asked once on stdin */
+static esp_err_t wifi_load_credentials(void)
+{
+    if (s_creds) return ESP_OK;
 #if CONFIG_EXAMPLE_WIFI_SSID_PWD_FROM_STDIN
     stdio_prepare();
     printf("Enter Wi-Fi SSID:\n");
-    if (!fgets(ssid, sizeof(ssid), stdin)) {
+    if (!fgets(s_ssid, sizeof(s_ssid), stdin)) {
         return ESP_FAIL;
     }
-    strip_newline(ssid);
+    strip_newline(s_ssid);
 
     printf("Enter Wi-Fi Password:\n");
-    if (!fgets(pwd, sizeof(pwd), stdin)) {
+    if (!fgets(s_pwd, sizeof(s_pwd), stdin)) {
         return ESP_FAIL;
     }
-    strip_newline(pwd);
+    strip_newline(s_pwd);
 #else
-    strncpy(ssid, CONFIG_WIFI_SSID, sizeof(ssid) - 1);
-    strncpy(pwd,  CONFIG_WIFI_PASS, sizeof(pwd) - 1);
+    strncpy(s_ssid, CONFIG_WIFI_SSID, sizeof(s_ssid) - 1);
+    strncpy(s_pwd,  CONFIG_WIFI_PASS, sizeof(s_pwd) - 1);
 #endif
+    s_creds = true;
+    return ESP_OK;
+}
 
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        &instance_got_ip));
+esp_err_t wifi_connect_sta(void)
+{
+    /* Assumes wifi_init_connection() was called in app_main */
+    if (!s_wifi_event_group) return ESP_ERR_INVALID_STATE;
+    if (wifi_load_credentials() != ESP_OK) return ESP_FAIL;
+
+    int64_t t_begin = esp_timer_get_time();
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(&s_conn, 0, sizeof(s_conn));
+    s_stats_valid = false;
+    xEventGroupClearBits(s_wifi_event_group, WIFI_READY_BIT | WIFI_LOST_BIT);
+    /* A lease reused by the last connect is only valid for that connection */
+    dhcp_restore();
 
     wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char *)wifi_config.sta.password, pwd, sizeof(wifi_config.sta.password) - 1);
+    strncpy((char *)wifi_config.sta.ssid, s_ssid, sizeof(wifi_config.sta.ssid) - 1);
+    strncpy((char *)wifi_config.sta.password, s_pwd, sizeof(wifi_config.sta.password) - 1);
 
     /* If you need WPA3 or open networks, adjust here */
     wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
     wifi_config.sta.pmf_cfg.capable = true;
     wifi_config.sta.pmf_cfg.required = false;
+    s_sta_cfg = wifi_config;
+
+    if (!s_started) {
+        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+        ESP_ERROR_CHECK(esp_wifi_start());
+        xEventGroupWaitBits(s_wifi_event_group, WIFI_STARTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+        s_started = true;
+        s_stats.start_us = esp_timer_get_time() - t_begin;
+    }
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-
-    ESP_LOGI(TAG, "Connecting to SSID: %s", ssid);
-
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                          WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                          pdFALSE,
-                                          pdFALSE,
-                                          portMAX_DELAY);
+    ESP_LOGI(TAG, "Connecting to SSID: %s", s_ssid);
 
     esp_err_t ret = ESP_FAIL;
-    if (bits & WIFI_CONNECTED_BIT) {
+#if CONFIG_WIFI_FAST_CONNECT
+    wifi_cache_t cache;
+    if (cache_load(&cache) && strcmp(cache.ssid, s_ssid) == 0) {
+        ret = wifi_connect_cached(&cache);
+    }
+#endif
+    if (ret != ESP_OK) ret = wifi_connect_scan(s_ssid);
+
+    if (ret == ESP_OK) {
+        int64_t now = esp_timer_get_time();
+        s_stats.assoc_us = s_t_assoc - s_t_connect;
+        s_stats.dhcp_us = now - s_t_assoc;
+        s_stats.total_us = now - t_begin;
+        s_stats.ready_us = now;
+        s_stats.retries = (uint8_t)s_retry_num;
+        s_stats_valid = true;
         ESP_LOGI(TAG, "Connected to AP");
-        ret = ESP_OK;
-    } else if (bits & WIFI_FAIL_BIT) {
+        wifi_log_stats();
+#if CONFIG_WIFI_FAST_CONNECT
+        esp_netif_dns_info_t dns = {0};
+        s_conn.version = WIFI_CACHE_VERSION;
+        strlcpy(s_conn.ssid, s_ssid, sizeof(s_conn.ssid));
+        s_conn.has_ip = s_conn.ip != 0;
+        if (esp_netif_get_dns_info(s_netif_sta, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+            s_conn.dns = dns.ip.u_addr.ip4.addr;
+        }
+        cache_save(&s_conn);
+#endif
+    } else {
         ESP_LOGE(TAG, "Failed to connect to AP");
-        ret = ESP_FAIL;
     }
+    return ret;
+}
 
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
+/* Exponential backoff between failed connect rounds, with +-25% jitter */
+static uint32_t wifi_backoff_ms(int failures)
+{
+    uint32_t ms = CONFIG_WIFI_BACKOFF_MIN_MS;
+    for (int i = 1; i < failures && ms < CONFIG_WIFI_BACKOFF_MAX_MS; i++) ms *= 2;
+    if (ms > CONFIG_WIFI_BACKOFF_MAX_MS) ms = CONFIG_WIFI_BACKOFF_MAX_MS;
+    return ms - ms / 4 + esp_random() % (ms / 2 + 1);
+}
 
-    vEventGroupDelete(s_wifi_event_group);
-    s_wifi_event_group = NULL;
+/* Connects in the background and reconnects whenever the link drops */
+static void wifi_task(void *arg)
+{
+    int failures = 0;
+    sys_mon_watch_task(NULL, WIFI_TASK_STACK);
+    while (true) {
+        if (wifi_connect_sta() != ESP_OK) {
+            uint32_t ms = wifi_backoff_ms(++failures);
+            ESP_LOGW(TAG, "Connect round %d failed, next in %" PRIu32 " ms", failures, ms);
+            vTaskDelay(pdMS_TO_TICKS(ms));
+            continue;
+        }
+        failures = 0;
+        if (s_ready_cb) s_ready_cb();
+        xEventGroupWaitBits(s_wifi_event_group, WIFI_LOST_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+    }
+}
 
-    return ret;
+esp_err_t wifi_start_async(wifi_ready_cb_t on_ready)
+{
+    if (!s_wifi_event_group) return ESP_ERR_INVALID_STATE;
+    s_ready_cb = on_ready;
+    if (xTaskCreatePinnedToCore(wifi_task, "Task WiFi", WIFI_TASK_STACK, NULL, WIFI_TASK_PRIO, NULL,
+                                tskNO_AFFINITY) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool wifi_is_ready(void)
+{
+    return s_wifi_event_group && (xEventGroupGetBits(s_wifi_event_group) & WIFI_READY_BIT);
+}
+
+esp_err_t wifi_wait_ready(TickType_t timeout)
+{
+    if (!s_wifi_event_group) return ESP_ERR_INVALID_STATE;
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_READY_BIT, pdFALSE, pdTRUE, timeout);
+    return (bits & WIFI_READY_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
 }
 
 esp_netif_t *wifi_get_netif_sta(void)
@@ -189,3 +557,22 @@ esp_err_t wifi_disable_powersave(void)
 {
     return esp_wifi_set_ps(WIFI_PS_NONE);
 }
+
+esp_err_t wifi_get_conn_stats(wifi_conn_stats_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_stats_valid) return ESP_ERR_INVALID_STATE;
+    *out = s_stats;
+    return ESP_OK;
+}
+
+esp_err_t wifi_forget_ap(void)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WIFI_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_erase_key(h, WIFI_NVS_KEY);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
@@ -20,12 +20,33 @@
  * This module provides functions to initialize Wi-Fi, connect in STA mode, and
  * disable power-save mode for better OTA performance. It also exposes the esp-netif handle for
  * the STA interface.
+ *
+ * Fast reconnect (CONFIG_WIFI_FAST_CONNECT): the BSSID and channel of the last
+ * access point (and optionally its DHCP lease) are cached in NVS. The next
+ * connect goes straight to that AP on its channel, without scanning, and can
+ * configure the cached address instead of waiting for DHCP. A reused address is
+ * published only once the cached gateway answers an ARP request, otherwise DHCP
+ * runs; the DHCP client is restarted on the next connect and before any scan.
+ * If the AP does not answer within CONFIG_WIFI_FAST_CONNECT_TIMEOUT_MS the full
+ * scan path runs.
+ * Each connect records its phase timings (see wifi_get_conn_stats()).
+ *
+ * Background mode (wifi_start_async()): a Wi-Fi task connects while the
+ * application already runs, retries failed rounds with exponential backoff
+ * (CONFIG_WIFI_BACKOFF_MIN_MS..CONFIG_WIFI_BACKOFF_MAX_MS) and reconnects when
+ * the link drops. Network readiness is an event bit: wifi_wait_ready() blocks on
+ * it, wifi_is_ready() polls it.
  * 
  * The following functions are provided:
  * - wifi_init_connection(): Initializes esp-netif and the default event loop.
  * - wifi_connect_sta(): Connects to a Wi-Fi AP in STA mode (blocking).
+ * - wifi_start_async(): Connects in a background task, reconnecting with backoff.
+ * - wifi_is_ready(): Whether the STA has an IP address.
+ * - wifi_wait_ready(): Waits for the network ready event.
  * - wifi_disable_powersave(): Disables Wi-Fi power-save mode.
  * - wifi_get_netif_sta(): Returns the esp-netif handle for the STA interface.
+ * - wifi_get_conn_stats(): Phase timings of the last connect.
+ * - wifi_forget_ap(): Drop the cached access point and lease.
  * 
  * @author Marconatale Parise
  * @date 19 Feb 2026
@@ -54,6 +75,27 @@ typedef struct esp_netif_obj esp_netif_t;
 extern "C" {
 #endif
 
+/**
+ * @brief Timings of the last wifi_connect_sta() (microseconds)
+ */
+typedef struct {
+    int64_t start_us;       /*!< esp_wifi_start() -> driver started */
+    int64_t scan_us;        /*!< SSID scan (0 on a directed reconnect) */
+    int64_t assoc_us;       /*!< Connect request -> associated (authentication, association, key handshake) */
+    int64_t dhcp_us;        /*!< Associated -> IP address (DHCP, or the reused lease) */
+    int64_t total_us;       /*!< wifi_connect_sta() -> IP address */
+    int64_t ready_us;       /*!< Time since boot when the IP address was obtained */
+    uint8_t fast;           /*!< Connected to the cached AP without scanning */
+    uint8_t lease_reused;   /*!< Cached IP address used without DHCP */
+    uint8_t fallback;       /*!< Cached AP failed, full scan used */
+    uint8_t retries;        /*!< Reconnect attempts after a disconnect */
+} wifi_conn_stats_t;
+
+/**
+ * @brief Called from the Wi-Fi task each time the network becomes ready
+ */
+typedef void (*wifi_ready_cb_t)(void);
+
 /**
  * @brief Initialize Wi-Fi connection (esp-netif and event loop)
  *
@@ -71,11 +113,40 @@ esp_err_t wifi_init_connection(void);
  * User-modifiable knobs are exposed via Kconfig:
  * - CONFIG_EXAMPLE_WIFI_SSID_PWD_FROM_STDIN
  * - CONFIG_EXAMPLE_WIFI_MAX_RETRY
+ * - CONFIG_WIFI_FAST_CONNECT, CONFIG_WIFI_FAST_REUSE_IP
+ *
+ * Can be called again after a failure or a lost link (wifi_start_async() does).
  *
  * @return ESP_OK on success
  */
 esp_err_t wifi_connect_sta(void);
 
+/**
+ * @brief Connect in a background task: returns immediately
+ *
+ * Failed connect rounds are retried with exponential backoff and jitter; a lost
+ * link is reconnected. Do not call wifi_connect_sta() as well.
+ *
+ * @param on_ready Called from the Wi-Fi task after each successful connect (optional)
+ *
+ * @return ESP_OK if the task started
+ */
+esp_err_t wifi_start_async(wifi_ready_cb_t on_ready);
+
+/**
+ * @brief Whether the network is ready (STA connected with an IP address)
+ */
+bool wifi_is_ready(void);
+
+/**
+ * @brief Wait for the network ready event
+ *
+ * @param timeout Ticks to wait (portMAX_DELAY: forever)
+ *
+ * @return ESP_OK when ready, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t wifi_wait_ready(TickType_t timeout);
+
 /**
  * @brief Disable Wi-Fi power-save mode (recommended for OTA throughput)
  *
@@ -90,6 +161,22 @@ esp_err_t wifi_disable_powersave(void);
  */
 esp_netif_t *wifi_get_netif_sta(void);
 
+/**
+ * @brief Get the phase timings of the last connect
+ *
+ * @param[out] out Timings
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if no connect succeeded yet
+ */
+esp_err_t wifi_get_conn_stats(wifi_conn_stats_t *out);
+
+/**
+ * @brief Drop the cached access point and lease: the next connect scans and uses DHCP
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_forget_ap(void);
+
 #ifdef __cplusplus
 }
 #endif
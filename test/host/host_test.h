@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file host_test.h
+ * @brief Host test helpers
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#pragma once
+
+#include <stdio.h>
+
+static int host_test_failures;
+
+/* Report and count a failed expectation, keep going */
+#define CHECK(cond) do {                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++;                                               \
+        }                                                                       \
+    } while (0)
+
+/* Summary line and exit status */
+static inline int host_test_done(const char *name)
+{
+    printf("%s: %s\n", name, host_test_failures ? "FAILED" : "OK");
+    return host_test_failures ? 1 : 0;
+}
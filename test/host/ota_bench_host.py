@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+OTA benchmark on the host: the ota_bench_run() sweep (CONFIG_OTA_BENCH_ENABLE)
+of the real HAL and pipeline, built as ota_host --bench, against a local
+tools/ota_test_server.py and a file-backed flash.
+
+The sweep covers buffer_size, buffer_size_tx, keep-alive, image size and the
+parallel connection curve. Each run is one OTA_BENCH line with throughput,
+peak heap (growth of the host heap in use), arena peak and CPU time (thread CPU
+clocks). The log is summarized by tools/ota_bench_report.py, which can
+compare it with a baseline CSV and fail on a throughput regression.
+
+The stand-in is plain HTTP: the host client has no TLS, so handshake costs
+are only measured on the target.
+
+Usage:
+    make -C test/host bench
+    python test/host/ota_bench_host.py test/host/build/ota_bench -o bench.csv --latency-ms 20 --rate-kbps 400
+    python test/host/ota_bench_host.py test/host/build/ota_bench --baseline bench.csv
+"""
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import ROOT, Device, Server, make_image  # noqa: E402
+
+REPORT = os.path.join(ROOT, "tools", "ota_bench_report.py")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("binary", help="ota_host built for benchmarks (make -C test/host build/ota_bench)")
+    parser.add_argument("--size-kb", type=int, default=960, help="image size, up to the 1 MB slot (default 960)")
+    parser.add_argument("--latency-ms", type=float, default=0.0, help="server delay before every response")
+    parser.add_argument("--rate-kbps", type=float, default=0.0, help="server cap per connection in KB/s (0: none)")
+    parser.add_argument("--log", help="keep the OTA_BENCH log here")
+    parser.add_argument("-o", "--output", help="summary CSV (default: stdout)")
+    parser.add_argument("--baseline", help="summary CSV of a previous release to compare with")
+    parser.add_argument("--threshold", type=float, help="allowed throughput drop in %% (ota_bench_report.py)")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        image = os.path.join(workdir, "fw.bin")
+        with open(image, "wb") as f:
+            f.write(make_image(args.size_kb * 1024, 0))
+        log = os.path.abspath(args.log) if args.log else os.path.join(workdir, "bench.log")
+        dev = Device(os.path.abspath(args.binary), workdir)
+        with Server(workdir, image, "--latency-ms", str(args.latency_ms), "--rate-kbps", str(args.rate_kbps)) as srv:
+            proc = dev.start(srv.url, bench=True)
+            with open(log, "w") as out:
+                for line in proc.stdout:
+                    out.write(line)
+                    if line.startswith("OTA_BENCH_END"):
+                        print(line.strip(), file=sys.stderr)
+            proc.wait()
+            dev.log_file.close()
+        if proc.returncode != 0:
+            dev.dump_log()
+
+        cmd = [sys.executable, REPORT, log]
+        if args.output:
+            cmd += ["-o", args.output]
+        if args.baseline:
+            cmd += ["--baseline", args.baseline]
+        if args.threshold is not None:
+            cmd += ["--threshold", str(args.threshold)]
+        report = subprocess.call(cmd)
+    return proc.returncode or report
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,119 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_host.c
+ * @brief Host driver: one OTA session of the real HAL against a local HTTP server
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * The OTA HAL, pipeline, resume, mirror, verify and stats modules built for
+ * the host (see shim/): flash is the file named by OTA_HOST_FLASH, NVS the
+ * file named by OTA_HOST_NVS, so a killed run resumes in the next one.
+ *
+ *   ota_host --url http://127.0.0.1:8070/fw.bin [--mirrors URL,URL] [--delta URL] [--manifest URL]
+ *            [--linger MS] [--sessions N]
+ *   ota_host --url http://127.0.0.1:8070/fw.bin --bench
+ *
+ * Prints one JSON line with the result, session stats, arena use, mirror
+ * ranking and boot slot; exits non zero when the update was not staged.
+ * --delta is the patch URL tried first (builds with CONFIG_OTA_DELTA_ENABLE),
+ * --manifest the block manifest (builds with CONFIG_OTA_BLOCKSYNC_ENABLE).
+ * --sessions stages the update N times back to back and reports the heap
+ * growth from the end of the first session to the end of the last. --linger
+ * keeps the process (and the HAL's timers) alive that long after the session.
+ * With --bench the ota_bench_run() sweep runs instead and prints its OTA_BENCH
+ * lines.
+ */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_ota_ops.h"
+#include "ota_arena.h"
+#include "ota_bench.h"
+#include "ota_hal.h"
+#include "ota_mirror.h"
+#include "ota_stats.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s --url URL [--mirrors URL,URL...] [--delta URL] [--manifest URL] [--linger MS] [--sessions N] [--bench]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    bool bench = false;
+    int linger_ms = 0;
+    int sessions = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--url") == 0 && i + 1 < argc) {
+            ota_cfg.url = argv[++i];
+        } else if (strcmp(argv[i], "--mirrors") == 0 && i + 1 < argc) {
+            ota_cfg.mirror_urls = argv[++i];
+        } else if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc) {
+            ota_cfg.delta_url = argv[++i];
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            ota_cfg.manifest_url = argv[++i];
+        } else if (strcmp(argv[i], "--linger") == 0 && i + 1 < argc) {
+            linger_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            sessions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!ota_cfg.url || !ota_cfg.url[0] || sessions < 1) usage(argv[0]);
+    if (bench) return ota_bench_run() == ESP_OK ? 0 : 1;
+
+    esp_err_t err = ota_hal_init();
+    /* The first session creates what is kept for the uptime (timers, stats): measure from its end */
+    size_t heap_free = 0;
+    int staged = 0;
+    while (err == ESP_OK && staged < sessions) {
+        err = ota_hal_stage(NULL);
+        if (err == ESP_OK && ++staged == 1) heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    }
+    long heap_growth = staged ? (long)heap_free - (long)heap_caps_get_free_size(MALLOC_CAP_8BIT) : 0;
+    if (linger_ms > 0) vTaskDelay(pdMS_TO_TICKS(linger_ms));
+
+    ota_hal_stats_t st = { 0 };
+    ota_arena_stats_t arena;
+    ota_hal_get_stats(&st);
+    ota_arena_get_stats(&arena);
+    printf("{\"result\":\"%s\",\"bytes_received\":%" PRIu32 ",\"bytes_written\":%" PRIu32
+           ",\"connections\":%u,\"reused\":%u,\"total_ms\":%" PRId64 ",\"boot\":\"%s\",\"sessions\":%d"
+           ",\"heap_growth\":%ld,\"arena\":{\"size\":%zu,\"peak\":%zu,\"sessions\":%" PRIu32
+           ",\"failures\":%" PRIu32 "},\"mirrors\":[",
+           esp_err_to_name(err), st.bytes_received, st.bytes_written, st.connections, st.reused,
+           st.total_us / 1000, esp_ota_get_boot_partition()->label, staged, heap_growth, arena.size,
+           arena.peak_max, arena.sessions, arena.failures);
+    for (size_t i = 0; i < ota_mirror_count(); i++) {
+        printf("%s\"%s\"", i ? "," : "", ota_mirror_url(i));
+    }
+    printf("]}\n");
+    return err == ESP_OK ? 0 : 1;
+}
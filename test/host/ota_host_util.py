@@ -0,0 +1,178 @@
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Helpers of the scripted host tests: valid ESP app images, local instances of
+tools/ota_test_server.py with a request log, and runs of the ota_host driver
+against them (fake flash and NVS files in a scratch directory).
+"""
+import hashlib
+import json
+import os
+import random
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+SERVER = os.path.join(ROOT, "tools", "ota_test_server.py")
+
+SECTOR = 4096
+SLOT_ADDR = {"ota_0": 0x10000, "ota_1": 0x110000}     # shim/esp_partition.c
+SLOT_SIZE = 0x100000
+
+
+def make_image(payload_len, seed, payload=None):
+    """ESP app image with one segment, checksum and appended SHA-256, as esptool writes it.
+
+    The segment is random bytes, or the first payload_len bytes of payload (e.g. real code).
+    """
+    rnd = random.Random(seed)
+    payload = rnd.randbytes(payload_len) if payload is None else payload[:payload_len]
+    payload = payload[:len(payload) & ~3]
+    header = struct.pack("<BBBBIB3sHBHH4sB", 0xE9, 1, 2, 0x20, 0x400D0000, 0xEE, b"\0\0\0", 0, 0, 0, 0xFFFF,
+                         b"\0" * 4, 1)
+    image = bytearray(header + struct.pack("<II", 0x3F400020, len(payload)) + payload)
+    checksum = 0xEF
+    for b in payload:
+        checksum ^= b
+    image += b"\0" * (15 - len(image) % 16)
+    image.append(checksum)
+    image += hashlib.sha256(image).digest()
+    return bytes(image)
+
+
+def etag_of(image):
+    """ETag tools/ota_test_server.py gives the image."""
+    return '"%s"' % hashlib.sha256(image).hexdigest()[:16]
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+class Server:
+    """One tools/ota_test_server.py instance serving image_path on 127.0.0.1."""
+
+    def __init__(self, workdir, image_path, *args, name="server"):
+        self.port = free_port()
+        self.log_path = os.path.join(workdir, "%s-%d.jsonl" % (name, self.port))
+        self.url = "http://127.0.0.1:%d/fw.bin" % self.port
+        self.proc = subprocess.Popen([sys.executable, SERVER, image_path, "--host", "127.0.0.1",
+                                      "--port", str(self.port), "--request-log", self.log_path] + list(args),
+                                     stderr=subprocess.DEVNULL)
+        deadline = time.monotonic() + 10
+        while True:
+            try:
+                socket.create_connection(("127.0.0.1", self.port), timeout=0.2).close()
+                break
+            except OSError:
+                if time.monotonic() > deadline or self.proc.poll() is not None:
+                    self.stop()
+                    raise RuntimeError("%s did not start" % name)
+                time.sleep(0.05)
+
+    def requests(self, method="GET"):
+        """Logged responses, oldest first."""
+        if not os.path.exists(self.log_path):
+            return []
+        with open(self.log_path) as f:
+            entries = [json.loads(line) for line in f if line.endswith("\n")]
+        return [e for e in entries if method is None or e["method"] == method]
+
+    def kill(self):
+        if self.proc.poll() is None:
+            self.proc.send_signal(signal.SIGKILL)
+        self.proc.wait()
+
+    def stop(self):
+        if self.proc.poll() is None:
+            self.proc.terminate()
+            try:
+                self.proc.wait(5)
+            except subprocess.TimeoutExpired:
+                self.kill()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.stop()
+
+
+class Device:
+    """The ota_host driver with its flash and NVS files: state survives between runs, as across reboots."""
+
+    def __init__(self, binary, workdir):
+        self.binary = binary
+        self.flash = os.path.join(workdir, "flash.bin")
+        self.nvs = os.path.join(workdir, "nvs.bin")
+        self.log = os.path.join(workdir, "ota_host.log")
+
+    def start(self, url, mirrors=None, bench=False, linger_ms=0, delta=None, manifest=None, sessions=1):
+        env = dict(os.environ, OTA_HOST_FLASH=self.flash, OTA_HOST_NVS=self.nvs)
+        cmd = [self.binary, "--url", url] + (["--mirrors", mirrors] if mirrors else []) + (["--bench"] if bench else [])
+        cmd += ["--linger", str(linger_ms)] if linger_ms else []
+        cmd += ["--delta", delta] if delta else []
+        cmd += ["--manifest", manifest] if manifest else []
+        cmd += ["--sessions", str(sessions)] if sessions != 1 else []
+        self.log_file = open(self.log, "a")
+        return subprocess.Popen(cmd, env=env, stdout=subprocess.PIPE, stderr=self.log_file, text=True)
+
+    def run(self, url, mirrors=None, timeout=120, linger_ms=0, delta=None, manifest=None, sessions=1):
+        """One OTA session (or sessions back to back): (exit code, JSON summary)."""
+        proc = self.start(url, mirrors, linger_ms=linger_ms, delta=delta, manifest=manifest, sessions=sessions)
+        out, _ = proc.communicate(timeout=timeout)
+        self.log_file.close()
+        summary = json.loads(out.strip().splitlines()[-1]) if out.strip() else None
+        return proc.returncode, summary
+
+    def install(self, label, image):
+        """Write image to a slot of the flash file, as if flashed over serial (the rest reads erased)."""
+        size = SLOT_ADDR["ota_1"] + SLOT_SIZE
+        with open(self.flash, "r+b" if os.path.exists(self.flash) else "w+b") as f:
+            f.seek(0, os.SEEK_END)
+            if f.tell() < size:
+                f.write(b"\xff" * (size - f.tell()))
+            f.seek(SLOT_ADDR[label])
+            f.write(image + b"\xff" * (-len(image) % SECTOR))
+
+    def slot(self, label, length):
+        with open(self.flash, "rb") as f:
+            f.seek(SLOT_ADDR[label])
+            return f.read(length)
+
+    def dump_log(self):
+        if os.path.exists(self.log):
+            with open(self.log) as f:
+                sys.stderr.write(f.read())
+
+
+def range_start(entry):
+    """First byte of "Range: bytes=N-..." of a logged request, None without Range."""
+    value = entry.get("range")
+    if not value:
+        return None
+    return int(value.split("=", 1)[1].split("-", 1)[0])
+
+
+class Checker:
+    """CHECK() of host_test.h for the scripted tests."""
+
+    def __init__(self, name):
+        self.name = name
+        self.failures = 0
+
+    def check(self, cond, what):
+        if not cond:
+            sys.stderr.write("%s: CHECK failed: %s\n" % (self.name, what))
+            self.failures += 1
+        return cond
+
+    def done(self):
+        print("%s: %s" % (self.name, "FAILED" if self.failures else "OK"))
+        return 1 if self.failures else 0
@@ -0,0 +1,131 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file ota_peer_host.c
+ * @brief Host driver: one device of a LAN site, serving its running image or discovering peers
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * main/ota_peer.c built for the host with CONFIG_OTA_PEER_SERVE and
+ * CONFIG_OTA_PEER_FETCH. Several processes form a site on the loopback
+ * (see shim/lwip/sockets.h): each one has its own address (OTA_HOST_IP),
+ * discovery probes reach the addresses of OTA_HOST_LAN, and the running
+ * image is ota_0 of the file named by OTA_HOST_FLASH.
+ *
+ *   ota_peer_host --serve
+ *   ota_peer_host --discover SHA256_HEX VERSION
+ *
+ * --serve starts the peer server, waits until it answers its own probe,
+ * prints its announce as one JSON line and serves until stdin is closed.
+ * --discover runs one ota_peer_discover() and prints the peers with free
+ * slots in the order the HAL would try them, and the count of busy answers.
+ */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "ota_peer.h"
+
+#define READY_TIMEOUT_MS    10000
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s --serve | --discover SHA256_HEX VERSION\n", prog);
+    exit(2);
+}
+
+static void print_hex(const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++) printf("%02x", p[i]);
+}
+
+/* The own announce, once the discovery responder is up */
+static bool wait_ready(ota_peer_announce_t *a)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) return false;
+    const char *ip = getenv("OTA_HOST_IP");
+    struct sockaddr_in self = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_OTA_PEER_DISCOVERY_PORT),
+        .sin_addr.s_addr = ip ? inet_addr(ip) : htonl(INADDR_LOOPBACK),
+    };
+    struct timeval tv = { .tv_usec = 100000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ota_peer_probe_t probe = { .magic = OTA_PEER_PROBE_MAGIC };     /* zero digest: any image */
+    bool ok = false;
+    for (int ms = 0; !ok && ms < READY_TIMEOUT_MS; ms += 100) {
+        sendto(sock, &probe, sizeof(probe), 0, (struct sockaddr *)&self, sizeof(self));
+        ok = recv(sock, a, sizeof(*a), 0) == sizeof(*a) && memcmp(a->magic, OTA_PEER_ANNOUNCE_MAGIC, 4) == 0;
+    }
+    close(sock);
+    return ok;
+}
+
+static int serve(void)
+{
+    ota_peer_announce_t a;
+    if (ota_peer_server_start() != ESP_OK || !wait_ready(&a)) {
+        fprintf(stderr, "peer server not ready\n");
+        return 1;
+    }
+    printf("{\"port\":%u,\"free_slots\":%u,\"max_slots\":%u,\"image_len\":%" PRIu32 ",\"version\":\"%.32s\""
+           ",\"discovery_port\":%d,\"sha256\":\"",
+           a.port, a.free_slots, a.max_slots, a.image_len, a.version, CONFIG_OTA_PEER_DISCOVERY_PORT);
+    print_hex(a.sha256, sizeof(a.sha256));
+    printf("\"}\n");
+    fflush(stdout);
+    while (getchar() != EOF) {
+    }
+    return 0;
+}
+
+static int discover(const char *sha_hex, const char *version)
+{
+    uint8_t sha[32];
+    for (int i = 0; i < 32; i++) {
+        if (strlen(sha_hex) != 64 || sscanf(sha_hex + 2 * i, "%2hhx", &sha[i]) != 1) return 2;
+    }
+    ota_peer_t peers[OTA_PEER_MAX];
+    size_t busy;
+    size_t n = ota_peer_discover(version, sha, peers, OTA_PEER_MAX, &busy);
+    printf("{\"busy\":%zu,\"peers\":[", busy);
+    for (size_t i = 0; i < n; i++) {
+        char url[48];
+        ota_peer_url(&peers[i], url, sizeof(url));
+        struct in_addr ip = { .s_addr = peers[i].ip };
+        printf("%s{\"ip\":\"%s\",\"port\":%u,\"free_slots\":%u,\"image_len\":%" PRIu32 ",\"url\":\"%s\"}",
+               i ? "," : "", inet_ntoa(ip), peers[i].port, peers[i].free_slots, peers[i].image_len, url);
+    }
+    printf("]}\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 && strcmp(argv[1], "--serve") == 0) return serve();
+    if (argc == 4 && strcmp(argv[1], "--discover") == 0) return discover(argv[2], argv[3]);
+    usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio.h
+ * @brief Host shim: GPIO inputs driven by the test, with per-pin ISR handlers
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * A test sets the level of an input with host_gpio_set_level(). A change
+ * raises the pin interrupt if it is enabled for that edge: the handler runs
+ * in the calling thread, which plays the interrupt context.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+typedef enum {
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+} gpio_int_type_t;
+
+typedef void (*gpio_isr_t)(void *arg);
+
+int gpio_get_level(gpio_num_t gpio);
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type);
+esp_err_t gpio_install_isr_service(int flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg);
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio);
+
+/* Test side: drive an input, running its handler on an enabled edge */
+void host_gpio_set_level(gpio_num_t gpio, int level);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,40 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_cpu.h
+ * @brief Host shim: CPU cycle counter and core id
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Core of the calling task (xPortGetCoreID()) */
+int esp_cpu_get_core_id(void);
+
+/* Wraps every 2^32 cycles, as on the target (see esp_rom_get_cpu_ticks_per_us()) */
+uint32_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
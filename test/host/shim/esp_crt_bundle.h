@@ -0,0 +1,28 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_crt_bundle.h
+ * @brief Host shim: certificate bundle (the host client speaks plain HTTP only)
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#pragma once
+
+#include "esp_err.h"
+
+esp_err_t esp_crt_bundle_attach(void *conf);
@@ -0,0 +1,427 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_http_client.c
+ * @brief Host shim: plain HTTP/1.1 client with keep-alive, enough for the OTA HAL
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * One request at a time per client, Content-Length bodies (or until close),
+ * no chunked encoding, no TLS. A connection is reused when the previous body
+ * was read to the end and the server did not ask to close it, so the HAL's
+ * reconnect-once path for a dropped keep-alive connection is exercised too.
+ */
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+
+static const char *TAG = "host_http";
+
+#define HTTP_MAX_HEADERS    8
+#define HTTP_KEY_LEN        32
+#define HTTP_VALUE_LEN      256
+#define HTTP_HOST_LEN       128
+#define HTTP_PATH_LEN       256
+#define HTTP_DEFAULT_BUF    512
+
+struct esp_http_client {
+    http_event_handle_cb handler;
+    void *user_data;
+    int timeout_ms;
+    esp_http_client_method_t method;
+    char host[HTTP_HOST_LEN];
+    int port;
+    char path[HTTP_PATH_LEN];
+    struct {
+        char key[HTTP_KEY_LEN];
+        char value[HTTP_VALUE_LEN];
+    } hdr[HTTP_MAX_HEADERS];
+    int fd;
+    /* Current response */
+    int status;
+    int64_t content_len;        /* -1: body until the server closes */
+    int64_t body_read;
+    bool no_body;
+    bool close_after;           /* "Connection: close" */
+    bool eof;
+    bool finished;              /* HTTP_EVENT_ON_FINISH sent */
+    /* Receive buffer: headers, then the start of the body */
+    char *rx;
+    int rx_size;
+    int rx_pos;
+    int rx_len;
+};
+
+static void emit(esp_http_client_handle_t c, esp_http_client_event_id_t id, char *key, char *value, int len)
+{
+    if (!c->handler) return;
+    esp_http_client_event_t evt = {
+        .event_id = id, .client = c, .user_data = c->user_data,
+        .header_key = key, .header_value = value, .data_len = len,
+    };
+    c->handler(&evt);
+}
+
+/* "http://host[:port]/path"; https is refused (no TLS on the host) */
+static esp_err_t parse_url(const char *url, char *host, int *port, char *path)
+{
+    if (!url) return ESP_ERR_INVALID_ARG;
+    if (strncasecmp(url, "https://", 8) == 0) {
+        ESP_LOGE(TAG, "https is not supported on the host: %s", url);
+        return ESP_ERR_HTTP_INVALID_TRANSPORT;
+    }
+    if (strncasecmp(url, "http://", 7) != 0) return ESP_ERR_INVALID_ARG;
+    const char *h = url + 7;
+    size_t hlen = strcspn(h, ":/");
+    if (hlen == 0 || hlen >= HTTP_HOST_LEN) return ESP_ERR_INVALID_ARG;
+    memcpy(host, h, hlen);
+    host[hlen] = '\0';
+    const char *p = h + hlen;
+    *port = 80;
+    if (*p == ':') {
+        *port = (int)strtol(p + 1, (char **)&p, 10);
+        if (*port <= 0 || *port > 65535) return ESP_ERR_INVALID_ARG;
+    }
+    snprintf(path, HTTP_PATH_LEN, "%s", *p ? p : "/");
+    return ESP_OK;
+}
+
+static void set_timeouts(esp_http_client_handle_t c)
+{
+    if (c->fd < 0) return;
+    struct timeval tv = { .tv_sec = c->timeout_ms / 1000, .tv_usec = (c->timeout_ms % 1000) * 1000 };
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static esp_err_t http_connect(esp_http_client_handle_t c)
+{
+    char port[8];
+    snprintf(port, sizeof(port), "%d", c->port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res = NULL;
+    if (getaddrinfo(c->host, port, &hints, &res) != 0 || !res) {
+        ESP_LOGE(TAG, "Cannot resolve %s", c->host);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Connection to %s:%d failed: %s", c->host, c->port, strerror(errno));
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->fd = fd;
+    set_timeouts(c);
+    emit(c, HTTP_EVENT_ON_CONNECTED, NULL, NULL, 0);
+    return ESP_OK;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (!config) return NULL;
+    esp_http_client_handle_t c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->fd = -1;
+    c->handler = config->event_handler;
+    c->user_data = config->user_data;
+    c->method = config->method;
+    c->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    c->rx_size = config->buffer_size > 0 ? config->buffer_size : HTTP_DEFAULT_BUF;
+    c->rx = malloc(c->rx_size);
+    if (!c->rx || parse_url(config->url, c->host, &c->port, c->path) != ESP_OK) {
+        free(c->rx);
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+        emit(client, HTTP_EVENT_DISCONNECTED, NULL, NULL, 0);
+    }
+    client->rx_pos = client->rx_len = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (!client) return ESP_FAIL;
+    esp_http_client_close(client);
+    free(client->rx);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    char host[HTTP_HOST_LEN];
+    int port;
+    esp_err_t err = parse_url(url, host, &port, client->path);
+    if (err != ESP_OK) return err;
+    if (strcasecmp(host, client->host) != 0 || port != client->port) {
+        esp_http_client_close(client);
+        strcpy(client->host, host);
+        client->port = port;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_get_user_data(esp_http_client_handle_t client, void **data)
+{
+    if (!client || !data) return ESP_ERR_INVALID_ARG;
+    *data = client->user_data;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if (!client || !key || !value || strlen(key) >= HTTP_KEY_LEN || strlen(value) >= HTTP_VALUE_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int slot = -1;
+    for (int i = 0; i < HTTP_MAX_HEADERS; i++) {
+        if (strcasecmp(client->hdr[i].key, key) == 0) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && !client->hdr[i].key[0]) slot = i;
+    }
+    if (slot < 0) return ESP_ERR_NO_MEM;
+    strcpy(client->hdr[slot].key, key);
+    strcpy(client->hdr[slot].value, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    if (!client || !key) return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < HTTP_MAX_HEADERS; i++) {
+        if (client->hdr[i].key[0] && strcasecmp(client->hdr[i].key, key) == 0) client->hdr[i].key[0] = '\0';
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms)
+{
+    if (!client || timeout_ms <= 0) return ESP_ERR_INVALID_ARG;
+    client->timeout_ms = timeout_ms;
+    set_timeouts(client);
+    return ESP_OK;
+}
+
+static bool body_done(esp_http_client_handle_t c)
+{
+    return c->no_body || (c->content_len >= 0 ? c->body_read >= c->content_len : c->eof);
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    /* Reuse the connection only after a complete response */
+    if (client->fd >= 0 && (!body_done(client) || client->close_after || client->eof)) {
+        esp_http_client_close(client);
+    }
+    if (client->fd < 0) {
+        esp_err_t err = http_connect(client);
+        if (err != ESP_OK) {
+            emit(client, HTTP_EVENT_ERROR, NULL, NULL, 0);
+            return err;
+        }
+    }
+    client->status = 0;
+    client->content_len = -1;
+    client->body_read = 0;
+    client->no_body = client->close_after = client->eof = client->finished = false;
+
+    static const char *const methods[] = { [HTTP_METHOD_GET] = "GET", [HTTP_METHOD_POST] = "POST",
+                                           [HTTP_METHOD_HEAD] = "HEAD" };
+    char req[2048];
+    int n = snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n",
+                     methods[client->method], client->path, client->host, client->port);
+    for (int i = 0; i < HTTP_MAX_HEADERS; i++) {
+        if (client->hdr[i].key[0]) {
+            n += snprintf(req + n, sizeof(req) - n, "%s: %s\r\n", client->hdr[i].key, client->hdr[i].value);
+        }
+    }
+    if (write_len > 0) n += snprintf(req + n, sizeof(req) - n, "Content-Length: %d\r\n", write_len);
+    n += snprintf(req + n, sizeof(req) - n, "\r\n");
+
+    for (int sent = 0; sent < n;) {
+        ssize_t w = send(client->fd, req + sent, n - sent, MSG_NOSIGNAL);
+        if (w <= 0) {
+            ESP_LOGD(TAG, "Request send failed: %s", strerror(errno));
+            esp_http_client_close(client);
+            return ESP_ERR_HTTP_WRITE_DATA;
+        }
+        sent += w;
+    }
+    client->rx_pos = client->rx_len = 0;
+    emit(client, HTTP_EVENT_HEADER_SENT, NULL, NULL, 0);
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    if (!client || client->fd < 0) return ESP_FAIL;
+    /* Everything up to the blank line must fit in the receive buffer */
+    char *end = NULL;
+    while (!end) {
+        if (client->rx_len >= client->rx_size - 1) {
+            ESP_LOGE(TAG, "Response headers larger than %d bytes", client->rx_size);
+            return ESP_FAIL;
+        }
+        ssize_t r = recv(client->fd, client->rx + client->rx_len, client->rx_size - 1 - client->rx_len, 0);
+        if (r <= 0) {
+            ESP_LOGD(TAG, "Connection closed before the response headers");
+            esp_http_client_close(client);
+            return ESP_FAIL;
+        }
+        client->rx_len += r;
+        client->rx[client->rx_len] = '\0';
+        end = strstr(client->rx, "\r\n\r\n");
+    }
+    *end = '\0';
+    client->rx_pos = end + 4 - client->rx;
+
+    char *save = NULL;
+    char *line = strtok_r(client->rx, "\r\n", &save);
+    if (!line || sscanf(line, "HTTP/%*d.%*d %d", &client->status) != 1) {
+        ESP_LOGE(TAG, "Bad status line");
+        return ESP_FAIL;
+    }
+    while ((line = strtok_r(NULL, "\r\n", &save))) {
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_len = strtoll(value, NULL, 10);
+        } else if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0) {
+            client->close_after = true;
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "identity") != 0) {
+            ESP_LOGE(TAG, "Transfer-Encoding %s is not supported on the host", value);
+            return ESP_FAIL;
+        }
+        emit(client, HTTP_EVENT_ON_HEADER, line, value, 0);
+    }
+    client->no_body = client->method == HTTP_METHOD_HEAD || client->status == 204 || client->status == 304 ||
+                      client->status / 100 == 1;
+    return client->content_len >= 0 ? client->content_len : 0;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (!client || !buffer || len < 0) return -1;
+    int got = 0;
+    while (got < len && !body_done(client)) {
+        int want = len - got;
+        if (client->content_len >= 0 && client->content_len - client->body_read < want) {
+            want = (int)(client->content_len - client->body_read);
+        }
+        int n;
+        if (client->rx_pos < client->rx_len) {
+            n = client->rx_len - client->rx_pos < want ? client->rx_len - client->rx_pos : want;
+            memcpy(buffer + got, client->rx + client->rx_pos, n);
+            client->rx_pos += n;
+        } else if (client->fd < 0) {
+            client->eof = true;
+            break;
+        } else {
+            ssize_t r = recv(client->fd, buffer + got, want, 0);
+            if (r < 0) {
+                ESP_LOGE(TAG, "Body read failed: %s", strerror(errno));
+                emit(client, HTTP_EVENT_ERROR, NULL, NULL, 0);
+                esp_http_client_close(client);
+                return got ? got : -1;
+            }
+            if (r == 0) {
+                client->eof = true;
+                break;
+            }
+            n = (int)r;
+        }
+        emit(client, HTTP_EVENT_ON_DATA, NULL, NULL, n);
+        got += n;
+        client->body_read += n;
+        /* One read per call once something arrived, like the transport */
+        if (client->rx_pos >= client->rx_len) break;
+    }
+    if (body_done(client) && !client->finished) {
+        client->finished = true;
+        emit(client, HTTP_EVENT_ON_FINISH, NULL, NULL, 0);
+    }
+    return got;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return client && body_done(client);
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client ? client->status : -1;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    char buf[512];
+    int total = 0;
+    while (!body_done(client)) {
+        int n = esp_http_client_read(client, buf, sizeof(buf));
+        if (n < 0) return ESP_FAIL;
+        if (n == 0) break;
+        total += n;
+    }
+    if (len) *len = total;
+    return body_done(client) ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,421 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_http_server.c
+ * @brief Host shim: HTTP server with URI handlers and async requests, enough for ota_peer
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * One server thread, as the httpd task: it accepts, reads one request head
+ * at a time and runs the handler. Keep-alive connections are served until
+ * the client closes them or a handler fails. A request handed to
+ * httpd_req_async_handler_begin() owns its socket until completed, and the
+ * server skips that socket meanwhile. No request bodies, no chunked
+ * responses. With lru_purge_enable, a new connection over max_open_sockets
+ * closes the least recently used idle one, otherwise it is refused.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "lwip/sockets.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#define HEAD_MAX        2048
+#define RESP_HDRS       8
+
+static const char *TAG = "httpd";
+
+struct conn {
+    int     fd;                 /* -1: free */
+    bool    busy;               /* owned by an async request */
+    int64_t used_us;            /* last request, for the LRU purge */
+};
+
+struct httpd {
+    httpd_config_t cfg;
+    int listen_fd;
+    int wake[2];                /* async completions wake the poll */
+    pthread_t thread;
+    volatile bool stop;
+    pthread_mutex_t lock;
+    httpd_uri_t *uris;
+    int n_uris;
+    struct conn *conns;
+};
+
+struct req_aux {
+    struct httpd *srv;
+    int conn;
+    int fd;
+    char head[HEAD_MAX];
+    const char *status;
+    const char *hdr[RESP_HDRS][2];
+    int n_hdr;
+    bool async;
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void conn_close(struct httpd *s, int i)
+{
+    if (s->conns[i].fd >= 0) close(s->conns[i].fd);
+    s->conns[i].fd = -1;
+    s->conns[i].busy = false;
+}
+
+/* Request head up to the blank line, nothing of the next request; length or -1 */
+static int read_head(int fd, char *buf, size_t cap)
+{
+    for (int waited_ms = 0;;) {
+        ssize_t n = recv(fd, buf, cap - 1, MSG_PEEK);
+        if (n <= 0) return -1;
+        buf[n] = '\0';
+        char *end = strstr(buf, "\r\n\r\n");
+        if (end) {
+            size_t len = end + 4 - buf;
+            if (recv(fd, buf, len, MSG_WAITALL) != (ssize_t)len) return -1;
+            buf[len] = '\0';
+            return (int)len;
+        }
+        if ((size_t)n == cap - 1 || waited_ms >= 5000) return -1;
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        poll(&p, 1, 1);
+        waited_ms++;
+    }
+}
+
+static const httpd_uri_t *find_handler(struct httpd *s, const char *uri, int method)
+{
+    size_t len = strcspn(uri, "?");
+    for (int i = 0; i < s->n_uris; i++) {
+        if ((int)s->uris[i].method == method && strlen(s->uris[i].uri) == len &&
+            strncmp(s->uris[i].uri, uri, len) == 0) {
+            return &s->uris[i];
+        }
+    }
+    return NULL;
+}
+
+static void serve_request(struct httpd *s, int i)
+{
+    httpd_req_t *req = calloc(1, sizeof(*req));
+    struct req_aux *aux = calloc(1, sizeof(*aux));
+    if (!req || !aux || read_head(s->conns[i].fd, aux->head, sizeof(aux->head)) < 0) {
+        free(req);
+        free(aux);
+        pthread_mutex_lock(&s->lock);
+        conn_close(s, i);
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+    aux->srv = s;
+    aux->conn = i;
+    aux->fd = s->conns[i].fd;
+    req->handle = s;
+    req->aux = aux;
+
+    char method[8] = "";
+    sscanf(aux->head, "%7s %512s", method, req->uri);
+    req->method = strcmp(method, "GET") == 0 ? HTTP_GET : strcmp(method, "HEAD") == 0 ? HTTP_HEAD :
+                  strcmp(method, "POST") == 0 ? HTTP_POST : strcmp(method, "PUT") == 0 ? HTTP_PUT :
+                  strcmp(method, "DELETE") == 0 ? HTTP_DELETE : -1;
+    const httpd_uri_t *h = find_handler(s, req->uri, req->method);
+    esp_err_t err;
+    if (h) {
+        req->user_ctx = h->user_ctx;
+        err = h->handler(req);
+    } else {
+        httpd_resp_set_status(req, "404 Not Found");
+        err = httpd_resp_send(req, NULL, 0);
+    }
+    char conn_hdr[16];
+    bool close_req = httpd_req_get_hdr_value_str(req, "Connection", conn_hdr, sizeof(conn_hdr)) == ESP_OK &&
+                     strcasecmp(conn_hdr, "close") == 0;
+
+    pthread_mutex_lock(&s->lock);
+    s->conns[i].used_us = now_us();
+    if (!aux->async && (err != ESP_OK || close_req)) conn_close(s, i);
+    pthread_mutex_unlock(&s->lock);
+    free(aux);
+    free(req);
+}
+
+static void accept_conn(struct httpd *s)
+{
+    int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    struct timeval tv = { .tv_sec = s->cfg.send_wait_timeout };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    tv.tv_sec = s->cfg.recv_wait_timeout;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    pthread_mutex_lock(&s->lock);
+    int slot = -1, lru = -1;
+    for (int i = 0; i < s->cfg.max_open_sockets; i++) {
+        if (s->conns[i].fd < 0) {
+            slot = i;
+            break;
+        }
+        if (!s->conns[i].busy && (lru < 0 || s->conns[i].used_us < s->conns[lru].used_us)) lru = i;
+    }
+    if (slot < 0 && s->cfg.lru_purge_enable && lru >= 0) {
+        ESP_LOGD(TAG, "Purging the least recently used connection");
+        conn_close(s, lru);
+        slot = lru;
+    }
+    if (slot >= 0) {
+        s->conns[slot] = (struct conn){ .fd = fd, .used_us = now_us() };
+    } else {
+        close(fd);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void *server_main(void *arg)
+{
+    struct httpd *s = arg;
+    int n_max = s->cfg.max_open_sockets + 2;
+    struct pollfd *p = calloc(n_max, sizeof(*p));
+    int *idx = calloc(n_max, sizeof(*idx));
+    while (p && idx && !s->stop) {
+        int n = 0;
+        p[n++] = (struct pollfd){ .fd = s->listen_fd, .events = POLLIN };
+        p[n++] = (struct pollfd){ .fd = s->wake[0], .events = POLLIN };
+        pthread_mutex_lock(&s->lock);
+        for (int i = 0; i < s->cfg.max_open_sockets; i++) {
+            if (s->conns[i].fd < 0 || s->conns[i].busy) continue;
+            idx[n] = i;
+            p[n++] = (struct pollfd){ .fd = s->conns[i].fd, .events = POLLIN };
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (poll(p, n, -1) < 0 && errno != EINTR) break;
+
+        if (p[1].revents) {
+            char drain[16];
+            while (read(s->wake[0], drain, sizeof(drain)) == sizeof(drain)) {
+            }
+        }
+        for (int k = 2; k < n; k++) {
+            if (p[k].revents) serve_request(s, idx[k]);
+        }
+        if (p[0].revents & POLLIN) accept_conn(s);
+    }
+    free(p);
+    free(idx);
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    if (!handle || !config || config->max_open_sockets == 0) return ESP_ERR_INVALID_ARG;
+    struct httpd *s = calloc(1, sizeof(*s));
+    if (!s) return ESP_ERR_NO_MEM;
+    s->cfg = *config;
+    s->conns = calloc(config->max_open_sockets, sizeof(*s->conns));
+    s->uris = calloc(config->max_uri_handlers, sizeof(*s->uris));
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    pthread_mutex_init(&s->lock, NULL);
+    for (int i = 0; s->conns && i < config->max_open_sockets; i++) s->conns[i].fd = -1;
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config->server_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (!s->conns || !s->uris || s->listen_fd < 0 || pipe(s->wake) != 0 ||
+        bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(s->listen_fd, config->backlog_conn) != 0) {
+        ESP_LOGE(TAG, "Error starting server on port %u: %s", config->server_port, strerror(errno));
+        if (s->listen_fd >= 0) close(s->listen_fd);
+        free(s->conns);
+        free(s->uris);
+        free(s);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    fcntl(s->wake[0], F_SETFL, O_NONBLOCK);
+    if (pthread_create(&s->thread, NULL, server_main, s) != 0) {
+        close(s->listen_fd);
+        free(s->conns);
+        free(s->uris);
+        free(s);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    *handle = s;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    struct httpd *s = handle;
+    if (!s) return ESP_ERR_INVALID_ARG;
+    s->stop = true;
+    if (write(s->wake[1], "", 1) < 0) return ESP_FAIL;
+    pthread_join(s->thread, NULL);
+    for (int i = 0; i < s->cfg.max_open_sockets; i++) conn_close(s, i);
+    close(s->listen_fd);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    free(s->conns);
+    free(s->uris);
+    free(s);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    struct httpd *s = handle;
+    if (!s || !uri_handler || !uri_handler->uri || !uri_handler->handler) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s->lock);
+    esp_err_t err = ESP_ERR_HTTPD_HANDLERS_FULL;
+    if (s->n_uris < s->cfg.max_uri_handlers) {
+        s->uris[s->n_uris++] = *uri_handler;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return err;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return r && r->aux ? ((struct req_aux *)r->aux)->fd : -1;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    if (!r || !field || !val || val_size == 0) return ESP_ERR_INVALID_ARG;
+    struct req_aux *aux = r->aux;
+    size_t flen = strlen(field);
+    for (const char *line = strstr(aux->head, "\r\n"); line && line[2] != '\r'; line = strstr(line + 2, "\r\n")) {
+        const char *name = line + 2;
+        if (strncasecmp(name, field, flen) != 0 || name[flen] != ':') continue;
+        const char *v = name + flen + 1;
+        while (*v == ' ' || *v == '\t') v++;
+        size_t len = strcspn(v, "\r");
+        size_t copy = len < val_size - 1 ? len : val_size - 1;
+        memcpy(val, v, copy);
+        val[copy] = '\0';
+        return copy < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    if (!r || !status) return ESP_ERR_INVALID_ARG;
+    ((struct req_aux *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    if (!r || !field || !value) return ESP_ERR_INVALID_ARG;
+    struct req_aux *aux = r->aux;
+    if (aux->n_hdr == RESP_HDRS) return ESP_ERR_HTTPD_RESP_HDR;
+    aux->hdr[aux->n_hdr][0] = field;
+    aux->hdr[aux->n_hdr][1] = value;
+    aux->n_hdr++;
+    return ESP_OK;
+}
+
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
+{
+    if (!r || (!buf && buf_len)) return HTTPD_SOCK_ERR_FAIL;
+    ssize_t n = send(httpd_req_to_sockfd(r), buf, buf_len, MSG_NOSIGNAL);
+    return n < 0 ? HTTPD_SOCK_ERR_FAIL : (int)n;
+}
+
+static esp_err_t send_all(httpd_req_t *r, const char *buf, size_t len)
+{
+    while (len > 0) {
+        int n = httpd_send(r, buf, len);
+        if (n <= 0) return ESP_ERR_HTTPD_RESP_SEND;
+        buf += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (!r) return ESP_ERR_INVALID_ARG;
+    struct req_aux *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = buf ? (ssize_t)strlen(buf) : 0;
+    char head[1024];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: text/html\r\nContent-Length: %zd\r\n",
+                     aux->status ? aux->status : "200 OK", buf_len);
+    for (int i = 0; i < aux->n_hdr && n < (int)sizeof(head); i++) {
+        n += snprintf(head + n, sizeof(head) - n, "%s: %s\r\n", aux->hdr[i][0], aux->hdr[i][1]);
+    }
+    if (n < (int)sizeof(head)) n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    if (n >= (int)sizeof(head)) return ESP_ERR_HTTPD_RESP_HDR;
+    esp_err_t err = send_all(r, head, n);
+    if (err == ESP_OK && buf_len > 0) err = send_all(r, buf, buf_len);
+    return err;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out)
+{
+    if (!r || !out) return ESP_ERR_INVALID_ARG;
+    struct req_aux *aux = r->aux;
+    httpd_req_t *copy = malloc(sizeof(*copy));
+    struct req_aux *copy_aux = malloc(sizeof(*copy_aux));
+    if (!copy || !copy_aux) {
+        free(copy);
+        free(copy_aux);
+        return ESP_ERR_NO_MEM;
+    }
+    *copy = *r;
+    *copy_aux = *aux;
+    copy->aux = copy_aux;
+    aux->async = true;
+    pthread_mutex_lock(&aux->srv->lock);
+    aux->srv->conns[aux->conn].busy = true;
+    pthread_mutex_unlock(&aux->srv->lock);
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r)
+{
+    if (!r) return ESP_ERR_INVALID_ARG;
+    struct req_aux *aux = r->aux;
+    struct httpd *s = aux->srv;
+    pthread_mutex_lock(&s->lock);
+    if (s->conns[aux->conn].fd == aux->fd) {
+        s->conns[aux->conn].busy = false;
+        s->conns[aux->conn].used_us = now_us();
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (write(s->wake[1], "", 1) < 0) ESP_LOGW(TAG, "Wake failed: %s", strerror(errno));
+    free(aux);
+    free(r);
+    return ESP_OK;
+}
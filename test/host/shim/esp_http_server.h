@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_http_server.h
+ * @brief Host shim: HTTP server with URI handlers and async requests, enough for ota_peer
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_HTTPD_BASE          0xb000
+#define ESP_ERR_HTTPD_HANDLERS_FULL (ESP_ERR_HTTPD_BASE + 1)
+#define ESP_ERR_HTTPD_RESULT_TRUNC  (ESP_ERR_HTTPD_BASE + 4)
+#define ESP_ERR_HTTPD_RESP_HDR      (ESP_ERR_HTTPD_BASE + 5)
+#define ESP_ERR_HTTPD_RESP_SEND     (ESP_ERR_HTTPD_BASE + 6)
+#define ESP_ERR_HTTPD_TASK          (ESP_ERR_HTTPD_BASE + 8)
+
+#define HTTPD_RESP_USE_STRLEN       -1
+#define HTTPD_SOCK_ERR_FAIL         -1
+#define HTTPD_MAX_URI_LEN           512
+
+typedef void *httpd_handle_t;
+
+enum http_method { HTTP_DELETE, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT };
+typedef enum http_method httpd_method_t;
+
+typedef struct {
+    unsigned task_priority;
+    size_t   stack_size;
+    int      core_id;
+    uint16_t server_port;
+    uint16_t ctrl_port;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    uint16_t max_resp_headers;
+    uint16_t backlog_conn;
+    bool     lru_purge_enable;
+    uint16_t recv_wait_timeout;
+    uint16_t send_wait_timeout;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {                                                        \
+    .task_priority = 5, .stack_size = 4096, .core_id = 0x7FFFFFFF, .server_port = 80,   \
+    .ctrl_port = 32768, .max_open_sockets = 7, .max_uri_handlers = 8,                   \
+    .max_resp_headers = 8, .backlog_conn = 5, .lru_purge_enable = false,                \
+    .recv_wait_timeout = 5, .send_wait_timeout = 5,                                     \
+}
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int            method;          /*!< enum http_method */
+    char           uri[HTTPD_MAX_URI_LEN + 1];
+    size_t         content_len;
+    void          *aux;             /*!< Shim: connection and response state */
+    void          *user_ctx;
+} httpd_req_t;
+
+typedef struct {
+    const char    *uri;
+    httpd_method_t method;
+    esp_err_t    (*handler)(httpd_req_t *r);
+    void          *user_ctx;
+} httpd_uri_t;
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler);
+
+int httpd_req_to_sockfd(httpd_req_t *r);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len);
+
+/* The copy owns the socket until completed: the server reads no further request from it meanwhile */
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r);
+
+#ifdef __cplusplus
+}
+#endif
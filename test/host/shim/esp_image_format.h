@@ -0,0 +1,83 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_image_format.h
+ * @brief Host shim: app image format and its verification
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_IMAGE_HEADER_MAGIC  0xE9
+#define ESP_IMAGE_MAX_SEGMENTS  16
+#define ESP_ERR_IMAGE_BASE      0x2000
+#define ESP_ERR_IMAGE_FLASH_FAIL (ESP_ERR_IMAGE_BASE + 1)
+#define ESP_ERR_IMAGE_INVALID   (ESP_ERR_IMAGE_BASE + 2)
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  segment_count;
+    uint8_t  spi_mode;
+    uint8_t  spi_speed_size;
+    uint32_t entry_addr;
+    uint8_t  wp_pin;
+    uint8_t  spi_pin_drv[3];
+    uint16_t chip_id;
+    uint8_t  min_chip_rev;
+    uint16_t min_chip_rev_full;
+    uint16_t max_chip_rev_full;
+    uint8_t  reserved[4];
+    uint8_t  hash_appended;
+} __attribute__((packed)) esp_image_header_t;
+
+typedef struct {
+    uint32_t load_addr;
+    uint32_t data_len;
+} esp_image_segment_header_t;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} esp_partition_pos_t;
+
+typedef struct {
+    uint32_t start_addr;
+    esp_image_header_t image;
+    uint32_t image_len;
+    uint8_t  image_digest[32];
+} esp_image_metadata_t;
+
+typedef enum {
+    ESP_IMAGE_VERIFY,
+    ESP_IMAGE_VERIFY_SILENT,
+} esp_image_load_mode_t;
+
+/* Header, segments, checksum and appended SHA-256 of the image at part->offset */
+esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data);
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,348 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_partition.c
+ * @brief Host shim: partitions, OTA slots and image verification over a flash image file
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * Flash layout (addresses are offsets in the file named by OTA_HOST_FLASH, or
+ * in memory when it is not set):
+ *   0x00d000  otadata  8 KB     boot slot record
+ *   0x010000  ota_0    1 MB     running app
+ *   0x110000  ota_1    1 MB     update slot
+ *
+ * Flash rules are kept: erases are sector aligned and set 0xFF, writes can only
+ * clear bits (a write over data that was not erased is logged).
+ */
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "mbedtls/sha256.h"
+
+static const char *TAG = "host_flash";
+
+#define SECTOR_SIZE     4096
+#define SLOT_SIZE       0x100000
+#define FLASH_SIZE      (0x110000 + SLOT_SIZE)
+#define BOOT_NONE       0xffffffffu
+
+static const esp_partition_t s_parts[] = {
+    { .type = ESP_PARTITION_TYPE_DATA, .subtype = ESP_PARTITION_SUBTYPE_DATA_OTA, .address = 0xd000,
+      .size = 0x2000, .erase_size = SECTOR_SIZE, .label = "otadata" },
+    { .type = ESP_PARTITION_TYPE_APP, .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0, .address = 0x10000,
+      .size = SLOT_SIZE, .erase_size = SECTOR_SIZE, .label = "ota_0" },
+    { .type = ESP_PARTITION_TYPE_APP, .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_1, .address = 0x110000,
+      .size = SLOT_SIZE, .erase_size = SECTOR_SIZE, .label = "ota_1" },
+};
+#define PART_OTADATA    (&s_parts[0])
+#define PART_OTA_0      (&s_parts[1])
+#define PART_OTA_1      (&s_parts[2])
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_fd = -1;
+static uint8_t *s_mem;          /* used when no flash file is given */
+
+/* Call with s_lock held */
+static esp_err_t flash_open(void)
+{
+    if (s_fd >= 0 || s_mem) return ESP_OK;
+    const char *path = getenv("OTA_HOST_FLASH");
+    if (!path || !path[0]) {
+        s_mem = malloc(FLASH_SIZE);
+        if (!s_mem) return ESP_ERR_NO_MEM;
+        memset(s_mem, 0xff, FLASH_SIZE);
+        return ESP_OK;
+    }
+    s_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (s_fd < 0) {
+        ESP_LOGE(TAG, "Cannot open flash file %s", path);
+        return ESP_FAIL;
+    }
+    off_t len = lseek(s_fd, 0, SEEK_END);
+    if (len < FLASH_SIZE) {
+        /* A new file reads as erased flash */
+        static const uint8_t ff[SECTOR_SIZE] = { [0 ... SECTOR_SIZE - 1] = 0xff };
+        for (off_t pos = len & ~(off_t)(SECTOR_SIZE - 1); pos < FLASH_SIZE; pos += SECTOR_SIZE) {
+            if (pwrite(s_fd, ff, SECTOR_SIZE, pos) != SECTOR_SIZE) return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t flash_read(uint32_t addr, void *dst, size_t size)
+{
+    if (s_mem) {
+        memcpy(dst, s_mem + addr, size);
+        return ESP_OK;
+    }
+    return pread(s_fd, dst, size, addr) == (ssize_t)size ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t flash_program(uint32_t addr, const void *src, size_t size)
+{
+    if (s_mem) {
+        memcpy(s_mem + addr, src, size);
+        return ESP_OK;
+    }
+    return pwrite(s_fd, src, size, addr) == (ssize_t)size ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t check_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    if (!part) return ESP_ERR_INVALID_ARG;
+    if (offset > part->size || size > part->size - offset) return ESP_ERR_INVALID_SIZE;
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (size_t i = 0; i < sizeof(s_parts) / sizeof(s_parts[0]); i++) {
+        const esp_partition_t *p = &s_parts[i];
+        if (type != ESP_PARTITION_TYPE_ANY && p->type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && p->subtype != subtype) continue;
+        if (label && strcmp(p->label, label) != 0) continue;
+        return p;
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    esp_err_t err = check_range(partition, src_offset, size);
+    if (err != ESP_OK) return err;
+    pthread_mutex_lock(&s_lock);
+    err = flash_open();
+    if (err == ESP_OK) err = flash_read(partition->address + src_offset, dst, size);
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    esp_err_t err = check_range(partition, dst_offset, size);
+    if (err != ESP_OK) return err;
+    uint8_t *cur = malloc(size ? size : 1);
+    if (!cur) return ESP_ERR_NO_MEM;
+    const uint8_t *in = src;
+    uint32_t addr = partition->address + dst_offset;
+
+    pthread_mutex_lock(&s_lock);
+    err = flash_open();
+    if (err == ESP_OK) err = flash_read(addr, cur, size);
+    if (err == ESP_OK) {
+        bool unerased = false;
+        for (size_t i = 0; i < size; i++) {
+            if ((cur[i] & in[i]) != in[i]) unerased = true;
+            cur[i] &= in[i];
+        }
+        if (unerased) ESP_LOGW(TAG, "Write over data not erased at 0x%" PRIx32 "+%u", addr, (unsigned)size);
+        err = flash_program(addr, cur, size);
+    }
+    pthread_mutex_unlock(&s_lock);
+    free(cur);
+    return err;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    esp_err_t err = check_range(partition, offset, size);
+    if (err != ESP_OK) return err;
+    if (offset % SECTOR_SIZE || size % SECTOR_SIZE) return ESP_ERR_INVALID_ARG;
+    static const uint8_t ff[SECTOR_SIZE] = { [0 ... SECTOR_SIZE - 1] = 0xff };
+
+    pthread_mutex_lock(&s_lock);
+    err = flash_open();
+    for (size_t pos = 0; err == ESP_OK && pos < size; pos += SECTOR_SIZE) {
+        err = flash_program(partition->address + offset + pos, ff, SECTOR_SIZE);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+static esp_err_t sha256_range(const esp_partition_t *part, size_t len, uint8_t *out)
+{
+    uint8_t buf[SECTOR_SIZE];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    esp_err_t err = ESP_OK;
+    for (size_t pos = 0; err == ESP_OK && pos < len; pos += sizeof(buf)) {
+        size_t n = len - pos < sizeof(buf) ? len - pos : sizeof(buf);
+        err = esp_partition_read(part, pos, buf, n);
+        if (err == ESP_OK) mbedtls_sha256_update(&ctx, buf, n);
+    }
+    if (err == ESP_OK) mbedtls_sha256_finish(&ctx, out);
+    mbedtls_sha256_free(&ctx);
+    return err;
+}
+
+static const esp_partition_t *slot_of(uint32_t offset)
+{
+    for (size_t i = 0; i < sizeof(s_parts) / sizeof(s_parts[0]); i++) {
+        if (s_parts[i].type == ESP_PARTITION_TYPE_APP && s_parts[i].address == offset) return &s_parts[i];
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    if (!partition || !sha_256) return ESP_ERR_INVALID_ARG;
+    if (slot_of(partition->address) == partition) {
+        /* App slots: digest of the image, as on the target */
+        esp_image_metadata_t md;
+        esp_partition_pos_t pos = { .offset = partition->address, .size = partition->size };
+        esp_err_t err = esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &pos, &md);
+        if (err == ESP_OK) memcpy(sha_256, md.image_digest, sizeof(md.image_digest));
+        return err;
+    }
+    /* Raw regions (bootloader): the partition struct is the caller's */
+    uint8_t buf[SECTOR_SIZE];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = flash_open();
+    for (uint32_t pos = 0; err == ESP_OK && pos < partition->size; pos += sizeof(buf)) {
+        size_t n = partition->size - pos < sizeof(buf) ? partition->size - pos : sizeof(buf);
+        err = flash_read(partition->address + pos, buf, n);
+        if (err == ESP_OK) mbedtls_sha256_update(&ctx, buf, n);
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (err == ESP_OK) mbedtls_sha256_finish(&ctx, sha_256);
+    mbedtls_sha256_free(&ctx);
+    return err;
+}
+
+esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data)
+{
+    const esp_partition_t *slot = part ? slot_of(part->offset) : NULL;
+    if (!slot || !data) return ESP_ERR_INVALID_ARG;
+    memset(data, 0, sizeof(*data));
+    data->start_addr = part->offset;
+
+    esp_err_t err = esp_partition_read(slot, 0, &data->image, sizeof(data->image));
+    if (err != ESP_OK) return ESP_ERR_IMAGE_FLASH_FAIL;
+    if (data->image.magic != ESP_IMAGE_HEADER_MAGIC || data->image.segment_count == 0 ||
+        data->image.segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+        if (mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "Bad image header (magic 0x%02x)", data->image.magic);
+        return ESP_ERR_IMAGE_INVALID;
+    }
+
+    /* Segments: the checksum is the XOR of their data bytes, seeded with 0xEF */
+    uint8_t checksum = 0xef;
+    uint8_t buf[SECTOR_SIZE];
+    uint32_t pos = sizeof(esp_image_header_t);
+    for (int s = 0; s < data->image.segment_count; s++) {
+        esp_image_segment_header_t seg;
+        if (esp_partition_read(slot, pos, &seg, sizeof(seg)) != ESP_OK ||
+            seg.data_len > slot->size - pos - sizeof(seg)) {
+            if (mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "Segment %d runs past the partition", s);
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        pos += sizeof(seg);
+        for (uint32_t done = 0; done < seg.data_len;) {
+            uint32_t n = seg.data_len - done < sizeof(buf) ? seg.data_len - done : sizeof(buf);
+            if (esp_partition_read(slot, pos + done, buf, n) != ESP_OK) return ESP_ERR_IMAGE_FLASH_FAIL;
+            for (uint32_t i = 0; i < n; i++) checksum ^= buf[i];
+            done += n;
+        }
+        pos += seg.data_len;
+    }
+    /* Padded so that the checksum byte ends a 16 byte block */
+    pos |= 15;
+    uint8_t stored;
+    if (pos >= slot->size || esp_partition_read(slot, pos, &stored, 1) != ESP_OK || stored != checksum) {
+        if (mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "Image checksum mismatch");
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    data->image_len = pos + 1;
+
+    if (sha256_range(slot, data->image_len, data->image_digest) != ESP_OK) return ESP_ERR_IMAGE_FLASH_FAIL;
+    if (data->image.hash_appended) {
+        uint8_t appended[32];
+        if (data->image_len + sizeof(appended) > slot->size ||
+            esp_partition_read(slot, data->image_len, appended, sizeof(appended)) != ESP_OK ||
+            memcmp(appended, data->image_digest, sizeof(appended)) != 0) {
+            if (mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "Appended image SHA-256 mismatch");
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        data->image_len += sizeof(appended);
+    }
+    return ESP_OK;
+}
+
+/* Header walk of the target without the checks: the verify pass is cheap enough on the host */
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata)
+{
+    return esp_image_verify(ESP_IMAGE_VERIFY_SILENT, part, metadata);
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return PART_OTA_0;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    if (!start_from) start_from = esp_ota_get_running_partition();
+    return start_from == PART_OTA_0 ? PART_OTA_1 : PART_OTA_0;
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+    uint32_t subtype = BOOT_NONE;
+    if (esp_partition_read(PART_OTADATA, 0, &subtype, sizeof(subtype)) != ESP_OK || subtype == BOOT_NONE) {
+        return PART_OTA_0;
+    }
+    const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_APP, (esp_partition_subtype_t)subtype,
+                                                        NULL);
+    return p ? p : PART_OTA_0;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    if (!partition || partition->type != ESP_PARTITION_TYPE_APP) return ESP_ERR_INVALID_ARG;
+    esp_image_metadata_t md;
+    esp_partition_pos_t pos = { .offset = partition->address, .size = partition->size };
+    if (esp_image_verify(ESP_IMAGE_VERIFY, &pos, &md) != ESP_OK) return ESP_ERR_OTA_VALIDATE_FAILED;
+
+    uint32_t subtype = partition->subtype;
+    esp_err_t err = esp_partition_erase_range(PART_OTADATA, 0, SECTOR_SIZE);
+    if (err == ESP_OK) err = esp_partition_write(PART_OTADATA, 0, &subtype, sizeof(subtype));
+    return err;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *ota_state)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_shim.c
+ * @brief Host shim: error names, logging and heap
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+#if defined(__SANITIZE_ADDRESS__)
+size_t __sanitizer_get_current_allocated_bytes(void);  /* <sanitizer/allocator_interface.h>, not always installed */
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
+#include "esp_image_format.h"
+#include "esp_netif.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    static const struct { esp_err_t code; const char *name; } names[] = {
+        { ESP_OK, "ESP_OK" },
+        { ESP_FAIL, "ESP_FAIL" },
+        { ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM" },
+        { ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG" },
+        { ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE" },
+        { ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE" },
+        { ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND" },
+        { ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED" },
+        { ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT" },
+        { ESP_ERR_INVALID_RESPONSE, "ESP_ERR_INVALID_RESPONSE" },
+        { ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC" },
+        { ESP_ERR_INVALID_VERSION, "ESP_ERR_INVALID_VERSION" },
+        { ESP_ERR_NVS_NOT_FOUND, "ESP_ERR_NVS_NOT_FOUND" },
+        { ESP_ERR_NVS_NO_FREE_PAGES, "ESP_ERR_NVS_NO_FREE_PAGES" },
+        { ESP_ERR_NVS_NEW_VERSION_FOUND, "ESP_ERR_NVS_NEW_VERSION_FOUND" },
+        { ESP_ERR_NVS_INVALID_HANDLE, "ESP_ERR_NVS_INVALID_HANDLE" },
+        { ESP_ERR_NVS_INVALID_LENGTH, "ESP_ERR_NVS_INVALID_LENGTH" },
+        { ESP_ERR_NVS_NOT_ENOUGH_SPACE, "ESP_ERR_NVS_NOT_ENOUGH_SPACE" },
+        { ESP_ERR_NVS_READ_ONLY, "ESP_ERR_NVS_READ_ONLY" },
+        { ESP_ERR_OTA_VALIDATE_FAILED, "ESP_ERR_OTA_VALIDATE_FAILED" },
+        { ESP_ERR_IMAGE_FLASH_FAIL, "ESP_ERR_IMAGE_FLASH_FAIL" },
+        { ESP_ERR_IMAGE_INVALID, "ESP_ERR_IMAGE_INVALID" },
+        { ESP_ERR_HTTP_CONNECT, "ESP_ERR_HTTP_CONNECT" },
+        { ESP_ERR_HTTP_WRITE_DATA, "ESP_ERR_HTTP_WRITE_DATA" },
+        { ESP_ERR_HTTP_FETCH_HEADER, "ESP_ERR_HTTP_FETCH_HEADER" },
+        { ESP_ERR_HTTP_INVALID_TRANSPORT, "ESP_ERR_HTTP_INVALID_TRANSPORT" },
+        { ESP_ERR_HTTP_EAGAIN, "ESP_ERR_HTTP_EAGAIN" },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (names[i].code == code) return names[i].name;
+    }
+    return "UNKNOWN ERROR";
+}
+
+static esp_log_level_t log_level(void)
+{
+    static int level = -1;
+    if (level < 0) {
+        const char *env = getenv("OTA_HOST_LOG");
+        const char *pos = env && env[0] ? strchr("NEWIDV", env[0]) : NULL;
+        level = pos ? (int)(pos - "NEWIDV") : ESP_LOG_INFO;
+    }
+    return (esp_log_level_t)level;
+}
+
+static host_log_hook_t s_log_hook;
+
+void host_log_set_hook(host_log_hook_t hook)
+{
+    __atomic_store_n(&s_log_hook, hook, __ATOMIC_RELEASE);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list ap;
+    host_log_hook_t hook = __atomic_load_n(&s_log_hook, __ATOMIC_ACQUIRE);
+    if (hook) {
+        char line[512];
+        va_start(ap, format);
+        vsnprintf(line, sizeof(line), format, ap);
+        va_end(ap);
+        hook(level, line);
+        return;
+    }
+    if (level > log_level()) return;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+/* Free heap of a nominal HOST_HEAP_SIZE heap: only differences (a peak during a run) mean
+ * something. AddressSanitizer replaces malloc: its allocator reports the bytes in use. */
+#define HOST_HEAP_SIZE  (64u * 1024 * 1024)
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+#if defined(__SANITIZE_ADDRESS__)
+    size_t used = __sanitizer_get_current_allocated_bytes();
+#elif defined(__GLIBC__)
+    size_t used = mallinfo2().uordblks;
+#else
+    size_t used = HOST_HEAP_SIZE;
+#endif
+    return used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return 0;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* The host "reboot" ends the process: the next run starts from the saved flash and NVS */
+void esp_restart(void)
+{
+    fflush(NULL);
+    exit(0);
+}
+
+/* Like the hardware RNG, a different sequence in every process (peers shuffle with it) */
+uint32_t esp_random(void)
+{
+    uint32_t r;
+    if (getrandom(&r, sizeof(r), 0) != (ssize_t)sizeof(r)) r = (uint32_t)random();
+    return r;
+}
+
+/* Version of the running image: OTA_HOST_VERSION, for the update check */
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static esp_app_desc_t desc = { .project_name = "ota_host", .idf_ver = "host" };
+    if (!desc.version[0]) {
+        const char *env = getenv("OTA_HOST_VERSION");
+        snprintf(desc.version, sizeof(desc.version), "%s", env && env[0] ? env : "0.0.0");
+    }
+    return &desc;
+}
+
+esp_err_t esp_netif_get_netif_impl_name(esp_netif_t *esp_netif, char *name)
+{
+    strcpy(name, "lo");
+    return ESP_OK;
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file esp_timer.c
+ * @brief Host shim: esp_timer one-shot and periodic timers on a dispatcher thread
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Armed timers are kept in a list; the dispatcher thread sleeps until the
+ * earliest expiry and runs the callbacks one at a time, outside the lock.
+ * esp_timer_delete() of a timer whose callback is running waits for it, unless
+ * called from that callback.
+ */
+
+struct esp_timer {
+    esp_timer_cb_t    callback;
+    void             *arg;
+    struct esp_timer *next;         /* armed list */
+    int64_t           alarm_us;
+    uint64_t          period_us;    /* 0: one-shot */
+    bool              armed;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond;       /* list changed / callback finished */
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static pthread_t s_thread;
+static struct esp_timer *s_armed;
+static struct esp_timer *s_running;
+
+static void unlink_timer(struct esp_timer *t)
+{
+    for (struct esp_timer **p = &s_armed; *p; p = &(*p)->next) {
+        if (*p == t) {
+            *p = t->next;
+            break;
+        }
+    }
+    t->armed = false;
+}
+
+static void *dispatcher(void *arg)
+{
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        struct esp_timer *first = s_armed;
+        for (struct esp_timer *t = s_armed; t; t = t->next) {
+            if (t->alarm_us < first->alarm_us) first = t;
+        }
+        if (!first) {
+            pthread_cond_wait(&s_cond, &s_lock);
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        if (first->alarm_us > now) {
+            struct timespec ts = { .tv_sec = first->alarm_us / 1000000, .tv_nsec = first->alarm_us % 1000000 * 1000 };
+            pthread_cond_timedwait(&s_cond, &s_lock, &ts);
+            continue;
+        }
+        if (first->period_us) {
+            first->alarm_us += first->period_us;
+            if (first->alarm_us < now) first->alarm_us = now + first->period_us;   /* skip missed expiries */
+        } else {
+            unlink_timer(first);
+        }
+        s_running = first;
+        pthread_mutex_unlock(&s_lock);
+        first->callback(first->arg);
+        pthread_mutex_lock(&s_lock);
+        s_running = NULL;
+        pthread_cond_broadcast(&s_cond);
+    }
+    return NULL;
+}
+
+/* esp_timer_get_time() is CLOCK_MONOTONIC: the dispatcher waits on that clock */
+static void start_dispatcher(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_create(&s_thread, NULL, dispatcher, NULL);
+    pthread_detach(s_thread);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    if (!args || !args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (!t) return ESP_ERR_NO_MEM;
+    t->callback = args->callback;
+    t->arg = args->arg;
+    pthread_once(&s_once, start_dispatcher);
+    *out_handle = t;
+    return ESP_OK;
+}
+
+static esp_err_t arm(esp_timer_handle_t t, uint64_t timeout_us, uint64_t period_us)
+{
+    if (!t) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (!t->armed) {
+        t->alarm_us = esp_timer_get_time() + (int64_t)timeout_us;
+        t->period_us = period_us;
+        t->armed = true;
+        t->next = s_armed;
+        s_armed = t;
+        pthread_cond_broadcast(&s_cond);
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return period ? arm(timer, period, period) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = timer->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (timer->armed) {
+        unlink_timer(timer);
+        pthread_cond_broadcast(&s_cond);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    while (s_running == timer && !pthread_equal(pthread_self(), s_thread)) {
+        pthread_cond_wait(&s_cond, &s_lock);
+    }
+    pthread_mutex_unlock(&s_lock);
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&s_lock);
+    bool armed = timer && timer->armed;
+    pthread_mutex_unlock(&s_lock);
+    return armed;
+}
+
+void esp_timer_isr_dispatch_need_yield(void)
+{
+}
@@ -0,0 +1,506 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file freertos.c
+ * @brief Host shim: FreeRTOS tasks, notifications and queues over POSIX threads
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Scheduling is left to the host: priorities and core affinity are recorded
+ * only. The parts of the kernel semantics the firmware relies on are kept:
+ * - a handle is valid before the new task runs
+ * - deleting another task is synchronous, its TCB and stack are free on return
+ * - a static task or queue lives in the buffers it was given
+ */
+
+struct shim_task {
+    pthread_t       thread;
+    bool            has_thread;
+    bool            is_static;
+    TaskFunction_t  fn;
+    void           *arg;
+    char            name[16];
+    UBaseType_t     prio;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    uint32_t        notify;
+    eTaskState      state;
+    bool            delete_req;
+};
+
+struct shim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    uint8_t        *storage;
+    bool            is_static;
+    UBaseType_t     length;
+    UBaseType_t     item_size;
+    UBaseType_t     head;
+    UBaseType_t     count;
+};
+
+_Static_assert(sizeof(struct shim_task) <= sizeof(StaticTask_t), "StaticTask_t too small");
+_Static_assert(sizeof(struct shim_queue) <= sizeof(StaticQueue_t), "StaticQueue_t too small");
+
+static __thread struct shim_task *t_self;
+static pthread_mutex_t s_create_lock = PTHREAD_MUTEX_INITIALIZER;
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+int esp_cpu_get_core_id(void)
+{
+    return (int)xPortGetCoreID();
+}
+
+static void deadline(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec += ns % 1000000000ULL;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Wait on cond until woken or the deadline; false on timeout */
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *ts)
+{
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, ts) != ETIMEDOUT;
+}
+
+static void task_init(struct shim_task *t, TaskFunction_t fn, const char *name, void *arg, UBaseType_t prio)
+{
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+    t->prio = prio;
+    t->state = eReady;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "");
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init(&t->cond);
+}
+
+static struct shim_task *self(void)
+{
+    if (!t_self) {
+        /* A thread the shim did not start (main): give it a TCB on first use */
+        t_self = calloc(1, sizeof(*t_self));
+        task_init(t_self, NULL, "main", NULL, 1);
+        t_self->state = eRunning;
+    }
+    return t_self;
+}
+
+static void task_exit(struct shim_task *t)
+{
+    pthread_mutex_lock(&t->lock);
+    t->state = eDeleted;
+    bool joined = t->delete_req;    /* vTaskDelete() from another task joins and frees */
+    pthread_mutex_unlock(&t->lock);
+    if (!joined) {
+        pthread_detach(pthread_self());
+        if (!t->is_static) free(t);
+    }
+    pthread_exit(NULL);
+}
+
+static void *task_main(void *arg)
+{
+    struct shim_task *t = arg;
+    t_self = t;
+    pthread_mutex_lock(&s_create_lock);     /* creator published the handle */
+    pthread_mutex_unlock(&s_create_lock);
+    t->state = eRunning;
+    t->fn(t->arg);
+    fprintf(stderr, "shim: task %s returned\n", t->name);
+    abort();
+}
+
+static BaseType_t task_start(struct shim_task *t)
+{
+    t->has_thread = true;
+    if (pthread_create(&t->thread, NULL, task_main, t) != 0) {
+        t->has_thread = false;
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *created, BaseType_t core)
+{
+    struct shim_task *t = malloc(sizeof(*t));
+    if (!t) return pdFAIL;
+    task_init(t, fn, name, arg, prio);
+    pthread_mutex_lock(&s_create_lock);
+    if (created) *created = t;
+    BaseType_t ret = task_start(t);
+    pthread_mutex_unlock(&s_create_lock);
+    if (ret != pdPASS) {
+        if (created) *created = NULL;
+        free(t);
+    }
+    return ret;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                           UBaseType_t prio, StackType_t *stack, StaticTask_t *tcb, BaseType_t core)
+{
+    if (!stack || !tcb) return NULL;
+    /* The host thread has its own stack: fill the given one so overlapping buffers show up */
+    memset(stack, 0xa5, stack_depth);
+    struct shim_task *t = (struct shim_task *)tcb;
+    task_init(t, fn, name, arg, prio);
+    t->is_static = true;
+    pthread_mutex_lock(&s_create_lock);
+    BaseType_t ret = task_start(t);
+    pthread_mutex_unlock(&s_create_lock);
+    return ret == pdPASS ? t : NULL;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    struct shim_task *me = self();
+    if (!task || task == me) task_exit(me);
+
+    pthread_mutex_lock(&task->lock);
+    if (task->state == eDeleted) {      /* already gone on its own */
+        pthread_mutex_unlock(&task->lock);
+        return;
+    }
+    task->delete_req = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    /* Returns once the thread is gone: the caller may reuse the static buffers */
+    if (task->has_thread) pthread_join(task->thread, NULL);
+    if (!task->is_static) free(task);
+}
+
+/* Called with t->lock held in every blocking point: a pending delete ends the task */
+static void check_delete(struct shim_task *t)
+{
+    if (t->delete_req) {
+        pthread_mutex_unlock(&t->lock);
+        task_exit(t);
+    }
+}
+
+void vTaskSuspend(TaskHandle_t task)
+{
+    struct shim_task *t = task ? task : self();
+    pthread_mutex_lock(&t->lock);
+    t->state = eSuspended;
+    if (t == self()) {
+        while (t->state == eSuspended) {
+            check_delete(t);
+            pthread_cond_wait(&t->cond, &t->lock);
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    if (task->state == eSuspended) task->state = eReady;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+eTaskState eTaskGetState(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    eTaskState state = task->state;
+    pthread_mutex_unlock(&task->lock);
+    return state;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { .tv_sec = ticks / configTICK_RATE_HZ,
+                           .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * portTICK_PERIOD_MS * 1000000L };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((uint64_t)ts.tv_sec * configTICK_RATE_HZ + ts.tv_nsec / (1000000L * portTICK_PERIOD_MS));
+}
+
+void vTaskSetTimeOutState(TimeOut_t *timeout)
+{
+    timeout->entered = xTaskGetTickCount();
+}
+
+/* pdTRUE once ticks_to_wait have passed since the state was set; otherwise the rest is left in it */
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticks_to_wait)
+{
+    if (*ticks_to_wait == portMAX_DELAY) return pdFALSE;
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - timeout->entered;
+    if (elapsed >= *ticks_to_wait) {
+        *ticks_to_wait = 0;
+        return pdTRUE;
+    }
+    *ticks_to_wait -= elapsed;
+    timeout->entered = now;
+    return pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return self();
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : self())->name;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return (task ? task : self())->prio;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t prio)
+{
+    (task ? task : self())->prio = prio;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return 0;
+}
+
+static int64_t clock_us(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) return 0;
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct shim_task s_idle[portNUM_PROCESSORS];
+static pthread_once_t s_idle_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t s_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t s_idle_epoch;
+static uint32_t s_idle_last;
+
+static void idle_init(void)
+{
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        task_init(&s_idle[core], NULL, core ? "IDLE1" : "IDLE0", NULL, 0);
+        s_idle[core].state = eReady;
+    }
+    s_idle_epoch = clock_us(CLOCK_MONOTONIC);
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core)
+{
+    pthread_once(&s_idle_once, idle_init);
+    return core >= 0 && core < portNUM_PROCESSORS ? &s_idle[core] : NULL;
+}
+
+uint32_t ulTaskGetRunTimeCounter(TaskHandle_t task)
+{
+    pthread_once(&s_idle_once, idle_init);
+    if (task >= &s_idle[0] && task < &s_idle[portNUM_PROCESSORS]) {
+        /* Each idle task: its core's share of the wall time the process did not spend on a CPU.
+         * Kept monotonic should the host run more than portNUM_PROCESSORS threads at once. */
+        int64_t wall = clock_us(CLOCK_MONOTONIC) - s_idle_epoch;
+        int64_t idle = wall - clock_us(CLOCK_PROCESS_CPUTIME_ID) / portNUM_PROCESSORS;
+        pthread_mutex_lock(&s_idle_lock);
+        if (idle > (int64_t)s_idle_last) s_idle_last = (uint32_t)idle;
+        uint32_t ret = s_idle_last;
+        pthread_mutex_unlock(&s_idle_lock);
+        return ret;
+    }
+    clockid_t clock = CLOCK_THREAD_CPUTIME_ID;
+    if (task != self() && (!task->has_thread || pthread_getcpuclockid(task->thread, &clock) != 0)) return 0;
+    return (uint32_t)clock_us(clock);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+/* Interrupts are played by plain threads: no context switch to request */
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct shim_task *t = self();
+    struct timespec ts;
+    deadline(&ts, ticks);
+    pthread_mutex_lock(&t->lock);
+    t->state = eBlocked;
+    while (t->notify == 0) {
+        check_delete(t);
+        if (ticks == 0 || !cond_wait(&t->cond, &t->lock, ticks, &ts)) break;
+    }
+    uint32_t value = t->notify;
+    if (value) t->notify = clear ? 0 : value - 1;
+    t->state = eRunning;
+    pthread_mutex_unlock(&t->lock);
+    return value;
+}
+
+static void queue_init(struct shim_queue *q, UBaseType_t length, UBaseType_t item_size, uint8_t *storage)
+{
+    memset(q, 0, sizeof(*q));
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->cond);
+    q->length = length;
+    q->item_size = item_size;
+    q->storage = storage;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    if (length == 0) return NULL;
+    struct shim_queue *q = malloc(sizeof(*q) + (size_t)length * item_size);
+    if (!q) return NULL;
+    queue_init(q, length, item_size, (uint8_t *)(q + 1));
+    return q;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer)
+{
+    if (length == 0 || !buffer || (item_size && !storage)) return NULL;
+    struct shim_queue *q = (struct shim_queue *)buffer;
+    queue_init(q, length, item_size, storage);
+    q->is_static = true;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->cond);
+    if (!q->is_static) free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    struct timespec ts;
+    deadline(&ts, ticks);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (ticks == 0 || !cond_wait(&q->cond, &q->lock, ticks, &ts)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFAIL;
+        }
+    }
+    if (q->item_size) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->storage + (size_t)tail * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    struct timespec ts;
+    deadline(&ts, ticks);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (ticks == 0 || !cond_wait(&q->cond, &q->lock, ticks, &ts)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFAIL;
+        }
+    }
+    if (q->item_size) memcpy(item, q->storage + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    QueueHandle_t q = xQueueCreate(max, 0);
+    if (q) q->count = initial;
+    return q;
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim: FreeRTOS kernel types and macros over POSIX threads
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t  StackType_t;   /* stack depth in bytes, as on ESP-IDF */
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+#define portMAX_DELAY   ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portNUM_PROCESSORS  2
+#define tskNO_AFFINITY      ((BaseType_t)0x7fffffff)
+#define configMAX_PRIORITIES 25
+
+/* Static objects are sized to hold the shim's own task/queue structures */
+typedef struct { _Alignas(16) uint8_t opaque[512]; } StaticTask_t;
+typedef struct { _Alignas(16) uint8_t opaque[256]; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+/* Critical sections: one recursive mutex per lock */
+typedef struct { pthread_mutex_t mutex; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+#define portENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(x)       ((void)(x))
+#define taskENTER_CRITICAL(mux)     portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)      portEXIT_CRITICAL(mux)
+
+BaseType_t xPortGetCoreID(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file semphr.h
+ * @brief Host shim: FreeRTOS semaphores (queues of empty items, as in the kernel)
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#pragma once
+
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+#define xSemaphoreCreateBinary()    xSemaphoreCreateCounting(1, 0)
+#define xSemaphoreCreateMutex()     xSemaphoreCreateCounting(1, 1)
+#define xSemaphoreTake(sem, ticks)  xQueueReceive(sem, NULL, ticks)
+#define xSemaphoreGive(sem)         xQueueSend(sem, NULL, 0)
+#define vSemaphoreDelete(sem)       vQueueDelete(sem)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio.c
+ * @brief Host shim: GPIO inputs driven by the test, with per-pin ISR handlers
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "driver/gpio.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+#define HOST_CPU_MHZ    240
+
+static struct {
+    int level;
+    gpio_int_type_t intr;
+    gpio_isr_t handler;
+    void *arg;
+} s_pin[GPIO_NUM_MAX];
+static bool s_service;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec) * HOST_CPU_MHZ / 1000);
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return HOST_CPU_MHZ;
+}
+
+static bool valid(gpio_num_t gpio)
+{
+    return gpio >= 0 && gpio < GPIO_NUM_MAX;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+    return valid(gpio) ? __atomic_load_n(&s_pin[gpio].level, __ATOMIC_ACQUIRE) : 0;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type)
+{
+    if (!valid(gpio)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    s_pin[gpio].intr = type;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    pthread_mutex_lock(&s_lock);
+    bool installed = s_service;
+    s_service = true;
+    pthread_mutex_unlock(&s_lock);
+    return installed ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+    if (!valid(gpio) || !handler) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = s_service ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK) {
+        s_pin[gpio].handler = handler;
+        s_pin[gpio].arg = arg;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio)
+{
+    if (!valid(gpio)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    s_pin[gpio].handler = NULL;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+void host_gpio_set_level(gpio_num_t gpio, int level)
+{
+    if (!valid(gpio)) return;
+    level = level ? 1 : 0;
+    pthread_mutex_lock(&s_lock);
+    int old = s_pin[gpio].level;
+    __atomic_store_n(&s_pin[gpio].level, level, __ATOMIC_RELEASE);
+    gpio_int_type_t intr = s_pin[gpio].intr;
+    gpio_isr_t handler = s_pin[gpio].handler;
+    void *arg = s_pin[gpio].arg;
+    pthread_mutex_unlock(&s_lock);
+
+    bool edge = level != old && (intr == GPIO_INTR_ANYEDGE || (intr == GPIO_INTR_POSEDGE && level) ||
+                                 (intr == GPIO_INTR_NEGEDGE && !level));
+    if (edge && handler) handler(arg);
+}
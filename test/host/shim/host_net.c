@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file host_net.c
+ * @brief Host shim: loopback LAN of device processes (see lwip/sockets.h)
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#define HOST_NET_IMPL
+#include "lwip/sockets.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* OTA_HOST_IP in network order, INADDR_ANY when not set */
+static in_addr_t own_ip(void)
+{
+    const char *env = getenv("OTA_HOST_IP");
+    struct in_addr a;
+    return env && inet_aton(env, &a) ? a.s_addr : htonl(INADDR_ANY);
+}
+
+/* Addresses of OTA_HOST_LAN ("first-last", host order); false when not set */
+static bool lan_range(uint32_t *first, uint32_t *last)
+{
+    const char *env = getenv("OTA_HOST_LAN");
+    char a[16], b[16];
+    struct in_addr ia, ib;
+    if (!env || sscanf(env, "%15[0-9.]-%15[0-9.]", a, b) != 2 || !inet_aton(a, &ia) || !inet_aton(b, &ib)) {
+        return false;
+    }
+    *first = ntohl(ia.s_addr);
+    *last = ntohl(ib.s_addr);
+    return *first <= *last;
+}
+
+int host_net_bind(int sock, const struct sockaddr *addr, socklen_t len)
+{
+    struct sockaddr_in in;
+    if (addr->sa_family == AF_INET && len >= sizeof(in)) {
+        memcpy(&in, addr, sizeof(in));
+        if (in.sin_addr.s_addr == htonl(INADDR_ANY)) in.sin_addr.s_addr = own_ip();
+        int on = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        return bind(sock, (struct sockaddr *)&in, sizeof(in));
+    }
+    return bind(sock, addr, len);
+}
+
+ssize_t host_net_sendto(int sock, const void *buf, size_t len, int flags, const struct sockaddr *to,
+                        socklen_t tolen)
+{
+    in_addr_t ip = own_ip();
+    if (ip == htonl(INADDR_ANY) || to->sa_family != AF_INET) return sendto(sock, buf, len, flags, to, tolen);
+
+    struct sockaddr_in self;
+    socklen_t slen = sizeof(self);
+    if (getsockname(sock, (struct sockaddr *)&self, &slen) == 0 && self.sin_port == 0) {
+        struct sockaddr_in any = { .sin_family = AF_INET, .sin_addr.s_addr = ip };
+        bind(sock, (struct sockaddr *)&any, sizeof(any));
+    }
+    struct sockaddr_in dst;
+    memcpy(&dst, to, sizeof(dst));
+    uint32_t first, last;
+    if (dst.sin_addr.s_addr != htonl(INADDR_BROADCAST) || !lan_range(&first, &last)) {
+        return sendto(sock, buf, len, flags, to, tolen);
+    }
+    for (uint32_t a = first; a <= last; a++) {
+        dst.sin_addr.s_addr = htonl(a);
+        if (dst.sin_addr.s_addr != ip) sendto(sock, buf, len, flags, (struct sockaddr *)&dst, sizeof(dst));
+    }
+    return (ssize_t)len;
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sockets.h
+ * @brief Host shim: lwIP sockets are the POSIX ones, on a loopback LAN of device processes
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * Each device process can have its own loopback address, OTA_HOST_IP
+ * (e.g. 127.0.0.5: Linux routes all of 127/8 to the loopback). A socket
+ * bound to INADDR_ANY is bound to that address instead, and a socket that
+ * sends unbound is bound to it first, so several devices serve the same
+ * ports side by side and see each other's addresses. A datagram sent to
+ * INADDR_BROADCAST is sent to every address of OTA_HOST_LAN
+ * ("127.0.0.2-127.0.0.9") but the own one. Without OTA_HOST_IP the calls
+ * are the plain POSIX ones.
+ */
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int host_net_bind(int sock, const struct sockaddr *addr, socklen_t len);
+ssize_t host_net_sendto(int sock, const void *buf, size_t len, int flags, const struct sockaddr *to,
+                        socklen_t tolen);
+
+#ifndef HOST_NET_IMPL
+#define bind    host_net_bind
+#define sendto  host_net_sendto
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,244 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file nvs.c
+ * @brief Host shim: NVS blobs in memory, saved to the file named by OTA_HOST_NVS on commit
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+/*
+ * File format: records of { namespace[16], key[16], u32 length, data }.
+ * Each commit rewrites the whole file (temporary file + rename), so a process
+ * killed mid-download keeps the last committed checkpoint, as on the target.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "host_nvs";
+
+#define NVS_NAME_LEN    16
+#define NVS_MAX_ENTRIES 32
+#define NVS_MAX_HANDLES 8
+
+typedef struct {
+    char ns[NVS_NAME_LEN];
+    char key[NVS_NAME_LEN];
+    uint32_t len;
+    uint8_t *data;
+} nvs_entry_t;
+
+typedef struct {
+    char ns[NVS_NAME_LEN];
+    nvs_open_mode_t mode;
+    bool used;
+} nvs_slot_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvs_entry_t s_entry[NVS_MAX_ENTRIES];
+static nvs_slot_t s_handle[NVS_MAX_HANDLES];    /* handle = index + 1 */
+static bool s_loaded;
+
+/* Call with s_lock held */
+static void nvs_load(void)
+{
+    if (s_loaded) return;
+    s_loaded = true;
+    const char *path = getenv("OTA_HOST_NVS");
+    FILE *f = path && path[0] ? fopen(path, "rb") : NULL;
+    if (!f) return;
+    for (size_t i = 0; i < NVS_MAX_ENTRIES; i++) {
+        nvs_entry_t *e = &s_entry[i];
+        if (fread(e->ns, NVS_NAME_LEN, 1, f) != 1 || fread(e->key, NVS_NAME_LEN, 1, f) != 1 ||
+            fread(&e->len, sizeof(e->len), 1, f) != 1 || !(e->data = malloc(e->len ? e->len : 1)) ||
+            (e->len && fread(e->data, e->len, 1, f) != 1)) {
+            free(e->data);
+            memset(e, 0, sizeof(*e));
+            break;
+        }
+        e->ns[NVS_NAME_LEN - 1] = e->key[NVS_NAME_LEN - 1] = '\0';
+    }
+    fclose(f);
+}
+
+/* Call with s_lock held */
+static esp_err_t nvs_save(void)
+{
+    const char *path = getenv("OTA_HOST_NVS");
+    if (!path || !path[0]) return ESP_OK;
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return ESP_FAIL;
+    bool ok = true;
+    for (size_t i = 0; i < NVS_MAX_ENTRIES && ok; i++) {
+        const nvs_entry_t *e = &s_entry[i];
+        if (!e->data) continue;
+        ok = fwrite(e->ns, NVS_NAME_LEN, 1, f) == 1 && fwrite(e->key, NVS_NAME_LEN, 1, f) == 1 &&
+             fwrite(&e->len, sizeof(e->len), 1, f) == 1 && (!e->len || fwrite(e->data, e->len, 1, f) == 1);
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        ESP_LOGE(TAG, "Cannot save %s", path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static nvs_entry_t *nvs_find(const char *ns, const char *key)
+{
+    for (size_t i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (s_entry[i].data && strcmp(s_entry[i].ns, ns) == 0 && strcmp(s_entry[i].key, key) == 0) {
+            return &s_entry[i];
+        }
+    }
+    return NULL;
+}
+
+static nvs_slot_t *nvs_slot(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > NVS_MAX_HANDLES || !s_handle[handle - 1].used) return NULL;
+    return &s_handle[handle - 1];
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!name || !out_handle || strlen(name) >= NVS_NAME_LEN) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    pthread_mutex_lock(&s_lock);
+    nvs_load();
+    bool exists = false;
+    for (size_t i = 0; i < NVS_MAX_ENTRIES && !exists; i++) {
+        exists = s_entry[i].data && strcmp(s_entry[i].ns, name) == 0;
+    }
+    if (open_mode == NVS_READONLY && !exists) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        for (size_t i = 0; i < NVS_MAX_HANDLES; i++) {
+            if (s_handle[i].used) continue;
+            s_handle[i] = (nvs_slot_t){ .mode = open_mode, .used = true };
+            strcpy(s_handle[i].ns, name);
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_slot_t *slot = nvs_slot(handle);
+    if (slot) slot->used = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (!key || !length) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    nvs_slot_t *slot = nvs_slot(handle);
+    nvs_entry_t *e = slot ? nvs_find(slot->ns, key) : NULL;
+    if (!slot) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (!e) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!out_value) {
+        *length = e->len;
+    } else if (*length < e->len) {
+        *length = e->len;
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, e->data, e->len);
+        *length = e->len;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!key || (!value && length) || strlen(key) >= NVS_NAME_LEN) return ESP_ERR_INVALID_ARG;
+    uint8_t *copy = malloc(length ? length : 1);
+    if (!copy) return ESP_ERR_NO_MEM;
+    if (length) memcpy(copy, value, length);
+
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    nvs_slot_t *slot = nvs_slot(handle);
+    nvs_entry_t *e = slot ? nvs_find(slot->ns, key) : NULL;
+    if (!slot) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (slot->mode == NVS_READONLY) {
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        for (size_t i = 0; i < NVS_MAX_ENTRIES && !e; i++) {
+            if (!s_entry[i].data) e = &s_entry[i];
+        }
+        if (!e) {
+            err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        } else {
+            free(e->data);
+            strcpy(e->ns, slot->ns);
+            strcpy(e->key, key);
+            e->len = length;
+            e->data = copy;
+            copy = NULL;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    free(copy);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (!key) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    nvs_slot_t *slot = nvs_slot(handle);
+    nvs_entry_t *e = slot ? nvs_find(slot->ns, key) : NULL;
+    if (!slot) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (slot->mode == NVS_READONLY) {
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else if (!e) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        free(e->data);
+        memset(e, 0, sizeof(*e));
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = nvs_slot(handle) ? nvs_save() : ESP_ERR_NVS_INVALID_HANDLE;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
@@ -0,0 +1,124 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sdkconfig.h
+ * @brief Host shim: configuration of the host builds (Kconfig defaults, -D overrides)
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#pragma once
+
+#ifndef CONFIG_OTA_ARENA_KB
+#define CONFIG_OTA_ARENA_KB 20
+#endif
+
+/* OTA HAL host build (ota_host): Kconfig defaults, plain HTTP, one connection */
+#ifndef CONFIG_FIRMWARE_UPGRADE_URL
+#define CONFIG_FIRMWARE_UPGRADE_URL ""
+#endif
+#ifndef CONFIG_USE_CERT_BUNDLE
+#define CONFIG_USE_CERT_BUNDLE 1
+#endif
+#ifndef CONFIG_OTA_PIPELINE_BUF_COUNT
+#define CONFIG_OTA_PIPELINE_BUF_COUNT 4
+#endif
+#ifndef CONFIG_OTA_PIPELINE_BUF_SIZE
+#define CONFIG_OTA_PIPELINE_BUF_SIZE 4096
+#endif
+#ifndef CONFIG_OTA_PREERASE_AHEAD_KB
+#define CONFIG_OTA_PREERASE_AHEAD_KB 64
+#endif
+#ifndef CONFIG_OTA_WRITER_CORE
+#define CONFIG_OTA_WRITER_CORE 0
+#endif
+#ifndef CONFIG_OTA_RESUME_ENABLE
+#define CONFIG_OTA_RESUME_ENABLE 1
+#endif
+#ifndef CONFIG_OTA_RESUME_CHECKPOINT_KB
+#define CONFIG_OTA_RESUME_CHECKPOINT_KB 64
+#endif
+#ifndef CONFIG_OTA_RESUME_MAX_RETRIES
+#define CONFIG_OTA_RESUME_MAX_RETRIES 3
+#endif
+#ifndef CONFIG_OTA_STATS_HISTORY_LEN
+#define CONFIG_OTA_STATS_HISTORY_LEN 8
+#endif
+#ifndef CONFIG_OTA_STATS_TCP_PROBE
+#define CONFIG_OTA_STATS_TCP_PROBE 0
+#endif
+#ifndef CONFIG_OTA_CONN_REUSE
+#define CONFIG_OTA_CONN_REUSE 1
+#endif
+#ifndef CONFIG_OTA_CONN_IDLE_S
+#define CONFIG_OTA_CONN_IDLE_S 30
+#endif
+#ifndef CONFIG_OTA_MIRROR_URLS
+#define CONFIG_OTA_MIRROR_URLS ""
+#endif
+#ifndef CONFIG_OTA_MIRROR_PROBE_KB
+#define CONFIG_OTA_MIRROR_PROBE_KB 16
+#endif
+#ifndef CONFIG_OTA_MIRROR_PROBE_TIMEOUT_MS
+#define CONFIG_OTA_MIRROR_PROBE_TIMEOUT_MS 2000
+#endif
+#ifndef CONFIG_OTA_PARALLEL_CONN
+#define CONFIG_OTA_PARALLEL_CONN 1
+#endif
+#ifndef CONFIG_OTA_PARALLEL_RANGE_KB
+#define CONFIG_OTA_PARALLEL_RANGE_KB 8
+#endif
+#ifndef CONFIG_OTA_DECOMP_ENABLE
+#define CONFIG_OTA_DECOMP_ENABLE 1
+#endif
+#ifndef CONFIG_OTA_DECOMP_WINDOW_SZ2
+#define CONFIG_OTA_DECOMP_WINDOW_SZ2 12
+#endif
+#ifndef CONFIG_OTA_DELTA_URL
+#define CONFIG_OTA_DELTA_URL ""         /* ota_host --delta */
+#endif
+#ifndef CONFIG_OTA_BLOCKSYNC_MANIFEST_URL
+#define CONFIG_OTA_BLOCKSYNC_MANIFEST_URL ""    /* ota_host --manifest */
+#endif
+#ifndef CONFIG_OTA_BENCH_REPEAT
+#define CONFIG_OTA_BENCH_REPEAT 3
+#endif
+#ifndef CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1     /* thread CPU clocks, see shim/freertos.c */
+#endif
+
+/* GPIO event ring (test_gpio_evt) */
+#ifndef CONFIG_GPIO_EVT_RING_LEN
+#define CONFIG_GPIO_EVT_RING_LEN 32
+#endif
+
+/* LAN peer distribution (ota_peer_host builds with SERVE and FETCH) */
+#ifndef CONFIG_OTA_PEER_HTTP_PORT
+#define CONFIG_OTA_PEER_HTTP_PORT 8071
+#endif
+#ifndef CONFIG_OTA_PEER_MAX_CLIENTS
+#define CONFIG_OTA_PEER_MAX_CLIENTS 2
+#endif
+#ifndef CONFIG_OTA_PEER_DISCOVER_MS
+#define CONFIG_OTA_PEER_DISCOVER_MS 300
+#endif
+#ifndef CONFIG_OTA_PEER_MAX_TRIES
+#define CONFIG_OTA_PEER_MAX_TRIES 4
+#endif
+#ifndef CONFIG_OTA_PEER_DISCOVERY_PORT
+#define CONFIG_OTA_PEER_DISCOVERY_PORT 8072
+#endif
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sys_mon.c
+ * @brief Host shim: phase tracking of sys_mon (no heap, stack or CPU sampling on the host)
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#include "sys_mon.h"
+
+static volatile sys_mon_phase_t s_phase = SYS_MON_PHASE_RUN;
+
+esp_err_t sys_mon_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t sys_mon_watch_task(TaskHandle_t task, uint32_t stack_size)
+{
+    return ESP_OK;
+}
+
+void sys_mon_unwatch_task(TaskHandle_t task)
+{
+}
+
+void sys_mon_set_phase(sys_mon_phase_t phase)
+{
+    if (phase < SYS_MON_PHASE_MAX) s_phase = phase;
+}
+
+sys_mon_phase_t sys_mon_get_phase(void)
+{
+    return s_phase;
+}
+
+void sys_mon_log_phases(void)
+{
+}
@@ -0,0 +1,196 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file test_gpio_evt.c
+ * @brief Host test: debounce, settle check and SPSC ring of gpio_evt
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "gpio_evt.h"
+#include "host_test.h"
+
+#define RING_LEN        CONFIG_GPIO_EVT_RING_LEN
+#define PIN_BTN         (GPIO_NUM_0 + 4)    /* debounced */
+#define PIN_FAST        (GPIO_NUM_0 + 5)    /* no debounce */
+#define DEBOUNCE_US     20000
+#define SPSC_EDGES      200000
+
+static gpio_evt_t s_ev[2 * RING_LEN];
+
+static gpio_evt_stats_t stats(void)
+{
+    gpio_evt_stats_t st;
+    gpio_evt_get_stats(&st);
+    return st;
+}
+
+/* Drain what is in the ring now */
+static size_t drain(size_t max)
+{
+    return gpio_evt_read(s_ev, max, 0);
+}
+
+/* A press that bounces inside the window is one event, at the level the line settled at */
+static void test_debounce(void)
+{
+    gpio_evt_stats_t st0 = stats();
+    host_gpio_set_level(PIN_BTN, 1);
+    host_gpio_set_level(PIN_BTN, 0);    /* bounce */
+    host_gpio_set_level(PIN_BTN, 1);    /* back at the reported level: no interrupt work */
+    host_gpio_set_level(PIN_BTN, 0);    /* bounce */
+    host_gpio_set_level(PIN_BTN, 1);
+
+    CHECK(drain(RING_LEN) == 1);
+    CHECK(s_ev[0].gpio == PIN_BTN && s_ev[0].level == 1);
+    CHECK(gpio_evt_age_us(&s_ev[0]) < DEBOUNCE_US);
+    gpio_evt_stats_t st = stats();
+    CHECK(st.events == st0.events + 1);
+    CHECK(st.bounces == st0.bounces + 2);
+
+    /* The line ended at the reported level: the settle check after the window adds nothing */
+    CHECK(gpio_evt_read(s_ev, RING_LEN, pdMS_TO_TICKS(3 * DEBOUNCE_US / 1000)) == 0);
+    CHECK(stats().settled == st0.settled);
+}
+
+/* A change swallowed by the window is pushed once the window ends, without waiting for the timeout */
+static void test_settle(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(2 * DEBOUNCE_US / 1000));
+    gpio_evt_stats_t st0 = stats();
+    host_gpio_set_level(PIN_BTN, 0);
+    host_gpio_set_level(PIN_BTN, 1);    /* inside the window, and the line stays there */
+
+    CHECK(gpio_evt_read(s_ev, RING_LEN, pdMS_TO_TICKS(1000)) == 1);
+    CHECK(s_ev[0].level == 0);
+    int64_t t0 = esp_timer_get_time();
+    CHECK(gpio_evt_read(s_ev, RING_LEN, pdMS_TO_TICKS(1000)) == 1);
+    int64_t waited = esp_timer_get_time() - t0;
+    CHECK(s_ev[0].gpio == PIN_BTN && s_ev[0].level == 1);
+    CHECK(waited < 10 * DEBOUNCE_US);
+    gpio_evt_stats_t st = stats();
+    CHECK(st.settled == st0.settled + 1);
+    CHECK(st.bounces == st0.bounces + 1);
+    CHECK(st.events == st0.events + 2);
+}
+
+/* A full ring drops the newest edges and keeps the oldest, in order */
+static void test_overflow(void)
+{
+    gpio_evt_stats_t st0 = stats();
+    for (int i = 0; i < RING_LEN + 5; i++) host_gpio_set_level(PIN_FAST, (i + 1) & 1);
+    gpio_evt_stats_t st = stats();
+    CHECK(st.events == st0.events + RING_LEN);
+    CHECK(st.overflows == st0.overflows + 5);
+
+    CHECK(drain(2 * RING_LEN) == RING_LEN);
+    for (int i = 0; i < RING_LEN; i++) {
+        CHECK(s_ev[i].gpio == PIN_FAST && s_ev[i].level == ((i + 1) & 1));
+        if (i) CHECK((int32_t)(s_ev[i].cycles - s_ev[i - 1].cycles) >= 0);
+    }
+    CHECK(stats().max_batch == RING_LEN);
+
+    /* Drained: the next edge fits again */
+    host_gpio_set_level(PIN_FAST, !gpio_get_level(PIN_FAST));
+    CHECK(drain(2 * RING_LEN) == 1);
+    CHECK(stats().overflows == st0.overflows + 5);
+}
+
+/* Batches smaller than the backlog return it oldest first across calls */
+static void test_batches(void)
+{
+    int level = gpio_get_level(PIN_FAST);
+    for (int i = 0; i < 10; i++) host_gpio_set_level(PIN_FAST, level ^ ((i + 1) & 1));
+    size_t got = 0;
+    for (size_t n; (n = drain(4)) > 0; got += n) {
+        CHECK(n <= 4);
+        for (size_t i = 0; i < n; i++) CHECK(s_ev[i].level == (level ^ (((got + i) + 1) & 1)));
+    }
+    CHECK(got == 10);
+}
+
+static volatile bool s_spsc_done;
+
+/* The interrupt: edges as fast as the pin can toggle, racing the consumer */
+static void *spsc_isr(void *arg)
+{
+    for (int i = 0; i < SPSC_EDGES; i++) host_gpio_set_level(PIN_FAST, !gpio_get_level(PIN_FAST));
+    __atomic_store_n(&s_spsc_done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void test_spsc(void)
+{
+    gpio_evt_stats_t st0 = stats();
+    pthread_t isr;
+    pthread_create(&isr, NULL, spsc_isr, NULL);
+
+    uint32_t got = 0, last = 0, bad = 0;
+    for (;;) {
+        bool done = __atomic_load_n(&s_spsc_done, __ATOMIC_ACQUIRE);
+        size_t n = gpio_evt_read(s_ev, RING_LEN, pdMS_TO_TICKS(10));
+        for (size_t i = 0; i < n; i++) {
+            if (s_ev[i].gpio != PIN_FAST || (got + i && (int32_t)(s_ev[i].cycles - last) < 0)) bad++;
+            last = s_ev[i].cycles;
+        }
+        got += n;
+        if (done && n == 0) break;
+    }
+    pthread_join(isr, NULL);
+
+    gpio_evt_stats_t st = stats();
+    CHECK(bad == 0);
+    CHECK(got == st.events - st0.events);
+    CHECK(got + (st.overflows - st0.overflows) == SPSC_EDGES);
+    CHECK(st.max_batch <= RING_LEN);
+    printf("%d edges: %u delivered, %u dropped by the full ring\n", SPSC_EDGES, got, st.overflows - st0.overflows);
+}
+
+/* A removed pin raises no more events */
+static void test_remove(void)
+{
+    gpio_evt_stats_t st0 = stats();
+    CHECK(gpio_evt_remove_pin(PIN_FAST) == ESP_OK);
+    host_gpio_set_level(PIN_FAST, !gpio_get_level(PIN_FAST));
+    CHECK(drain(RING_LEN) == 0);
+    CHECK(stats().events == st0.events);
+}
+
+int main(void)
+{
+    /* Pins registered before the ring are armed by gpio_evt_init() */
+    CHECK(gpio_evt_add_pin(PIN_BTN, DEBOUNCE_US) == ESP_OK);
+    CHECK(gpio_evt_init() == ESP_OK);
+    CHECK(gpio_evt_add_pin(PIN_FAST, 0) == ESP_OK);
+    CHECK(gpio_evt_add_pin(GPIO_NUM_MAX, 0) == ESP_ERR_INVALID_ARG);
+
+    test_debounce();
+    test_settle();
+    test_overflow();
+    test_batches();
+    test_spsc();
+    test_remove();
+    return host_test_done("gpio_evt");
+}
@@ -0,0 +1,283 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file test_log_ring.c
+ * @brief Host test: record encoding, formatting, wrap-around and drain order of log_ring
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "log_ring.h"
+#include "host_test.h"
+
+#define TAG             "T"
+#define MAX_LINES       32768
+#define WRAP_RECORDS    3000
+#define WRAP_FLUSH      8               /* records between flushes: never fills the ring */
+#define PRODUCERS       4
+#define PER_PRODUCER    5000
+#define PRODUCER_BURST  16
+
+/* Lines printed by the drain task, message part only ("I (ts) T: " cut) */
+static struct {
+    pthread_mutex_t lock;
+    char *msg[MAX_LINES];
+    char level[MAX_LINES];
+    uint32_t ts[MAX_LINES];
+    size_t n;
+    uint32_t drop_lines;
+    uint32_t dropped;
+} s_out = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void capture(esp_log_level_t level, const char *line)
+{
+    char letter;
+    uint32_t ts;
+    int skip = 0;
+    char tag[16];
+    if (sscanf(line, "%c (%" SCNu32 ") %15[^:]: %n", &letter, &ts, tag, &skip) != 3 || !skip) return;
+    const char *msg = line + skip;
+    pthread_mutex_lock(&s_out.lock);
+    if (strcmp(tag, "log_ring") == 0) {
+        uint32_t n;
+        if (sscanf(msg, "%" SCNu32 " records dropped", &n) == 1) {
+            s_out.drop_lines++;
+            s_out.dropped += n;
+        }
+    } else if (strcmp(tag, TAG) == 0 && s_out.n < MAX_LINES) {
+        s_out.msg[s_out.n] = strndup(msg, strcspn(msg, "\n"));
+        s_out.level[s_out.n] = letter;
+        s_out.ts[s_out.n] = ts;
+        s_out.n++;
+    }
+    pthread_mutex_unlock(&s_out.lock);
+}
+
+static void reset_output(void)
+{
+    pthread_mutex_lock(&s_out.lock);
+    for (size_t i = 0; i < s_out.n; i++) free(s_out.msg[i]);
+    s_out.n = 0;
+    s_out.drop_lines = 0;
+    s_out.dropped = 0;
+    pthread_mutex_unlock(&s_out.lock);
+}
+
+static log_ring_stats_t stats(void)
+{
+    log_ring_stats_t st;
+    log_ring_get_stats(&st);
+    return st;
+}
+
+/* Records written before log_ring_init() wait; a full ring drops the newest and counts them */
+static void test_before_init(void)
+{
+    int64_t t0_ms = esp_timer_get_time() / 1000;
+    int written = 0;
+    while (stats().dropped < 3) {
+        LOG_RING(ESP_LOG_INFO, TAG, "early %d", written);
+        written++;
+    }
+    log_ring_stats_t st = stats();
+    CHECK((int)(st.records + st.dropped) == written);
+    CHECK(st.records > 0 && st.records * 32 <= st.ring_size);
+
+    vTaskDelay(pdMS_TO_TICKS(100));
+    CHECK(log_ring_init() == ESP_OK);
+    CHECK(log_ring_flush(pdMS_TO_TICKS(2000)) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));          /* the drop report follows the records */
+
+    CHECK(s_out.n == st.records);
+    for (size_t i = 0; i < s_out.n; i++) {
+        char expect[32];
+        snprintf(expect, sizeof(expect), "early %zu", i);
+        CHECK(strcmp(s_out.msg[i], expect) == 0);
+        CHECK(s_out.level[i] == 'I');
+        CHECK(s_out.ts[i] - (uint32_t)t0_ms < 50);      /* call time, not print time */
+    }
+    CHECK(s_out.drop_lines == 1 && s_out.dropped == st.dropped);
+    CHECK(stats().max_fill <= st.ring_size);
+    reset_output();
+}
+
+/* Every conversion is printed as printf would, from the packed arguments */
+static void test_format(void)
+{
+    char expect[3][256];
+    int64_t big = -((int64_t)1 << 40);
+    uint32_t u32 = 0xFFFFFFF0u;
+    void *ptr = (void *)(intptr_t)0x12345678;
+    LOG_RING(ESP_LOG_WARN, TAG, "i=%d u=%u x=%08x X=%#X c=%c pct=100%% p=%p", -5, 7u, 0xbeefu, 255u, 'Z', ptr);
+    snprintf(expect[0], sizeof(expect[0]), "i=%d u=%u x=%08x X=%#X c=%c pct=100%% p=%p", -5, 7u, 0xbeefu, 255u,
+             'Z', ptr);
+    LOG_RING(ESP_LOG_ERROR, TAG, "%" PRId64 " %" PRIu32 " %" PRIx64 " %.3f %e %g", big, u32, (uint64_t)big,
+             3.14159, 1e-9, 2.5f);
+    snprintf(expect[1], sizeof(expect[1]), "%" PRId64 " %" PRIu32 " %" PRIx64 " %.3f %e %g", big, u32,
+             (uint64_t)big, 3.14159, 1e-9, 2.5f);
+    LOG_RING(ESP_LOG_INFO, TAG, "[%-6s|%*d|%-*.*s|%hhd|%hd|%lu]", "ab", 5, 42, 4, 2, "xyz", 300, 70000, 9ul);
+    snprintf(expect[2], sizeof(expect[2]), "[%-6s|%*d|%-*.*s|%hhd|%hd|%lu]", "ab", 5, 42, 4, 2, "xyz", 300,
+             70000, 9ul);
+    CHECK(log_ring_flush(pdMS_TO_TICKS(1000)) == ESP_OK);
+
+    CHECK(s_out.n == 3);
+    for (size_t i = 0; i < 3 && i < s_out.n; i++) {
+        if (strcmp(s_out.msg[i], expect[i]) != 0) {
+            fprintf(stderr, "got    \"%s\"\nexpect \"%s\"\n", s_out.msg[i], expect[i]);
+            CHECK(0);
+        }
+    }
+    CHECK(s_out.n == 3 && s_out.level[0] == 'W' && s_out.level[1] == 'E' && s_out.level[2] == 'I');
+    reset_output();
+}
+
+/* %s is copied at call time, up to LOG_RING_STR_MAX bytes */
+static void test_strings(void)
+{
+    char buf[LOG_RING_STR_MAX * 2 + 1];
+    memset(buf, 'x', sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    buf[LOG_RING_STR_MAX - 1] = 'y';
+    LOG_RING(ESP_LOG_INFO, TAG, "long [%s]", buf);
+    buf[3] = '\0';
+    LOG_RING(ESP_LOG_INFO, TAG, "short [%s] empty [%s]", buf, "");
+    memset(buf, 'z', sizeof(buf) - 1);      /* after the call: the records keep their copy */
+    CHECK(log_ring_flush(pdMS_TO_TICKS(1000)) == ESP_OK);
+
+    char expect[LOG_RING_STR_MAX + 16] = "long [";
+    memset(expect + 6, 'x', LOG_RING_STR_MAX - 1);
+    strcpy(expect + 6 + LOG_RING_STR_MAX - 1, "y]");
+    CHECK(s_out.n == 2);
+    CHECK(s_out.n > 0 && strcmp(s_out.msg[0], expect) == 0);
+    CHECK(s_out.n > 1 && strcmp(s_out.msg[1], "short [xxx] empty []") == 0);
+    reset_output();
+}
+
+/* More than LOG_RING_MAX_ARGS arguments: the first ones are kept, the rest print as "?" */
+static void test_too_many_args(void)
+{
+    log_ring_arg_t args[LOG_RING_MAX_ARGS + 2];
+    for (int i = 0; i < LOG_RING_MAX_ARGS + 2; i++) {
+        args[i] = (log_ring_arg_t){ .type = LOG_RING_T_INT, .i = i + 1 };
+    }
+    log_ring_write(ESP_LOG_INFO, TAG, "%d %d %d %d %d %d %d %d %d %d %d %d", args, LOG_RING_MAX_ARGS + 2);
+    LOG_RING(ESP_LOG_INFO, TAG, "%d %d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    log_ring_write(ESP_LOG_INFO, TAG, "no args, missing %d", NULL, 0);
+    CHECK(log_ring_flush(pdMS_TO_TICKS(1000)) == ESP_OK);
+
+    CHECK(s_out.n == 3);
+    CHECK(s_out.n > 0 && strcmp(s_out.msg[0], "1 2 3 4 5 6 7 8 9 10 ? ?") == 0);
+    CHECK(s_out.n > 1 && strcmp(s_out.msg[1], "1 2 3 4 5 6 7 8 9 10") == 0);
+    CHECK(s_out.n > 2 && strcmp(s_out.msg[2], "no args, missing ?") == 0);
+    reset_output();
+}
+
+/* Records of every size through many wraps of the ring: none lost, none reordered, none torn */
+static void test_wrap(void)
+{
+    log_ring_stats_t st0 = stats();
+    char str[LOG_RING_STR_MAX + 1];
+    for (int i = 0; i < WRAP_RECORDS; i++) {
+        int len = (i * 7) % (LOG_RING_STR_MAX + 1);
+        memset(str, 'a' + i % 26, len);
+        str[len] = '\0';
+        LOG_RING(ESP_LOG_INFO, TAG, "%d %s %" PRId64, i, str, (int64_t)i * 1000003);
+        if (i % WRAP_FLUSH == WRAP_FLUSH - 1) CHECK(log_ring_flush(pdMS_TO_TICKS(1000)) == ESP_OK);
+    }
+    CHECK(log_ring_flush(pdMS_TO_TICKS(1000)) == ESP_OK);
+
+    log_ring_stats_t st = stats();
+    CHECK(st.dropped == st0.dropped);
+    CHECK(st.records - st0.records == WRAP_RECORDS);
+    CHECK(s_out.n == WRAP_RECORDS);
+    int bad = 0;
+    for (int i = 0; i < WRAP_RECORDS && i < (int)s_out.n; i++) {
+        char expect[LOG_RING_STR_MAX + 48];
+        int len = (i * 7) % (LOG_RING_STR_MAX + 1);
+        memset(str, 'a' + i % 26, len);
+        str[len] = '\0';
+        snprintf(expect, sizeof(expect), "%d %s %" PRId64, i, str, (int64_t)i * 1000003);
+        if (strcmp(s_out.msg[i], expect) != 0) bad++;
+    }
+    CHECK(bad == 0);
+    reset_output();
+}
+
+static void *producer(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    for (int n = 0; n < PER_PRODUCER; n++) {
+        LOG_RING(ESP_LOG_INFO, TAG, "p%d n%d", id, n);
+        if (n % PRODUCER_BURST == 0) usleep(200);     /* bursts: the drain catches up in between */
+    }
+    return NULL;
+}
+
+/* Several producers on one core's ring race on the reservation; each one's records come out in its order */
+static void test_producers(void)
+{
+    log_ring_stats_t st0 = stats();
+    pthread_t th[PRODUCERS];
+    for (int p = 0; p < PRODUCERS; p++) pthread_create(&th[p], NULL, producer, (void *)(intptr_t)p);
+    for (int p = 0; p < PRODUCERS; p++) pthread_join(th[p], NULL);
+    CHECK(log_ring_flush(pdMS_TO_TICKS(2000)) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    log_ring_stats_t st = stats();
+    uint32_t records = st.records - st0.records, dropped = st.dropped - st0.dropped;
+    CHECK(records + dropped == PRODUCERS * PER_PRODUCER);
+    CHECK(s_out.n == records);
+    CHECK(s_out.dropped == dropped);
+    int last[PRODUCERS] = { -1, -1, -1, -1 };
+    int bad = 0;
+    for (size_t i = 0; i < s_out.n; i++) {
+        int p, n;
+        if (sscanf(s_out.msg[i], "p%d n%d", &p, &n) != 2 || p < 0 || p >= PRODUCERS || n <= last[p]) {
+            bad++;
+            continue;
+        }
+        last[p] = n;
+    }
+    CHECK(bad == 0);
+    printf("%d records from %d producers: %" PRIu32 " printed, %" PRIu32 " dropped, ring peak %" PRIu32
+           " of %" PRIu32 " B\n", PRODUCERS * PER_PRODUCER, PRODUCERS, records, dropped, st.max_fill, st.ring_size);
+    reset_output();
+}
+
+int main(void)
+{
+    host_log_set_hook(capture);
+    test_before_init();
+    test_format();
+    test_strings();
+    test_too_many_args();
+    test_wrap();
+    test_producers();
+    host_log_set_hook(NULL);
+    return host_test_done("log_ring");
+}
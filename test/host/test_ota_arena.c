@@ -0,0 +1,218 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file test_ota_arena.c
+ * @brief Host test: OTA session arena over 1000 back-to-back sessions
+ *
+ * @author Marconatale Parise
+ * @date 28 Mar 2026
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "ota_arena.h"
+#include "host_test.h"
+
+/*
+ * Synthetic sessions of arbitrary sizes that fit the 36 KB arena: this test is about
+ * the arena itself. The real pipeline and range workers, with their own stack and
+ * queue sizes, are run back to back by test_ota_sessions.py.
+ */
+#define SESSIONS        1000
+#define WRITER_STACK    4096
+#define ERASER_STACK    3072
+#define WORKER_STACK    8192
+#define MAX_WORKERS     4
+
+/* The shapes of an OTA session: pipeline tasks and queues, range workers, block sync tables */
+typedef struct {
+    int attempts;       /* retries rebuild the tasks in the same blocks */
+    int workers;
+    bool blocksync;
+} shape_t;
+
+static ota_arena_task_t s_writer, s_eraser, s_worker[MAX_WORKERS];
+static ota_arena_block_t s_free_q_mem, s_job_q_mem;
+static QueueHandle_t s_job_q;
+static TaskHandle_t s_owner;
+
+/* Workers: take jobs until NULL, tell the owner, then park for the join */
+static void worker_task(void *arg)
+{
+    int *job;
+    while (xQueueReceive(s_job_q, &job, portMAX_DELAY) == pdTRUE && job) {
+        (*job)++;
+    }
+    xTaskNotifyGive(s_owner);
+    ota_arena_task_exit();
+}
+
+static void idle_task(void *arg)
+{
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xTaskNotifyGive(s_owner);
+    ota_arena_task_exit();
+}
+
+static void stop(ota_arena_task_t *task)
+{
+    xTaskNotifyGive(task->handle);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    ota_arena_task_join(task);
+}
+
+/* One session; returns the address of the writer block */
+static void *session(const shape_t *shape)
+{
+    void *writer_mem = NULL;
+    uint64_t *hash = NULL;
+    uint8_t *blk = NULL;
+    if (shape->blocksync) {
+        hash = ota_arena_alloc(475 * sizeof(uint64_t));
+        blk = ota_arena_alloc(4096);
+        CHECK(hash && blk);
+        memset(hash, 0x5a, 475 * sizeof(uint64_t));
+        ota_arena_free(blk);
+    }
+    for (int a = 0; a < shape->attempts; a++) {
+        CHECK(ota_arena_task_create(&s_eraser, idle_task, "eraser", ERASER_STACK, NULL, 5, 0) == ESP_OK);
+        QueueHandle_t q = ota_arena_queue_create(&s_free_q_mem, 4, sizeof(uint8_t));
+        CHECK(q != NULL);
+        CHECK(ota_arena_task_create(&s_writer, idle_task, "writer", WRITER_STACK, NULL, 5, 0) == ESP_OK);
+        CHECK(ota_arena_task_create(&s_writer, idle_task, "writer", WRITER_STACK, NULL, 5, 0) == ESP_ERR_INVALID_STATE);
+        if (!writer_mem) writer_mem = s_writer.mem.ptr;
+        CHECK(s_writer.mem.ptr == writer_mem);
+
+        if (shape->workers) {
+            s_job_q = ota_arena_queue_create(&s_job_q_mem, shape->workers, sizeof(int *));
+            CHECK(s_job_q != NULL);
+            for (int i = 0; i < shape->workers; i++) {
+                CHECK(ota_arena_task_create(&s_worker[i], worker_task, "range", WORKER_STACK, NULL, 5, 0) == ESP_OK);
+            }
+            int done = 0;
+            int *job = &done, *none = NULL;
+            for (int i = 0; i < 3 * shape->workers; i++) xQueueSend(s_job_q, &job, portMAX_DELAY);
+            for (int i = 0; i < shape->workers; i++) xQueueSend(s_job_q, &none, portMAX_DELAY);
+            for (int i = 0; i < shape->workers; i++) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+            for (int i = 0; i < shape->workers; i++) ota_arena_task_join(&s_worker[i]);
+            vQueueDelete(s_job_q);
+            CHECK(done == 3 * shape->workers);
+        }
+        stop(&s_writer);
+        stop(&s_eraser);
+        vQueueDelete(q);
+    }
+    if (hash) {
+        for (int i = 0; i < 475; i++) CHECK(hash[i] == 0x5a5a5a5a5a5a5a5aULL);   /* not overlapped */
+        ota_arena_free(hash);
+    }
+    return writer_mem;
+}
+
+static void test_sessions(void)
+{
+    static const shape_t shapes[] = {
+        { 1, 0, false }, { 3, 0, false }, { 1, 2, true }, { 2, 0, true }, { 2, 2, false },
+    };
+    const size_t nshapes = sizeof(shapes) / sizeof(shapes[0]);
+    void *addr[sizeof(shapes) / sizeof(shapes[0])] = { 0 };
+    size_t peak[sizeof(shapes) / sizeof(shapes[0])] = { 0 };
+    ota_arena_stats_t st;
+    s_owner = xTaskGetCurrentTaskHandle();
+
+    for (int n = 0; n < SESSIONS; n++) {
+        size_t k = (size_t)n % nshapes;
+        void *a = session(&shapes[k]);
+        ota_arena_get_stats(&st);
+        CHECK(st.used > 0);
+        ota_arena_reset();
+        ota_arena_get_stats(&st);
+        CHECK(st.used == 0);
+        CHECK(st.sessions == (uint32_t)n + 1);
+        CHECK(st.last_failures == 0);
+        /* Repeatable: the same shape lands on the same addresses with the same peak */
+        if (!addr[k]) {
+            addr[k] = a;
+            peak[k] = st.peak;
+        }
+        CHECK(a == addr[k]);
+        CHECK(st.peak == peak[k]);
+    }
+    ota_arena_get_stats(&st);
+    CHECK(st.failures == 0);
+    CHECK(st.peak_max <= st.size);
+    printf("%d sessions: arena %zu B, peak %zu B\n", SESSIONS, st.size, st.peak_max);
+}
+
+static void test_overflow(void)
+{
+    ota_arena_stats_t st;
+    ota_arena_get_stats(&st);
+    uint32_t failures = st.failures;
+
+    /* Four range workers do not fit the arena of two: the excess comes from the heap */
+    const shape_t big = { 2, MAX_WORKERS, true };
+    session(&big);
+    ota_arena_reset();
+    ota_arena_get_stats(&st);
+    CHECK(st.last_failures > 0);
+    CHECK(st.failures == failures + st.last_failures);
+    CHECK(st.peak <= st.size);
+    bool heap = false;
+    for (int i = 0; i < MAX_WORKERS; i++) heap |= s_worker[i].mem.heap;
+    CHECK(heap);
+
+    /* The next session that fits goes back to the arena (heap blocks are freed on reuse) */
+    const shape_t small = { 1, 2, false };
+    session(&small);
+    CHECK(!s_worker[0].mem.heap);
+    CHECK(!s_writer.mem.heap);
+    ota_arena_reset();
+    ota_arena_get_stats(&st);
+    CHECK(st.last_failures == 0);
+}
+
+static void test_reset_with_live_task(void)
+{
+    ota_arena_stats_t st;
+    ota_arena_get_stats(&st);
+    uint32_t sessions = st.sessions;
+
+    CHECK(ota_arena_task_create(&s_writer, idle_task, "writer", WRITER_STACK, NULL, 5, 0) == ESP_OK);
+    ota_arena_reset();      /* refused: the writer stack is still in use */
+    ota_arena_get_stats(&st);
+    CHECK(st.used > 0);
+    CHECK(st.sessions == sessions);
+
+    stop(&s_writer);
+    ota_arena_reset();
+    ota_arena_get_stats(&st);
+    CHECK(st.used == 0);
+    CHECK(st.sessions == sessions + 1);
+}
+
+int main(void)
+{
+    test_sessions();
+    test_overflow();
+    test_reset_with_live_task();
+    return host_test_done("ota_arena");
+}
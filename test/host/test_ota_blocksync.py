@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: block sync (CONFIG_OTA_BLOCKSYNC_ENABLE) through the real OTA HAL
+and main/ota_blocksync.c.
+
+The running slot (ota_0) holds the base image. The new image differs from it
+in a few 4 KB blocks. tools/ota_test_server.py serves the new image, and the
+manifest from tools/ota_blockmap.py next to it (--file).
+
+  1. Only the runs of differing blocks are fetched, one Range request per run,
+     on one connection. The update slot must end up byte-identical, and the
+     whole image SHA-256 from the manifest must be verified.
+  2. A block hash colliding with a local block on the 64 bits the device
+     matches on makes it copy the wrong block. The whole image SHA-256 must
+     reject that image, and the HAL falls back to the full image.
+
+Usage: test_ota_blocksync.py <ota_host binary built with CONFIG_OTA_BLOCKSYNC_ENABLE>
+"""
+import hashlib
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import ROOT, SECTOR, Checker, Device, Server, make_image  # noqa: E402
+
+IMAGE_KB = 256
+BLOCKMAP = os.path.join(ROOT, "tools", "ota_blockmap.py")
+MANIFEST_HEADER = 48        # ota_blocksync_header_t
+HASH_BITS = 64              # block matching in ota_blocksync.c
+
+
+def write(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def blocks(image):
+    return [image[off:off + SECTOR] for off in range(0, len(image), SECTOR)]
+
+
+def expected_ranges(base, image):
+    """Range headers the device must send: one per run of blocks missing from base (64-bit match, any position)."""
+    local = set(hashlib.sha256(b).digest()[:HASH_BITS // 8] for b in blocks(base))
+    missing = [hashlib.sha256(b).digest()[:HASH_BITS // 8] not in local for b in blocks(image)]
+    ranges, i = [], 0
+    while i < len(missing):
+        if not missing[i]:
+            i += 1
+            continue
+        j = i
+        while j < len(missing) and missing[j]:
+            j += 1
+        ranges.append("bytes=%d-%d" % (i * SECTOR, min(j * SECTOR, len(image)) - 1))
+        i = j
+    return ranges, missing.count(False)
+
+
+def session(binary, workdir, name, base, image_path, manifest):
+    """One block sync session on a device running base: (device, exit code, summary, GETs, log)."""
+    devdir = os.path.join(workdir, name)
+    os.mkdir(devdir)
+    dev = Device(binary, devdir)
+    dev.install("ota_0", base)
+    manifest_path = os.path.join(devdir, "fw.obm")
+    write(manifest_path, manifest)
+    with Server(workdir, image_path, "--file", "/fw.obm=" + manifest_path, name=name) as srv:
+        rc, summary = dev.run(srv.url, manifest=srv.url.replace("/fw.bin", "/fw.obm"))
+        gets = srv.requests()
+    with open(dev.log) as f:
+        log = f.read()
+    return dev, rc, summary or {}, gets, log
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_blocksync")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        rnd = random.Random(11)
+        payload = bytearray(rnd.randbytes(IMAGE_KB * 1024))
+        base = make_image(len(payload), 0, payload=bytes(payload))
+        for off, n in ((5 * SECTOR + 100, 6000), (20 * SECTOR, 16), (40 * SECTOR + 2000, 1)):
+            payload[off:off + n] = bytes(b ^ 0xFF for b in payload[off:off + n])
+        image = make_image(len(payload), 0, payload=bytes(payload))
+        image_path = os.path.join(workdir, "fw.bin")
+        manifest_path = os.path.join(workdir, "fw.obm")
+        write(image_path, image)
+        subprocess.run([sys.executable, BLOCKMAP, image_path, manifest_path], check=True, stdout=subprocess.DEVNULL)
+        with open(manifest_path, "rb") as f:
+            manifest = f.read()
+        ranges, local = expected_ranges(base, image)
+
+        # 1. Only the differing blocks are fetched
+        good, rc, summary, gets, log = session(binary, workdir, "sync", base, image_path, manifest)
+        fetched = [g["range"] for g in gets if g["path"] == "/fw.bin"]
+        t.check(rc == 0 and summary.get("result") == "ESP_OK", "block sync succeeds: %s" % summary)
+        t.check(good.slot("ota_1", len(image)) == image, "update slot holds the new image")
+        t.check(summary.get("boot") == "ota_1", "synced image selected for boot")
+        t.check(len(ranges) == 4 and local == len(blocks(image)) - 5,
+                "test image differs in four runs of blocks: %s, %d local" % (ranges, local))
+        t.check(fetched == ranges, "only the differing blocks are fetched: %s, expected %s" % (fetched, ranges))
+        t.check(all(g["status"] == 206 for g in gets if g["path"] == "/fw.bin"), "every range answered with 206")
+        t.check(len([g for g in gets if g["path"] == "/fw.obm"]) == 1, "manifest fetched once")
+        t.check(summary.get("connections") == 1, "one connection for the manifest and the ranges: %s" % summary)
+        t.check("%d of %d blocks available locally" % (local, len(blocks(image))) in log, "device matched the blocks")
+        t.check("Image SHA-256 verified while streaming" in log, "whole image SHA-256 verified")
+        t.check("OTA (block sync) Succeed" in log, "device reports the block sync")
+
+        # 2. A 64-bit collision copies a wrong block: only the whole image SHA-256 catches it
+        forged = bytearray(manifest)
+        changed = next(i for i, (a, b) in enumerate(zip(blocks(base), blocks(image))) if a != b)
+        at = MANIFEST_HEADER + 32 * changed
+        forged[at:at + HASH_BITS // 8] = hashlib.sha256(blocks(base)[changed]).digest()[:HASH_BITS // 8]
+        bad, rc, summary, gets, log = session(binary, workdir, "collision", base, image_path, bytes(forged))
+        full = [g for g in gets if g["path"] == "/fw.bin" and g["range"] is None]
+        t.check("Image SHA-256 mismatch" in log, "colliding block fails the whole image SHA-256")
+        t.check("Block sync not applied (ESP_ERR_OTA_VALIDATE_FAILED)" in log, "block sync result rejected")
+        t.check(len(full) == 1, "falls back to the full image: %d whole GETs" % len(full))
+        t.check(rc == 0 and bad.slot("ota_1", len(image)) == image, "update slot holds the full image")
+
+        if t.failures:
+            for dev in (good, bad):
+                dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
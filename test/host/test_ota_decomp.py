@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test and benchmark: compressed images (CONFIG_OTA_DECOMP_ENABLE) through
+the real OTA HAL and main/ota_decomp.c.
+
+The image segment is real machine code (the ota_host binary itself). The
+image is compressed with tools/ota_compress.py and served over a capped link,
+next to the raw image.
+
+  1. The raw and the compressed download must both leave the image in the
+     update slot byte for byte. The test prints the compression ratio, the
+     decompression throughput the device logged, and the end-to-end time of
+     both runs.
+  2. The compressed body is dropped once. Compressed sessions keep no
+     checkpoint, so the retry must ask for the whole file again, without
+     Range, and still end byte-identical.
+
+Usage: test_ota_decomp.py <ota_host binary>
+"""
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import ROOT, Checker, Device, Server, make_image, range_start  # noqa: E402
+
+IMAGE_KB = 512
+LINK = ["--latency-ms", "20", "--rate-kbps", "400"]     # a slow link: the transfer, not the decoder, dominates
+CUT_KB = 64
+
+COMPRESS = os.path.join(ROOT, "tools", "ota_compress.py")
+DECOMP_LOG = re.compile(r"Decompressed (\d+) -> (\d+) B \(ratio ([\d.]+)\), ([\d.]+) MB/s, (\d+) ms decoding")
+
+
+def write(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def download(t, binary, workdir, path, name, *server_args):
+    """One OTA session of path on a fresh device: (device, summary, server GETs)."""
+    devdir = os.path.join(workdir, name)
+    os.mkdir(devdir)
+    dev = Device(binary, devdir)
+    with Server(workdir, path, *(LINK + list(server_args)), name=name) as srv:
+        rc, summary = dev.run(srv.url)
+        gets = srv.requests()
+    t.check(rc == 0 and summary and summary["result"] == "ESP_OK", "%s download succeeds: %s" % (name, summary))
+    return dev, summary or {}, gets
+
+
+def decomp_log(dev):
+    with open(dev.log) as f:
+        return DECOMP_LOG.search(f.read())
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_decomp")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        with open(binary, "rb") as f:
+            image = make_image(IMAGE_KB * 1024, 5, payload=f.read())
+        raw_path = os.path.join(workdir, "fw.bin")
+        ohs_path = os.path.join(workdir, "fw.ohs")
+        write(raw_path, image)
+        subprocess.run([sys.executable, COMPRESS, raw_path, ohs_path], check=True, stdout=subprocess.DEVNULL)
+        ohs_len = os.path.getsize(ohs_path)
+
+        # 1. Raw against compressed
+        raw, raw_sum, _ = download(t, binary, workdir, raw_path, "raw")
+        ohs, ohs_sum, gets = download(t, binary, workdir, ohs_path, "ohs")
+        t.check(raw.slot("ota_1", len(image)) == image, "raw download leaves the image in the slot")
+        t.check(ohs.slot("ota_1", len(image)) == image, "compressed download leaves the image in the slot")
+        t.check(ohs_sum.get("boot") == "ota_1", "decompressed image selected for boot")
+        t.check(len(gets) == 1 and ohs_sum.get("bytes_received") == ohs_len,
+                "compressed file fetched once: %s, %s B" % (gets, ohs_sum.get("bytes_received")))
+        log = decomp_log(ohs)
+        t.check(log is not None, "device reports the decompression")
+        if log:
+            consumed, produced, ratio, mbps, decode_ms = log.groups()
+            t.check(int(consumed) == ohs_len and int(produced) == len(image),
+                    "decoder consumed the file and produced the image: %s -> %s" % (consumed, produced))
+            raw_ms, ohs_ms = raw_sum.get("total_ms", 0), ohs_sum.get("total_ms", 0)
+            print("  image %d B -> %d B, ratio %s; decompression %s MB/s (%s ms)" %
+                  (len(image), ohs_len, ratio, mbps, decode_ms))
+            print("  end to end over %s KB/s: raw %d ms, compressed %d ms (%+d ms, %+.0f%%)" %
+                  (LINK[3], raw_ms, ohs_ms, ohs_ms - raw_ms, 100.0 * (ohs_ms - raw_ms) / max(raw_ms, 1)))
+            t.check(float(ratio) > 1.5, "machine code compresses: ratio %s" % ratio)
+            t.check(ohs_ms < raw_ms, "compressed update is faster on a slow link: %d vs %d ms" % (ohs_ms, raw_ms))
+
+        # 2. A dropped compressed body starts over
+        cut, cut_sum, gets = download(t, binary, workdir, ohs_path, "ohs-cut",
+                                      "--fail-after-kb", str(CUT_KB), "--fail-count", "1")
+        t.check(len(gets) == 2, "one retry after the dropped body: %s" % gets)
+        t.check(all(range_start(g) is None and g["status"] == 200 for g in gets),
+                "compressed download restarts from the first byte: %s" % gets)
+        t.check(cut.slot("ota_1", len(image)) == image, "slot holds the image after the retry")
+
+        if t.failures:
+            for dev in (raw, ohs, cut):
+                dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
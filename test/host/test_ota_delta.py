@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: delta updates (CONFIG_OTA_DELTA_ENABLE) through the real OTA HAL
+and main/ota_delta.c.
+
+The running slot (ota_0) holds the base image. The new image differs from it
+in a few places, and the patch is made with tools/ota_delta_gen.py. The patch
+and the full image are served by separate servers.
+
+  1. The patch applies on top of the running image. The update slot must end
+     up byte-identical to the new image, and the full image is never fetched.
+  2. A patch whose target_sha256 does not match what it produces is rejected
+     by the streaming digest check. The HAL falls back to the full image.
+  3. A patch made against another base is refused from its header, before
+     any byte is written. The HAL falls back to the full image.
+
+Usage: test_ota_delta.py <ota_host binary built with CONFIG_OTA_DELTA_ENABLE>
+"""
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import ROOT, Checker, Device, Server, make_image  # noqa: E402
+
+IMAGE_KB = 256
+DELTA_GEN = os.path.join(ROOT, "tools", "ota_delta_gen.py")
+TARGET_SHA_OFFSET = 4 + 32 + 4 + 4      # ota_delta_header_t.target_sha256
+
+
+def write(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def make_patch(workdir, name, old, new):
+    old_path, new_path, patch_path = (os.path.join(workdir, "%s.%s" % (name, ext)) for ext in ("old", "new", "odp"))
+    write(old_path, old)
+    write(new_path, new)
+    subprocess.run([sys.executable, DELTA_GEN, old_path, new_path, patch_path], check=True,
+                   stdout=subprocess.DEVNULL)
+    with open(patch_path, "rb") as f:
+        return f.read()
+
+
+def session(binary, workdir, name, base, patch, image_path):
+    """One delta session on a device running base: (device, exit code, summary, patch GETs, image GETs, log)."""
+    devdir = os.path.join(workdir, name)
+    os.mkdir(devdir)
+    dev = Device(binary, devdir)
+    dev.install("ota_0", base)
+    patch_path = os.path.join(devdir, "patch.odp")
+    write(patch_path, patch)
+    with Server(workdir, patch_path, name=name + "-patch") as psrv, \
+            Server(workdir, image_path, name=name + "-image") as isrv:
+        rc, summary = dev.run(isrv.url, delta=psrv.url)
+        patch_gets, image_gets = psrv.requests(), isrv.requests()
+    with open(dev.log) as f:
+        log = f.read()
+    return dev, rc, summary or {}, patch_gets, image_gets, log
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_delta")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        rnd = random.Random(8)
+        payload = bytearray(rnd.randbytes(IMAGE_KB * 1024))
+        base = make_image(len(payload), 0, payload=bytes(payload))
+        for off in (0x1000, 0x9000, 0x20000):
+            payload[off:off + 300] = rnd.randbytes(300)
+        image = make_image(len(payload), 0, payload=bytes(payload))
+        image_path = os.path.join(workdir, "fw.bin")
+        write(image_path, image)
+        patch = make_patch(workdir, "good", base, image)
+
+        # 1. Patch applied over the running image
+        good, rc, summary, patch_gets, image_gets, log = session(binary, workdir, "good", base, patch, image_path)
+        t.check(rc == 0 and summary.get("result") == "ESP_OK", "delta update succeeds: %s" % summary)
+        t.check(good.slot("ota_1", len(image)) == image, "update slot holds the new image")
+        t.check(summary.get("boot") == "ota_1", "patched image selected for boot")
+        t.check(len(patch_gets) == 1 and not image_gets,
+                "only the patch is fetched: %d patch, %d image GETs" % (len(patch_gets), len(image_gets)))
+        t.check(len(patch) < len(image) // 10, "patch is small: %d of %d B" % (len(patch), len(image)))
+        t.check("OTA (delta) Succeed" in log, "device reports the delta update")
+        t.check(log.count("SHA-256 for current firmware") == 1, "running image hashed once")
+
+        # 2. Wrong target_sha256: rejected by the digest check, full image instead
+        bad = bytearray(patch)
+        bad[TARGET_SHA_OFFSET] ^= 0xFF
+        wrong, rc, summary, patch_gets, image_gets, log = session(binary, workdir, "wrong-target", base, bytes(bad),
+                                                                  image_path)
+        t.check("Image SHA-256 mismatch" in log, "patched image fails the target digest")
+        t.check("Delta update not applied (ESP_ERR_OTA_VALIDATE_FAILED)" in log, "delta result is rejected")
+        t.check(len(image_gets) == 1, "falls back to the full image: %d GETs" % len(image_gets))
+        t.check(rc == 0 and wrong.slot("ota_1", len(image)) == image, "update slot holds the full image")
+
+        # 3. Patch for another base: refused from the header
+        other = make_image(len(payload), 9)
+        foreign, rc, summary, patch_gets, image_gets, log = session(binary, workdir, "other-base", other, patch,
+                                                                    image_path)
+        t.check("Patch base does not match the running image" in log, "patch base is checked")
+        t.check("Applying patch" not in log, "nothing applied from a foreign patch")
+        t.check(len(image_gets) == 1, "falls back to the full image: %d GETs" % len(image_gets))
+        t.check(rc == 0 and foreign.slot("ota_1", len(image)) == image, "update slot holds the full image")
+
+        if t.failures:
+            for dev in (good, wrong, foreign):
+                dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: the connection kept after a session (CONFIG_OTA_CONN_REUSE) is
+freed by its idle timer, not at the next request. ota_host is built with
+CONFIG_OTA_CONN_IDLE_S=1.
+
+  1. A failed session (the server answers 503) keeps its client. With the
+     process kept alive past the idle time, the timer must close it once.
+  2. Before the idle time is over, it must still be kept.
+  3. A successful session frees its client at once, so no timer fires.
+
+Usage: test_ota_idle.py <ota_host binary>
+"""
+import os
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import Checker, Device, Server, make_image  # noqa: E402
+
+IMAGE_KB = 64
+IDLE_LOG = "Idle connection closed after 1 s"
+
+
+def session(binary, workdir, name, image_path, linger_ms, *server_args):
+    """One session on a fresh device: (exit code, times the idle timer closed the client)."""
+    devdir = os.path.join(workdir, name)
+    os.mkdir(devdir)
+    dev = Device(binary, devdir)
+    with Server(workdir, image_path, *server_args, name=name) as srv:
+        rc, _ = dev.run(srv.url, linger_ms=linger_ms)
+    with open(dev.log) as f:
+        return rc, f.read().count(IDLE_LOG), dev
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_idle")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        path = os.path.join(workdir, "fw.bin")
+        with open(path, "wb") as f:
+            f.write(make_image(IMAGE_KB * 1024, 7))
+
+        rc, closed, failed = session(binary, workdir, "failed", path, 2500, "--status", "503")
+        t.check(rc != 0, "the 503 session fails")
+        t.check(closed == 1, "the kept client is closed once by the idle timer: %d" % closed)
+
+        rc, closed, early = session(binary, workdir, "early", path, 300, "--status", "503")
+        t.check(closed == 0, "the client is kept until the idle time is over: %d" % closed)
+
+        rc, closed, staged = session(binary, workdir, "staged", path, 2500)
+        t.check(rc == 0, "the update is staged")
+        t.check(closed == 0, "a successful session does not keep its client: %d" % closed)
+
+        if t.failures:
+            for dev in (failed, early, staged):
+                dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: mirror ranking and failover (CONFIG_OTA_MIRROR_URLS) of the real
+OTA HAL against three tools/ota_test_server.py instances of one image.
+
+The mirrors differ in latency and throughput and are listed worst first. The
+probes must rank the fastest first. That mirror is killed once its full
+download is under way. The download must then move to the second ranked
+mirror with "Range: bytes=N-", where N is the offset the HAL logged. The
+slowest mirror must only ever see its probe, and the slot must end up
+byte-identical.
+
+Usage: test_ota_mirror.py <ota_host binary>
+"""
+import json
+import os
+import re
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import SECTOR, Checker, Device, Server, etag_of, make_image, range_start  # noqa: E402
+
+IMAGE_KB = 600
+PROBE_RANGE = "bytes=0-16383"       # CONFIG_OTA_MIRROR_PROBE_KB default
+KILL_AFTER_S = 1.0                  # into the full download of the best mirror: past the first checkpoint
+
+# name: (latency ms, KB/s per connection)
+MIRRORS = {
+    "slow": (200, 50),
+    "medium": (60, 150),
+    "fast": (5, 200),
+}
+
+
+def full_gets(srv):
+    return [g for g in srv.requests() if g["range"] != PROBE_RANGE]
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_mirror")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        image = make_image(IMAGE_KB * 1024, 4)
+        path = os.path.join(workdir, "fw.bin")
+        with open(path, "wb") as f:
+            f.write(image)
+        srv = {}
+        try:
+            for name, (latency, rate) in MIRRORS.items():
+                srv[name] = Server(workdir, path, "--latency-ms", str(latency), "--rate-kbps", str(rate), name=name)
+            dev = Device(binary, workdir)
+            proc = dev.start(srv["slow"].url, mirrors="%s,%s" % (srv["medium"].url, srv["fast"].url))
+
+            # Kill the best mirror once its full GET has been going for a while
+            deadline = time.monotonic() + 30
+            while not full_gets(srv["fast"]) and proc.poll() is None and time.monotonic() < deadline:
+                time.sleep(0.02)
+            t.check(full_gets(srv["fast"]), "the fastest mirror gets the download")
+            time.sleep(KILL_AFTER_S)
+            srv["fast"].kill()
+
+            out, _ = proc.communicate(timeout=120)
+            dev.log_file.close()
+            summary = json.loads(out.strip().splitlines()[-1]) if out.strip() else {}
+        finally:
+            for s in srv.values():
+                s.stop()
+
+        with open(dev.log) as f:
+            log = f.read()
+        failover = re.search(r"failing over to (\S+) at offset (\d+)", log)
+
+        for name, s in srv.items():
+            probes = [g for g in s.requests() if g["range"] == PROBE_RANGE]
+            t.check(len(probes) == 1 and probes[0]["status"] == 206, "%s mirror probed once: %s" % (name, probes))
+        t.check(summary.get("result") == "ESP_OK", "download completes after the failover: %s" % summary)
+        t.check(failover is not None, "the HAL reports the failover")
+        if failover:
+            t.check(failover.group(1) == srv["medium"].url, "failover goes to the second ranked mirror: %s" %
+                    failover.group(1))
+            offset = int(failover.group(2))
+            t.check(offset > 0 and offset % SECTOR == 0, "failover keeps a sector aligned checkpoint: %d" % offset)
+            resumed = full_gets(srv["medium"])
+            t.check(len(resumed) == 1 and range_start(resumed[0]) == offset,
+                    "second mirror asked for the rest from the logged offset: %s" % resumed)
+            t.check(resumed and resumed[0]["if_range"] == etag_of(image) and resumed[0]["status"] == 206,
+                    "ranged request is conditional on the shared ETag: %s" % resumed)
+        t.check(not full_gets(srv["slow"]), "the slowest mirror only sees its probe")
+        ranking = summary.get("mirrors", [])
+        t.check(len(ranking) == 3 and ranking[-1] == srv["slow"].url, "slowest mirror ranked last: %s" % ranking)
+        t.check(dev.slot("ota_1", len(image)) == image, "update slot holds the image")
+        t.check(summary.get("boot") == "ota_1", "update slot selected for boot")
+        if t.failures:
+            dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
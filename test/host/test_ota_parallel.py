@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: parallel ranged download (CONFIG_OTA_PARALLEL_CONN) of the real
+OTA HAL against tools/ota_test_server.py, with the per-connection stats.
+
+The image is fetched as ranges over the main connection and the range
+workers, all connecting at once on a high latency link. The slot must end
+up byte-identical. Every range after the first must be conditional on the
+ETag. The session stats must count each worker connection: the HAL's
+connections plus reused requests must equal the GETs the server answered.
+
+Usage: test_ota_parallel.py <ota_host binary built with CONFIG_OTA_PARALLEL_CONN > 1>
+"""
+import os
+import re
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import Checker, Device, Server, etag_of, make_image, range_start  # noqa: E402
+
+IMAGE_KB = 400
+PAR_LOG = re.compile(r"(\d+) ranges of (\d+) KB over (\d+)\+1 connections")
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_parallel")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        image = make_image(IMAGE_KB * 1024, 6)
+        path = os.path.join(workdir, "fw.bin")
+        with open(path, "wb") as f:
+            f.write(image)
+        dev = Device(binary, workdir)
+        with Server(workdir, path, "--latency-ms", "40", "--rate-kbps", "300") as srv:
+            rc, summary = dev.run(srv.url)
+            gets = srv.requests()
+        summary = summary or {}
+        with open(dev.log) as f:
+            par = PAR_LOG.search(f.read())
+
+        t.check(rc == 0 and summary.get("result") == "ESP_OK", "parallel download succeeds: %s" % summary)
+        t.check(dev.slot("ota_1", len(image)) == image, "update slot holds the image")
+        t.check(summary.get("boot") == "ota_1", "update slot selected for boot")
+        t.check(par is not None, "the HAL reports the parallel download")
+        if par:
+            ranges, range_kb, workers = (int(g) for g in par.groups())
+            t.check(workers > 0, "range workers were started: %d" % workers)
+            t.check(len(gets) == ranges, "one GET per range: %d of %d" % (len(gets), ranges))
+            starts = sorted(range_start(g) or 0 for g in gets)
+            t.check(starts == list(range(0, len(image), range_kb * 1024)),
+                    "the ranges cover the image once: %s" % starts)
+            t.check(summary.get("connections") == workers + 1,
+                    "main and worker connections counted: %s of %d" % (summary.get("connections"), workers + 1))
+        t.check(all(g["status"] == 206 for g in gets), "every range answered with 206")
+        t.check(all(g["if_range"] == etag_of(image) for g in gets if range_start(g)),
+                "ranges after the first are conditional on the ETag")
+        t.check(summary.get("connections", 0) + summary.get("reused", 0) == len(gets),
+                "each GET is a new or a reused connection: %s + %s of %d" %
+                (summary.get("connections"), summary.get("reused"), len(gets)))
+        if t.failures:
+            dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
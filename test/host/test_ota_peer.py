@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: LAN peer distribution (main/ota_peer.c), several ota_peer_host
+devices against each other on the loopback.
+
+Every device has its own address (OTA_HOST_IP, 127.0.0.2 and up) and the
+discovery broadcast reaches 127.0.0.2-127.0.0.9 (OTA_HOST_LAN). Three peers
+run image A, one runs image B, and a device without a server discovers them.
+HTTP clients on their own source addresses stand for the updating devices.
+
+  1. Discovery lists the peers running the wanted image and version only,
+     and the order among peers with the same free slots changes between
+     discoveries.
+  2. Fan-out: a peer with both slots taken answers 503 + Retry-After to a
+     third client, keeps serving the two it admitted, and is reported busy.
+     A less loaded peer is listed first. A client that fetched the end of
+     the image frees its slot.
+  3. Range serving: single ranges (a-b, a-, -n, past the end), 416 for a
+     range starting past the end, a range ending before it starts ignored
+     (the whole image), multi-range ignored, If-Range, HEAD, keep-alive.
+
+Usage: test_ota_peer.py <ota_peer_host binary>
+"""
+import hashlib
+import http.client
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import Checker, Device, make_image  # noqa: E402
+
+LAN = "127.0.0.2-127.0.0.9"
+DISCOVERER = "127.0.0.9"
+VERSION = "1.2.0"
+IMAGE_KB = 96
+PATH = "/firmware.bin"
+RETRY_AFTER = "5"           # PEER_RETRY_AFTER_S
+ORDER_RUNS = 10
+
+
+def device_env(dev, ip, version=VERSION):
+    return dict(os.environ, OTA_HOST_FLASH=dev.flash, OTA_HOST_NVS=dev.nvs, OTA_HOST_IP=ip, OTA_HOST_LAN=LAN,
+                OTA_HOST_VERSION=version)
+
+
+class Peer:
+    """One ota_peer_host --serve device running image; serves until stopped."""
+
+    def __init__(self, binary, workdir, ip, image):
+        devdir = os.path.join(workdir, ip)
+        os.mkdir(devdir)
+        self.ip = ip
+        self.dev = Device(binary, devdir)
+        self.dev.install("ota_0", image)
+        self.log_file = open(self.dev.log, "w")
+        self.proc = subprocess.Popen([binary, "--serve"], env=device_env(self.dev, ip), stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE, stderr=self.log_file, text=True)
+        line = self.proc.stdout.readline()
+        self.announce = json.loads(line) if line.strip() else {}
+        self.port = self.announce.get("port")
+
+    def stop(self):
+        self.proc.stdin.close()
+        try:
+            self.proc.wait(5)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            self.proc.wait()
+        self.log_file.close()
+
+
+def discover(binary, workdir, sha_hex, version=VERSION):
+    """One discovery from a device without a server: (peers, busy answers)."""
+    devdir = os.path.join(workdir, "discoverer")
+    os.makedirs(devdir, exist_ok=True)
+    dev = Device(binary, devdir)
+    out = subprocess.run([binary, "--discover", sha_hex, version], env=device_env(dev, DISCOVERER),
+                         capture_output=True, text=True, timeout=30)
+    result = json.loads(out.stdout) if out.returncode == 0 and out.stdout.strip() else {}
+    return result.get("peers", []), result.get("busy", -1)
+
+
+def connect(peer, source):
+    return http.client.HTTPConnection(peer.ip, peer.port, timeout=10, source_address=(source, 0))
+
+
+def request(conn, headers=None, method="GET"):
+    """(status, headers with lower case names, body)."""
+    conn.request(method, PATH, headers=headers or {})
+    resp = conn.getresponse()
+    return resp.status, {k.lower(): v for k, v in resp.getheaders()}, resp.read()
+
+
+def get(peer, source, headers=None):
+    conn = connect(peer, source)
+    try:
+        return request(conn, headers)
+    finally:
+        conn.close()
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_peer")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        image_a = make_image(IMAGE_KB * 1024, 21)
+        image_b = make_image(IMAGE_KB * 1024, 22)
+        sha_a, sha_b = hashlib.sha256(image_a).hexdigest(), hashlib.sha256(image_b).hexdigest()
+        peers = []
+        try:
+            for ip, image in (("127.0.0.2", image_a), ("127.0.0.3", image_a), ("127.0.0.4", image_a),
+                              ("127.0.0.5", image_b)):
+                peers.append(Peer(binary, workdir, ip, image))
+            p2, p3, p4, p5 = peers
+            t.check(all(p.port for p in peers), "every peer answers its own probe")
+            t.check(p2.announce.get("sha256") == sha_a and p5.announce.get("sha256") == sha_b,
+                    "peers announce the SHA-256 of their running image")
+            t.check(p2.announce.get("image_len") == len(image_a) and p2.announce.get("version") == VERSION,
+                    "announce carries length and version: %s" % p2.announce)
+            t.check(p2.announce.get("free_slots") == 2 == p2.announce.get("max_slots"), "two free slots")
+
+            # 1. Discovery
+            found, busy = discover(binary, workdir, sha_a)
+            t.check(sorted(p["ip"] for p in found) == [p2.ip, p3.ip, p4.ip] and busy == 0,
+                    "peers of image A found: %s, %d busy" % ([p["ip"] for p in found], busy))
+            t.check(all(p["free_slots"] == 2 and p["image_len"] == len(image_a) for p in found),
+                    "free slots and length of each peer")
+            t.check(found and found[0]["url"] == "http://%s:%d%s" % (found[0]["ip"], p2.port, PATH),
+                    "firmware URL of a peer: %s" % (found[0]["url"] if found else None))
+            found, _ = discover(binary, workdir, sha_b)
+            t.check([p["ip"] for p in found] == [p5.ip], "only the peer of image B serves B")
+            found, busy = discover(binary, workdir, sha_a, "1.3.0")
+            t.check(found == [] and busy == 0, "another version is not offered")
+            found, busy = discover(binary, workdir, "00" * 31 + "01")
+            t.check(found == [] and busy == 0, "nobody answers for an unknown image")
+            firsts = set()
+            for _ in range(ORDER_RUNS):
+                found, _ = discover(binary, workdir, sha_a)
+                if found:
+                    firsts.add(found[0]["ip"])
+            t.check(len(firsts) > 1, "random order among equally loaded peers: first was %s" % sorted(firsts))
+
+            # 2. Fan-out: two clients hold the slots of 127.0.0.2
+            head = {"Range": "bytes=0-4095"}
+            s1, _, b1 = get(p2, "127.0.0.20", head)
+            s2, _, b2 = get(p2, "127.0.0.21", head)
+            t.check(s1 == s2 == 206 and b1 == b2 == image_a[:4096], "two clients admitted")
+            s3, h3, b3 = get(p2, "127.0.0.22", head)
+            t.check(s3 == 503 and h3.get("retry-after") == RETRY_AFTER and b3 == b"",
+                    "third client gets 503 + Retry-After: %d %s" % (s3, h3.get("retry-after")))
+            s1, _, b1 = get(p2, "127.0.0.20", {"Range": "bytes=4096-8191"})
+            t.check(s1 == 206 and b1 == image_a[4096:8192], "an admitted client keeps being served")
+            found, busy = discover(binary, workdir, sha_a)
+            t.check(sorted(p["ip"] for p in found) == [p3.ip, p4.ip] and busy >= 1,
+                    "the full peer is reported busy, not offered: %s, %d busy" % ([p["ip"] for p in found], busy))
+
+            s, _, _ = get(p3, "127.0.0.23", head)
+            t.check(s == 206, "one client on 127.0.0.3")
+            for _ in range(3):
+                found, _ = discover(binary, workdir, sha_a)
+                t.check([(p["ip"], p["free_slots"]) for p in found] == [(p4.ip, 2), (p3.ip, 1)],
+                        "least loaded first: %s" % [(p["ip"], p["free_slots"]) for p in found])
+
+            for source in ("127.0.0.20", "127.0.0.21"):
+                s, _, body = get(p2, source, {"Range": "bytes=8192-"})
+                t.check(s == 206 and body == image_a[8192:], "%s fetches the end of the image" % source)
+            found, _ = discover(binary, workdir, sha_a)
+            free = {p["ip"]: p["free_slots"] for p in found}
+            t.check(free.get(p2.ip) == 2, "slots freed by the clients that got the end: %s" % free)
+            t.check(found and found[-1]["ip"] == p3.ip, "the loaded peer comes last")
+
+            # 3. Range serving, on one keep-alive connection
+            n = len(image_a)
+            etag = '"%s"' % sha_a[:16]
+            conn = connect(p4, "127.0.0.30")
+            s, h, body = request(conn)
+            sock = conn.sock
+            t.check(s == 200 and body == image_a, "whole image: %d" % s)
+            t.check(h.get("etag") == etag and h.get("x-image-sha256") == sha_a and h.get("accept-ranges") == "bytes",
+                    "ETag, digest and Accept-Ranges: %s" % h)
+            t.check(h.get("content-length") == str(n), "Content-Length of the image")
+            for rng, first, last in (("100-199", 100, 199), ("-500", n - 500, n - 1), ("1000-", 1000, n - 1),
+                                     ("%d-%d" % (n - 10, n + 100), n - 10, n - 1), ("-%d" % (2 * n), 0, n - 1)):
+                s, h, body = request(conn, {"Range": "bytes=" + rng})
+                t.check(s == 206 and body == image_a[first:last + 1] and
+                        h.get("content-range") == "bytes %d-%d/%d" % (first, last, n),
+                        "bytes=%s: %d %s" % (rng, s, h.get("content-range")))
+            s, h, body = request(conn, {"Range": "bytes=%d-" % n})
+            t.check(s == 416 and h.get("content-range") == "bytes */%d" % n and body == b"",
+                    "range past the end: %d %s" % (s, h.get("content-range")))
+            s, h, body = request(conn, {"Range": "bytes=300-200"})
+            t.check(s == 200 and body == image_a and "content-range" not in h,
+                    "range ending before it starts is ignored: %d" % s)
+            s, h, body = request(conn, {"Range": "bytes=0-1,5-6"})
+            t.check(s == 200 and body == image_a, "multi-range is ignored: %d" % s)
+            s, h, body = request(conn, {"Range": "bytes=100-199", "If-Range": etag})
+            t.check(s == 206 and body == image_a[100:200], "If-Range with the ETag: %d" % s)
+            s, h, body = request(conn, {"Range": "bytes=100-199", "If-Range": '"0123456789abcdef"'})
+            t.check(s == 200 and body == image_a, "If-Range with another ETag: %d" % s)
+            s, h, body = request(conn, method="HEAD")
+            t.check(s == 200 and h.get("content-length") == str(n) and body == b"", "HEAD: %d %s" % (s, h))
+            t.check(conn.sock is sock, "every request on one keep-alive connection")
+            conn.close()
+        finally:
+            for p in peers:
+                p.stop()
+        if t.failures:
+            for p in peers:
+                p.dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
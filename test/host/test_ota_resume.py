@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: resumable download (CONFIG_OTA_RESUME_ENABLE) of the real OTA HAL
+against tools/ota_test_server.py.
+
+  1. The server drops the first two bodies (--fail-after-kb/--fail-count): the
+     retries ask for "Range: bytes=N-" with If-Range on the image ETag, N the
+     sector aligned checkpoint, and the slot ends up byte-identical.
+  2. The device is killed mid-download: the next run resumes from the NVS
+     checkpoint instead of starting over.
+  3. The image changed on the server meanwhile: If-Range gets a 200 and the
+     download restarts from 0 with the new image.
+
+Usage: test_ota_resume.py <ota_host binary>
+"""
+import os
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import SECTOR, Checker, Device, Server, etag_of, make_image, range_start  # noqa: E402
+
+IMAGE_KB = 400
+CUT_KB = 148                 # a multiple of the server chunk (4 KB): the cut lands exactly there
+
+
+def write(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def dropped_bodies(t, binary, workdir):
+    image = make_image(IMAGE_KB * 1024, 1)
+    path = os.path.join(workdir, "fw.bin")
+    write(path, image)
+    dev = Device(binary, workdir)
+    with Server(workdir, path, "--fail-after-kb", str(CUT_KB), "--fail-count", "2") as srv:
+        rc, summary = dev.run(srv.url)
+        gets = srv.requests()
+
+    t.check(rc == 0 and summary["result"] == "ESP_OK", "download with two dropped bodies succeeds: %s" % summary)
+    t.check(len(gets) == 3, "one request per attempt: %s" % gets)
+    t.check(gets and gets[0]["range"] is None and gets[0]["status"] == 200, "first request is unranged")
+    prev = 0
+    for g in gets[1:]:
+        start = range_start(g)
+        t.check(start is not None and start % SECTOR == 0, "retry asks for a sector aligned range: %s" % g)
+        t.check(start is not None and prev < start <= prev + CUT_KB * 1024, "range starts at the checkpoint: %s" % g)
+        t.check(g["if_range"] == etag_of(image), "retry is conditional on the ETag: %s" % g)
+        t.check(g["status"] == 206, "server answers with the rest of the image: %s" % g)
+        prev = start or prev
+    t.check(dev.slot("ota_1", len(image)) == image, "update slot holds the image")
+    t.check(summary and summary["boot"] == "ota_1", "update slot selected for boot")
+    if t.failures:
+        dev.dump_log()
+
+
+def killed_device(t, binary, workdir):
+    old = make_image(IMAGE_KB * 1024, 2)
+    new = make_image(IMAGE_KB * 1024, 3)
+    path = os.path.join(workdir, "fw.bin")
+    dev = Device(binary, workdir)
+
+    def kill_mid_download(srv):
+        proc = dev.start(srv.url)
+        deadline = time.monotonic() + 30
+        while not os.path.exists(dev.nvs) and time.monotonic() < deadline:
+            time.sleep(0.05)       # first checkpoint committed
+        time.sleep(0.5)
+        proc.kill()
+        proc.wait()
+        dev.log_file.close()
+
+    # 2. Killed, then resumed from the checkpoint by the next run
+    write(path, old)
+    with Server(workdir, path, "--rate-kbps", "100", name="slow") as srv:
+        kill_mid_download(srv)
+        t.check(os.path.exists(dev.nvs), "checkpoint stored before the kill")
+        rc, summary = dev.run(srv.url)
+        gets = srv.requests()
+    t.check(rc == 0 and summary["result"] == "ESP_OK", "run after the kill succeeds: %s" % summary)
+    t.check(len(gets) == 2, "one request per run: %s" % gets)
+    resumed = gets[-1] if gets else {}
+    start = range_start(resumed)
+    t.check(start is not None and start > 0 and start % SECTOR == 0, "next run resumes at the checkpoint: %s" % resumed)
+    t.check(resumed.get("if_range") == etag_of(old) and resumed.get("status") == 206,
+            "resumed request is conditional and answered 206: %s" % resumed)
+    t.check(dev.slot("ota_1", len(old)) == old, "update slot holds the image after the resume")
+
+    # 3. Killed again, and the server now has another image: If-Range restarts from 0
+    os.remove(dev.nvs)
+    with Server(workdir, path, "--rate-kbps", "100", name="slow2") as srv:
+        kill_mid_download(srv)
+    write(path, new)
+    with Server(workdir, path, name="changed") as srv:
+        rc, summary = dev.run(srv.url)
+        gets = srv.requests()
+    t.check(rc == 0 and summary["result"] == "ESP_OK", "run after the image change succeeds: %s" % summary)
+    t.check(len(gets) == 1 and range_start(gets[0]) and gets[0]["if_range"] == etag_of(old),
+            "stale checkpoint still asks for its range: %s" % gets)
+    t.check(gets and gets[0]["status"] == 200, "changed image comes back whole: %s" % gets)
+    t.check(dev.slot("ota_1", len(new)) == new, "update slot holds the new image")
+    if t.failures:
+        dev.dump_log()
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_resume")
+    for case in (dropped_bodies, killed_device):
+        with tempfile.TemporaryDirectory() as workdir:
+            case(t, binary, workdir)
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host test: 1000 back-to-back OTA sessions of the real HAL, pipeline and (in
+ota_host_par) range workers, without heap growth.
+
+Every session creates its writer, eraser and range worker tasks and their
+queues in the session arena (main/ota_arena.c), with the stack and queue
+sizes of ota_pipeline.c and ota_parallel.c. The sessions must all fit the
+arena (no request served by the heap), and the heap in use at the end of the
+last session must be what it was at the end of the first one (that session
+creates what is kept for the uptime).
+
+Usage: test_ota_sessions.py <ota_host or ota_host_par binary>
+"""
+import os
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_host_util import Checker, Device, Server, make_image  # noqa: E402
+
+SESSIONS = 1000
+IMAGE_KB = 32
+HEAP_SLACK = 4096       # one-off allocations (libc caches); a leak of 8 B per session is twice that
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    binary = os.path.abspath(sys.argv[1])
+    t = Checker("test_ota_sessions")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        image = make_image(IMAGE_KB * 1024, 10)
+        path = os.path.join(workdir, "fw.bin")
+        with open(path, "wb") as f:
+            f.write(image)
+        dev = Device(binary, workdir)
+        with Server(workdir, path) as srv:
+            rc, summary = dev.run(srv.url, sessions=SESSIONS, timeout=600)
+        summary = summary or {}
+        arena = summary.get("arena", {})
+
+        t.check(rc == 0 and summary.get("sessions") == SESSIONS,
+                "%d sessions staged: %s" % (SESSIONS, summary.get("sessions")))
+        t.check(dev.slot("ota_1", len(image)) == image, "update slot holds the image")
+        t.check(arena.get("sessions") == SESSIONS, "every session released its arena: %s" % arena)
+        t.check(arena.get("failures") == 0, "every session fits the arena: %s" % arena)
+        t.check(0 < arena.get("peak", 0) <= arena.get("size", 0), "arena peak within its size: %s" % arena)
+        t.check(summary.get("heap_growth", HEAP_SLACK) < HEAP_SLACK,
+                "no heap growth over the sessions: %s B" % summary.get("heap_growth"))
+        print("  %d sessions: arena peak %s of %s B, heap growth %s B" %
+              (summary.get("sessions", 0), arena.get("peak"), arena.get("size"), summary.get("heap_growth")))
+        if t.failures:
+            dev.dump_log()
+    return t.done()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
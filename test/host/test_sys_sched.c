@@ -0,0 +1,214 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file test_sys_sched.c
+ * @brief Host test: fixed-rate releases, overruns and pausing of sys_sched
+ *
+ * @author Marconatale Parise
+ * @date 29 Mar 2026
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sys_sched.h"
+#include "host_test.h"
+
+#define MAX_RUNS        512
+
+/* What a job saw of its releases */
+typedef struct {
+    int64_t due[MAX_RUNS];
+    int64_t start[MAX_RUNS];
+    int64_t end[MAX_RUNS];
+    int     runs;                       /* written by the executor, read with __atomic */
+    int     long_run;                   /* run index that takes long_us, -1: none */
+    int64_t exec_us;
+    int64_t long_us;
+} trace_t;
+
+static void busy_until(int64_t t)
+{
+    while (esp_timer_get_time() < t) {
+    }
+}
+
+static void job(int64_t due_us, void *arg)
+{
+    trace_t *tr = arg;
+    int n = __atomic_load_n(&tr->runs, __ATOMIC_RELAXED);
+    if (n >= MAX_RUNS) return;
+    int64_t start = esp_timer_get_time();
+    tr->due[n] = due_us;
+    tr->start[n] = start;
+    if (n == tr->long_run) usleep((useconds_t)tr->long_us);
+    else if (tr->exec_us) busy_until(start + tr->exec_us);
+    tr->end[n] = esp_timer_get_time();
+    __atomic_store_n(&tr->runs, n + 1, __ATOMIC_RELEASE);
+}
+
+static int runs(trace_t *tr)
+{
+    return __atomic_load_n(&tr->runs, __ATOMIC_ACQUIRE);
+}
+
+static void wait_runs(trace_t *tr, int n)
+{
+    for (int ms = 0; runs(tr) < n && ms < 10000; ms++) vTaskDelay(pdMS_TO_TICKS(1));
+}
+
+/* Releases on i x period from the first one, exactly: execution time and neighbours never add drift */
+static void check_grid(trace_t *tr, int from, int to, uint32_t period_us, int64_t late_max_us)
+{
+    int off_grid = 0, too_late = 0;
+    for (int i = from; i < to; i++) {
+        if (tr->due[i] != tr->due[from] + (int64_t)(i - from) * period_us) off_grid++;
+        if (tr->start[i] < tr->due[i] || tr->start[i] - tr->due[i] > late_max_us) too_late++;
+    }
+    CHECK(off_grid == 0);
+    CHECK(too_late == 0);
+}
+
+static sys_sched_handle_t s_exec;
+static trace_t s_a, s_b, s_over, s_pause;
+
+/* Two jobs on one executor, one of them busy for a quarter of its period */
+static void test_fixed_rate(void)
+{
+    const uint32_t pa = 20000, pb = 15000;
+    s_a.long_run = s_b.long_run = -1;
+    s_a.exec_us = 5000;
+    sys_sched_job_t ja, jb;
+    CHECK(sys_sched_add(s_exec, "a", pa, job, &s_a, true, &ja) == ESP_OK);
+    CHECK(sys_sched_add(s_exec, "b", pb, job, &s_b, true, &jb) == ESP_OK);
+    wait_runs(&s_a, 50);
+    sys_sched_enable(ja, false);
+    sys_sched_enable(jb, false);
+    int na = runs(&s_a), nb = runs(&s_b);
+
+    /* Late by a period would have been an overrun */
+    check_grid(&s_a, 0, na, pa, pa);
+    check_grid(&s_b, 0, nb, pb, pb);
+    int64_t span = s_a.start[na - 1] - s_a.start[0];
+    CHECK(span - (int64_t)(na - 1) * pa < pa);
+    CHECK(nb >= (int)(na * pa / pb) - 2);
+
+    sys_sched_stats_t st;
+    CHECK(sys_sched_get_stats(ja, &st) == ESP_OK);
+    CHECK((int)st.runs == na && st.overruns == 0 && st.period_us == pa);
+    CHECK(st.exec_avg_us >= s_a.exec_us && st.exec_max_us >= st.exec_avg_us);
+    CHECK(st.late_avg_us >= 0 && st.late_avg_us <= st.late_max_us && st.late_max_us < pa);
+    CHECK(st.period_err_max_us < pa);
+    CHECK(sys_sched_get_stats(jb, &st) == ESP_OK);
+    CHECK((int)st.runs == nb && st.overruns == 0);
+    printf("fixed rate: %d + %d runs, late max %lld us, period error max %lld us\n", na, nb,
+           (long long)st.late_max_us, (long long)st.period_err_max_us);
+}
+
+/* A run longer than several periods: the missed releases are skipped and counted, the phase is kept */
+static void test_overrun(void)
+{
+    const uint32_t period = 5000;
+    s_over.long_run = 3;
+    s_over.long_us = 17000;
+    sys_sched_job_t j;
+    CHECK(sys_sched_add(s_exec, "over", period, job, &s_over, true, &j) == ESP_OK);
+    wait_runs(&s_over, 10);
+    sys_sched_enable(j, false);
+    int n = runs(&s_over);
+
+    sys_sched_stats_t st;
+    CHECK(sys_sched_get_stats(j, &st) == ESP_OK);
+    int64_t gap = s_over.due[4] - s_over.due[3];
+    CHECK(gap % period == 0);
+    CHECK(st.overruns >= 2 && st.overruns == (uint32_t)(gap / period - 1));
+    /* No catch-up burst: the next release is the one that was still to come when the long run ended */
+    CHECK(s_over.due[4] > s_over.end[3] - period);
+    CHECK(s_over.start[4] >= s_over.end[3]);
+    CHECK(s_over.due[5] - s_over.due[4] == period);
+    /* Same phase before and after */
+    CHECK((s_over.due[n - 1] - s_over.due[0]) % period == 0);
+    CHECK((int)st.runs == n);
+    CHECK(st.exec_max_us >= s_over.long_us);
+}
+
+/* A paused job stops after its current run and keeps its stats; enabled again it runs at once, new phase */
+static void test_pause(void)
+{
+    const uint32_t period = 20000;
+    s_pause.long_run = -1;
+    sys_sched_job_t j;
+    CHECK(sys_sched_add(s_exec, "pause", period, job, &s_pause, false, &j) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(30));
+    CHECK(runs(&s_pause) == 0);         /* added disabled */
+
+    sys_sched_enable(j, true);
+    wait_runs(&s_pause, 10);
+    sys_sched_enable(j, false);
+    vTaskDelay(pdMS_TO_TICKS(5));
+    int n = runs(&s_pause);
+    sys_sched_stats_t before;
+    CHECK(sys_sched_get_stats(j, &before) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    CHECK(runs(&s_pause) == n);
+    sys_sched_stats_t st;
+    CHECK(sys_sched_get_stats(j, &st) == ESP_OK);
+    CHECK(st.runs == before.runs && (int)st.runs == n);
+
+    int64_t enabled_at = esp_timer_get_time();
+    sys_sched_enable(j, true);
+    wait_runs(&s_pause, n + 10);
+    sys_sched_enable(j, false);
+    int m = runs(&s_pause);
+
+    CHECK(s_pause.due[n] >= enabled_at && s_pause.due[n] - enabled_at < period);
+    CHECK(s_pause.due[n] - s_pause.due[n - 1] >= 100000);
+    check_grid(&s_pause, 0, n, period, period);
+    check_grid(&s_pause, n, m, period, period);
+    CHECK(sys_sched_get_stats(j, &st) == ESP_OK);
+    CHECK((int)st.runs == m && st.overruns == 0);
+    CHECK(st.period_err_max_us < period);       /* the pause is not a period error */
+}
+
+/* Argument checks and the static pools */
+static void test_limits(void)
+{
+    static trace_t spare;
+    sys_sched_handle_t h;
+    CHECK(sys_sched_add(s_exec, "zero", 0, job, &spare, false, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(sys_sched_add(s_exec, "nofn", 1000, NULL, &spare, false, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(sys_sched_add(NULL, "noexec", 1000, job, &spare, false, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(sys_sched_create("second", 2048, 5, tskNO_AFFINITY, &h) == ESP_OK);
+    CHECK(sys_sched_create("third", 2048, 5, tskNO_AFFINITY, &h) == ESP_ERR_NO_MEM);
+    int added = 0;
+    while (sys_sched_add(h, "spare", 1000, job, &spare, false, NULL) == ESP_OK) added++;
+    CHECK(added == CONFIG_SYS_SCHED_MAX_JOBS - 4);
+    CHECK(sys_sched_get_stats(NULL, NULL) == ESP_ERR_INVALID_ARG);
+}
+
+int main(void)
+{
+    CHECK(sys_sched_create("exec", 4096, 5, tskNO_AFFINITY, &s_exec) == ESP_OK);
+    test_fixed_rate();
+    test_overrun();
+    test_pause();
+    test_limits();
+    return host_test_done("sys_sched");
+}
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Summarize OTA benchmark runs (CONFIG_OTA_BENCH_ENABLE) from a serial log.
+
+Every "OTA_BENCH {...}" line is one run. Runs of the same case
+(rx_buf, tx_buf, keep_alive, conns, size) are aggregated by median, written as
+CSV and optionally compared with a baseline CSV produced by this script: a case
+whose median throughput drops by more than --threshold percent is reported
+and the exit status is 1. When the log holds a parallel sweep
+(CONFIG_OTA_PARALLEL_CONN > 1) the throughput curve over conns is printed too.
+Logs and CSVs without conns are read as single connection runs.
+
+Usage:
+    idf.py monitor | tee bench.log
+    python tools/ota_bench_report.py bench.log -o bench.csv
+    python tools/ota_bench_report.py bench.log --baseline release_1.0.csv
+"""
+import argparse
+import csv
+import json
+import statistics
+import sys
+
+KEY = ("rx_buf", "tx_buf", "keep_alive", "conns", "size")
+DEFAULTS = {"conns": 1}     # fields missing from older logs
+METRICS = ("kbps", "ms", "peak_heap", "arena", "cpu_us")
+
+
+def parse_log(path):
+    cases = {}
+    meta = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            tag, _, payload = line.partition(" {")
+            tag = tag.split()[-1] if tag.split() else ""
+            if tag not in ("OTA_BENCH", "OTA_BENCH_BEGIN"):
+                continue
+            try:
+                rec = json.loads("{" + payload.strip())
+            except ValueError:
+                continue    # line garbled by concurrent log output
+            if tag == "OTA_BENCH_BEGIN":
+                meta = rec
+            elif rec.get("err") == "ESP_OK":
+                cases.setdefault(tuple(rec.get(k, DEFAULTS.get(k)) for k in KEY), []).append(rec)
+            else:
+                print("run %s failed: %s" % (rec.get("run"), rec.get("err")), file=sys.stderr)
+    return meta, cases
+
+
+def summarize(cases):
+    rows = []
+    for key in sorted(cases):
+        runs = cases[key]
+        row = dict(zip(KEY, key))
+        row["runs"] = len(runs)
+        for m in METRICS:
+            row[m] = round(statistics.median(r.get(m, 0) for r in runs), 1)
+        row["kbps_min"] = min(r["kbps"] for r in runs)
+        rows.append(row)
+    return rows
+
+
+def load_csv(path):
+    with open(path) as f:
+        return {tuple(int(r.get(k) or DEFAULTS[k]) for k in KEY): r for r in csv.DictReader(f)}
+
+
+def print_curve(rows):
+    """Whole image throughput as the number of parallel connections grows."""
+    curves = {}
+    for row in rows:
+        if row["size"] == 0:
+            curves.setdefault((row["rx_buf"], row["tx_buf"], row["keep_alive"]), []).append(row)
+    for (rx_buf, tx_buf, keep_alive), points in sorted(curves.items()):
+        if len(points) < 2:
+            continue
+        base = points[0]["kbps"]
+        print("parallel curve rx_buf=%d tx_buf=%d keep_alive=%d:" % (rx_buf, tx_buf, keep_alive), file=sys.stderr)
+        for p in points:
+            print("  conns=%d %8.1f KB/s  x%.2f  peak_heap %d B  arena %d B" % (
+                p["conns"], p["kbps"], p["kbps"] / base if base else 0.0, p["peak_heap"], p["arena"]), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="serial log containing OTA_BENCH lines")
+    parser.add_argument("-o", "--output", help="write the summary CSV here (default: stdout)")
+    parser.add_argument("--baseline", help="summary CSV of a previous release")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed throughput drop in %% (default 10)")
+    args = parser.parse_args()
+
+    meta, cases = parse_log(args.log)
+    if not cases:
+        sys.exit("no successful OTA_BENCH runs in %s" % args.log)
+    if meta:
+        print("firmware %s, IDF %s, ring %d x %d B" % (meta.get("version"), meta.get("idf"),
+              meta.get("pipe_bufs", 0), meta.get("pipe_buf_size", 0)), file=sys.stderr)
+
+    rows = summarize(cases)
+    fields = list(KEY) + ["runs"] + list(METRICS) + ["kbps_min"]
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.DictWriter(out, fieldnames=fields)
+    writer.writeheader()
+    writer.writerows(rows)
+    if args.output:
+        out.close()
+    print_curve(rows)
+
+    if not args.baseline:
+        return
+    base = load_csv(args.baseline)
+    regressions = 0
+    for row in rows:
+        ref = base.get(tuple(row[k] for k in KEY))
+        if not ref:
+            continue
+        ref_kbps = float(ref["kbps"])
+        if ref_kbps > 0 and row["kbps"] < ref_kbps * (1 - args.threshold / 100):
+            regressions += 1
+            print("REGRESSION rx_buf=%d tx_buf=%d keep_alive=%d conns=%d size=%d: %.1f -> %.1f KB/s (%.1f%%)" % (
+                row["rx_buf"], row["tx_buf"], row["keep_alive"], row["conns"], row["size"],
+                ref_kbps, row["kbps"], 100.0 * (row["kbps"] - ref_kbps) / ref_kbps), file=sys.stderr)
+    if regressions:
+        sys.exit(1)
+    print("no throughput regression above %.0f%%" % args.threshold, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Generate the block manifest used by main/ota_blocksync.c.
+
+Output format (little endian):
+
+    header : "OBM1" | block_size u32 | image_len u32 | reserved u32 | image_sha256[32]
+    blocks : sha256[32] per block_size block of the image
+             (the last block is hashed over its actual length)
+
+Publish the manifest next to the raw image (same host, Range support
+required). With --base, the tool also reports how much of the new image a
+device running the base image would copy locally instead of downloading.
+
+Usage:
+    python tools/ota_blockmap.py build/ESP32_IDF_OTA_demo.bin firmware.obm
+    python tools/ota_blockmap.py build/ESP32_IDF_OTA_demo.bin firmware.obm --base old.bin
+"""
+import argparse
+import hashlib
+import struct
+
+MAGIC = b"OBM1"
+BLOCK_SIZE = 4096
+
+
+def block_hashes(image):
+    return [hashlib.sha256(image[off:off + BLOCK_SIZE]).digest() for off in range(0, len(image), BLOCK_SIZE)]
+
+
+def estimate(new_hashes, base):
+    """Mirror of the device matching: same position first, then any block aligned position."""
+    base_set = set(h[:8] for h in block_hashes(base))
+    local = sum(1 for h in new_hashes if h[:8] in base_set)
+    ranges, missing = 0, False
+    for h in new_hashes:
+        now_missing = h[:8] not in base_set
+        if now_missing and not missing:
+            ranges += 1
+        missing = now_missing
+    return local, ranges
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="new raw firmware image (.bin)")
+    parser.add_argument("output", help="block manifest")
+    parser.add_argument("--base", help="image running on the devices, to estimate the transfer")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    hashes = block_hashes(image)
+    header = MAGIC + struct.pack("<III", BLOCK_SIZE, len(image), 0) + hashlib.sha256(image).digest()
+    with open(args.output, "wb") as f:
+        f.write(header + b"".join(hashes))
+    print("%s: %d blocks, %d bytes" % (args.output, len(hashes), len(header) + 32 * len(hashes)))
+
+    if args.base:
+        with open(args.base, "rb") as f:
+            local, ranges = estimate(hashes, f.read())
+        fetched = len(image) - local * BLOCK_SIZE
+        print("from %s: %d/%d blocks local, ~%d KB fetched in %d range requests" % (
+            args.base, local, len(hashes), max(fetched, 0) // 1024, ranges))
+
+
+if __name__ == "__main__":
+    main()
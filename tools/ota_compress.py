@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Compress a firmware image for main/ota_decomp.c.
+
+Output format:
+
+    header    : "OHS1" | window_sz2 u8 | lookahead_sz2 u8 | reserved u16 | image_len u32
+    bitstream : heatshrink compatible LZSS, MSB first
+                1 + literal[8]
+                0 + (distance - 1)[window_sz2] + (length - 1)[lookahead_sz2]
+
+The device keeps a static 2^CONFIG_OTA_DECOMP_WINDOW_SZ2 byte window, so
+--window must not exceed that setting (default 12 -> 4 KB).
+
+Usage:
+    python tools/ota_compress.py build/ESP32_IDF_OTA_demo.bin firmware.ohs
+"""
+import argparse
+import struct
+import sys
+import time
+
+MAGIC = b"OHS1"
+MAX_CANDIDATES = 32     # hash chain entries checked per position
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.nbits = 0
+
+    def put(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.nbits += bits
+        while self.nbits >= 8:
+            self.nbits -= 8
+            self.out.append((self.acc >> self.nbits) & 0xFF)
+        self.acc &= (1 << self.nbits) - 1
+
+    def flush(self):
+        if self.nbits:
+            self.out.append((self.acc << (8 - self.nbits)) & 0xFF)
+            self.acc = 0
+            self.nbits = 0
+        return bytes(self.out)
+
+
+def compress(data, window_sz2, lookahead_sz2):
+    window = 1 << window_sz2
+    max_len = 1 << lookahead_sz2
+    # a back-reference costs 1 + w + l bits, a literal 9 bits
+    min_len = (1 + window_sz2 + lookahead_sz2) // 9 + 1
+    chains = {}
+    bw = BitWriter()
+    pos = 0
+    n = len(data)
+
+    def insert(p):
+        if p + 3 <= n:
+            chain = chains.setdefault(data[p:p + 3], [])
+            chain.append(p)
+            if len(chain) > MAX_CANDIDATES:
+                del chain[0]
+
+    while pos < n:
+        best_len, best_dist = 0, 0
+        if pos + 3 <= n:
+            limit = min(max_len, n - pos)
+            for cand in reversed(chains.get(data[pos:pos + 3], ())):
+                dist = pos - cand
+                if dist > window:
+                    break
+                length = 3
+                while length < limit and data[cand + length] == data[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, dist
+                    if length == limit:
+                        break
+        if best_len >= min_len:
+            bw.put(0, 1)
+            bw.put(best_dist - 1, window_sz2)
+            bw.put(best_len - 1, lookahead_sz2)
+            for p in range(pos, pos + best_len):
+                insert(p)
+            pos += best_len
+        else:
+            bw.put(1, 1)
+            bw.put(data[pos], 8)
+            insert(pos)
+            pos += 1
+    return bw.flush()
+
+
+def decompress(payload, window_sz2, lookahead_sz2, image_len):
+    """Reference decoder, used to self-check the output."""
+    out = bytearray()
+    bitpos = 0
+
+    def get(bits):
+        nonlocal bitpos
+        v = 0
+        for _ in range(bits):
+            byte = payload[bitpos >> 3]
+            v = (v << 1) | ((byte >> (7 - (bitpos & 7))) & 1)
+            bitpos += 1
+        return v
+
+    while len(out) < image_len:
+        if get(1):
+            out.append(get(8))
+        else:
+            dist = get(window_sz2) + 1
+            length = get(lookahead_sz2) + 1
+            for _ in range(length):
+                out.append(out[-dist])
+    return bytes(out[:image_len])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="raw firmware image (.bin)")
+    parser.add_argument("output", help="compressed image")
+    parser.add_argument("-w", "--window", type=int, default=12, help="log2 window size (default 12)")
+    parser.add_argument("-l", "--lookahead", type=int, default=4, help="log2 max match length (default 4)")
+    parser.add_argument("--no-verify", action="store_true", help="skip the decompression self-check")
+    args = parser.parse_args()
+
+    if not 4 <= args.window <= 14 or not 2 <= args.lookahead < args.window:
+        sys.exit("invalid window/lookahead")
+
+    with open(args.image, "rb") as f:
+        data = f.read()
+
+    t0 = time.time()
+    payload = compress(data, args.window, args.lookahead)
+    t1 = time.time()
+    if not args.no_verify and decompress(payload, args.window, args.lookahead, len(data)) != data:
+        sys.exit("internal error: round trip mismatch")
+
+    header = MAGIC + struct.pack("<BBHI", args.window, args.lookahead, 0, len(data))
+    with open(args.output, "wb") as f:
+        f.write(header + payload)
+
+    total = len(header) + len(payload)
+    print("%s: %d -> %d bytes, ratio %.2f, %.1f s" % (args.output, len(data), total, len(data) / total, t1 - t0))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Generate a delta patch for main/ota_delta.c.
+
+The patch rebuilds <new.bin> from the image currently running on the device
+(<old.bin>). Format (little endian):
+
+    header : "ODP1" | base_sha256[32] | base_len u32 | target_len u32 | target_sha256[32]
+    COPY   : 0x01 | src_offset u32 | len u32     (bytes taken from the running image)
+    INSERT : 0x02 | len u32 | <len bytes>        (bytes carried by the patch)
+    END    : 0x00
+
+base_sha256 is what esp_partition_get_sha256() returns for the running app
+partition: the SHA-256 appended to the image by esptool (or the SHA-256 of the
+whole file when no hash is appended).
+
+Usage:
+    python tools/ota_delta_gen.py old.bin new.bin patch.bin
+"""
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = b"ODP1"
+OP_END, OP_COPY, OP_INSERT = 0x00, 0x01, 0x02
+
+BLOCK = 32          # match seed length
+INDEX_STEP = 4      # old image is indexed every INDEX_STEP bytes
+MIN_COPY = 24       # shorter matches are cheaper as INSERT (COPY costs 9 bytes)
+
+IMAGE_HASH_APPENDED_OFFSET = 23   # esp_image_header_t.hash_appended
+
+
+def image_sha256(image):
+    """SHA-256 as reported by esp_partition_get_sha256() for an app image."""
+    if len(image) > 32 + IMAGE_HASH_APPENDED_OFFSET and image[IMAGE_HASH_APPENDED_OFFSET] == 1:
+        return image[-32:]
+    return hashlib.sha256(image).digest()
+
+
+def build_index(old):
+    index = {}
+    for off in range(0, len(old) - BLOCK + 1, INDEX_STEP):
+        index.setdefault(old[off:off + BLOCK], off)
+    return index
+
+
+def match_len(old, src, new, dst):
+    n = 0
+    limit = min(len(old) - src, len(new) - dst)
+    # compare in chunks first, then byte by byte
+    while n + 64 <= limit and old[src + n:src + n + 64] == new[dst + n:dst + n + 64]:
+        n += 64
+    while n < limit and old[src + n] == new[dst + n]:
+        n += 1
+    return n
+
+
+def diff(old, new):
+    index = build_index(old)
+    ops = []
+    literal = bytearray()
+    pos = 0
+    while pos < len(new):
+        src = index.get(new[pos:pos + BLOCK]) if pos + BLOCK <= len(new) else None
+        if src is not None:
+            n = match_len(old, src, new, pos)
+            if n >= MIN_COPY:
+                if literal:
+                    ops.append((OP_INSERT, bytes(literal)))
+                    literal = bytearray()
+                ops.append((OP_COPY, src, n))
+                pos += n
+                continue
+        literal.append(new[pos])
+        pos += 1
+    if literal:
+        ops.append((OP_INSERT, bytes(literal)))
+    return ops
+
+
+def encode(old, new, ops):
+    out = bytearray()
+    out += MAGIC
+    out += image_sha256(old)
+    out += struct.pack("<II", len(old), len(new))
+    out += hashlib.sha256(new).digest()
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack("<BII", OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack("<BI", OP_INSERT, len(op[1]))
+            out += op[1]
+    out += bytes([OP_END])
+    return bytes(out)
+
+
+def apply(old, patch):
+    """Reference applier, used to self-check every generated patch."""
+    pos = 76
+    out = bytearray()
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            return bytes(out)
+        if op == OP_COPY:
+            src, n = struct.unpack_from("<II", patch, pos)
+            pos += 8
+            out += old[src:src + n]
+        elif op == OP_INSERT:
+            (n,) = struct.unpack_from("<I", patch, pos)
+            pos += 4
+            out += patch[pos:pos + n]
+            pos += n
+        else:
+            raise ValueError("bad opcode 0x%02x" % op)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("old", help="image running on the device")
+    parser.add_argument("new", help="new image")
+    parser.add_argument("patch", help="output patch")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    patch = encode(old, new, diff(old, new))
+    if apply(old, patch) != new:
+        sys.exit("internal error: patch does not reproduce the new image")
+
+    with open(args.patch, "wb") as f:
+        f.write(patch)
+    print("%s: %d bytes (%.1f%% of %d)" % (args.patch, len(patch), 100.0 * len(patch) / max(len(new), 1), len(new)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,463 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host side of the LAN peer distribution (main/ota_peer.c, CONFIG_OTA_PEER_*).
+
+Speaks the same protocol as the firmware:
+
+    probe    (UDP, to the discovery port) : "OPQ1" | sha256[32] (zero: any image)
+    announce (UDP, back to the sender)    : "OPA1" | port u16 | free_slots u8 | max_slots u8
+                                            | image_len u32 | version[32] | sha256[32]
+    GET/HEAD /firmware.bin (HTTP)         : the image, single Range, ETag/If-Range,
+                                            503 + Retry-After when all client slots are taken
+
+Commands:
+    simulate  a whole site on this host: an origin with a capped uplink and N
+              devices on 127.0.0.2, 127.0.0.3, ... (Linux routes all of 127/8 to
+              the loopback; elsewhere add the aliases first). Devices start at random
+              times, read the manifest, try peers like the firmware does and serve
+              the image once they have it. Prints where every device got its image,
+              origin vs LAN bytes and the peak fan-out per peer; the exit code is 1
+              if an image was corrupted or a peer exceeded its fan-out.
+    probe     broadcast a probe on the real LAN and list the devices that answer.
+    serve     act as one more peer for real devices (serves a .bin on this host).
+
+Usage:
+    python tools/ota_peer_sim.py simulate build/ESP32_IDF_OTA_demo.bin --devices 20 --uplink-kbps 200
+    python tools/ota_peer_sim.py simulate build/ESP32_IDF_OTA_demo.bin --devices 20 --no-peers
+    python tools/ota_peer_sim.py probe --sha256 <manifest sha256>
+    python tools/ota_peer_sim.py serve build/ESP32_IDF_OTA_demo.bin --version 1.4.0
+"""
+import argparse
+import hashlib
+import http.client
+import http.server
+import json
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+PROBE_FMT = "<4s32s"
+ANNOUNCE_FMT = "<4sHBBI32s32s"
+PROBE_MAGIC = b"OPQ1"
+ANNOUNCE_MAGIC = b"OPA1"
+PATH = "/firmware.bin"
+HTTP_PORT = 8071            # CONFIG_OTA_PEER_HTTP_PORT
+DISCOVERY_PORT = 8072       # CONFIG_OTA_PEER_DISCOVERY_PORT
+CHUNK = 4096
+BUSY_WAIT_S = 2.0           # OTA_PEER_BUSY_WAIT_MS
+
+
+class Bucket:
+    """Throughput shared by every connection using it (the site uplink)."""
+
+    def __init__(self, rate):
+        self.rate = rate
+        self.lock = threading.Lock()
+        self.t = time.monotonic()
+
+    def take(self, n):
+        if not self.rate:
+            return
+        with self.lock:
+            start = max(time.monotonic(), self.t)
+            self.t = start + n / self.rate
+            until = self.t
+        delay = until - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+
+
+def send_paced(wfile, data, per_conn_rate, bucket=None):
+    t0 = time.monotonic()
+    for pos in range(0, len(data), CHUNK):
+        chunk = data[pos:pos + CHUNK]
+        if bucket:
+            bucket.take(len(chunk))
+        wfile.write(chunk)
+        if per_conn_rate:
+            ahead = (pos + len(chunk)) / per_conn_rate - (time.monotonic() - t0)
+            if ahead > 0:
+                time.sleep(ahead)
+
+
+def parse_range(value, size):
+    """(first, last), None for the whole image, False if unsatisfiable (as firmware_handler)."""
+    if not value.startswith("bytes=") or "," in value:
+        return None
+    a, _, b = value[6:].partition("-")
+    try:
+        if not a:
+            n = int(b)
+            return (max(0, size - n), size - 1) if n else False
+        first = int(a)
+        last = min(int(b), size - 1) if b else size - 1
+    except ValueError:
+        return None
+    return False if first >= size or first > last else (first, last)
+
+
+class Peer:
+    """The serving half of a device: slot limited HTTP server plus discovery responder."""
+
+    def __init__(self, ip, image, version, max_clients, slot_idle, lan_rate, http_port=HTTP_PORT,
+                 disc_port=DISCOVERY_PORT):
+        self.ip, self.image, self.version = ip, image, version
+        self.sha = hashlib.sha256(image).digest()
+        self.etag = '"%s"' % self.sha.hex()[:16]
+        self.max_clients, self.slot_idle, self.lan_rate = max_clients, slot_idle, lan_rate
+        self.http_port, self.disc_port = http_port, disc_port
+        self.slots = {}                 # client ip -> last activity
+        self.lock = threading.Lock()
+        self.workers = threading.Semaphore(max_clients)    # the firmware's transfer worker tasks
+        self.served = self.rejected = self.bytes = self.peak = 0
+
+    def _expire(self, now):
+        for ip in [ip for ip, t in self.slots.items() if now - t >= self.slot_idle]:
+            del self.slots[ip]
+
+    def slot_take(self, ip):
+        with self.lock:
+            now = time.monotonic()
+            self._expire(now)
+            if ip not in self.slots and len(self.slots) >= self.max_clients:
+                return False
+            self.slots[ip] = now
+            self.peak = max(self.peak, len(self.slots))
+            return True
+
+    def slot_release(self, ip):
+        with self.lock:
+            self.slots.pop(ip, None)
+
+    def slots_free(self):
+        with self.lock:
+            self._expire(time.monotonic())
+            return self.max_clients - len(self.slots)
+
+    def announce(self):
+        return struct.pack(ANNOUNCE_FMT, ANNOUNCE_MAGIC, self.http_port, self.slots_free(), self.max_clients,
+                           len(self.image), self.version.encode()[:31].ljust(32, b"\0"), self.sha)
+
+    def start(self):
+        peer = self
+
+        class Handler(http.server.BaseHTTPRequestHandler):
+            protocol_version = "HTTP/1.1"
+
+            def log_message(self, fmt, *args):
+                pass
+
+            def respond(self, head):
+                if self.path != PATH:
+                    self.send_error(404)
+                    return
+                if not peer.slot_take(self.client_address[0]):
+                    peer.rejected += 1
+                    self.send_response(503)
+                    self.send_header("Retry-After", "5")
+                    self.send_header("Content-Length", "0")
+                    self.end_headers()
+                    return
+                with peer.workers:
+                    size = len(peer.image)
+                    rng = None
+                    if self.headers.get("Range") and self.headers.get("If-Range", peer.etag) == peer.etag:
+                        rng = parse_range(self.headers["Range"], size)
+                    if rng is False:
+                        self.send_response(416)
+                        self.send_header("Content-Range", "bytes */%d" % size)
+                        self.send_header("Content-Length", "0")
+                        self.end_headers()
+                        return
+                    first, last = rng if rng else (0, size - 1)
+                    self.send_response(206 if rng else 200)
+                    self.send_header("Content-Type", "application/octet-stream")
+                    self.send_header("Content-Length", str(last - first + 1))
+                    self.send_header("Accept-Ranges", "bytes")
+                    self.send_header("ETag", peer.etag)
+                    self.send_header("X-Image-SHA256", peer.sha.hex())
+                    if rng:
+                        self.send_header("Content-Range", "bytes %d-%d/%d" % (first, last, size))
+                    self.end_headers()
+                    peer.served += 1
+                    if not head:
+                        peer.bytes += last - first + 1    # before: the client may finish first
+                        send_paced(self.wfile, peer.image[first:last + 1], peer.lan_rate)
+                        if last == size - 1:
+                            peer.slot_release(self.client_address[0])
+                        else:
+                            peer.slot_take(self.client_address[0])
+
+            def do_GET(self):
+                self.respond(False)
+
+            def do_HEAD(self):
+                self.respond(True)
+
+        self.httpd = http.server.ThreadingHTTPServer((self.ip, self.http_port), Handler)
+        self.httpd.daemon_threads = True
+        threading.Thread(target=self.httpd.serve_forever, daemon=True).start()
+
+        self.udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.udp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.udp.bind((self.ip, self.disc_port))
+        threading.Thread(target=self._respond_probes, daemon=True).start()
+
+    def _respond_probes(self):
+        while True:
+            try:
+                data, addr = self.udp.recvfrom(64)
+            except OSError:
+                return
+            if len(data) != struct.calcsize(PROBE_FMT):
+                continue
+            magic, sha = struct.unpack(PROBE_FMT, data)
+            if magic == PROBE_MAGIC and (sha == bytes(32) or sha == self.sha):
+                self.udp.sendto(self.announce(), addr)
+
+
+def discover(sha, version, targets, discover_ms, source_ip="0.0.0.0", broadcast=False):
+    """Probe twice (like ota_peer_discover): [(ip, announce)] with free slots (best first), and the full ones."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    if broadcast:
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.bind((source_ip, 0))
+    probe = struct.pack(PROBE_FMT, PROBE_MAGIC, sha)
+    t0 = time.monotonic()
+    deadline = t0 + discover_ms / 1000.0
+    found, probes = {}, 0
+    while time.monotonic() < deadline:
+        now = time.monotonic()
+        if probes < 2 and now >= t0 + (deadline - t0) * probes / 2:
+            for target in targets:
+                sock.sendto(probe, target)
+            probes += 1
+        next_evt = t0 + (deadline - t0) * probes / 2 if probes < 2 else deadline
+        sock.settimeout(max(0.001, next_evt - time.monotonic()))
+        try:
+            data, addr = sock.recvfrom(128)
+        except socket.timeout:
+            continue
+        if len(data) != struct.calcsize(ANNOUNCE_FMT):
+            continue
+        a = struct.unpack(ANNOUNCE_FMT, data)
+        if a[0] != ANNOUNCE_MAGIC or (sha != bytes(32) and a[6] != sha):
+            continue
+        if version and a[5].rstrip(b"\0").decode(errors="replace") != version:
+            continue
+        found[addr[0]] = a
+    sock.close()
+    peers = [(ip, a) for ip, a in found.items() if a[2] > 0]
+    random.shuffle(peers)
+    peers.sort(key=lambda p: -p[1][2])      # stable: random among equals
+    return peers, [(ip, a) for ip, a in found.items() if a[2] == 0]
+
+
+def fetch(host, port, path, source_ip, timeout=60):
+    conn = http.client.HTTPConnection(host, port, timeout=timeout, source_address=(source_ip, 0))
+    try:
+        conn.request("GET", path)
+        resp = conn.getresponse()
+        data = resp.read()
+        if resp.status != 200:
+            raise IOError("HTTP %d" % resp.status)
+        return data
+    finally:
+        conn.close()
+
+
+def simulate(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    sha = hashlib.sha256(image).digest()
+    version = args.version
+    uplink = Bucket(args.uplink_kbps * 1024)
+    lan_rate = int(args.lan_kbps * 1024)
+    origin_stats = {"bytes": 0}
+
+    class Origin(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt, *args):
+            pass
+
+        def do_GET(self):
+            if self.path == "/manifest.json":
+                body = json.dumps({"version": version, "sha256": sha.hex()}).encode()
+            elif self.path == PATH:
+                body = image
+            else:
+                self.send_error(404)
+                return
+            time.sleep(args.origin_latency_ms / 1000.0)
+            self.send_response(200)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            if self.path == PATH:
+                send_paced(self.wfile, body, 0, uplink)
+                origin_stats["bytes"] += len(body)
+            else:
+                self.wfile.write(body)
+
+    origin = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Origin)
+    origin.daemon_threads = True
+    origin_port = origin.server_address[1]
+    threading.Thread(target=origin.serve_forever, daemon=True).start()
+
+    ips = ["127.0.0.%d" % (2 + i) for i in range(args.seeds + args.devices)]
+    targets = [(ip, DISCOVERY_PORT) for ip in ips]
+    peers = {}
+    results = {}
+    lock = threading.Lock()
+
+    def make_peer(ip):
+        p = Peer(ip, image, version, args.max_clients, args.slot_idle, lan_rate)
+        p.start()
+        with lock:
+            peers[ip] = p
+
+    for ip in ips[:args.seeds]:
+        make_peer(ip)
+
+    def device(ip):
+        time.sleep(random.uniform(0, args.spread))
+        t0 = time.monotonic()
+        manifest = json.loads(fetch("127.0.0.1", origin_port, "/manifest.json", ip))
+        want = bytes.fromhex(manifest["sha256"])
+        source, data, tries, busy = None, None, 0, 0
+        for _ in range(0 if args.no_peers else args.max_tries):    # as ota_peer_download()
+            found, full = discover(want, manifest["version"], [t for t in targets if t[0] != ip],
+                                   args.discover_ms, ip)
+            if not found:
+                if not full:
+                    break               # nobody has the image yet
+                busy += 1
+                time.sleep(random.uniform(BUSY_WAIT_S, 2 * BUSY_WAIT_S))
+                continue
+            peer_ip, a = found[0]
+            tries += 1
+            try:
+                got = fetch(peer_ip, a[1], PATH, ip)
+            except (IOError, OSError, http.client.HTTPException) as e:
+                busy += "503" in str(e)
+                continue
+            if hashlib.sha256(got).digest() == want:    # the manifest digest, never the peer's
+                source, data = peer_ip, got
+                break
+        if data is None:
+            data = fetch("127.0.0.1", origin_port, PATH, ip)
+            source = "origin"
+        ok = hashlib.sha256(data).digest() == want
+        with lock:
+            results[ip] = (source, time.monotonic() - t0, tries, busy, ok)
+        if ok and not args.no_peers:
+            make_peer(ip)
+
+    t_start = time.monotonic()
+    threads = [threading.Thread(target=device, args=(ip,)) for ip in ips[args.seeds:]]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    wall = time.monotonic() - t_start
+
+    print("%-12s %-12s %7s %5s %5s %s" % ("device", "source", "time_s", "tries", "busy", "image"))
+    for ip in ips[args.seeds:]:
+        source, secs, tries, busy, ok = results[ip]
+        print("%-12s %-12s %7.2f %5d %5d %s" % (ip, source, secs, tries, busy, "ok" if ok else "CORRUPT"))
+    print()
+    print("%-12s %6s %8s %10s %5s" % ("peer", "served", "rejected", "bytes", "peak"))
+    over = False
+    for ip, p in sorted(peers.items(), key=lambda kv: socket.inet_aton(kv[0])):
+        if p.served or p.rejected:
+            print("%-12s %6d %8d %10d %3d/%d" % (ip, p.served, p.rejected, p.bytes, p.peak, p.max_clients))
+        over |= p.peak > p.max_clients
+    lan = sum(p.bytes for p in peers.values())
+    total = len(image) * args.devices
+    from_origin = sum(1 for r in results.values() if r[0] == "origin")
+    print()
+    print("%d devices, %d seeds: %d from origin, %d from LAN peers, %.1f s wall" % (
+        args.devices, args.seeds, from_origin, args.devices - from_origin, wall))
+    print("origin bytes %d (%.0f%% of %d without peers), LAN bytes %d" % (
+        origin_stats["bytes"], 100.0 * origin_stats["bytes"] / total, total, lan))
+    bad = [ip for ip, r in results.items() if not r[4]]
+    if bad or over:
+        print("FAIL: %s" % ("corrupted image on " + ", ".join(bad) if bad else "fan-out limit exceeded"))
+        sys.exit(1)
+
+
+def probe(args):
+    sha = bytes.fromhex(args.sha256) if args.sha256 else bytes(32)
+    free, full = discover(sha, args.version, [("255.255.255.255", args.port)], args.discover_ms, broadcast=True)
+    if not free and not full:
+        print("no peers answered")
+    for ip, a in free + full:
+        print("%-15s http://%s:%d%s  %s  %d B  slots %d/%d  sha256 %s" % (
+            ip, ip, a[1], PATH, a[5].rstrip(b"\0").decode(errors="replace"), a[4], a[2], a[3], a[6].hex()))
+
+
+def serve(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    peer = Peer("0.0.0.0", image, args.version, args.max_clients, args.slot_idle, int(args.lan_kbps * 1024),
+                args.http_port, args.port)
+    peer.start()
+    print("serving %s (%d B, sha256 %s) as %s on http :%d, discovery udp :%d" % (
+        args.image, len(image), peer.sha.hex(), args.version, args.http_port, args.port), file=sys.stderr)
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    print("%d served, %d rejected, %d bytes, peak %d clients" % (peer.served, peer.rejected, peer.bytes, peer.peak),
+          file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("simulate", help="simulate a site of devices on this host")
+    p.add_argument("image", help="firmware image")
+    p.add_argument("--devices", type=int, default=12, help="devices to update (default 12)")
+    p.add_argument("--seeds", type=int, default=0, help="devices already running the image (default 0)")
+    p.add_argument("--version", default="1.1.0", help="published version")
+    p.add_argument("--max-clients", type=int, default=2, help="CONFIG_OTA_PEER_MAX_CLIENTS (default 2)")
+    p.add_argument("--max-tries", type=int, default=4, help="CONFIG_OTA_PEER_MAX_TRIES (default 4)")
+    p.add_argument("--discover-ms", type=int, default=300, help="CONFIG_OTA_PEER_DISCOVER_MS (default 300)")
+    p.add_argument("--slot-idle", type=float, default=10.0, help="seconds before an idle client frees its slot")
+    p.add_argument("--uplink-kbps", type=float, default=200.0, help="site uplink shared by origin downloads")
+    p.add_argument("--origin-latency-ms", type=float, default=80.0, help="delay of every origin response")
+    p.add_argument("--lan-kbps", type=float, default=0.0, help="per connection LAN cap in KB/s (0: none)")
+    p.add_argument("--spread", type=float, default=10.0, help="devices start within this many seconds")
+    p.add_argument("--no-peers", action="store_true", help="baseline: every device uses the origin")
+    p.set_defaults(func=simulate)
+
+    p = sub.add_parser("probe", help="list LAN peers")
+    p.add_argument("--sha256", help="wanted image digest (default: any)")
+    p.add_argument("--version", help="wanted version (default: any)")
+    p.add_argument("--port", type=int, default=DISCOVERY_PORT, help="discovery port")
+    p.add_argument("--discover-ms", type=int, default=1000, help="listen time")
+    p.set_defaults(func=probe)
+
+    p = sub.add_parser("serve", help="serve an image to real devices as a LAN peer")
+    p.add_argument("image", help="firmware image")
+    p.add_argument("--version", required=True, help="version announced (must match the manifest)")
+    p.add_argument("--http-port", type=int, default=HTTP_PORT, help="HTTP port")
+    p.add_argument("--port", type=int, default=DISCOVERY_PORT, help="discovery port")
+    p.add_argument("--max-clients", type=int, default=2, help="fan-out")
+    p.add_argument("--slot-idle", type=float, default=10.0, help="seconds before an idle client frees its slot")
+    p.add_argument("--lan-kbps", type=float, default=0.0, help="per connection cap in KB/s (0: none)")
+    p.set_defaults(func=serve)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Sign a firmware image for main/ota_sign.c (CONFIG_OTA_SIGN_ENABLE).
+
+Output format (little endian):
+
+    header : "OSG1" | header_ver u8 | block_sz2 u8 | chip_id u16 | image_len u32
+             | block_count u16 | reserved u16 | version[32] | image_sha256[32]
+             | blocks_sha256[32] | sig_len u8 | signature[72]
+    table  : block_count x SHA-256 of each block of the raw image
+    payload: the image as given (raw .bin, or compressed by tools/ota_compress.py)
+
+The signature is ECDSA P-256 (DER) over the SHA-256 of the header bytes before
+sig_len. The device checks it, the chip target and the version before writing
+anything, then checks every block against the table while writing.
+
+The openssl command line tool does the key handling and signing.
+
+Usage:
+    python tools/ota_sign.py genkey ota_sign_key.pem server_certs/ota_sign_pub.pem
+    python tools/ota_sign.py sign ota_sign_key.pem build/ESP32_IDF_OTA_demo.bin firmware.signed
+    python tools/ota_sign.py sign ota_sign_key.pem firmware.ohs firmware.signed
+"""
+import argparse
+import hashlib
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+import ota_compress
+
+MAGIC = b"OSG1"
+HEADER_VER = 1
+HEADER_FMT = "<4sBBHIHH32s32s32s"   # signed part, sig_len and signature follow
+SIG_MAX = 72
+MAX_BLOCKS = 128                    # OTA_SIGN_MAX_BLOCKS
+MIN_BLOCK_SZ2 = 16                  # 64 KB blocks unless the image needs larger ones
+IMAGE_MAGIC = 0xE9
+APP_DESC_VERSION_OFFSET = 24 + 8 + 16   # image header, first segment header, app desc fields
+
+
+def openssl(*args, data=None):
+    try:
+        return subprocess.run(["openssl"] + list(args), input=data, check=True, capture_output=True).stdout
+    except FileNotFoundError:
+        sys.exit("openssl not found")
+    except subprocess.CalledProcessError as e:
+        sys.exit("openssl %s failed: %s" % (args[0], e.stderr.decode(errors="replace").strip()))
+
+
+def raw_image(payload):
+    """The image the device writes to flash: compressed payloads are decoded."""
+    if payload[:4] != ota_compress.MAGIC:
+        return payload
+    window, lookahead, _, image_len = struct.unpack_from("<BBHI", payload, 4)
+    return ota_compress.decompress(payload[12:], window, lookahead, image_len)
+
+
+def block_sz2(image_len):
+    sz2 = MIN_BLOCK_SZ2
+    while (image_len + (1 << sz2) - 1) >> sz2 > MAX_BLOCKS:
+        sz2 += 1
+    return sz2
+
+
+def genkey(args):
+    key = openssl("ecparam", "-name", "prime256v1", "-genkey", "-noout")
+    with open(args.key, "wb") as f:
+        f.write(key)
+    os.chmod(args.key, 0o600)
+    pub = openssl("ec", "-pubout", data=key)
+    with open(args.pubkey, "wb") as f:
+        f.write(pub)
+    print("%s: private key (keep it off the server), %s: public key for CONFIG_OTA_SIGN_PUBKEY_FILE"
+          % (args.key, args.pubkey))
+
+
+def sign(args):
+    with open(args.image, "rb") as f:
+        payload = f.read()
+    image = raw_image(payload)
+    if len(image) < APP_DESC_VERSION_OFFSET + 32 or image[0] != IMAGE_MAGIC:
+        sys.exit("%s is not an ESP application image" % args.image)
+
+    chip_id = struct.unpack_from("<H", image, 12)[0]
+    version = args.version.encode() if args.version else image[APP_DESC_VERSION_OFFSET:APP_DESC_VERSION_OFFSET + 32]
+    version = version.split(b"\0")[0][:31]
+    sz2 = block_sz2(len(image))
+    block = 1 << sz2
+    table = b"".join(hashlib.sha256(image[i:i + block]).digest() for i in range(0, len(image), block))
+    count = len(table) // 32
+
+    signed = struct.pack(HEADER_FMT, MAGIC, HEADER_VER, sz2, chip_id, len(image), count, 0,
+                         version.ljust(32, b"\0"), hashlib.sha256(image).digest(), hashlib.sha256(table).digest())
+    sig = openssl("dgst", "-sha256", "-sign", args.key, data=signed)
+    if len(sig) > SIG_MAX:
+        sys.exit("signature too long (%d B): the key must be ECDSA P-256" % len(sig))
+
+    if not args.no_verify:
+        with tempfile.TemporaryDirectory() as tmp:
+            pub, sig_file = os.path.join(tmp, "pub.pem"), os.path.join(tmp, "sig.der")
+            with open(pub, "wb") as f:
+                f.write(openssl("ec", "-in", args.key, "-pubout"))
+            with open(sig_file, "wb") as f:
+                f.write(sig)
+            openssl("dgst", "-sha256", "-verify", pub, "-signature", sig_file, data=signed)
+
+    header = signed + struct.pack("<B", len(sig)) + sig.ljust(SIG_MAX, b"\0")
+    with open(args.output, "wb") as f:
+        f.write(header + table + payload)
+    print("%s: %s, chip %d, %d B image in %d blocks of %d KB, %d B header + table" % (
+        args.output, version.decode(errors="replace"), chip_id, len(image), count, block // 1024,
+        len(header) + len(table)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("genkey", help="create a P-256 release key pair")
+    p.add_argument("key", help="private key to create (PEM)")
+    p.add_argument("pubkey", help="public key to create (PEM)")
+    p.set_defaults(func=genkey)
+    p = sub.add_parser("sign", help="sign a raw or compressed image")
+    p.add_argument("key", help="private key (PEM)")
+    p.add_argument("image", help="raw .bin or tools/ota_compress.py output")
+    p.add_argument("output", help="signed image")
+    p.add_argument("--version", help="version to sign (default: the app description of the image)")
+    p.add_argument("--no-verify", action="store_true", help="skip the signature self-check")
+    p.set_defaults(func=sign)
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# SPDX-License-Identifier: Apache-2.0
+"""
+Local stand-in OTA server for benchmarks (CONFIG_OTA_BENCH_ENABLE).
+
+Serves one firmware image over HTTP/1.1 (keep-alive) or HTTPS with the
+features the OTA HAL relies on: single "Range: bytes=a-b" requests answered
+with 206 and Content-Range, ETag/Last-Modified and If-Range, HEAD and
+If-None-Match. Every path returns the image (but the --file paths).
+
+A real server far away is emulated with:
+    --latency-ms  delay before each response (one round trip per request)
+    --rate-kbps   throughput cap of each connection (a window limited stream)
+
+so the parallel download sweep shows how throughput grows with the number of
+connections (CONFIG_OTA_PARALLEL_CONN) when a single stream is the bottleneck.
+
+Broken mirrors (CONFIG_OTA_MIRROR_URLS) are emulated with:
+    --fail-after-kb  drop the connection after that much of a response body
+    --fail-count     only for the first N bodies (0: all of them)
+    --status         answer every GET with this status (e.g. 503)
+
+Scripted tests (test/host) read what the client asked for from:
+    --request-log    one JSON line per response: method, Range, If-Range, status
+
+and publish files next to the image (e.g. a block manifest) with:
+    --file PATH=FILE serve FILE whole at URL path PATH instead of the image
+
+The ETag is derived from the image, so several instances serving the same file
+share it and a download failing over between them resumes at its checkpoint.
+
+Usage:
+    python tools/ota_test_server.py build/ESP32_IDF_OTA_demo.bin --latency-ms 80 --rate-kbps 200
+    python tools/ota_test_server.py firmware.bin --port 8443 --cert server_certs/ca_cert.pem --key server_certs/ca_key.pem
+
+Mirror failover, three instances (fast but dying, slow, refusing):
+    python tools/ota_test_server.py fw.bin --port 8070 --fail-after-kb 300 --fail-count 1 &
+    python tools/ota_test_server.py fw.bin --port 8071 --latency-ms 150 --rate-kbps 100 &
+    python tools/ota_test_server.py fw.bin --port 8072 --status 503 &
+"""
+import argparse
+import hashlib
+import http.server
+import json
+import os
+import re
+import socket
+import ssl
+import sys
+import threading
+import time
+
+CHUNK = 4096
+RANGE_RE = re.compile(r"bytes=(\d*)-(\d*)$")
+
+
+class OtaHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"   # keep-alive: ranged requests reuse the connection
+    image = b""
+    etag = ""
+    last_modified = ""
+    latency = 0.0
+    rate = 0                        # bytes/s per connection, 0 = unlimited
+    fail_after = 0                  # body bytes before the connection is dropped, 0 = never
+    fail_count = 0                  # bodies to cut, 0 = all
+    status = 0                      # forced GET status, 0 = normal
+    request_log = None              # file receiving one JSON line per response
+    files = {}                      # URL path -> contents served whole instead of the image
+    stats_lock = threading.Lock()
+    stats = {"requests": 0, "bytes": 0, "connections": 0, "failures": 0}
+
+    def setup(self):
+        super().setup()
+        # Headers and body go out in separate writes: don't let Nagle hold the body for the client's delayed ACK
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        with self.stats_lock:
+            self.stats["connections"] += 1
+
+    def log_message(self, fmt, *args):
+        if self.server.verbose:
+            super().log_message(fmt, *args)
+
+    def send_response(self, code, message=None):
+        super().send_response(code, message)
+        if self.request_log:
+            entry = {"method": self.command, "path": self.path, "range": self.headers.get("Range"),
+                     "if_range": self.headers.get("If-Range"), "status": code}
+            with self.stats_lock:
+                self.request_log.write(json.dumps(entry) + "\n")
+                self.request_log.flush()
+
+    def parse_range(self):
+        """(first, last) of a satisfiable single range, None for the whole image, False if unsatisfiable."""
+        value = self.headers.get("Range")
+        if not value:
+            return None
+        cond = self.headers.get("If-Range")
+        if cond and cond not in (self.etag, self.last_modified):
+            return None     # image changed: send it whole
+        m = RANGE_RE.match(value.strip())
+        if not m or (not m.group(1) and not m.group(2)):
+            return None     # multi-range and friends: ignore, as Range allows
+        size = len(self.image)
+        if not m.group(1):
+            first, last = max(0, size - int(m.group(2))), size - 1
+        else:
+            first = int(m.group(1))
+            last = min(int(m.group(2)), size - 1) if m.group(2) else size - 1
+        if first >= size or first > last:
+            return False
+        return first, last
+
+    def cut_at(self, size):
+        """Body bytes to send before dropping the connection, None to send it all."""
+        if not self.fail_after or size <= self.fail_after:
+            return None
+        with self.stats_lock:
+            if self.fail_count and self.stats["failures"] >= self.fail_count:
+                return None
+            self.stats["failures"] += 1
+        return self.fail_after
+
+    def send_body(self, data):
+        sent = 0
+        t0 = time.monotonic()
+        cut = self.cut_at(len(data))
+        while sent < len(data):
+            if cut is not None and sent >= cut:
+                self.log_message("dropping connection after %d bytes", sent)
+                self.close_connection = True
+                self.wfile.flush()
+                self.connection.shutdown(socket.SHUT_RDWR)
+                break
+            chunk = data[sent:sent + CHUNK]
+            self.wfile.write(chunk)
+            sent += len(chunk)
+            if self.rate:
+                ahead = sent / self.rate - (time.monotonic() - t0)
+                if ahead > 0:
+                    time.sleep(ahead)
+        with self.stats_lock:
+            self.stats["bytes"] += sent
+
+    def respond(self, head):
+        with self.stats_lock:
+            self.stats["requests"] += 1
+        if self.latency:
+            time.sleep(self.latency)
+
+        if self.status and not head:
+            self.send_response(self.status)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+
+        if self.path in self.files:
+            body = self.files[self.path]
+            self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            if not head:
+                self.send_body(body)
+            return
+
+        if self.headers.get("If-None-Match") == self.etag:
+            self.send_response(304)
+            self.send_header("ETag", self.etag)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+
+        rng = self.parse_range()
+        size = len(self.image)
+        if rng is False:
+            self.send_response(416)
+            self.send_header("Content-Range", "bytes */%d" % size)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+        first, last = rng if rng else (0, size - 1)
+        self.send_response(206 if rng else 200)
+        if rng:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (first, last, size))
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(last - first + 1))
+        self.send_header("Accept-Ranges", "bytes")
+        self.send_header("ETag", self.etag)
+        self.send_header("Last-Modified", self.last_modified)
+        self.end_headers()
+        if not head:
+            self.send_body(self.image[first:last + 1])
+
+    def do_GET(self):
+        self.respond(False)
+
+    def do_HEAD(self):
+        self.respond(True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="firmware image to serve")
+    parser.add_argument("--host", default="0.0.0.0", help="listen address (default 0.0.0.0)")
+    parser.add_argument("--port", type=int, default=8070, help="listen port (default 8070)")
+    parser.add_argument("--latency-ms", type=float, default=0.0, help="delay added before every response")
+    parser.add_argument("--rate-kbps", type=float, default=0.0, help="per connection throughput cap in KB/s (0: none)")
+    parser.add_argument("--fail-after-kb", type=float, default=0.0, help="drop the connection after this much of a body")
+    parser.add_argument("--fail-count", type=int, default=0, help="bodies cut by --fail-after-kb (0: all)")
+    parser.add_argument("--status", type=int, default=0, help="answer every GET with this HTTP status")
+    parser.add_argument("--request-log", help="append one JSON line per response to this file")
+    parser.add_argument("--file", action="append", default=[], metavar="PATH=FILE",
+                        help="serve FILE whole at URL path PATH (repeatable)")
+    parser.add_argument("--cert", help="PEM certificate: serve HTTPS")
+    parser.add_argument("--key", help="PEM private key of --cert")
+    parser.add_argument("-v", "--verbose", action="store_true", help="log every request")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    OtaHandler.image = image
+    OtaHandler.etag = '"%s"' % hashlib.sha256(image).hexdigest()[:16]
+    OtaHandler.last_modified = time.strftime("%a, %d %b %Y %H:%M:%S GMT", time.gmtime(os.path.getmtime(args.image)))
+    OtaHandler.latency = args.latency_ms / 1000.0
+    OtaHandler.rate = int(args.rate_kbps * 1024)
+    OtaHandler.fail_after = int(args.fail_after_kb * 1024)
+    OtaHandler.fail_count = args.fail_count
+    OtaHandler.status = args.status
+    if args.request_log:
+        OtaHandler.request_log = open(args.request_log, "a")
+    for spec in args.file:
+        path, sep, name = spec.partition("=")
+        if not sep or not path.startswith("/"):
+            parser.error("--file expects /PATH=FILE, got %s" % spec)
+        with open(name, "rb") as f:
+            OtaHandler.files[path] = f.read()
+
+    server = http.server.ThreadingHTTPServer((args.host, args.port), OtaHandler)
+    server.daemon_threads = True
+    server.verbose = args.verbose
+    scheme = "http"
+    if args.cert:
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        ctx.load_cert_chain(args.cert, args.key)
+        server.socket = ctx.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+
+    print("serving %s (%d B, ETag %s) on %s://%s:%d, latency %.0f ms, cap %s" % (
+        args.image, len(image), OtaHandler.etag, scheme, args.host, args.port, args.latency_ms,
+        "%.0f KB/s per connection" % args.rate_kbps if args.rate_kbps else "none"), file=sys.stderr)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    s = OtaHandler.stats
+    print("%d connections, %d requests, %d bytes sent, %d bodies cut" % (
+        s["connections"], s["requests"], s["bytes"], s["failures"]), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()